@@ -0,0 +1,26 @@
+; F(n) для n из ввода — ruby/fibonacci_asm.rb с метками вместо смещений
+        ADDI r8, r0, 3          ; SYS_READ_INT
+        SYSCALL
+        ADD r1, r0, r3          ; r1 = n
+
+        ADDI r2, r0, 0          ; F(i-1)
+        ADDI r3, r0, 1          ; F(i)
+        ADDI r4, r0, 1          ; i
+
+        BEQ r1, r0, zero
+        ADDI r5, r0, 1
+        BEQ r1, r5, print
+
+loop:   ADDI r4, r4, 1
+        ADD r6, r2, r3
+        ADD r2, r0, r3
+        ADD r3, r0, r6
+        BNE r4, r1, loop
+
+print:  ADDI r8, r0, 1          ; SYS_PRINT_INT
+        SYSCALL
+        ADDI r8, r0, 0          ; SYS_EXIT
+        SYSCALL
+
+zero:   ADDI r3, r0, 0
+        J print
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "bitops.hpp"
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "simd.hpp"
+
+class Machine;
+
+// Трансляция заранее (AOT): cpu_emulator aot превращает образ в C++, где каждый
+// базовый блок — прямой код над локальными копиями регистров CPU::State и Memory.
+// Оттранслированный код не поднимает ошибок и не делает системных вызовов сам:
+// на SYSCALL, неизвестной инструкции, обращении за size(), невыровненном CAS
+// и переходе вне оттранслированного кода он выходит, и эту инструкцию исполняет
+// интерпретатор (run_aot) — с его же семантикой ловушек и системных вызовов
+enum class AotExit : uint8_t
+{
+    Interpret,      // инструкцию по state.pc выполняет интерпретатор, затем трансляция продолжается
+    CodeWrite       // инструкция по state.pc пишет в оттранслированный код: дальше только интерпретатор
+};
+
+// Слово, по которому шла трансляция: run_aot сверяет их с памятью перед запуском
+struct AotWord
+{
+    uint32_t address;
+    uint32_t word;
+};
+
+// Дескриптор, который экспортирует сгенерированный файл
+struct AotProgram
+{
+    // Исполняет с state.pc до выхода; к retired прибавляет выполненные инструкции
+    AotExit (*run)(CPU::State& state, Memory& memory, uint64_t& retired);
+    const AotWord* words;
+    size_t word_count;
+    uint32_t load_address;      // для сырого кода, как --load-address при трансляции
+    uint64_t memory_size;
+};
+
+struct AotOptions
+{
+    std::string name = "aot_program";   // имя дескриптора; функции получают его как префикс
+    std::string source;                 // откуда взят код — только для комментария в начале файла
+    uint32_t load_address = 0x1000;
+    uint64_t memory_size = 64 * 1024;
+};
+
+// C++ исходник программы из memory. Трансляция идёт по графу потока управления
+// от entry внутри диапазонов code ([begin, end)); недостижимые слова не транслируются
+std::string translate_to_cpp(const Memory& memory, const std::vector<std::pair<uint32_t, uint32_t>>& code,
+                             uint32_t entry, const AotOptions& options);
+
+// То же для образа на диске (сырой код или CEXE), загруженного как в cpu_emulator.
+// Ошибки загрузки — std::runtime_error
+std::string translate_image(const std::string& path, AotOptions options);
+
+// Исполняет программу на machine, начиная с её PC. Лимиты run() не действуют.
+// std::runtime_error, если код в памяти не совпадает с оттранслированным
+CPU::RunStatus run_aot(const AotProgram& program, Machine& machine);
+
+// main сгенерированного файла: <программа> IMAGE — загружает образ и исполняет
+// его как cpu_emulator IMAGE; код выхода тот же
+int aot_main(const AotProgram& program, int argc, char** argv);
@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "image.hpp"
+
+struct AssemblerOptions
+{
+    uint32_t base = DEFAULT_LOAD_ADDRESS;   // адрес первой инструкции
+    uint32_t data_base = 0;                 // 0 — сразу за кодом, с выравниванием на страницу
+};
+
+// Ошибка в исходном тексте; what() — "name:line: message"
+class AssemblyError : public std::runtime_error
+{
+public:
+    AssemblyError(const std::string& name, size_t line, const std::string& message)
+        : std::runtime_error(name + ":" + std::to_string(line) + ": " + message), line(line), message(message) {}
+
+    size_t get_line() const { return line; }
+    const std::string& get_message() const { return message; }
+
+private:
+    size_t line;
+    std::string message;
+};
+
+// Собранная программа. Сегменты — с байтами, как для save_image: сегмент кода,
+// затем данные и BSS, если они есть. Символы — все метки по возрастанию адреса
+struct Assembly
+{
+    uint32_t entry = 0;
+    std::vector<ImageSegment> segments;
+    std::vector<ImageSymbol> symbols;
+    size_t instructions = 0;
+};
+
+// Ассемблер в синтаксисе ReadMe, без учёта регистра мнемоник: "ADDI r1, r0, 5",
+// "LD r3, 8(r2)", "BNE r1, r0, loop". Один проход по тексту; ссылки вперёд
+// дописываются в конце. Операнд перехода — метка или смещение в инструкциях (#-3),
+// у J — метка или индекс. Метки — "name:" в начале строки.
+// Комментарии — ';', "//" и '#', за которым не идёт число.
+// Директивы: .text, .data, .bss — секция; .word — слова (можно метки); .ascii "..." —
+// байты строки; .space N — нули (в BSS — резерв); .align N; .entry label — точка входа.
+// name — имя источника в сообщениях об ошибках
+Assembly assemble(const std::string& source, const AssemblerOptions& options = {},
+                  const std::string& name = "<input>");
+
+// std::runtime_error, если файл не открыть
+Assembly assemble_file(const std::string& path, const AssemblerOptions& options = {});
+
+// *.s и *.asm: load_image собирает их в памяти, а не читает как образ
+bool is_assembly_source(const std::string& path);
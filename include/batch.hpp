@@ -0,0 +1,74 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "machine.hpp"
+
+// Пакетный прогон множества заданий (программа, ввод) на пуле потоков с кражей
+// работы. У каждого рабочего потока одна Machine на все его задания: образ
+// загружается один раз, дальше машина возвращается к снимку после загрузки,
+// переписывая только изменённые заданием страницы
+
+struct BatchJob
+{
+    std::string program;
+    std::vector<int32_t> input;         // значения для SYS_READ_INT по порядку
+};
+
+struct BatchResult
+{
+    CPU::RunStatus status = CPU::RunStatus::Running;
+    CPU::Fault fault = CPU::Fault::None;
+    uint32_t fault_pc = 0;
+    CPU::StopReason stop_reason = CPU::StopReason::None;
+    uint32_t result = 0;                // r3 после останова
+    uint64_t instructions = 0;
+    std::string output;                 // всё, что программа вывела системными вызовами
+    std::string error;                  // не пусто, если программу не удалось загрузить
+};
+
+struct BatchOptions
+{
+    unsigned threads = 0;               // 0 — по числу ядер
+    size_t memory_size = Machine::DEFAULT_SIZE;
+    CPU::Engine engine = CPU::Engine::Switch;
+    bool fusion = true;
+    bool decode_cache = true;
+    uint64_t max_instructions = 0;      // на задание, 0 — без лимита
+    std::chrono::steady_clock::duration time_limit{};
+    size_t lanes = 0;                   // больше 1 — задания одной программы идут группами в лок-степе (lockstep.hpp)
+};
+
+// Манифест: по заданию на строку — путь к программе и числа для SYS_READ_INT
+// через пробел. Пустые строки и строки, начинающиеся с '#', пропускаются.
+// Относительные пути отсчитываются от каталога манифеста
+std::vector<BatchJob> read_manifest(const std::string& path);
+
+class BatchRunner
+{
+public:
+    struct Stats
+    {
+        size_t jobs = 0;
+        unsigned threads = 0;
+        uint64_t instructions = 0;
+        uint64_t steals = 0;            // заданий, взятых из чужой очереди
+        double seconds = 0;
+
+        double jobs_per_second() const { return seconds > 0 ? jobs / seconds : 0.0; }
+        double instructions_per_second() const { return seconds > 0 ? instructions / seconds : 0.0; }
+    };
+
+    explicit BatchRunner(const BatchOptions& options = {}) : options(options) {}
+
+    // Результаты — в порядке заданий
+    std::vector<BatchResult> run(const std::vector<BatchJob>& jobs);
+
+    const Stats& get_stats() const { return stats; }
+
+private:
+    BatchOptions options;
+    Stats stats;
+};
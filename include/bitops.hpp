@@ -0,0 +1,50 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+// CLS: сколько старших битов равны знаковому, считая его самого (1..32).
+// Без ветвлений: x = value ^ знак, дальше clz; бит 31 младшего слова даёт 32 при x == 0.
+// На x86-64 это bsr, с -mlzcnt — lzcnt
+inline uint32_t count_leading_signs(uint32_t value)
+{
+    uint32_t x = value ^ static_cast<uint32_t>(static_cast<int32_t>(value) >> 31);
+    uint64_t wide = (uint64_t{x} << 32) | 0x80000000u;
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long index;
+    _BitScanReverse64(&index, wide);
+    return 63 - index;
+#else
+    return static_cast<uint32_t>(__builtin_clzll(wide));
+#endif
+}
+
+// BEXT: биты value на позициях единиц mask, упакованные в младшие разряды (PEXT).
+// Реализация выбирается при запуске по CPUID: BMI2 pext или переносимая
+// параллельная выборка без ветвлений
+struct BitExtract
+{
+    const char* name;               // "pext" | "portable"
+    uint32_t (*extract)(uint32_t value, uint32_t mask);
+};
+
+// Выбранная реализация; до динамической инициализации — переносимая
+extern const BitExtract* bit_extract;
+
+inline uint32_t extract_bits(uint32_t value, uint32_t mask)
+{
+    return bit_extract->extract(value, mask);
+}
+
+// Все реализации, которые может исполнить этот процессор, лучшая первой
+const std::vector<BitExtract>& bit_extract_implementations();
+
+// Переключает реализацию по имени (тесты, бенчмарки); false, если её нет.
+// Не потокобезопасно: вызывать, пока ни один CPU не исполняет код. JIT читает
+// выбор при трансляции, поэтому уже оттранслированные блоки его не заметят
+bool select_bit_extract(const std::string& name);
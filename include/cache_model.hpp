@@ -0,0 +1,255 @@
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Memory;
+
+enum class Replacement : uint8_t
+{
+    Lru,
+    Fifo,
+    Random
+};
+
+// Где нашлось обращение: в L1, в L2 или пришлось идти в память
+enum class CacheLevel : uint8_t
+{
+    L1,
+    L2,
+    Memory
+};
+
+struct CacheConfig
+{
+    uint32_t size = 32 * 1024;          // байт; size, ways и line — степени двойки
+    uint32_t ways = 8;
+    uint32_t line = 64;
+    Replacement replacement = Replacement::Lru;
+};
+
+// Один уровень: множественно-ассоциативный кэш с обратной записью и размещением
+// при записи. Теги и возрасты строк лежат плоскими массивами, набор — ways подряд
+class Cache
+{
+public:
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Stats
+    {
+        uint64_t accesses = 0;
+        uint64_t misses = 0;
+        uint64_t writebacks = 0;        // вытеснено грязных строк
+
+        double miss_rate() const { return accesses ? static_cast<double>(misses) / static_cast<double>(accesses) : 0.0; }
+    };
+
+    // std::invalid_argument, если размеры не степени двойки или строк меньше, чем путей
+    explicit Cache(const CacheConfig& config);
+
+    // true — попадание. При промахе строка размещается; если вытеснена грязная,
+    // её адрес попадает в writeback, иначе там NONE
+    bool access(uint32_t address, bool write, uint32_t& writeback)
+    {
+        stats.accesses++;
+        uint32_t line = address >> line_shift;
+
+        // Подряд идущие обращения к одной строке (выборка линейного кода, проход по массиву)
+        // обходятся без поиска: порядок LRU от них не меняется
+        if (line == last_line)
+        {
+            dirty[last_slot] |= write;
+            writeback = NONE;
+            return true;
+        }
+        return lookup(line, write, writeback);
+    }
+
+    const CacheConfig& get_config() const { return config; }
+    const Stats& get_stats() const { return stats; }
+
+    void clear();
+
+private:
+    CacheConfig config;
+    uint32_t line_shift;
+    uint32_t set_mask;
+
+    std::vector<uint32_t> tags;         // номер строки + 1; 0 — пусто
+    std::vector<uint64_t> stamps;       // LRU — последнее обращение, FIFO — размещение
+    std::vector<uint8_t> dirty;
+    uint64_t clock = 0;
+    uint64_t random_state = 0x9E3779B97F4A7C15ull;
+
+    uint32_t last_line = NONE;
+    size_t last_slot = 0;
+
+    Stats stats;
+
+    bool lookup(uint32_t line, bool write, uint32_t& writeback);
+};
+
+struct CacheModelOptions
+{
+    CacheConfig l1i;
+    CacheConfig l1d;
+    CacheConfig l2 = { 256 * 1024, 8, 64, Replacement::Lru };
+    bool has_l2 = true;
+    uint32_t region_shift = 12;         // обращения к данным суммируются по диапазонам в 1 << region_shift байт
+};
+
+// Модель иерархии кэшей гостя: L1 инструкций, L1 данных и общий L2. Пока модель
+// подключена (CPU::set_cache_model), CPU::run исполняет код эталонным интерпретатором
+// по одной инструкции, как с профилировщиком, а step() тоже сообщает ей о своих
+// обращениях. Промахи считаются по PC инструкции и по диапазонам адресов данных
+class CacheModel
+{
+public:
+    struct Counters
+    {
+        uint64_t accesses = 0;
+        uint64_t l1_misses = 0;
+        uint64_t l2_misses = 0;         // промахи L2 — обращения к памяти
+    };
+
+    struct PcCounters
+    {
+        Counters fetch;
+        Counters data;
+    };
+
+    static constexpr uint32_t PAGE_SHIFT = 12;
+    static constexpr uint32_t PAGE_WORDS = (1u << PAGE_SHIFT) / 4;
+
+    // std::invalid_argument при неверной геометрии кэша
+    explicit CacheModel(const CacheModelOptions& options = {});
+
+    // Выборка инструкции по pc
+    CacheLevel fetch(uint32_t pc)
+    {
+        Counters& counters = at(pc).fetch;
+        counters.accesses++;
+
+        uint32_t writeback;
+        if (l1i.access(pc, false, writeback))
+        {
+            return CacheLevel::L1;
+        }
+        counters.l1_misses++;
+        if (next_level(pc, writeback))
+        {
+            return CacheLevel::L2;
+        }
+        counters.l2_misses++;
+        return CacheLevel::Memory;
+    }
+
+    // Обращение инструкции по pc к size байтам данных с address; строки, которые
+    // оно задевает, учитываются по отдельности. Результат — самый дальний уровень из двух
+    CacheLevel data(uint32_t pc, uint32_t address, uint32_t size, bool write)
+    {
+        CacheLevel level = access_line(pc, address, write);
+        uint32_t last = address + size - 1;
+        if ((last ^ address) >> data_shift)
+        {
+            level = std::max(level, access_line(pc, last, write));
+        }
+        return level;
+    }
+
+    const Cache& get_l1i() const { return l1i; }
+    const Cache& get_l1d() const { return l1d; }
+    const Cache* get_l2() const { return l2.get(); }
+    uint32_t get_region_shift() const { return options.region_shift; }
+
+    // nullptr, если инструкция по pc ни разу не выбиралась и не обращалась к данным
+    const PcCounters* find(uint32_t pc) const;
+
+    // Обращения к данным в диапазоне, куда попадает address; nullptr, если их не было
+    const Counters* find_region(uint32_t address) const;
+
+    // Отчёт: промахи по уровням, инструкции с наибольшим числом промахов
+    // (тексты читаются из memory) и самые промахивающиеся диапазоны данных
+    void report(std::ostream& out, const Memory& memory, size_t top = 10) const;
+
+    void clear();
+
+private:
+    struct Page
+    {
+        std::array<PcCounters, PAGE_WORDS> counters{};
+    };
+
+    CacheModelOptions options;
+    Cache l1i;
+    Cache l1d;
+    std::unique_ptr<Cache> l2;
+    uint32_t data_shift;
+
+    std::unordered_map<uint32_t, std::unique_ptr<Page>> pages;
+    uint32_t last_index = UINT32_MAX;
+    Page* last_page = nullptr;
+
+    // Диапазоны — так же, как счётчики по PC: страницами по REGION_PAGE штук,
+    // которые заводятся при первом обращении. Плотный вектор при region_shift = 2
+    // и 4 ГиБ гостя занял бы десятки гигабайт
+    static constexpr uint32_t REGION_PAGE_SHIFT = 10;
+
+    struct RegionPage
+    {
+        std::array<Counters, 1u << REGION_PAGE_SHIFT> counters{};
+    };
+
+    std::unordered_map<uint32_t, std::unique_ptr<RegionPage>> region_pages;
+    uint32_t last_region_index = UINT32_MAX;
+    RegionPage* last_region_page = nullptr;
+
+    PcCounters& at(uint32_t pc)
+    {
+        uint32_t index = pc >> PAGE_SHIFT;
+        if (index != last_index)
+        {
+            auto& page = pages[index];
+            if (!page)
+            {
+                page = std::make_unique<Page>();
+            }
+            last_index = index;
+            last_page = page.get();
+        }
+        return last_page->counters[(pc & ((1u << PAGE_SHIFT) - 1)) >> 2];
+    }
+
+    Counters& region_at(uint32_t address)
+    {
+        uint32_t index = address >> options.region_shift;
+        uint32_t page_index = index >> REGION_PAGE_SHIFT;
+        if (page_index != last_region_index)
+        {
+            auto& page = region_pages[page_index];
+            if (!page)
+            {
+                page = std::make_unique<RegionPage>();
+            }
+            last_region_index = page_index;
+            last_region_page = page.get();
+        }
+        return last_region_page->counters[index & ((1u << REGION_PAGE_SHIFT) - 1)];
+    }
+
+    CacheLevel access_line(uint32_t pc, uint32_t address, bool write);
+
+    // Промах L1: вытесненная грязная строка (writeback) пишется в L2, сама строка
+    // читается оттуда. true — попадание в L2
+    bool next_level(uint32_t address, uint32_t writeback);
+};
+
+// Разбор --cache: через запятую LEVEL=SIZE:WAYS:LINE[:POLICY], LEVEL — l1i, l1d или l2,
+// SIZE — байты с суффиксом K или M, POLICY — lru, fifo или random; l2=none отключает L2.
+// Неупомянутые уровни остаются по умолчанию. std::invalid_argument при ошибке
+CacheModelOptions parse_cache_options(const std::string& spec);
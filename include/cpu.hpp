@@ -1,3 +1,5 @@
+#pragma once
+#include <chrono>
 #include <cstdint>
 #include <vector>
 #include <memory>
@@ -5,60 +7,266 @@
 #include <iostream>
 
 #include "memory.hpp"
+#include "decode_cache.hpp"
+#include "jit.hpp"
+#include "simd.hpp"
+#include "syscall_io.hpp"
+
+enum class CacheLevel : uint8_t;
+class CacheModel;
+class Profiler;
+class TimingModel;
+class TraceWriter;
 
 class CPU
 {
 private:
     std::array<uint32_t, 32> gpr;
+    std::array<VectorRegister, 32> vr;
     uint32_t pc;
     bool should_halt = false;
     bool branch_flag = false;
 
 public:
 
-     CPU() : pc(0) {
+    // Ошибки гостя — не исключения, а состояние CPU: run() останавливается,
+    // PC указывает на виновную инструкцию, её результат не записан
+    enum class Fault : uint8_t
+    {
+        None,
+        MemoryAccess,       // обращение за пределы памяти (в том числе выборка инструкции), невыровненный CAS
+        IllegalInstruction, // неизвестный opcode или funct
+        UnknownSyscall,     // неизвестный номер в r8
+        InputWait           // не ошибка и наружу не видна: run()/step() делают из неё StopReason::InputWait
+    };
+
+    enum class RunStatus : uint8_t
+    {
+        Running,            // только step(): инструкция выполнена, останова нет
+        Halted,             // SYS_EXIT
+        Faulted,            // см. get_fault()
+        Stopped             // лимит run() исчерпан, см. get_stop_reason(); следующий run() продолжит
+    };
+
+    enum class StopReason : uint8_t
+    {
+        None,
+        InstructionLimit,
+        TimeLimit,
+        InputWait           // SYS_READ_INT/SYS_READ_STR, а SyscallIO ещё не готов; PC на SYSCALL
+    };
+
+    static const char* stop_reason_name(StopReason reason) noexcept
+    {
+        switch (reason)
+        {
+            case StopReason::InstructionLimit: return "instruction limit reached";
+            case StopReason::TimeLimit:        return "time limit reached";
+            case StopReason::InputWait:        return "waiting for input";
+            default:                           return "not stopped";
+        }
+    }
+
+    static const char* fault_name(Fault fault) noexcept
+    {
+        switch (fault)
+        {
+            case Fault::None:               return "none";
+            case Fault::MemoryAccess:       return "memory access out of range";
+            case Fault::IllegalInstruction: return "illegal instruction";
+            case Fault::UnknownSyscall:     return "unknown syscall";
+            case Fault::InputWait:          return "waiting for input";
+        }
+        return "unknown";
+    }
+
+    enum class Engine : uint8_t
+    {
+        Switch,     // execute_instruction: switch по opcode, затем по funct
+        Threaded,   // шитый код: computed goto (GCC/Clang) или таблица обработчиков
+        Jit         // интерпретатор + трансляция горячих блоков в x86-64 (иначе Threaded)
+    };
+
+    // Суперинструкции: частые пары, слитые при загрузке в одну операцию шитого кода
+    enum Fusion : uint8_t
+    {
+        FUSE_ADDI_BNE,      // ADDI rX, rX, imm + BNE rX, rY, off (счётчик цикла)
+        FUSE_MOVE_PAIR,     // ADD rd, r0, rs + ADD rd2, r0, rs2 (пересылки регистров)
+        FUSE_SYSCALL_IMM,   // ADDI r8, r0, N + SYSCALL
+        FUSE_COUNT
+    };
+
+    struct FusionStats
+    {
+        std::array<uint64_t, FUSE_COUNT> sites{};       // слито пар при загрузке
+        std::array<uint64_t, FUSE_COUNT> executed{};    // выполнено слитых операций
+
+        // Каждая выполненная слитая операция — на один диспатч меньше
+        uint64_t dispatches_saved() const
+        {
+            uint64_t total = 0;
+            for (uint64_t count : executed) total += count;
+            return total;
+        }
+
+        static const char* name(size_t kind)
+        {
+            static const char* const names[FUSE_COUNT] = { "ADDI+BNE", "MOVE+MOVE", "ADDI r8+SYSCALL" };
+            return names[kind];
+        }
+    };
+
+private:
+    Fault fault = Fault::None;
+    uint32_t fault_pc = 0;
+    uint32_t fault_address = 0;
+
+    // Выполненные (retired) инструкции: слитая пара считается за две,
+    // инструкция, вызвавшая ошибку, не считается
+    uint64_t retired = 0;
+
+    // Лимиты одного вызова run(), 0 — без лимита. Движки сверяют retired с next_check
+    // только в конце блока (переход, J, SYSCALL; в JIT — обратный переход), а часы
+    // смотрят раз в CHECK_INTERVAL инструкций, поэтому run() может выполнить
+    // на несколько инструкций блока больше лимита
+    uint64_t instruction_limit = 0;
+    std::chrono::steady_clock::duration time_limit{};
+    uint64_t run_limit = UINT64_MAX;
+    std::chrono::steady_clock::time_point deadline;
+    uint64_t next_check = UINT64_MAX;
+    StopReason stop_reason = StopReason::None;
+
+    // Свой буферизованный ввод-вывод на std::cin / std::cout, пока не подключён другой
+    std::unique_ptr<SyscallIO> own_io;
+    SyscallIO* io;
+    bool quiet = false;
+
+    // Номер этого CPU (hart) среди исполняющих одну Memory и их число: SYS_HART_ID, SYS_HART_COUNT
+    uint32_t hart_id = 0;
+    uint32_t hart_count = 1;
+
+    Profiler* profiler = nullptr;
+    TraceWriter* tracer = nullptr;
+    CacheModel* cache_model = nullptr;
+    TimingModel* timing_model = nullptr;
+
+    Engine engine = Engine::Switch;
+    bool checked = false;
+    bool fusion_enabled = true;
+    FusionStats fusion_stats;
+
+public:
+
+     CPU() : pc(0), own_io(std::make_unique<BufferedIO>(&std::cout, &std::cin, SyscallIO::Format::Banner)),
+             io(own_io.get()) {
         reset();
     }
 
     void reset() {
         pc = 0;
         std::fill(gpr.begin(), gpr.end(), 0);
+        vr.fill(VectorRegister{});
         should_halt = false;
+        fault = Fault::None;
+        fault_pc = fault_address = 0;
+        retired = 0;
+        stop_reason = StopReason::None;
+        decode_cache.clear();
+        jit.clear();
     }
 
-    void step(Memory& memory)
+    RunStatus step(Memory& memory)
     {
+        if (stop_reason != StopReason::None)
+        {
+            stop_reason = StopReason::None;
+            should_halt = false;
+        }
 
-        uint32_t raw_instr = memory.read<uint32_t>(pc);
-        Instruction instr_obj(raw_instr);
-        branch_flag = false;
-        execute_instruction(instr_obj, memory);
+        uint32_t trap_address;
 
-        if (!branch_flag)
+        if (!memory.guarded([&] { step_unguarded(memory); }, trap_address))
         {
-            pc += 4;
+            raise_fault(Fault::MemoryAccess, trap_address);
         }
+        settle_input_wait();
+        return status();
     }
 
-    void run(Memory& memory)
+    RunStatus run(Memory& memory)
     {
-        std::cout << "Starting execution "<< std::endl;
+        if (!quiet)
+        {
+            std::cout << "Starting execution "<< std::endl;
+        }
+
+        if (stop_reason != StopReason::None)
+        {
+            stop_reason = StopReason::None;
+            should_halt = false;
+        }
+        arm_limits();
 
-        while (!should_halt)
+        uint32_t trap_address;
+        bool completed = memory.guarded([&]
         {
-            step(memory);
+            if (profiler)
+            {
+                run_reference<ProfiledPolicy>(memory);
+            }
+            else if (tracer)
+            {
+                run_reference<TracedPolicy>(memory);
+            }
+            else if (cache_model || timing_model)
+            {
+                run_reference<ModeledPolicy>(memory);
+            }
+            else if (checked)
+            {
+                run_reference<CheckedPolicy>(memory);
+            }
+            else if (engine == Engine::Threaded)
+            {
+                run_threaded(memory);
+            }
+            else if (engine == Engine::Jit)
+            {
+                run_jit(memory);
+            }
+            else
+            {
+                run_reference<FastPolicy>(memory);
+            }
+        }, trap_address);
+
+        if (!completed)
+        {
+            raise_fault(Fault::MemoryAccess, trap_address);
+        }
+        settle_input_wait();
+
+        if (tracer && !profiler)
+        {
+            trace_end();
         }
 
-       std::cout << "Program halted normally" << std::endl;
+        io->flush();
+
+        if (fault == Fault::None && stop_reason == StopReason::None && !quiet)
+        {
+            std::cout << "Program halted normally" << std::endl;
+        }
+        return status();
     }
 
 
-    uint32_t get_register(uint8_t index) const
+    uint32_t get_register(uint8_t index) const noexcept
     {
         return gpr[index];
     }
 
-    void set_register(uint8_t index, uint32_t value)
+    void set_register(uint8_t index, uint32_t value) noexcept
     {
         if (index != 0)
         {
@@ -66,9 +274,153 @@ public:
         }
     }
 
-    uint32_t get_pc() const { return pc; }
-    void set_pc(uint32_t value) { pc = value; }
-    bool is_halted() const { return should_halt; }
+    VectorRegister get_vector(uint8_t index) const noexcept
+    {
+        return vr[index];
+    }
+
+    void set_vector(uint8_t index, const VectorRegister& value) noexcept
+    {
+        vr[index] = value;
+    }
+
+    uint32_t get_pc() const noexcept { return pc; }
+    void set_pc(uint32_t value) noexcept { pc = value; }
+    bool is_halted() const noexcept { return should_halt; }
+
+    uint64_t get_retired() const noexcept { return retired; }
+    // Для исполнителей в обход движков (run_aot)
+    void add_retired(uint64_t count) noexcept { retired += count; }
+
+    // Сколько инструкций может выполнить один run(), 0 — без лимита
+    void set_instruction_limit(uint64_t count) { instruction_limit = count; }
+    uint64_t get_instruction_limit() const { return instruction_limit; }
+
+    // Сколько времени может идти один run(), 0 — без лимита
+    void set_time_limit(std::chrono::steady_clock::duration limit) { time_limit = limit; }
+    std::chrono::steady_clock::duration get_time_limit() const { return time_limit; }
+
+    StopReason get_stop_reason() const noexcept { return stop_reason; }
+
+    // Ввод-вывод системных вызовов; backend должен жить, пока CPU им пользуется.
+    // run() сбрасывает его вывод перед возвратом
+    void set_io(SyscallIO& backend) { io = &backend; }
+    SyscallIO& get_io() { return *io; }
+
+    // Пока подключён, run() идёт по одной инструкции мимо выбранного движка
+    // и считает в него; nullptr отключает. step() профилировщик не трогает
+    void set_profiler(Profiler* value) { profiler = value; }
+    Profiler* get_profiler() const { return profiler; }
+
+    // Так же, как профилировщик, но run() пишет каждую инструкцию в трассу
+    // (профилировщик, если подключены оба, важнее); nullptr отключает.
+    // Первый run() пишет заголовок с текущим состоянием, следующие продолжают трассу
+    void set_tracer(TraceWriter* value) { tracer = value; }
+    TraceWriter* get_tracer() const { return tracer; }
+
+    // Модель кэшей: run() так же идёт эталонным циклом (профилировщик и трасса важнее),
+    // и step() тоже сообщает ей выборку и обращения к данным; nullptr отключает
+    void set_cache_model(CacheModel* value) { cache_model = value; }
+    CacheModel* get_cache_model() const { return cache_model; }
+
+    // Модель конвейера: так же, как модель кэшей, и вместе с ней — тогда промахи
+    // кэшей становятся простоями конвейера; nullptr отключает
+    void set_timing_model(TimingModel* value) { timing_model = value; }
+    TimingModel* get_timing_model() const { return timing_model; }
+
+    // Отладочный режим: run() идёт эталонным циклом с двойным switch по opcode и funct
+    // и сверяет каждую инструкцию из кэша декодирования со словом в памяти.
+    // Устаревшая запись (код изменён в обход invalidate_code) — std::logic_error
+    void set_checked(bool value) { checked = value; }
+    bool is_checked() const { return checked; }
+
+    // Без сообщений о начале и конце выполнения
+    void set_quiet(bool value) { quiet = value; }
+    bool is_quiet() const { return quiet; }
+
+    void set_hart(uint32_t id, uint32_t count) { hart_id = id; hart_count = count; }
+    uint32_t get_hart_id() const noexcept { return hart_id; }
+
+    Fault get_fault() const noexcept { return fault; }
+    uint32_t get_fault_pc() const noexcept { return fault_pc; }
+    // Для MemoryAccess — гостевой адрес обращения, иначе PC инструкции
+    uint32_t get_fault_address() const noexcept { return fault_address; }
+
+    // Архитектурное состояние для снимков: регистры (и векторные), PC, останов и ошибка
+    struct State
+    {
+        std::array<uint32_t, 32> gpr;
+        uint32_t pc;
+        bool halted;
+        Fault fault;
+        uint32_t fault_pc;
+        uint32_t fault_address;
+        std::array<VectorRegister, 32> vr;
+    };
+
+    State get_state() const noexcept
+    {
+        return { gpr, pc, should_halt && stop_reason == StopReason::None, fault, fault_pc, fault_address, vr };
+    }
+
+    // Кэш декодирования и JIT не трогает: код в памяти восстанавливает Machine
+    void set_state(const State& state) noexcept
+    {
+        gpr = state.gpr;
+        pc = state.pc;
+        should_halt = state.halted;
+        fault = state.fault;
+        fault_pc = state.fault_pc;
+        fault_address = state.fault_address;
+        vr = state.vr;
+        stop_reason = StopReason::None;
+    }
+
+    RunStatus status() const noexcept
+    {
+        if (fault != Fault::None) return RunStatus::Faulted;
+        if (stop_reason != StopReason::None) return RunStatus::Stopped;
+        return should_halt ? RunStatus::Halted : RunStatus::Running;
+    }
+
+    void set_engine(Engine value) { engine = value; }
+    Engine get_engine() const { return engine; }
+
+    void set_fusion_enabled(bool enabled) { fusion_enabled = enabled; }
+    bool is_fusion_enabled() const { return fusion_enabled; }
+    const FusionStats& get_fusion_stats() const { return fusion_stats; }
+
+    // Загрузочный проход по образу: заполняет кэш декодирования для [begin, end)
+    // и сливает распознанные пары в суперинструкции. Слитые операции исполняют
+    // switch- и шитый движки; step(), профиль, трасса и модели по-прежнему идут
+    // по одной инструкции, так что PC и регистры при пошаговом выполнении точные
+    void predecode(Memory& memory, uint32_t begin, uint32_t end);
+
+    void set_decode_cache_enabled(bool enabled)
+    {
+        decode_cache_enabled = enabled;
+        decode_cache.clear();
+    }
+    bool is_decode_cache_enabled() const { return decode_cache_enabled; }
+
+    // Сбрасывает декодированные и оттранслированные копии кода в [address, address + size).
+    // Запись в код в обход ST/STP (загрузчик, тесты) должна вызывать её вручную.
+    // Возвращает true, если был задет оттранслированный JIT-блок
+    bool invalidate_code(uint32_t address, uint32_t size)
+    {
+        // Слитая запись по address - 4 тоже зависит от этого слова
+        uint32_t head = address >= 4 ? address - 4 : address;
+        decode_cache.invalidate(head, size + (address - head));
+        return jit.invalidate(address, size);
+    }
+
+    void flush_decode_cache()
+    {
+        decode_cache.clear();
+        jit.clear();
+    }
+
+    const Jit::Stats& get_jit_stats() const { return jit.get_stats(); }
 
 private:
 
@@ -83,14 +435,52 @@ private:
     {
         uint8_t opcode;
         uint8_t funct;
+        uint8_t handler;                                // Handler, см. classify()
 
         uint8_t rs1, rs2, rd, rt;
         int32_t imm;
         uint32_t target, offset;
 
+        // Операнды второй инструкции суперинструкции (см. predecode)
+        uint8_t fused_rs, fused_rt, fused_rd;
+        int32_t fused_imm;
+
+        // Шитый код: адрес обработчика в run_threaded относительно do_RESOLVE.
+        // 0 — ещё не разрешён (новая, сброшенная или сторожевая запись кэша)
+        int32_t thread_label = 0;
+
+        Instruction() = default;
         Instruction(uint32_t raw);
     };
 
+    DecodeCache<Instruction> decode_cache;
+    bool decode_cache_enabled = true;
+
+    Jit jit;
+    friend class Jit;
+
+    Instruction fetch(Memory& memory)
+    {
+        if (!decode_cache_enabled || (pc & 0x3) != 0)
+        {
+            return Instruction(memory.read<uint32_t>(pc));
+        }
+
+        if (const Instruction* cached = decode_cache.lookup(pc))
+        {
+            return *cached;
+        }
+
+        return decode_cache.insert(pc, Instruction(memory.read<uint32_t>(pc)));
+    }
+
+public:
+    using DecodeCacheStats = DecodeCache<Instruction>::Stats;
+
+    const DecodeCacheStats& get_decode_cache_stats() const { return decode_cache.get_stats(); }
+
+private:
+
 
     enum Opcode : uint8_t
     {
@@ -101,7 +491,10 @@ private:
         OP_BEQ      = 0b011010,
         OP_SBIT     = 0b011100,
         OP_J        = 0b011111,
+        OP_VECTOR   = 0b100000,
         OP_ADDI     = 0b101101,
+        OP_VLD      = 0b110001,
+        OP_VST      = 0b110011,
         OP_ST       = 0b110111,
         OP_LD       = 0b111001
     };
@@ -111,10 +504,107 @@ private:
         F_CLS     = 0b001010,
         F_ADD     = 0b010010,
         F_BEXT    = 0b010100,
+        F_CAS     = 0b011110,
         F_SYSCALL = 0b101000,
-        F_SUB     = 0b110110
+        F_SUB     = 0b110110,
+        F_FENCE   = 0b111000
+    };
+
+    // funct векторных операций (opcode OP_VECTOR)
+    enum VectorFunct : uint8_t
+    {
+        VF_VADD    = 0b000001,
+        VF_VSUB    = 0b000010,
+        VF_VADDS   = 0b000011,
+        VF_VSSAT   = 0b000100,
+        VF_VSPLAT  = 0b000101,
+        VF_VREDSUM = 0b000110
+    };
+
+    // Плоский номер обработчика: opcode и funct сводятся в одно значение
+    // при декодировании, чтобы шитый код делал один косвенный переход
+    enum Handler : uint8_t
+    {
+        H_CLS,
+        H_ADD,
+        H_BEXT,
+        H_SYSCALL,
+        H_SUB,
+        H_SSAT,
+        H_STP,
+        H_BNE,
+        H_BEQ,
+        H_SBIT,
+        H_J,
+        H_ADDI,
+        H_ST,
+        H_LD,
+        H_CAS,
+        H_FENCE,
+        H_VLD,
+        H_VST,
+        H_VADD,
+        H_VSUB,
+        H_VADDS,
+        H_VSSAT,
+        H_VSPLAT,
+        H_VREDSUM,
+        H_ADDI_BNE,
+        H_MOVE_PAIR,
+        H_SYSCALL_IMM,
+        H_UNKNOWN_FUNCT,
+        H_UNKNOWN_OPCODE,
+        H_COUNT
     };
 
+    static uint8_t classify(uint8_t opcode, uint8_t funct)
+    {
+        if (opcode == OP_R_FORMAT)
+        {
+            switch (funct)
+            {
+                case F_CLS:     return H_CLS;
+                case F_ADD:     return H_ADD;
+                case F_BEXT:    return H_BEXT;
+                case F_SYSCALL: return H_SYSCALL;
+                case F_SUB:     return H_SUB;
+                case F_CAS:     return H_CAS;
+                case F_FENCE:   return H_FENCE;
+                default:        return H_UNKNOWN_FUNCT;
+            }
+        }
+
+        if (opcode == OP_VECTOR)
+        {
+            switch (funct)
+            {
+                case VF_VADD:    return H_VADD;
+                case VF_VSUB:    return H_VSUB;
+                case VF_VADDS:   return H_VADDS;
+                case VF_VSSAT:   return H_VSSAT;
+                case VF_VSPLAT:  return H_VSPLAT;
+                case VF_VREDSUM: return H_VREDSUM;
+                default:         return H_UNKNOWN_FUNCT;
+            }
+        }
+
+        switch (opcode)
+        {
+            case OP_SSAT: return H_SSAT;
+            case OP_STP:  return H_STP;
+            case OP_BNE:  return H_BNE;
+            case OP_BEQ:  return H_BEQ;
+            case OP_SBIT: return H_SBIT;
+            case OP_J:    return H_J;
+            case OP_ADDI: return H_ADDI;
+            case OP_ST:   return H_ST;
+            case OP_LD:   return H_LD;
+            case OP_VLD:  return H_VLD;
+            case OP_VST:  return H_VST;
+            default:      return H_UNKNOWN_OPCODE;
+        }
+    }
+
     static void execute_LD     (CPU& cpu, Instruction instr, Memory& memory);
     static void execute_ST     (CPU& cpu, Instruction instr, Memory& memory);
     static void execute_STP    (CPU& cpu, Instruction instr, Memory& memory);
@@ -128,9 +618,198 @@ private:
     static void execute_CLS    (CPU& cpu, Instruction instr);
     static void execute_BEXT   (CPU& cpu, Instruction instr);
     static void execute_J      (CPU& cpu, Instruction instr);
-    static void execute_SYSCALL(CPU& cpu);
+    static void execute_SYSCALL(CPU& cpu, Memory& memory);
+    static void execute_CAS    (CPU& cpu, Instruction instr, Memory& memory);
+    static void execute_FENCE  ();
+
+    // Векторные: vd/vs — номера V-регистров в полях rd, rs1, rs2
+    static void execute_VLD    (CPU& cpu, Instruction instr, Memory& memory);
+    static void execute_VST    (CPU& cpu, Instruction instr, Memory& memory);
+    static void execute_VADD   (CPU& cpu, Instruction instr);
+    static void execute_VSUB   (CPU& cpu, Instruction instr);
+    static void execute_VADDS  (CPU& cpu, Instruction instr);
+    static void execute_VSSAT  (CPU& cpu, Instruction instr);
+    static void execute_VSPLAT (CPU& cpu, Instruction instr);
+    static void execute_VREDSUM(CPU& cpu, Instruction instr);
+
+    // Суперинструкции: вторая половина берёт операнды из fused_*
+    static void execute_ADDI_BNE   (CPU& cpu, Instruction instr);
+    static void execute_MOVE_PAIR  (CPU& cpu, Instruction instr);
+    static void execute_SYSCALL_IMM(CPU& cpu, Instruction instr, Memory& memory);
+
+    // Останов на текущей инструкции: branch_flag не даёт диспетчеру продвинуть PC
+    void raise_fault(Fault code, uint32_t address) noexcept
+    {
+        fault = code;
+        fault_pc = pc;
+        fault_address = address;
+        should_halt = true;
+        branch_flag = true;
+    }
 
+    // Ожидание ввода движки видят как ошибку: инструкция не засчитана, PC остался на ней.
+    // Наружу это останов, и следующий run()/step() выполнит SYSCALL заново
+    void settle_input_wait() noexcept
+    {
+        if (fault == Fault::InputWait)
+        {
+            fault = Fault::None;
+            fault_pc = fault_address = 0;
+            stop_reason = StopReason::InputWait;
+        }
+    }
+
+    // Внутри Memory::guarded: выход за границы памяти прерывает выполнение ловушкой
+    void step_unguarded(Memory& memory)
+    {
+        Instruction instr_obj = fetch(memory);
+        uint32_t at = pc;
+        CacheLevel fetch_level{}, data_level{};
+        if (cache_model)
+        {
+            model_caches(instr_obj, memory, fetch_level, data_level);
+        }
+        branch_flag = false;
+        execute_instruction(instr_obj, memory);
 
+        if (timing_model && fault == Fault::None)
+        {
+            model_timing(instr_obj, at, branch_flag, fetch_level, data_level);
+        }
+        if (!branch_flag)
+        {
+            pc += 4;
+        }
+        retired += fault == Fault::None;
+    }
+
+    // Часы смотрятся раз в столько выполненных инструкций
+    static constexpr uint64_t CHECK_INTERVAL = 1u << 16;
+
+    void arm_limits();
+    // Вызывается движками, когда retired >= next_check. true — лимит исчерпан,
+    // CPU остановлен (should_halt) и движок должен вернуться
+    bool checkpoint();
+
+    // Политики эталонного цикла run_reference: что он считает, пишет и проверяет,
+    // решается при компиляции, и в FastPolicy (switch-движок) от этого ничего не остаётся.
+    // flat_dispatch — один switch по handler вместо execute_instruction;
+    // fused — слитая пара выполняется целиком, иначе по одной инструкции
+    struct FastPolicy
+    {
+        static constexpr bool flat_dispatch = true, fused = true, profile = false, trace = false, checked = false, model = false;
+    };
+
+    struct CheckedPolicy
+    {
+        static constexpr bool flat_dispatch = false, fused = false, profile = false, trace = false, checked = true, model = false;
+    };
+
+    struct ProfiledPolicy
+    {
+        static constexpr bool flat_dispatch = true, fused = false, profile = true, trace = false, checked = false, model = false;
+    };
+
+    struct TracedPolicy
+    {
+        static constexpr bool flat_dispatch = true, fused = false, profile = false, trace = true, checked = false, model = false;
+    };
+
+    // Модели кэшей и конвейера; каждая включается, если подключена
+    struct ModeledPolicy
+    {
+        static constexpr bool flat_dispatch = true, fused = false, profile = false, trace = false, checked = false, model = true;
+    };
+
+    template <class Policy>
+    void run_reference(Memory& memory);
+
+    void check_decoded(Memory& memory, const Instruction& cached);
+    void model_caches(const Instruction& instr_obj, const Memory& memory, CacheLevel& fetch_level, CacheLevel& data_level);
+    void model_timing(const Instruction& instr_obj, uint32_t at, bool taken, CacheLevel fetch_level, CacheLevel data_level);
+    void run_threaded(Memory& memory);
+    void trace_end();
+    static bool fuse(Instruction& first, const Instruction& second, Fusion& kind);
+    void run_jit(Memory& memory);
+    void interpret_block(Memory& memory);
+
+
+
+    // Один switch по плоскому номеру обработчика. Без Fused слитая пара выполняется
+    // по одной инструкции, и от неё берётся только первая половина. С Fused пара
+    // выполняется целиком: первая половина сама продвигает PC и retired, вторую
+    // досчитывает вызывающий, как любую инструкцию. Ошибка бывает только у SYSCALL
+    // второй половины — тогда PC остаётся на нём, а ADDI уже засчитан
+    template <bool Fused>
+    void execute_handler(const Instruction& instr_obj, Memory& memory)
+    {
+        switch (instr_obj.handler)
+        {
+            case H_CLS:     execute_CLS(*this, instr_obj);          break;
+            case H_ADD:     execute_ADD(*this, instr_obj);          break;
+            case H_MOVE_PAIR:
+                if constexpr (Fused)
+                {
+                    execute_MOVE_PAIR(*this, instr_obj);
+                    pc += 4;
+                    retired++;
+                }
+                else
+                {
+                    execute_ADD(*this, instr_obj);
+                }
+                break;
+            case H_ADDI_BNE:
+                if constexpr (Fused)
+                {
+                    execute_ADDI_BNE(*this, instr_obj);
+                    if (!branch_flag)
+                    {
+                        pc += 4;
+                    }
+                    retired++;
+                }
+                else
+                {
+                    execute_ADDI(*this, instr_obj);
+                }
+                break;
+            case H_SYSCALL_IMM:
+                if constexpr (Fused)
+                {
+                    execute_SYSCALL_IMM(*this, instr_obj, memory);
+                    retired++;
+                }
+                else
+                {
+                    execute_ADDI(*this, instr_obj);
+                }
+                break;
+            case H_BEXT:    execute_BEXT(*this, instr_obj);         break;
+            case H_SYSCALL: execute_SYSCALL(*this, memory);         break;
+            case H_SUB:     execute_SUB(*this, instr_obj);          break;
+            case H_SSAT:    execute_SSAT(*this, instr_obj);         break;
+            case H_STP:     execute_STP(*this, instr_obj, memory);  break;
+            case H_BNE:     execute_BNE(*this, instr_obj);          break;
+            case H_BEQ:     execute_BEQ(*this, instr_obj);          break;
+            case H_SBIT:    execute_SBIT(*this, instr_obj);         break;
+            case H_J:       execute_J(*this, instr_obj);            break;
+            case H_ADDI:    execute_ADDI(*this, instr_obj);         break;
+            case H_ST:      execute_ST(*this, instr_obj, memory);   break;
+            case H_LD:      execute_LD(*this, instr_obj, memory);   break;
+            case H_CAS:     execute_CAS(*this, instr_obj, memory);  break;
+            case H_FENCE:   execute_FENCE();                        break;
+            case H_VLD:     execute_VLD(*this, instr_obj, memory);  break;
+            case H_VST:     execute_VST(*this, instr_obj, memory);  break;
+            case H_VADD:    execute_VADD(*this, instr_obj);         break;
+            case H_VSUB:    execute_VSUB(*this, instr_obj);         break;
+            case H_VADDS:   execute_VADDS(*this, instr_obj);        break;
+            case H_VSSAT:   execute_VSSAT(*this, instr_obj);        break;
+            case H_VSPLAT:  execute_VSPLAT(*this, instr_obj);       break;
+            case H_VREDSUM: execute_VREDSUM(*this, instr_obj);      break;
+            default:        raise_fault(Fault::IllegalInstruction, pc);
+        }
+    }
 
    void execute_instruction( Instruction instr_obj, Memory& memory)
     {
@@ -145,10 +824,26 @@ private:
                 case F_CLS:     execute_CLS(*this, instr_obj);     break;
                 case F_ADD:     execute_ADD(*this, instr_obj);     break;
                 case F_BEXT:    execute_BEXT(*this, instr_obj);    break;
-                case F_SYSCALL: execute_SYSCALL(*this); break;
+                case F_SYSCALL: execute_SYSCALL(*this, memory); break;
                 case F_SUB:     execute_SUB(*this, instr_obj);     break;
-                default:
-                    std::cerr << "Unknown R-format funct: 0x" << std::hex << (int)funct << std::endl;
+                case F_CAS:     execute_CAS(*this, instr_obj, memory); break;
+                case F_FENCE:   execute_FENCE();                   break;
+                default:        raise_fault(Fault::IllegalInstruction, pc);
+            }
+            return;
+        }
+
+        if (opcode == OP_VECTOR)
+        {
+            switch (funct)
+            {
+                case VF_VADD:    execute_VADD(*this, instr_obj);    break;
+                case VF_VSUB:    execute_VSUB(*this, instr_obj);    break;
+                case VF_VADDS:   execute_VADDS(*this, instr_obj);   break;
+                case VF_VSSAT:   execute_VSSAT(*this, instr_obj);   break;
+                case VF_VSPLAT:  execute_VSPLAT(*this, instr_obj);  break;
+                case VF_VREDSUM: execute_VREDSUM(*this, instr_obj); break;
+                default:         raise_fault(Fault::IllegalInstruction, pc);
             }
             return;
         }
@@ -164,8 +859,9 @@ private:
             case OP_STP:  execute_STP(*this, instr_obj, memory);    break;
             case OP_ST:   execute_ST(*this, instr_obj, memory);     break;
             case OP_LD:   execute_LD(*this, instr_obj, memory);     break;
-            default:
-                std::cerr << "Unknown instruction opcode: 0x" << std::hex << (int)opcode << std::endl;
+            case OP_VLD:  execute_VLD(*this, instr_obj, memory);    break;
+            case OP_VST:  execute_VST(*this, instr_obj, memory);    break;
+            default:      raise_fault(Fault::IllegalInstruction, pc);
         }
     }
 
@@ -186,4 +882,9 @@ inline CPU::Instruction::Instruction(uint32_t raw)
 
     target = raw & 0x3FFFFFF;                           // [25:0] для J
     offset = sign_extend(raw & 0x7FF, 11);              // [0:10] stp
+
+    handler = classify(opcode, funct);
+
+    fused_rs = fused_rt = fused_rd = 0;
+    fused_imm = 0;
 }
@@ -0,0 +1,155 @@
+#pragma once
+#include <cstdint>
+#include <array>
+#include <memory>
+#include <unordered_map>
+
+// Кэш предекодированных инструкций, индексируется по PC.
+// Гостевое адресное пространство делится на страницы по 4 KiB (1024 слова),
+// страницы создаются лениво при первом промахе. Последняя использованная
+// страница запоминается, поэтому в горячем цикле поиск — это одно сравнение.
+template<typename Entry>
+class DecodeCache
+{
+public:
+    static constexpr uint32_t PAGE_SHIFT = 12;
+    static constexpr uint32_t PAGE_SIZE  = 1u << PAGE_SHIFT;
+    static constexpr uint32_t PAGE_WORDS = PAGE_SIZE / 4;
+
+    struct Stats
+    {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t invalidations = 0;
+
+        double hit_rate() const
+        {
+            uint64_t total = hits + misses;
+            return total ? static_cast<double>(hits) / total : 0.0;
+        }
+    };
+
+private:
+    // За последним словом — две записи по умолчанию, которые никогда не заполняются:
+    // шитый код идёт по записям страницы подряд и на них уходит в обычную выборку
+    // (слитая пара в последнем слове перескакивает через одну)
+    struct Page
+    {
+        std::array<Entry, PAGE_WORDS + 2> entries{};
+        std::array<bool, PAGE_WORDS> valid{};
+    };
+
+    std::unordered_map<uint32_t, std::unique_ptr<Page>> pages;
+
+    uint32_t last_index = UINT32_MAX;
+    Page* last_page = nullptr;
+
+    // Границы закэшированного кода: записи вне [code_lo, code_hi) не требуют поиска страницы
+    uint64_t code_lo = UINT64_MAX;
+    uint64_t code_hi = 0;
+
+    Stats stats;
+
+    Page* find_page(uint32_t page_index)
+    {
+        if (page_index == last_index)
+        {
+            return last_page;
+        }
+
+        auto it = pages.find(page_index);
+        if (it == pages.end())
+        {
+            return nullptr;
+        }
+
+        last_index = page_index;
+        last_page = it->second.get();
+        return last_page;
+    }
+
+public:
+    // Возвращает закэшированную запись или nullptr при промахе. Запись остаётся на месте,
+    // пока её страница жива (до clear()); запись за концом страницы можно читать
+    Entry* lookup(uint32_t addr)
+    {
+        Page* page = find_page(addr >> PAGE_SHIFT);
+        uint32_t slot = (addr & (PAGE_SIZE - 1)) >> 2;
+
+        if (page && page->valid[slot])
+        {
+            stats.hits++;
+            return &page->entries[slot];
+        }
+
+        stats.misses++;
+        return nullptr;
+    }
+
+    Entry& insert(uint32_t addr, const Entry& entry)
+    {
+        uint32_t page_index = addr >> PAGE_SHIFT;
+        Page* page = find_page(page_index);
+
+        if (!page)
+        {
+            auto& slot_ptr = pages[page_index];
+            slot_ptr = std::make_unique<Page>();
+            last_index = page_index;
+            last_page = slot_ptr.get();
+            page = last_page;
+        }
+
+        uint32_t slot = (addr & (PAGE_SIZE - 1)) >> 2;
+        page->entries[slot] = entry;
+        page->valid[slot] = true;
+
+        if (addr < code_lo) code_lo = addr;
+        if (addr + uint64_t{4} > code_hi) code_hi = addr + uint64_t{4};
+
+        return page->entries[slot];
+    }
+
+    // Сбрасывает записи, пересекающиеся с [addr, addr + size): они становятся
+    // невалидными и возвращаются к значению по умолчанию
+    void invalidate(uint32_t addr, uint32_t size = 4)
+    {
+        if (addr >= code_hi || addr + uint64_t{size} <= code_lo || size == 0)
+        {
+            return;
+        }
+
+        uint64_t first = addr & ~3u;
+        uint64_t last  = (addr + uint64_t{size} - 1) & ~uint64_t{3};
+
+        for (uint64_t word64 = first; word64 <= last; word64 += 4)
+        {
+            uint32_t word = static_cast<uint32_t>(word64);
+            Page* page = find_page(word >> PAGE_SHIFT);
+            if (!page)
+            {
+                continue;
+            }
+
+            uint32_t slot = (word & (PAGE_SIZE - 1)) >> 2;
+            if (page->valid[slot])
+            {
+                page->valid[slot] = false;
+                page->entries[slot] = Entry{};
+                stats.invalidations++;
+            }
+        }
+    }
+
+    void clear()
+    {
+        pages.clear();
+        last_index = UINT32_MAX;
+        last_page = nullptr;
+        code_lo = UINT64_MAX;
+        code_hi = 0;
+    }
+
+    const Stats& get_stats() const { return stats; }
+    void reset_stats() { stats = Stats{}; }
+};
@@ -0,0 +1,13 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+// Текстовая форма инструкции в синтаксисе ReadMe: "ADDI r3, r0, 5", "LD r3, 16(r1)".
+// Цели переходов — абсолютные адреса, поэтому нужен PC инструкции
+std::string disassemble(uint32_t word, uint32_t pc);
+
+// Только мнемоника ("ADD", "BNE"); для неизвестного кода — "???"
+const char* mnemonic(uint32_t word);
+
+// Переход, J или SYSCALL: после них базовый блок кончается
+bool ends_block(uint32_t word);
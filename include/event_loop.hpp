@@ -0,0 +1,119 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "machine.hpp"
+#include "scheduler.hpp"
+#include "syscall_io.hpp"
+
+// Ввод-вывод гостя через неблокирующие дескрипторы. Ввод дочитывается fill(),
+// вывод копится и уходит drain(); пока во вводе нет целого числа (или строки),
+// can_read_int/can_read_line отвечают false и CPU останавливается с InputWait
+class FdIO : public BufferedIO
+{
+public:
+    static constexpr size_t READ_CHUNK = 64 * 1024;
+
+    FdIO(int input_fd, int output_fd, Format format = Format::Raw)
+        : BufferedIO(nullptr, nullptr, format), input_fd(input_fd), output_fd(output_fd) {}
+
+    // Читает то, что уже есть в input_fd (не больше READ_CHUNK). true — ввод
+    // пополнился или кончился; ошибка чтения считается концом ввода
+    bool fill();
+
+    // Пишет в output_fd, сколько примет; true — вывод ушёл целиком.
+    // При ошибке записи вывод отбрасывается
+    bool drain();
+
+    bool at_end() const { return end_of_input; }
+
+    bool can_read_int() override;
+    bool can_read_line(size_t max) override;
+
+    // Эмулятор сам не ждёт: ввод и вывод ждёт EventLoop
+    void flush() override {}
+
+private:
+    int input_fd;
+    int output_fd;
+    bool end_of_input = false;
+};
+
+// Гости с вводом-выводом через неблокирующие дескрипторы поверх Scheduler:
+// кванты, веса, лимиты и статистика по гостям — его, с теми же SchedulerOptions.
+// Гость, ждущий ввода (StopReason::InputWait), не держит поток: Scheduler его
+// усыпляет, дескриптор ввода уходит в epoll (poll() вне Linux), и отдельный поток
+// цикла будит гостя, когда придут данные. Так же гость ждёт, пока освободится вывод.
+//
+// Лимиты run() машины цикл заменяет своими (quantum и max_instructions).
+// Дескрипторы переводятся в O_NONBLOCK и не закрываются; у каждого гостя они
+// должны быть свои. Обычные файлы считаются всегда готовыми
+class EventLoop
+{
+public:
+    // Вызывается, когда гость остановился и его вывод ушёл: в потоке планировщика
+    // или в потоке ожидания. status — Halted, Faulted или Stopped (исчерпан max_instructions)
+    using Done = std::function<void(Machine& machine, CPU::RunStatus status)>;
+
+    struct Stats
+    {
+        uint64_t guests = 0;            // завершено
+        uint64_t quanta = 0;            // вызовов run()
+        uint64_t input_waits = 0;       // раз гость уходил ждать ввода в epoll
+        uint64_t output_waits = 0;      // раз гость ждал, пока освободится вывод
+    };
+
+    explicit EventLoop(const SchedulerOptions& options = {});
+    ~EventLoop();
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop& operator=(const EventLoop&) = delete;
+
+    // Машина с загруженной программой. Можно вызывать из любого потока, в том
+    // числе из Done и во время run(); std::runtime_error, если fd не годится,
+    // std::invalid_argument при нулевом весе
+    Scheduler::GuestId add(std::unique_ptr<Machine> machine, int input_fd, int output_fd,
+                           Done done = {}, unsigned weight = 1);
+
+    // Исполняет гостей, пока не завершатся все добавленные
+    void run();
+
+    // Точна после run()
+    Stats get_stats() const;
+
+    // Веса и статистика по гостям; id — из add()
+    Scheduler& get_scheduler() { return scheduler; }
+
+private:
+    class Poller;
+    struct Guest;
+
+    Scheduler scheduler;
+    std::unique_ptr<Poller> poller;
+    int wake_read = -1;
+    int wake_write = -1;
+
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::vector<std::unique_ptr<Guest>> guests;
+    std::atomic<size_t> live{0};        // добавлено и ещё не завершено
+    std::atomic<bool> stopping{false};
+
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> input_waits{0};
+    std::atomic<uint64_t> output_waits{0};
+
+    bool pause(Guest& guest, Machine& machine);
+    void done(Guest& guest, CPU::RunStatus status);
+    bool wait_output(Guest& guest);
+    bool watch(Guest& guest, int fd, bool output);
+    void ready(Guest& guest);
+    void finish(Guest& guest);
+    void serve();
+    void wake();
+};
@@ -0,0 +1,100 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "memory.hpp"
+
+// Формат исполняемого образа (все поля little-endian):
+//
+//   ImageHeader                         32 байта, magic "CEXE"
+//   SegmentHeader[segment_count]        сразу за заголовком
+//   данные сегментов                    смещения кратны IMAGE_ALIGNMENT
+//   таблица символов (необязательна)    ImageSymbolEntry[symbol_count] + строки
+//
+// Смещение в файле и адрес сегмента, выровненные на страницу, позволяют
+// загрузчику отобразить файл прямо в гостевую память без копирования.
+// Файл без magic считается сырым кодом (старый .bin) и грузится по load_address.
+
+constexpr char     IMAGE_MAGIC[4]    = { 'C', 'E', 'X', 'E' };
+constexpr uint16_t IMAGE_VERSION     = 1;
+constexpr uint32_t IMAGE_ALIGNMENT   = 4096;
+constexpr uint32_t DEFAULT_LOAD_ADDRESS = 0x1000;
+
+enum class SegmentKind : uint32_t
+{
+    Code = 0,
+    Data = 1,
+    Bss  = 2        // только memory_size, в файле ничего нет
+};
+
+struct ImageHeader
+{
+    char magic[4];
+    uint16_t version;
+    uint16_t segment_count;
+    uint32_t entry;
+    uint32_t symbol_offset;     // 0 — символов нет
+    uint32_t symbol_count;
+    uint32_t reserved[3];
+};
+
+struct SegmentHeader
+{
+    SegmentKind kind;
+    uint32_t address;
+    uint32_t file_offset;
+    uint32_t file_size;
+    uint32_t memory_size;       // >= file_size, хвост заполняется нулями
+    uint32_t reserved;
+};
+
+// Имена — строки с нулём в конце, сразу после массива записей;
+// name_offset отсчитывается от начала этих строк
+struct ImageSymbolEntry
+{
+    uint32_t address;
+    uint32_t name_offset;
+};
+
+static_assert(sizeof(ImageHeader) == 32, "image header layout");
+static_assert(sizeof(SegmentHeader) == 24, "segment header layout");
+static_assert(sizeof(ImageSymbolEntry) == 8, "symbol entry layout");
+
+struct ImageSegment
+{
+    SegmentKind kind;
+    uint32_t address;
+    uint32_t file_size;
+    uint32_t memory_size;
+    std::vector<uint8_t> bytes;     // только для save_image; load_image их не заполняет
+};
+
+struct ImageSymbol
+{
+    uint32_t address;
+    std::string name;
+};
+
+struct LoadedImage
+{
+    uint32_t entry = 0;
+    bool raw = false;                       // сырой код без заголовка
+    std::vector<ImageSegment> segments;
+    std::vector<ImageSymbol> symbols;
+
+    uint64_t mapped_bytes = 0;              // отображено из файла без копирования
+    uint64_t copied_bytes = 0;
+};
+
+// Загружает образ в memory. Ошибки формата и выход сегмента за память —
+// std::runtime_error; память к этому моменту может быть частично заполнена.
+// Исходный текст на ассемблере (*.s, *.asm) собирается в памяти, код кладётся по
+// load_address; ошибки сборки — AssemblyError (тоже std::runtime_error)
+LoadedImage load_image(Memory& memory, const std::string& path,
+                       uint32_t load_address = DEFAULT_LOAD_ADDRESS);
+
+// Записывает образ; file_size и смещения считаются по bytes сегментов
+void save_image(const std::string& path, uint32_t entry,
+                const std::vector<ImageSegment>& segments,
+                const std::vector<ImageSymbol>& symbols = {});
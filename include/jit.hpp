@@ -0,0 +1,121 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class CPU;
+class Memory;
+struct VectorRegister;
+
+#if defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__))
+#define CPU_JIT_SUPPORTED 1
+#else
+#define CPU_JIT_SUPPORTED 0
+#endif
+
+// Шаблонный JIT для x86-64: горячие блоки транслируются в машинный код.
+// Блок начинается с адреса, на который передали управление, проходит через
+// условные переходы (выход из блока при срабатывании, если цель вне блока)
+// и заканчивается на J, перед SYSCALL или неизвестной инструкцией.
+// Часто используемые регистры блока держатся в host-регистрах.
+class Jit
+{
+public:
+    // Младшие 32 бита результата — PC, с которого продолжить выполнение.
+    // BAILOUT: инструкцию по этому PC нужно выполнить интерпретатором
+    // (выход за границы памяти — ловушку с точным PC поднимет интерпретатор)
+    // Выполненные блоком инструкции прибавляются к *retired. Переход назад внутри
+    // блока выходит из него, когда блок выполнил не меньше budget инструкций.
+    // Векторные регистры блок читает и пишет прямо в vr
+    using BlockFn = uint64_t (*)(uint32_t* gpr, Memory* memory, CPU* cpu, uint64_t* retired, uint64_t budget,
+                                 VectorRegister* vr);
+
+    static constexpr uint64_t BAILOUT = uint64_t{1} << 32;
+
+    static constexpr uint32_t HOT_THRESHOLD = 50;
+    static constexpr uint32_t MAX_BLOCK_INSTRUCTIONS = 256;
+
+    struct Stats
+    {
+        uint64_t blocks_compiled = 0;
+        uint64_t block_runs = 0;
+        uint64_t invalidations = 0;
+    };
+
+    Jit();
+    ~Jit();
+
+    Jit(const Jit&) = delete;
+    Jit& operator=(const Jit&) = delete;
+
+    static bool supported() { return CPU_JIT_SUPPORTED != 0; }
+
+    BlockFn lookup(uint32_t pc)
+    {
+        if (blocks.empty())
+        {
+            return nullptr;
+        }
+
+        auto it = blocks.find(pc);
+        if (it == blocks.end())
+        {
+            return nullptr;
+        }
+
+        stats.block_runs++;
+        return it->second.fn;
+    }
+
+    // Считает входы в блок; true, когда блок стал горячим
+    bool should_compile(uint32_t pc)
+    {
+        return ++counters[pc] == HOT_THRESHOLD;
+    }
+
+    BlockFn compile(uint32_t pc, const Memory& memory);
+
+    // true, если запись задела уже оттранслированный код
+    bool invalidate(uint32_t addr, uint32_t size)
+    {
+        if (addr >= code_hi || addr + uint64_t{size} <= code_lo)
+        {
+            return false;
+        }
+        return invalidate_slow(addr, size);
+    }
+
+    void clear();
+
+    const Stats& get_stats() const { return stats; }
+
+private:
+    struct Block
+    {
+        uint32_t start;
+        uint32_t end;
+        BlockFn fn;
+    };
+
+    std::unordered_map<uint32_t, Block> blocks;
+    std::unordered_map<uint32_t, uint32_t> counters;
+
+    // Номер страницы -> начала блоков, код которых лежит на этой странице
+    std::unordered_map<uint32_t, std::vector<uint32_t>> page_blocks;
+
+    // Страницы с самомодифицирующимся кодом остаются интерпретатору
+    std::unordered_set<uint32_t> smc_pages;
+
+    uint8_t* code_buffer = nullptr;
+    size_t code_capacity = 0;
+    size_t code_used = 0;
+
+    uint64_t code_lo = UINT64_MAX;
+    uint64_t code_hi = 0;
+
+    Stats stats;
+
+    bool invalidate_slow(uint32_t addr, uint32_t size);
+};
@@ -0,0 +1,109 @@
+#pragma once
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "batch.hpp"
+#include "machine.hpp"
+#include "syscall_io.hpp"
+
+// Режим SIMT: одна программа на многих входах в ногу (lockstep). Регистры всех
+// дорожек (lanes) лежат структурой массивов gpr[32][K], у каждой дорожки свой PC.
+// За шаг выбирается наименьший PC среди работающих дорожек, и инструкция по нему
+// выполняется сразу для всех дорожек с этим PC (маска активности). Разошедшиеся
+// на BNE/BEQ дорожки сходятся снова, когда их PC совпадут; наименьший PC первым
+// догоняет отставших, поэтому в структурном коде они сходятся на выходе из цикла.
+//
+// Арифметика и переходы идут циклами по дорожкам, которые компилятор векторизует;
+// LD/ST — по дорожке, в память её Machine. Остальное (системные вызовы, векторные
+// инструкции, STP, CAS, ошибки) выполняет CPU::step дорожки с её семантикой.
+// Дорожка, записавшая в код, уходит из лок-степа и дорабатывает в CPU::run
+struct LockstepOptions
+{
+    size_t lanes = 16;                  // K; округляется вверх до кратного LockstepRunner::LANE_BLOCK
+    size_t memory_size = Machine::DEFAULT_SIZE;
+    uint32_t load_address = DEFAULT_LOAD_ADDRESS;
+    uint64_t max_instructions = 0;      // на дорожку, 0 — без лимита
+    std::chrono::steady_clock::duration time_limit{};   // на группу из K заданий
+};
+
+class LockstepRunner
+{
+public:
+    // Дорожки обрабатываются блоками фиксированной ширины: внутренний цикл векторизуется без хвоста
+    static constexpr size_t LANE_BLOCK = 8;
+
+    struct Stats
+    {
+        uint64_t jobs = 0;
+        uint64_t instructions = 0;      // выполнено всеми дорожками
+        uint64_t issues = 0;            // шагов лок-степа (выбранных PC)
+        uint64_t scalar_steps = 0;      // инструкций, выполненных CPU::step дорожки
+        uint64_t detached = 0;          // дорожек, ушедших из лок-степа
+
+        // Средняя доля занятых дорожек на шаг: 1 — расхождений не было
+        double lane_utilization(size_t lanes) const
+        {
+            return issues ? static_cast<double>(instructions) / (static_cast<double>(issues) * lanes) : 0.0;
+        }
+    };
+
+    // Загружает программу (образ или сырой код) один раз; ошибки загрузки — std::runtime_error
+    LockstepRunner(const std::string& program, const LockstepOptions& options = {});
+
+    // Задание — значения для SYS_READ_INT; задания идут группами по K, результаты — в их порядке
+    std::vector<BatchResult> run(const std::vector<std::vector<int32_t>>& inputs);
+
+    size_t lanes() const { return width; }
+    const Stats& get_stats() const { return stats; }
+
+private:
+    enum Kind : uint8_t
+    {
+        K_ADD, K_SUB, K_ADDI, K_SBIT, K_CLS, K_BEXT, K_SSAT,
+        K_LD, K_ST, K_BNE, K_BEQ, K_J,
+        K_SCALAR        // CPU::step дорожки
+    };
+
+    // Предекодированная инструкция: поля как в CPU::Instruction
+    struct Op
+    {
+        Kind kind = K_SCALAR;
+        uint8_t a = 0, b = 0, c = 0;    // [25:21], [20:16], [15:11]
+        uint32_t imm = 0;               // знакорасширенный; для переходов — цель
+    };
+
+    LockstepOptions options;
+    size_t width;
+
+    std::vector<std::unique_ptr<Machine>> machines;
+    std::vector<std::unique_ptr<BufferedIO>> ios;
+    Machine::Snapshot loaded;
+
+    uint32_t code_begin = 0;            // ops покрывают [code_begin, code_end)
+    uint32_t code_end = 0;
+    std::vector<Op> ops;
+    std::vector<uint8_t> code_bytes;    // образ кода для проверки после медленного пути
+
+    // Состояние группы: gpr[r * width + lane]; маски — 0 или ~0u
+    std::vector<uint32_t> gpr;
+    std::vector<uint32_t> pc;
+    std::vector<uint32_t> running;
+    std::vector<uint32_t> active;
+    std::vector<uint64_t> retired;
+    size_t running_count = 0;
+    std::chrono::steady_clock::time_point group_start;
+
+    Stats stats;
+
+    void run_group(const std::vector<std::vector<int32_t>>& inputs, size_t first, size_t count,
+                   std::vector<BatchResult>& results);
+
+    const Op& op_at(uint32_t address) const;
+
+    // Инструкция по pc[lane] через CPU::step; detach — затем до конца через CPU::run
+    void scalar_step(size_t lane, bool detach, BatchResult& result);
+    void finish(size_t lane, CPU::RunStatus status, BatchResult& result);
+};
@@ -1,6 +1,12 @@
 #pragma once
 #include "memory.hpp"
 #include "cpu.hpp"
+#include "image.hpp"
+
+#include <chrono>
+#include <memory>
+#include <utility>
+#include <vector>
 
 class Machine
 {
@@ -8,8 +14,34 @@ private:
     Memory memory;
     CPU cpu;
 
-    static constexpr size_t DEFAULT_SIZE = 64 * 1024;
+    // Диапазоны кода, прошедшие prepare_code: после смены снимка их нужно предекодировать заново
+    std::vector<std::pair<uint32_t, uint32_t>> code_ranges;
+
+public:
+    // Итог последнего run()
+    struct Stats
+    {
+        uint64_t instructions = 0;
+        double seconds = 0;
+
+        double instructions_per_second() const { return seconds > 0 ? instructions / seconds : 0.0; }
+    };
+
+private:
+    Stats stats;
+
 public:
+    // Снимок машины: состояние CPU и неизменяемая копия памяти. Копирование
+    // снимка дешёвое — память разделяется
+    struct Snapshot
+    {
+        CPU::State cpu;
+        std::shared_ptr<const MemoryImage> memory;
+        std::vector<std::pair<uint32_t, uint32_t>> code_ranges;
+    };
+
+    static constexpr size_t DEFAULT_SIZE = 64 * 1024;
+
     Machine(size_t memory_size = DEFAULT_SIZE) : memory(memory_size), cpu() {}
 
     Memory& get_memory() { return memory; }
@@ -17,14 +49,28 @@ public:
     const Memory& get_memory() const { return memory; }
     const CPU& get_cpu() const { return cpu; }
 
-    void run()
+    // Stopped, если исчерпан лимит инструкций или времени; следующий run() продолжит
+    CPU::RunStatus run()
     {
-        cpu.run(memory);
+        uint64_t retired_before = cpu.get_retired();
+        auto start = std::chrono::steady_clock::now();
+
+        CPU::RunStatus status = cpu.run(memory);
+
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.instructions = cpu.get_retired() - retired_before;
+        return status;
     }
 
-    void step()
+    const Stats& get_stats() const { return stats; }
+
+    // Лимиты одного run(), 0 — без лимита
+    void set_instruction_limit(uint64_t count) { cpu.set_instruction_limit(count); }
+    void set_time_limit(std::chrono::steady_clock::duration limit) { cpu.set_time_limit(limit); }
+
+    CPU::RunStatus step()
     {
-        cpu.step(memory);
+        return cpu.step(memory);
     }
 
     void reset()
@@ -44,4 +90,103 @@ public:
 
     uint32_t get_pc() const { return cpu.get_pc(); }
 
+    void set_decode_cache_enabled(bool enabled) { cpu.set_decode_cache_enabled(enabled); }
+
+    void set_engine(CPU::Engine engine) { cpu.set_engine(engine); }
+    CPU::Engine get_engine() const { return cpu.get_engine(); }
+
+    void set_fusion_enabled(bool enabled) { cpu.set_fusion_enabled(enabled); }
+
+    void set_checked(bool value) { cpu.set_checked(value); }
+
+    // Вызывается после загрузки образа: предекодирование и слияние пар
+    void prepare_code(uint32_t begin, uint32_t end)
+    {
+        cpu.predecode(memory, begin, end);
+        code_ranges.emplace_back(begin, end);
+    }
+
+    // Загружает образ (или сырой код по load_address), ставит PC на точку входа
+    // и предекодирует сегменты кода
+    LoadedImage load(const std::string& path, uint32_t load_address = DEFAULT_LOAD_ADDRESS)
+    {
+        LoadedImage image = load_image(memory, path, load_address);
+
+        for (const ImageSegment& segment : image.segments)
+        {
+            if (segment.kind == SegmentKind::Code)
+            {
+                prepare_code(segment.address, segment.address + segment.file_size);
+            }
+        }
+
+        set_start_address(image.entry);
+        return image;
+    }
+
+    // Стоимость пропорциональна страницам, изменённым с прошлого снимка
+    Snapshot snapshot()
+    {
+        return { cpu.get_state(), memory.snapshot(), code_ranges };
+    }
+
+    // Возврат к снимку. Если это последний снятый или восстановленный снимок этой
+    // машины, переписываются только изменённые с тех пор страницы
+    void restore(const Snapshot& snapshot)
+    {
+        if (snapshot.memory == memory.get_baseline())
+        {
+            // Декодированные копии слов, которые отличаются от снимка, устаревают
+            uint32_t page_size = 1u << memory.get_page_shift();
+            for (uint32_t page : memory.get_dirty_pages())
+            {
+                uint32_t begin = page << memory.get_page_shift();
+                uint32_t end = static_cast<uint32_t>(std::min<uint64_t>(begin + uint64_t{page_size}, memory.size()));
+
+                for (uint32_t addr = begin; addr + 4 <= end; addr += 4)
+                {
+                    if (memory.read<uint32_t>(addr) != snapshot.memory->read_word(addr))
+                    {
+                        cpu.invalidate_code(addr, 4);
+                    }
+                }
+            }
+            memory.restore(snapshot.memory);
+        }
+        else
+        {
+            memory.restore(snapshot.memory);
+            cpu.flush_decode_cache();
+
+            code_ranges.clear();
+            for (const auto& range : snapshot.code_ranges)
+            {
+                prepare_code(range.first, range.second);
+            }
+        }
+
+        cpu.set_state(snapshot.cpu);
+    }
+
+    // Новая машина в состоянии snapshot с теми же настройками; память разделяется
+    // со снимком копированием при записи (на POSIX), без копирования содержимого
+    std::unique_ptr<Machine> fork(const Snapshot& snapshot) const
+    {
+        auto child = std::make_unique<Machine>(memory.size());
+        child->set_engine(cpu.get_engine());
+        child->set_fusion_enabled(cpu.is_fusion_enabled());
+        child->set_checked(cpu.is_checked());
+        child->set_decode_cache_enabled(cpu.is_decode_cache_enabled());
+        child->set_instruction_limit(cpu.get_instruction_limit());
+        child->set_time_limit(cpu.get_time_limit());
+        child->restore(snapshot);
+        return child;
+    }
+
+    std::unique_ptr<Machine> fork()
+    {
+        return fork(snapshot());
+    }
+
+
 };
@@ -2,42 +2,363 @@
 #include <vector>
 #include <memory>
 #include <cstdint>    //  для uint8_t, uint32_t
+#include <cstring>    //  для std::memcpy
 #include <algorithm>  //  для std::copy_n
 #include <stdexcept>  //  для std::out_of_range
 
+// На POSIX память — резерв всего 32-битного гостевого пространства через
+// mmap(MAP_NORESERVE): физические страницы появляются при первом обращении,
+// всё за пределами size() закрыто PROT_NONE. Обращение туда вызывает SIGSEGV,
+// который внутри guarded() превращается в ловушку — проверки границ на каждом
+// доступе нет, read/write это одна загрузка/запись хоста.
+// На остальных платформах — std::vector с проверкой границ, ловушка та же,
+// только через longjmp из readBlock/writeBlock. Исключений гостевой доступ не бросает.
+#if defined(__unix__) || defined(__APPLE__)
+#define MEMORY_GUARD_PAGES 1
+#include <csignal>
+#else
+#define MEMORY_GUARD_PAGES 0
+#endif
+
+#include <atomic>     //  для std::atomic_signal_fence, std::atomic_thread_fence
+#include <csetjmp>
+#include <exception> //  для std::terminate
+
+#if defined(_MSC_VER)
+#include <intrin.h>   //  для _InterlockedCompareExchange
+#endif
+
+// Неизменяемая копия содержимого Memory (снимок). Разделяется между снимками
+// и машинами, созданными fork(); на POSIX лежит в анонимном файле, который
+// память отображает копированием при записи
+class MemoryImage
+{
+public:
+    ~MemoryImage();
+
+    MemoryImage(const MemoryImage&) = delete;
+    MemoryImage& operator=(const MemoryImage&) = delete;
+
+    size_t size() const { return length; }
+    size_t page_count() const { return pages; }
+
+    uint32_t read_word(uint32_t addr) const
+    {
+        uint32_t value = 0;
+#if MEMORY_GUARD_PAGES
+        if (present[addr >> page_shift])
+        {
+            std::memcpy(&value, view + addr, sizeof(value));
+        }
+#else
+        std::memcpy(&value, data.data() + addr, sizeof(value));
+#endif
+        return value;
+    }
+
+private:
+    friend class Memory;
+    MemoryImage() = default;
+
+    size_t length = 0;
+    size_t pages = 0;
+    uint32_t page_shift = 12;
+    std::vector<uint8_t> present;       // по байту на страницу: 1 — страница ненулевая
+#if MEMORY_GUARD_PAGES
+    int fd = -1;
+    const uint8_t* view = nullptr;
+#else
+    std::vector<uint8_t> data;
+#endif
+};
+
 class Memory
 {
+public:
+    static constexpr uint64_t ADDRESS_SPACE = uint64_t{1} << 32;
+
+    // Хвост резерва после 4 GiB: доступ до 8 байт по адресу 0xFFFFFFFF не выходит за резерв
+    static constexpr uint64_t GUARD_SIZE = 64 * 1024;
+
 private:
+    struct TrapScope
+    {
+#if MEMORY_GUARD_PAGES
+        sigjmp_buf env;
+#else
+        std::jmp_buf env;
+#endif
+        const void* owner;
+        const uint8_t* lo;
+        const uint8_t* hi;
+        volatile uint32_t fault_address;    // пишется обработчиком сигнала
+        TrapScope* previous;
+    };
+
+    static TrapScope*& active_scope()
+    {
+        thread_local TrapScope* scope = nullptr;
+        return scope;
+    }
+
+    // Состояние страниц относительно baseline (последнего снимка): нулевая,
+    // совпадает со снимком, изменена. Изменённые страницы перечислены в dirty_pages —
+    // восстановление снимка стоит пропорционально их числу.
+    // На POSIX, начиная с первого baseline, неизменённые страницы закрыты от записи
+    // (PROT_READ): первая запись в такую страницу вызывает SIGSEGV, обработчик отмечает
+    // её изменённой, открывает и запись повторяется. Сам write — обычная запись хоста,
+    // без учёта страниц. До первого baseline память открыта и страницы не учитываются
+    enum PageState : uint8_t { PAGE_ZERO, PAGE_CLEAN, PAGE_DIRTY };
+
+    uint32_t page_shift = 12;
+    std::vector<std::atomic<uint8_t>> page_state;
+    std::vector<uint32_t> dirty_pages;      // ёмкость — все страницы, push_back не выделяет память
+    std::atomic_flag dirty_lock = ATOMIC_FLAG_INIT;
+    std::shared_ptr<const MemoryImage> baseline;
+
+    // Память может быть общей для нескольких CPU на разных потоках: страница
+    // попадает в dirty_pages ровно один раз, кто бы первым в неё ни записал.
+    // На POSIX вызывается из обработчика сигнала и операций хоста, но не из write
+    void mark_dirty(uint32_t addr) noexcept
+    {
+        uint32_t page = addr >> page_shift;
+        if (page_state[page].load(std::memory_order_relaxed) != PAGE_DIRTY &&
+            page_state[page].exchange(PAGE_DIRTY, std::memory_order_relaxed) != PAGE_DIRTY)
+        {
+            while (dirty_lock.test_and_set(std::memory_order_acquire))
+            {
+            }
+            dirty_pages.push_back(page);
+            dirty_lock.clear(std::memory_order_release);
+        }
+    }
+
+    static bool compare_exchange_word(uint8_t* host, uint32_t& expected, uint32_t desired) noexcept
+    {
+#if defined(_MSC_VER)
+        uint32_t old = static_cast<uint32_t>(_InterlockedCompareExchange(
+            reinterpret_cast<volatile long*>(host), static_cast<long>(desired), static_cast<long>(expected)));
+        bool exchanged = old == expected;
+        expected = old;
+        return exchanged;
+#else
+        return __atomic_compare_exchange_n(reinterpret_cast<uint32_t*>(host), &expected, desired,
+                                           false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+    }
+
+    void mark_dirty_range(uint32_t address, size_t size);
+    void init_page_tracking(size_t page_size);
+
+#if MEMORY_GUARD_PAGES
+    uint8_t* base = nullptr;
+    size_t limit = 0;
+
+    // Запись в реестре памяти с защищёнными страницами: по нему обработчик
+    // находит владельца адреса, когда запись сделана не из guarded()
+    struct Registration;
+    static std::atomic<Registration*> registrations;
+    Registration* registration = nullptr;
+
+    static void install_trap_handler();
+    static void trap_handler(int signal, siginfo_t* info, void* context);
+
+    // Запись в закрытую страницу этой памяти: отмечает её изменённой и открывает.
+    // false — адрес не из [base, base + size()) или baseline ещё нет
+    bool open_page(const uint8_t* addr) noexcept;
+
+    // mprotect не смог разделить отображение (vm.max_map_count): открывается вся
+    // память, изменёнными считаются все страницы. false, если не удалось и это
+    bool open_all() noexcept;
+#else
     std::vector<uint8_t> data;
 
+    // Гостевой доступ за границу: longjmp в ближайший guarded() этой памяти.
+    // Вне guarded() это ошибка самого хоста — std::terminate
+    [[noreturn]] void trap(uint32_t offset) const
+    {
+        for (TrapScope* scope = active_scope(); scope; scope = scope->previous)
+        {
+            if (scope->owner == this)
+            {
+                scope->fault_address = offset;
+                std::longjmp(scope->env, 1);
+            }
+        }
+        std::terminate();
+    }
+
     void readBlock(uint8_t* dest, size_t size, uint32_t offset) const
     {
-        if (offset + size > data.size()) throw std::out_of_range("Memory overflow");
+        if (offset + size > data.size()) trap(offset);
         std::copy_n(data.begin() + offset, size, dest);
     }
 
     void writeBlock(const uint8_t* src, size_t size, uint32_t offset)
     {
-        if (offset + size > data.size()) throw std::out_of_range("Memory overflow");
+        if (offset + size > data.size()) trap(offset);
         std::copy_n(src, size, data.begin() + offset);
     }
+#endif
 
 public:
-    Memory(size_t size_in_bytes) : data(size_in_bytes, 0) {}
+    // Размер округляется вверх до размера страницы хоста, максимум — 4 GiB
+    explicit Memory(size_t size_in_bytes);
+    ~Memory();
 
+    Memory(const Memory&) = delete;
+    Memory& operator=(const Memory&) = delete;
+    Memory(Memory&& other) noexcept;
+    Memory& operator=(Memory&&) = delete;
+
+    // Барьер компилятора перед доступом: состояние CPU (PC, регистры), записанное
+    // до обращения, видно в точке ловушки — ловушки точные
+#if MEMORY_GUARD_PAGES
+    template<typename T>
+    T read(uint32_t addr) const noexcept
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        T result;
+        std::memcpy(&result, base + addr, sizeof(T));
+        return result;
+    }
+
+    template<typename T>
+    void write(uint32_t addr, T value) noexcept
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        std::memcpy(base + addr, &value, sizeof(T));
+    }
+
+    // Атомарное сравнение с обменом выровненного слова: если в addr лежит expected,
+    // туда пишется desired. Возвращает прежнее значение слова. Неудачный обмен
+    // тоже может отметить закрытую страницу изменённой
+    uint32_t compare_exchange(uint32_t addr, uint32_t expected, uint32_t desired) noexcept
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        compare_exchange_word(base + addr, expected, desired);
+        return expected;
+    }
+
+    size_t size() const noexcept { return limit; }
+
+    // Гостевой диапазон как непрерывная память хоста (системные вызовы);
+    // nullptr, если он выходит за size()
+    const uint8_t* host_bytes(uint32_t address, size_t length) const noexcept
+    {
+        return uint64_t{address} + length <= limit ? base + address : nullptr;
+    }
+#else
     template<typename T>
-    T read(uint32_t addr) const
+    T read(uint32_t addr) const noexcept
     {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
         T result;
         readBlock(reinterpret_cast<uint8_t*>(&result), sizeof(T), addr);
         return result;
     }
 
     template<typename T>
-    void write(uint32_t addr, T value)
+    void write(uint32_t addr, T value) noexcept
     {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
         writeBlock(reinterpret_cast<const uint8_t*>(&value), sizeof(T), addr);
+        mark_dirty(addr);
+        mark_dirty(addr + sizeof(T) - 1);
+    }
+
+    uint32_t compare_exchange(uint32_t addr, uint32_t expected, uint32_t desired) noexcept
+    {
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+        if (uint64_t{addr} + sizeof(uint32_t) > data.size()) trap(addr);
+        if (compare_exchange_word(data.data() + addr, expected, desired))
+        {
+            mark_dirty(addr);
+        }
+        return expected;
     }
 
-    size_t size() const { return data.size(); }
+    size_t size() const noexcept { return data.size(); }
+
+    const uint8_t* host_bytes(uint32_t address, size_t length) const noexcept
+    {
+        return uint64_t{address} + length <= data.size() ? data.data() + address : nullptr;
+    }
+#endif
+
+    // Полный барьер между обращениями к памяти этого потока (FENCE гостя)
+    static void fence() noexcept
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+
+    // Операции хоста над диапазоном (загрузчик, снимки). Выход за size() —
+    // ошибка хоста: std::out_of_range
+    void write_block(uint32_t address, const void* src, size_t size);
+
+    // Обнуляет диапазон; целые страницы заменяются свежими, физическую память не трогают
+    void zero(uint32_t address, size_t size);
+
+#if MEMORY_GUARD_PAGES
+    // Отображает size байт файла fd со смещения file_offset в гостевую память
+    // по address, копирование при записи. Отображаются только целые страницы хоста:
+    // возвращает число отображённых байт (0, если адрес или смещение не выровнены),
+    // остаток вызывающий копирует сам
+    size_t map_file(int fd, uint64_t file_offset, uint32_t address, size_t size);
+
+    static size_t page_size();
+#endif
+
+    // Снимок текущего содержимого; становится baseline, отсчёт изменённых страниц
+    // начинается заново. Без изменений с прошлого снимка возвращает его же
+    std::shared_ptr<const MemoryImage> snapshot();
+
+    // Возвращает содержимое снимка того же размера. Для текущего baseline
+    // переписываются только изменённые страницы; для другого снимка память
+    // целиком отображается из него копированием при записи (fork)
+    void restore(const std::shared_ptr<const MemoryImage>& image);
+
+    const std::shared_ptr<const MemoryImage>& get_baseline() const { return baseline; }
+
+    // Номера страниц (по 1 << get_page_shift() байт), изменённых с последнего снимка
+    const std::vector<uint32_t>& get_dirty_pages() const { return dirty_pages; }
+    uint32_t get_page_shift() const { return page_shift; }
+
+    // Выполняет fn. Если внутри fn гость обратился за пределы size(), fn
+    // прерывается (без раскрутки стека — в fn не должно быть объектов
+    // с нетривиальными деструкторами), адрес попадает в fault_address, результат false
+    template<typename Fn>
+    bool guarded(Fn&& fn, uint32_t& fault_address) const
+    {
+        struct Restore
+        {
+            TrapScope* previous;
+            ~Restore() { active_scope() = previous; }
+        } restore{active_scope()};
+
+        TrapScope scope;
+        scope.owner = this;
+#if MEMORY_GUARD_PAGES
+        scope.lo = base;
+        scope.hi = base + ADDRESS_SPACE + GUARD_SIZE;
+#else
+        scope.lo = scope.hi = nullptr;
+#endif
+        scope.fault_address = 0;
+        scope.previous = restore.previous;
+
+#if MEMORY_GUARD_PAGES
+        if (sigsetjmp(scope.env, 0) != 0)
+#else
+        if (setjmp(scope.env) != 0)
+#endif
+        {
+            fault_address = scope.fault_address;
+            return false;
+        }
+
+        active_scope() = &scope;
+        fn();
+        return true;
+    }
 };
@@ -0,0 +1,105 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <unordered_map>
+
+class Memory;
+
+// Профиль выполнения гостя: счётчики по PC, по opcode/funct, исходы переходов
+// и обращения LD/ST/STP/CAS по диапазонам адресов. Пока профилировщик подключён
+// (CPU::set_profiler), CPU::run исполняет код эталонным интерпретатором по одной
+// инструкции, независимо от движка; без профилировщика run и step не меняются
+class Profiler
+{
+public:
+    struct PcCounters
+    {
+        uint64_t executed = 0;
+        uint64_t taken = 0;             // для BNE/BEQ/J — сколько раз переход состоялся
+    };
+
+    struct Traffic
+    {
+        uint64_t loads = 0;
+        uint64_t stores = 0;
+    };
+
+    static constexpr uint32_t PAGE_SHIFT = 12;
+    static constexpr uint32_t PAGE_WORDS = (1u << PAGE_SHIFT) / 4;
+
+    // Обращения к памяти суммируются по диапазонам в 1 << range_shift байт
+    explicit Profiler(uint32_t range_shift = 12) : range_shift(range_shift) {}
+
+    // Вызывается CPU после каждой выполненной инструкции
+    void count(uint32_t pc, uint8_t opcode, uint8_t funct, bool taken)
+    {
+        PcCounters& counters = at(pc);
+        counters.executed++;
+        counters.taken += taken;
+        mix[opcode == 0 ? 64 + funct : opcode == VECTOR_OPCODE ? 128 + funct : opcode]++;
+        total++;
+    }
+
+    void access(uint32_t address, bool store)
+    {
+        Traffic& range = traffic[address >> range_shift];
+        (store ? range.stores : range.loads)++;
+    }
+
+    uint64_t instructions() const { return total; }
+
+    // nullptr, если PC ни разу не выполнялся
+    const PcCounters* find(uint32_t pc) const;
+
+    // Число выполненных инструкций с данным opcode (R-формат — с данным funct;
+    // векторные операции в opcode_count не попадают)
+    uint64_t opcode_count(uint8_t opcode) const { return mix[opcode]; }
+    uint64_t funct_count(uint8_t funct) const { return mix[64 + funct]; }
+
+    const std::unordered_map<uint32_t, Traffic>& get_traffic() const { return traffic; }
+    uint32_t get_range_shift() const { return range_shift; }
+
+    // Отчёт: самые горячие базовые блоки и циклы, гистограмма инструкций,
+    // обращения к памяти и дизассемблированный горячий код со счётчиками.
+    // Тексты инструкций читаются из memory
+    void report(std::ostream& out, const Memory& memory, size_t top = 10) const;
+
+    void clear();
+
+private:
+    struct Page
+    {
+        std::array<PcCounters, PAGE_WORDS> counters{};
+    };
+
+    std::unordered_map<uint32_t, std::unique_ptr<Page>> pages;
+    uint32_t last_index = UINT32_MAX;
+    Page* last_page = nullptr;
+
+    // Совпадает с OP_VECTOR в cpu.hpp: векторные операции различаются по funct
+    static constexpr uint8_t VECTOR_OPCODE = 0b100000;
+
+    std::array<uint64_t, 192> mix{};    // opcode; R-формат — 64 + funct, векторные — 128 + funct
+    uint64_t total = 0;
+
+    uint32_t range_shift;
+    std::unordered_map<uint32_t, Traffic> traffic;
+
+    PcCounters& at(uint32_t pc)
+    {
+        uint32_t index = pc >> PAGE_SHIFT;
+        if (index != last_index)
+        {
+            auto& page = pages[index];
+            if (!page)
+            {
+                page = std::make_unique<Page>();
+            }
+            last_index = index;
+            last_page = page.get();
+        }
+        return last_page->counters[(pc & ((1u << PAGE_SHIFT) - 1)) >> 2];
+    }
+};
@@ -0,0 +1,121 @@
+#pragma once
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "machine.hpp"
+
+struct SchedulerOptions
+{
+    unsigned threads = 1;               // 0 — по числу ядер
+    uint64_t quantum = 100000;          // инструкций за один run() гостя
+    uint64_t max_instructions = 0;      // на гостя за всё время, 0 — без лимита
+};
+
+// Вытесняющий планировщик гостей: каждый исполняется квантами по quantum
+// инструкций, так что зациклившийся гость не занимает поток навсегда.
+// Переключение — это run() другой Machine: у каждого гостя своя память и своё
+// состояние CPU, ничего не копируется. Квант — обычный лимит инструкций run(),
+// движки сверяют его только в конце блока (JIT — на обратных переходах блока).
+//
+// Доля процессора пропорциональна весу гостя (честное разделение по виртуальному
+// времени): за квант виртуальное время гостя растёт на instructions * WEIGHT_SCALE / weight,
+// следующим идёт гость с наименьшим. Новый или проснувшийся гость начинает с текущего
+// минимума и не получает процессор «в долг» за время, пока его не было.
+// Учёт идёт по инструкциям, не по времени: он воспроизводим
+class Scheduler
+{
+public:
+    using GuestId = size_t;
+
+    static constexpr uint64_t WEIGHT_SCALE = 1024;
+
+    enum class State : uint8_t
+    {
+        Runnable,
+        Running,
+        Waiting,        // остановился на StopReason::InputWait, ждёт wake()
+        Done
+    };
+
+    struct GuestStats
+    {
+        State state = State::Runnable;
+        CPU::RunStatus status = CPU::RunStatus::Running;    // итог последнего кванта
+        unsigned weight = 1;
+        uint64_t instructions = 0;
+        double cpu_seconds = 0;
+        uint64_t quanta = 0;
+        uint64_t waits = 0;             // остановок на InputWait
+    };
+
+    struct Stats
+    {
+        uint64_t quanta = 0;
+        uint64_t switches = 0;          // квантов, после которых поток взял другого гостя
+        uint64_t finished = 0;
+    };
+
+    // Вызывается в потоке планировщика, когда гость остановился насовсем:
+    // status — Halted, Faulted или Stopped (исчерпан max_instructions)
+    using Done = std::function<void(GuestId id, Machine& machine, CPU::RunStatus status)>;
+
+    // Вызывается в потоке планировщика после кванта, на котором гость остановился,
+    // не завершившись (кончился квант или InputWait). true — гость ждёт wake(), и run()
+    // не вернётся, пока его не разбудят: это обязан сделать тот, кто усыпил.
+    // Без Pause ждёт только гость на InputWait, и run() его не дожидается
+    using Pause = std::function<bool(GuestId id, Machine& machine)>;
+
+    explicit Scheduler(const SchedulerOptions& options = {});
+    ~Scheduler();
+
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+
+    // Машина с загруженной программой; можно вызывать из любого потока, в том
+    // числе из Done и во время run(). std::invalid_argument при нулевом весе
+    GuestId add(std::unique_ptr<Machine> machine, unsigned weight = 1, Done done = {}, Pause pause = {});
+
+    // std::out_of_range для неизвестного id, std::invalid_argument при нулевом весе
+    void set_weight(GuestId id, unsigned weight);
+
+    // Ждущий гость снова готов; для остальных ничего не делает. Пришедший во время
+    // кванта или Pause не даёт гостю уснуть после него
+    void wake(GuestId id);
+
+    // Исполняет гостей, пока есть готовые или исполняемые; ждущие ввода остаются
+    // ждать, следующий run() продолжит их после wake()
+    void run();
+
+    GuestStats get_guest_stats(GuestId id) const;
+    Stats get_stats() const;
+    size_t size() const;
+
+    // Машина гостя; трогать её можно только вне run() или из Done
+    Machine& get_machine(GuestId id);
+
+private:
+    struct Guest;
+
+    SchedulerOptions options;
+    unsigned threads;
+
+    mutable std::mutex mutex;
+    std::condition_variable changed;
+
+    std::vector<std::unique_ptr<Guest>> guests;
+    std::set<std::pair<uint64_t, GuestId>> queue;   // готовые по виртуальному времени
+    uint64_t min_vtime = 0;
+    size_t running = 0;                 // гостей в run(), Pause и Done
+    size_t held = 0;                    // ждущих, которых усыпил Pause
+    Stats stats;
+
+    Guest& find(GuestId id) const;
+    void enqueue(Guest& guest);
+    void work();
+};
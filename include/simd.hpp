@@ -0,0 +1,154 @@
+#pragma once
+#include <cstdint>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE2 1
+#include <emmintrin.h>
+#else
+#define SIMD_SSE2 0
+#endif
+
+// Векторный регистр V0..V31: 128 бит, четыре 32-битные дорожки.
+// Операции ниже — семантика векторных инструкций; на x86-64 это SSE2
+// (есть на любом x86-64, выбирать по CPUID нечего), иначе цикл по дорожкам
+constexpr uint32_t VECTOR_LANES = 4;
+
+struct alignas(16) VectorRegister
+{
+    uint32_t lane[VECTOR_LANES];
+};
+
+#if SIMD_SSE2
+
+inline __m128i simd_load(const VectorRegister& v)
+{
+    return _mm_load_si128(reinterpret_cast<const __m128i*>(v.lane));
+}
+
+inline VectorRegister simd_store(__m128i x)
+{
+    VectorRegister v;
+    _mm_store_si128(reinterpret_cast<__m128i*>(v.lane), x);
+    return v;
+}
+
+// mask ? a : b по дорожкам
+inline __m128i simd_select(__m128i mask, __m128i a, __m128i b)
+{
+    return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+inline VectorRegister vector_add(const VectorRegister& a, const VectorRegister& b)
+{
+    return simd_store(_mm_add_epi32(simd_load(a), simd_load(b)));
+}
+
+inline VectorRegister vector_sub(const VectorRegister& a, const VectorRegister& b)
+{
+    return simd_store(_mm_sub_epi32(simd_load(a), simd_load(b)));
+}
+
+// Переполнение — когда у суммы знак не как у обоих слагаемых;
+// тогда результат — INT32_MAX или INT32_MIN по знаку a
+inline VectorRegister vector_add_saturated(const VectorRegister& a, const VectorRegister& b)
+{
+    __m128i x = simd_load(a);
+    __m128i y = simd_load(b);
+    __m128i sum = _mm_add_epi32(x, y);
+    __m128i overflow = _mm_srai_epi32(_mm_and_si128(_mm_xor_si128(x, sum), _mm_xor_si128(y, sum)), 31);
+    __m128i limit = _mm_xor_si128(_mm_srai_epi32(x, 31), _mm_set1_epi32(INT32_MAX));
+    return simd_store(simd_select(overflow, limit, sum));
+}
+
+// Каждая дорожка — как SSAT с тем же bits
+inline VectorRegister vector_saturate(const VectorRegister& a, uint32_t bits)
+{
+    if (bits == 0 || bits > 31)
+    {
+        return simd_store(_mm_setzero_si128());
+    }
+
+    __m128i max_positive = _mm_set1_epi32((1 << (bits - 1)) - 1);
+    __m128i min_negative = _mm_set1_epi32(-(1 << (bits - 1)));
+    __m128i x = simd_load(a);
+    x = simd_select(_mm_cmpgt_epi32(x, max_positive), max_positive, x);
+    x = simd_select(_mm_cmpgt_epi32(min_negative, x), min_negative, x);
+    return simd_store(x);
+}
+
+inline VectorRegister vector_splat(uint32_t value)
+{
+    return simd_store(_mm_set1_epi32(static_cast<int32_t>(value)));
+}
+
+// Сумма дорожек по модулю 2^32
+inline uint32_t vector_sum(const VectorRegister& a)
+{
+    __m128i x = simd_load(a);
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0x4E));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0xB1));
+    return static_cast<uint32_t>(_mm_cvtsi128_si32(x));
+}
+
+#else
+
+inline VectorRegister vector_add(const VectorRegister& a, const VectorRegister& b)
+{
+    VectorRegister r;
+    for (uint32_t i = 0; i < VECTOR_LANES; i++) r.lane[i] = a.lane[i] + b.lane[i];
+    return r;
+}
+
+inline VectorRegister vector_sub(const VectorRegister& a, const VectorRegister& b)
+{
+    VectorRegister r;
+    for (uint32_t i = 0; i < VECTOR_LANES; i++) r.lane[i] = a.lane[i] - b.lane[i];
+    return r;
+}
+
+inline VectorRegister vector_add_saturated(const VectorRegister& a, const VectorRegister& b)
+{
+    VectorRegister r;
+    for (uint32_t i = 0; i < VECTOR_LANES; i++)
+    {
+        int64_t sum = int64_t{static_cast<int32_t>(a.lane[i])} + static_cast<int32_t>(b.lane[i]);
+        sum = sum > INT32_MAX ? INT32_MAX : sum < INT32_MIN ? INT32_MIN : sum;
+        r.lane[i] = static_cast<uint32_t>(sum);
+    }
+    return r;
+}
+
+inline VectorRegister vector_saturate(const VectorRegister& a, uint32_t bits)
+{
+    VectorRegister r{};
+    if (bits == 0 || bits > 31)
+    {
+        return r;
+    }
+
+    int32_t max_positive = (1 << (bits - 1)) - 1;
+    int32_t min_negative = -(1 << (bits - 1));
+    for (uint32_t i = 0; i < VECTOR_LANES; i++)
+    {
+        int32_t value = static_cast<int32_t>(a.lane[i]);
+        value = value > max_positive ? max_positive : value < min_negative ? min_negative : value;
+        r.lane[i] = static_cast<uint32_t>(value);
+    }
+    return r;
+}
+
+inline VectorRegister vector_splat(uint32_t value)
+{
+    VectorRegister r;
+    for (uint32_t i = 0; i < VECTOR_LANES; i++) r.lane[i] = value;
+    return r;
+}
+
+inline uint32_t vector_sum(const VectorRegister& a)
+{
+    uint32_t sum = 0;
+    for (uint32_t i = 0; i < VECTOR_LANES; i++) sum += a.lane[i];
+    return sum;
+}
+
+#endif
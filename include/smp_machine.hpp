@@ -0,0 +1,163 @@
+#pragma once
+#include "machine.hpp"
+
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+// Несколько CPU (harts) над одной Memory, каждый на своём потоке хоста.
+// Все harts стартуют с точки входа и различаются только SYS_HART_ID.
+//
+// Модель памяти гостя:
+//   - выровненные LD/ST слова атомарны (без разрывов), но порядок обычных
+//     обращений к разным адресам другие harts могут наблюдать любым;
+//   - CAS атомарна и последовательно согласована, она же — полный барьер;
+//   - FENCE — полный барьер: обращения до него видны всем harts раньше любых после.
+// Кэш декодирования и JIT у каждого hart свои: код, который выполняют
+// несколько harts, во время работы менять нельзя
+class SmpMachine
+{
+private:
+    Memory memory;
+    std::vector<std::unique_ptr<CPU>> harts;
+
+public:
+    struct Stats
+    {
+        std::vector<uint64_t> retired;      // по harts
+        double seconds = 0;
+
+        uint64_t instructions() const
+        {
+            uint64_t total = 0;
+            for (uint64_t count : retired) total += count;
+            return total;
+        }
+
+        double instructions_per_second() const { return seconds > 0 ? instructions() / seconds : 0.0; }
+    };
+
+private:
+    Stats stats;
+
+public:
+    SmpMachine(size_t hart_count, size_t memory_size = Machine::DEFAULT_SIZE) : memory(memory_size)
+    {
+        if (hart_count == 0)
+        {
+            throw std::invalid_argument("At least one hart is required");
+        }
+
+        for (size_t id = 0; id < hart_count; id++)
+        {
+            harts.push_back(std::make_unique<CPU>());
+            harts.back()->set_hart(static_cast<uint32_t>(id), static_cast<uint32_t>(hart_count));
+            harts.back()->set_quiet(true);
+        }
+    }
+
+    Memory& get_memory() { return memory; }
+    const Memory& get_memory() const { return memory; }
+
+    size_t hart_count() const { return harts.size(); }
+    CPU& get_hart(size_t id) { return *harts[id]; }
+    const CPU& get_hart(size_t id) const { return *harts[id]; }
+
+    void set_engine(CPU::Engine engine)
+    {
+        for (auto& hart : harts) hart->set_engine(engine);
+    }
+
+    void set_fusion_enabled(bool enabled)
+    {
+        for (auto& hart : harts) hart->set_fusion_enabled(enabled);
+    }
+
+    // Лимиты действуют на каждый hart отдельно
+    void set_instruction_limit(uint64_t count)
+    {
+        for (auto& hart : harts) hart->set_instruction_limit(count);
+    }
+
+    void set_time_limit(std::chrono::steady_clock::duration limit)
+    {
+        for (auto& hart : harts) hart->set_time_limit(limit);
+    }
+
+    void set_decode_cache_enabled(bool enabled)
+    {
+        for (auto& hart : harts) hart->set_decode_cache_enabled(enabled);
+    }
+
+    void set_start_address(uint32_t address)
+    {
+        for (auto& hart : harts) hart->set_pc(address);
+    }
+
+    void prepare_code(uint32_t begin, uint32_t end)
+    {
+        for (auto& hart : harts) hart->predecode(memory, begin, end);
+    }
+
+    // Образ загружается в общую память один раз, все harts встают на точку входа
+    LoadedImage load(const std::string& path, uint32_t load_address = DEFAULT_LOAD_ADDRESS)
+    {
+        LoadedImage image = load_image(memory, path, load_address);
+
+        for (const ImageSegment& segment : image.segments)
+        {
+            if (segment.kind == SegmentKind::Code)
+            {
+                prepare_code(segment.address, segment.address + segment.file_size);
+            }
+        }
+
+        set_start_address(image.entry);
+        return image;
+    }
+
+    // Запускает каждый hart на своём потоке (hart 0 — на вызывающем) и ждёт,
+    // пока остановятся все. SYS_EXIT и ошибка останавливают только свой hart.
+    // Faulted, если ошибся хотя бы один, — его состояние см. get_hart();
+    // иначе Stopped, если хотя бы один остановлен лимитом
+    CPU::RunStatus run()
+    {
+        std::vector<uint64_t> retired_before;
+        for (auto& hart : harts) retired_before.push_back(hart->get_retired());
+
+        auto start = std::chrono::steady_clock::now();
+
+        std::vector<std::thread> threads;
+        for (size_t id = 1; id < harts.size(); id++)
+        {
+            threads.emplace_back([this, id] { harts[id]->run(memory); });
+        }
+        harts[0]->run(memory);
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+
+        stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        stats.retired.clear();
+
+        CPU::RunStatus status = CPU::RunStatus::Halted;
+        for (size_t id = 0; id < harts.size(); id++)
+        {
+            stats.retired.push_back(harts[id]->get_retired() - retired_before[id]);
+            if (harts[id]->status() == CPU::RunStatus::Faulted)
+            {
+                status = CPU::RunStatus::Faulted;
+            }
+            else if (harts[id]->status() == CPU::RunStatus::Stopped && status != CPU::RunStatus::Faulted)
+            {
+                status = CPU::RunStatus::Stopped;
+            }
+        }
+        return status;
+    }
+
+    const Stats& get_stats() const { return stats; }
+};
@@ -0,0 +1,99 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+// Ввод-вывод системных вызовов гостя. CPU только достаёт аргументы из регистров
+// и памяти, форматирование и буферизация — дело реализации. Реализация
+// принадлежит одному CPU за раз: одновременные вызовы из разных потоков не поддерживаются
+class SyscallIO
+{
+public:
+    enum class Format : uint8_t
+    {
+        Banner,     // SYS_PRINT_INT в рамке из '=', приглашение "Input: " перед SYS_READ_INT
+        Raw         // число и перевод строки, без приглашений
+    };
+
+    explicit SyscallIO(Format format) : format(format) {}
+    virtual ~SyscallIO() = default;
+
+    virtual void print_int(uint32_t value) = 0;
+    virtual void print_str(std::string_view text) = 0;
+
+    // Следующее число ввода (через пробельные символы). false — ввод кончился
+    // или там не число; токен при этом пропускается
+    virtual bool read_int(uint32_t& value) = 0;
+
+    // Строка до '\n' (сам он съедается, но не возвращается) или первые max байт.
+    // line действительна до следующего вызова. false — ввод кончился
+    virtual bool read_line(std::string_view& line, size_t max) = 0;
+
+    // Отдаст ли read_int/read_line ввод без ожидания. false — CPU не выполняет
+    // системный вызов и останавливается (StopReason::InputWait) до следующего run()
+    virtual bool can_read_int() { return true; }
+    virtual bool can_read_line(size_t) { return true; }
+
+    virtual void flush() {}
+
+    Format get_format() const { return format; }
+    void set_format(Format value) { format = value; }
+
+protected:
+    Format format;
+};
+
+// Вывод копится в строке и уходит в sink крупными кусками (FLUSH_THRESHOLD)
+// и при flush(); без sink остаётся в памяти, см. output(). Ввод читается из
+// буфера в памяти; когда он кончается, следующая строка дочитывается из source,
+// предварительно сбросив вывод, так что интерактивный запуск видит приглашение
+class BufferedIO : public SyscallIO
+{
+public:
+    static constexpr size_t FLUSH_THRESHOLD = 64 * 1024;
+
+    explicit BufferedIO(std::ostream* sink = nullptr, std::istream* source = nullptr,
+                        Format format = Format::Raw)
+        : SyscallIO(format), sink(sink), source(source) {}
+
+    ~BufferedIO() override { flush(); }
+
+    BufferedIO(const BufferedIO&) = delete;
+    BufferedIO& operator=(const BufferedIO&) = delete;
+
+    // Весь ввод сразу: из памяти или целиком из файла (std::runtime_error, если не открылся)
+    void set_input(std::string data);
+    void load_input(const std::string& path);
+
+    // Дописывает ввод к ещё не прочитанному
+    void append_input(std::string_view data);
+    std::string_view unread_input() const { return std::string_view(in).substr(in_pos); }
+
+    // Ещё не сброшенный вывод; без sink — весь вывод
+    const std::string& output() const { return out; }
+    void clear_output() { out.clear(); }
+    void consume_output(size_t count) { out.erase(0, count); }
+
+    void print_int(uint32_t value) override;
+    void print_str(std::string_view text) override;
+    bool read_int(uint32_t& value) override;
+    bool read_line(std::string_view& line, size_t max) override;
+    void flush() override;
+
+private:
+    std::ostream* sink;
+    std::istream* source;
+
+    std::string in;
+    size_t in_pos = 0;
+    std::string out;
+
+    // Дочитывает строку из source; false, если его нет или он кончился
+    bool refill();
+
+    void written()
+    {
+        if (sink && out.size() >= FLUSH_THRESHOLD) flush();
+    }
+};
@@ -0,0 +1,161 @@
+#pragma once
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "cache_model.hpp"
+
+class Memory;
+
+enum class PredictorKind : uint8_t
+{
+    Static,         // назад — переход, вперёд — нет (BTFN)
+    Bimodal,        // двухбитные счётчики по PC
+    Gshare          // двухбитные счётчики по PC xor глобальная история
+};
+
+struct TimingOptions
+{
+    PredictorKind predictor = PredictorKind::Bimodal;
+    uint32_t predictor_bits = 12;       // 1 << bits счётчиков; у gshare столько же бит истории
+    uint32_t mispredict_penalty = 2;    // переход решается в EX: два потерянных такта
+    uint32_t load_use_penalty = 1;      // результат LD нужен следующей инструкции в EX
+    uint32_t cls_latency = 1;           // тактов в EX; EX не конвейеризован, остальные ждут
+    uint32_t bext_latency = 1;
+    uint32_t ssat_latency = 1;
+    uint32_t l2_latency = 10;           // с моделью кэшей: доп. такты на промах L1, попавший в L2
+    uint32_t memory_latency = 100;      // и на промах L2
+};
+
+// Оценка тактов для классического пятистадийного конвейера IF ID EX MEM WB
+// с обходом (forwarding) по потоку выполненных инструкций. Идеально — такт на
+// инструкцию; сверх этого считаются простои: LD, за которым сразу читают его
+// результат; многотактные CLS/BEXT/SSAT; неверно предсказанные BNE/BEQ
+// (J предсказывается всегда верно: цель известна при декодировании, как и цель
+// предсказанного перехода — считается, что есть BTB); промахи кэшей, если
+// подключена и CacheModel. Подключается через CPU::set_timing_model, как профилировщик
+class TimingModel
+{
+public:
+    enum class Unit : uint8_t
+    {
+        Alu,
+        Load,           // LD, VLD, CAS
+        Store,          // ST, STP, VST
+        Cls,
+        Bext,
+        Ssat,
+        Branch,         // BNE, BEQ
+        Jump,
+        Syscall
+    };
+
+    // Выполненная инструкция: что она читает и пишет, куда ушла
+    struct Event
+    {
+        uint32_t pc = 0;
+        Unit unit = Unit::Alu;
+        uint32_t reads = 0;             // маска X-регистров
+        uint32_t vector_reads = 0;      // маска векторных регистров
+        int8_t writes = -1;             // X-регистр результата или -1
+        int8_t vector_writes = -1;
+        bool taken = false;
+        uint32_t target = 0;            // для BNE/BEQ/J — куда ведёт переход
+        CacheLevel fetch = CacheLevel::L1;  // где нашлась инструкция и данные
+        CacheLevel data = CacheLevel::L1;
+    };
+
+    struct Stalls
+    {
+        uint64_t load_use = 0;
+        uint64_t execute = 0;           // многотактные CLS/BEXT/SSAT
+        uint64_t branch = 0;
+        uint64_t fetch_miss = 0;
+        uint64_t data_miss = 0;
+
+        uint64_t total() const { return load_use + execute + branch + fetch_miss + data_miss; }
+    };
+
+    struct BranchCounters
+    {
+        uint64_t executed = 0;
+        uint64_t taken = 0;
+        uint64_t mispredicted = 0;
+    };
+
+    static constexpr uint32_t PIPELINE_DEPTH = 5;
+
+    // std::invalid_argument при predictor_bits вне 1..24 или нулевой латентности
+    explicit TimingModel(const TimingOptions& options = {});
+
+    void retire(const Event& event);
+
+    uint64_t instructions() const { return retired; }
+    // Такты с заполнением конвейера
+    uint64_t cycles() const { return retired ? retired + PIPELINE_DEPTH - 1 + stalls.total() : 0; }
+    double cpi() const { return retired ? static_cast<double>(cycles()) / static_cast<double>(retired) : 0.0; }
+
+    const Stalls& get_stalls() const { return stalls; }
+    const TimingOptions& get_options() const { return options; }
+
+    // По всем BNE/BEQ (J предсказывается всегда верно и сюда не входит)
+    uint64_t conditional_branches() const { return branches; }
+    uint64_t mispredictions() const { return mispredicted; }
+    double mispredict_rate() const
+    {
+        return branches ? static_cast<double>(mispredicted) / static_cast<double>(branches) : 0.0;
+    }
+
+    // nullptr, если по pc не выполнялся переход
+    const BranchCounters* find_branch(uint32_t pc) const;
+
+    // Отчёт: CPI, разбивка простоев и переходы с наибольшим числом промахов
+    // предсказания (тексты читаются из memory)
+    void report(std::ostream& out, const Memory& memory, size_t top = 10) const;
+
+    void clear();
+
+private:
+    TimingOptions options;
+    uint32_t table_mask;
+
+    std::vector<uint8_t> counters;      // двухбитные, 0..3; 2 и выше — «переход»
+    uint32_t history = 0;
+
+    uint64_t retired = 0;
+    uint64_t branches = 0;
+    uint64_t mispredicted = 0;
+    Stalls stalls;
+
+    int8_t pending_load = -1;           // X-регистр, который грузит предыдущая инструкция
+    int8_t pending_vector_load = -1;
+
+    std::unordered_map<uint32_t, BranchCounters> branch_counters;
+    uint32_t last_branch_pc = 0;        // узлы unordered_map не переезжают: горячий цикл обходится без поиска
+    BranchCounters* last_branch = nullptr;
+
+    BranchCounters& at(uint32_t pc)
+    {
+        if (!last_branch || pc != last_branch_pc)
+        {
+            last_branch = &branch_counters[pc];
+            last_branch_pc = pc;
+        }
+        return *last_branch;
+    }
+
+    uint32_t latency(CacheLevel level) const
+    {
+        return level == CacheLevel::L1 ? 0 : level == CacheLevel::L2 ? options.l2_latency : options.memory_latency;
+    }
+
+    // true — переход предсказан; обновляет счётчики и историю
+    bool predict(uint32_t pc, uint32_t target, bool taken);
+};
+
+// Разбор --timing: через запятую KEY=VALUE; predictor — static, bimodal или gshare,
+// bits, mispredict, load-use, cls, bext, ssat, l2, memory — числа.
+// std::invalid_argument при ошибке
+TimingOptions parse_timing_options(const std::string& spec);
@@ -0,0 +1,286 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iosfwd>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simd.hpp"
+
+// Двоичная трасса выполнения.
+//
+// Заголовок: "CTRC", версия (u16), 0 (u16), PC (u32), X0..X31 (u32), V0..V31 (по 16 байт) —
+// состояние в начале записи; числа little-endian. Дальше по записи на выполненную инструкцию:
+//   tag (u8)          набор TRACE_* ниже
+//   [TRACE_JUMP]      varint zigzag(PC - (PC предыдущей записи + 4))
+//   [TRACE_WORD]      слово инструкции (u32), если его нет в кэше слов
+//   [TRACE_MEMORY]    varint zigzag(адрес - адрес предыдущего обращения)
+//   [TRACE_REGISTER]  номер X (u8, бит 7 — за ним ещё один регистр), varint zigzag(новое - старое)
+//   [TRACE_VECTOR]    номер V (u8), 16 байт нового значения
+// Событие (tag == TRACE_EVENT): вид (TraceEvent, u8), PC (u32), для ошибки — код (u8) и адрес (u32).
+//
+// Кэш слов — прямого отображения по PC >> 2; писатель и читатель ведут его одинаково,
+// поэтому слово пишется только при первом выполнении PC и после перезаписи кода.
+// В REGISTER попадают только изменившиеся регистры. Записанные в память значения
+// не хранятся: читатель знает регистры и восстанавливает их сам
+enum TraceTag : uint8_t
+{
+    TRACE_JUMP     = 1 << 0,
+    TRACE_WORD     = 1 << 1,
+    TRACE_MEMORY   = 1 << 2,
+    TRACE_REGISTER = 1 << 3,
+    TRACE_VECTOR   = 1 << 4,
+    TRACE_EVENT    = 0x80
+};
+
+enum class TraceEvent : uint8_t
+{
+    Halt = 1,       // SYS_EXIT
+    Fault = 2,      // PC — виновная инструкция, она в трассу не попала
+    Stop = 3        // лимит run(); следующий run() продолжит ту же трассу
+};
+
+constexpr uint16_t TRACE_VERSION = 1;
+constexpr uint32_t TRACE_WORD_CACHE = 4096;
+constexpr size_t TRACE_HEADER_SIZE = 12 + 32 * 4 + 32 * sizeof(VectorRegister);
+
+// Кольцо байтов без блокировок: один поток пишет, другой читает.
+// Ёмкость — степень двойки; head и tail растут без ограничения, индекс — по маске
+class TraceRing
+{
+public:
+    explicit TraceRing(size_t capacity);
+
+    size_t capacity() const { return buffer.size(); }
+
+    // Производитель. Ждёт, пока потребитель освободит место: данные не теряются.
+    // size не больше capacity()
+    void push(const uint8_t* data, size_t size);
+
+    // Потребитель: непрерывный кусок готовых данных (0 — пусто), затем consume
+    size_t peek(const uint8_t*& data) const;
+    void consume(size_t size);
+
+private:
+    std::vector<uint8_t> buffer;
+    size_t mask;
+
+    alignas(64) std::atomic<size_t> head{0};   // пишет производитель
+    alignas(64) std::atomic<size_t> tail{0};   // пишет потребитель
+};
+
+// Пишет трассу одного CPU (CPU::set_tracer). Записи кодируются в локальный кусок,
+// полные куски уходят через TraceRing фоновому потоку, который пишет файл
+class TraceWriter
+{
+public:
+    // std::runtime_error, если файл не открылся
+    explicit TraceWriter(const std::string& path, size_t ring_size = size_t{1} << 22);
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool started() const { return is_started; }
+
+    // Заголовок с начальным состоянием; CPU вызывает перед первой записью
+    void start(uint32_t pc, const uint32_t* gpr, const VectorRegister* vr);
+
+    // Запись инструкции: begin, затем memory, register_write, vector — в этом порядке, — затем commit
+    void begin(uint32_t pc, uint32_t word)
+    {
+        if (used > CHUNK_SIZE - MAX_RECORD)
+        {
+            flush_chunk();
+        }
+
+        tag_at = used++;
+        tag = 0;
+        last_register_at = 0;
+
+        if (pc != next_pc)
+        {
+            tag |= TRACE_JUMP;
+            put_varint(zigzag(pc - next_pc));
+        }
+        next_pc = pc + 4;
+
+        WordSlot& slot = words[(pc >> 2) & (TRACE_WORD_CACHE - 1)];
+        if (slot.pc != pc || slot.word != word)
+        {
+            slot.pc = pc;
+            slot.word = word;
+            tag |= TRACE_WORD;
+            put_u32(word);
+        }
+    }
+
+    void memory(uint32_t address)
+    {
+        tag |= TRACE_MEMORY;
+        put_varint(zigzag(address - last_address));
+        last_address = address;
+    }
+
+    // Не больше двух на запись (SYSCALL меняет r0 и r3)
+    void register_write(uint8_t index, uint32_t old_value, uint32_t new_value)
+    {
+        if (last_register_at)
+        {
+            chunk[last_register_at] |= 0x80;
+        }
+        tag |= TRACE_REGISTER;
+        last_register_at = used;
+        chunk[used++] = index;
+        put_varint(zigzag(new_value - old_value));
+    }
+
+    void vector(uint8_t index, const VectorRegister& value)
+    {
+        tag |= TRACE_VECTOR;
+        chunk[used++] = index;
+        std::memcpy(chunk.data() + used, value.lane, sizeof(VectorRegister));
+        used += sizeof(VectorRegister);
+    }
+
+    void commit()
+    {
+        chunk[tag_at] = tag;
+        records++;
+    }
+
+    // Код и адрес — только для TraceEvent::Fault
+    void event(TraceEvent kind, uint32_t pc, uint8_t code = 0, uint32_t address = 0);
+
+    // Дописывает всё в файл и останавливает поток; повторный вызов ничего не делает.
+    // std::runtime_error, если запись в файл не удалась
+    void close();
+
+    uint64_t instructions() const { return records; }
+    // Байт трассы, включая заголовок и ещё не записанные в файл
+    uint64_t bytes() const { return flushed + used; }
+
+private:
+    static constexpr size_t CHUNK_SIZE = size_t{1} << 16;
+    static constexpr size_t MAX_RECORD = 64;
+
+    struct WordSlot
+    {
+        uint32_t pc = UINT32_MAX;
+        uint32_t word = 0;
+    };
+
+    std::vector<uint8_t> chunk;
+    size_t used = 0;
+    size_t tag_at = 0;
+    size_t last_register_at = 0;
+    uint8_t tag = 0;
+
+    uint32_t next_pc = 0;
+    uint32_t last_address = 0;
+    std::array<WordSlot, TRACE_WORD_CACHE> words{};
+
+    uint64_t records = 0;
+    uint64_t flushed = 0;
+    bool is_started = false;
+    bool closed = false;
+
+    TraceRing ring;
+    std::ofstream out;
+    std::atomic<bool> stopping{false};
+    std::atomic<bool> failed{false};
+    std::thread writer;
+
+    static uint32_t zigzag(uint32_t delta)
+    {
+        return (delta << 1) ^ static_cast<uint32_t>(static_cast<int32_t>(delta) >> 31);
+    }
+
+    void put_varint(uint32_t value)
+    {
+        while (value >= 0x80)
+        {
+            chunk[used++] = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        chunk[used++] = static_cast<uint8_t>(value);
+    }
+
+    void put_u32(uint32_t value)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            chunk[used++] = static_cast<uint8_t>(value >> (8 * i));
+        }
+    }
+
+    void flush_chunk();
+    void drain();
+};
+
+// Одна запись трассы; значения регистров после неё — у TraceReader
+struct TraceRecord
+{
+    bool is_event = false;
+    TraceEvent event = TraceEvent::Halt;
+
+    uint32_t pc = 0;
+    uint32_t word = 0;
+
+    bool has_memory = false;
+    uint32_t address = 0;
+
+    uint8_t register_count = 0;
+    std::array<uint8_t, 2> registers{};
+    std::array<uint32_t, 2> old_values{};   // значения до инструкции (для CAS — записанное в память)
+
+    bool has_vector = false;
+    uint8_t vector = 0;
+
+    // Для TraceEvent::Fault
+    uint8_t fault_code = 0;
+    uint32_t fault_address = 0;
+};
+
+// Читает трассу и ведёт состояние регистров по ней.
+// std::runtime_error — не трасса, другая версия или файл обрезан посреди записи
+class TraceReader
+{
+public:
+    explicit TraceReader(const std::string& path);
+
+    // false в конце файла
+    bool next(TraceRecord& record);
+
+    uint32_t get_start_pc() const { return start_pc; }
+    uint32_t get_register(uint8_t index) const { return gpr[index]; }
+    const VectorRegister& get_vector(uint8_t index) const { return vr[index]; }
+
+    uint64_t instructions() const { return records; }
+    uint64_t bytes() const { return offset; }
+
+private:
+    std::ifstream in;
+    uint64_t offset = 0;
+    uint64_t records = 0;
+
+    uint32_t start_pc = 0;
+    uint32_t next_pc = 0;
+    uint32_t last_address = 0;
+    std::array<uint32_t, 32> gpr{};
+    std::array<VectorRegister, 32> vr{};
+    std::array<uint32_t, TRACE_WORD_CACHE> word_pcs;
+    std::array<uint32_t, TRACE_WORD_CACHE> words{};
+
+    uint8_t get_u8();
+    uint32_t get_u32();
+    uint32_t get_varint();
+};
+
+// Текстовый дамп: номер, PC, дизассемблер, обращение к памяти, изменённые регистры.
+// limit — сколько записей вывести (0 — все); в конце итог по размеру трассы
+void dump_trace(TraceReader& reader, std::ostream& out, uint64_t limit = 0);
@@ -1,17 +1,39 @@
 require 'fileutils'
 
 class Assembler
-   def initialize(output_path = 'output.bin')
+  # Формат образа CEXE — см. include/image.hpp
+  IMAGE_MAGIC = 'CEXE'
+  IMAGE_VERSION = 1
+  IMAGE_ALIGNMENT = 4096
+  SEGMENT_CODE = 0
+  SEGMENT_DATA = 1
+  SEGMENT_BSS = 2
+
+  # format: :raw — только слова кода (старый .bin), :image — образ с сегментами;
+  # по умолчанию :image для файлов *.cexe
+   def initialize(output_path = 'output.bin', format: nil, base: 0x1000, data_base: 0x4000)
     @code = []
     @labels = {}
     @pc = 0
     @output_path = output_path
+    @format = format || (File.extname(output_path) == '.cexe' ? :image : :raw)
+    @base = base
+    @data_base = data_base
+    @data = []
+    @bss = []
+    @bss_size = 0
+    @entry = nil
   end
 
     (0..31).each do |i|
     define_method("r#{i}") { "r#{i}" }
   end
 
+  # Векторные регистры: 128 бит, четыре 32-битные дорожки
+  (0..31).each do |i|
+    define_method("v#{i}") { "v#{i}" }
+  end
+
   def assemble(&block)
     puts "Assembler is beginning: "
     instance_eval(&block)
@@ -19,6 +41,36 @@ class Assembler
     return @code
   end
 
+  # Метка текущего адреса кода; попадает в таблицу символов образа
+  def label(name)
+    @labels[name.to_s] = @base + @pc
+  end
+
+  # Точка входа образа (по умолчанию — начало кода)
+  def entry(name)
+    @entry = name.to_s
+  end
+
+  # Слова в сегменте данных; возвращает адрес первого
+  def data(name, *words)
+    address = @data_base + @data.size * 4
+    @labels[name.to_s] = address
+    @data.concat(words.flatten)
+    address
+  end
+
+  # Нулевой блок в BSS (сразу за данными, с выравниванием на страницу); возвращает адрес
+  def bss(name, size)
+    address = bss_base + @bss_size
+    @labels[name.to_s] = address
+    @bss_size += (size + 3) & ~3
+    address
+  end
+
+  def address_of(name)
+    @labels.fetch(name.to_s)
+  end
+
   def addi(rt, rs, imm)
     opcode = 0b101101
     instruction = (opcode << 26) | (reg_num(rs) << 21) | (reg_num(rt) << 16) | (imm & 0xFFFF)
@@ -209,18 +261,153 @@ class Assembler
     puts "STP #{rt1}, #{rt2}, #{offset}(#{base})"
   end
 
+  # CAS rd, rs, rt: если слово по адресу rs равно rt, туда пишется rd; rd получает прежнее слово
+  def cas(rd, rs, rt)
+    opcode = 0b000000
+    funct = 0b011110
+
+    instruction = (opcode << 26) |
+                  (reg_num(rs) << 21) |
+                  (reg_num(rt) << 16) |
+                  (reg_num(rd) << 11) |
+                  (0 << 6) |
+                  funct
+
+    emit(instruction)
+    puts "CAS #{rd}, #{rs}, #{rt} -> opcode: #{opcode}, funct: #{funct}"
+  end
+
+  # Полный барьер памяти между harts
+  def fence
+    opcode = 0b000000
+    funct = 0b111000
+
+    instruction = (opcode << 26) | funct
+    emit(instruction)
+    puts "FENCE"
+  end
+
+  # VLD vt, "offset(base)": 16 байт из памяти в vt, выравнивание не требуется
+  def vld(vt, offset_base)
+    vector_memory(0b110001, 'VLD', vt, offset_base)
+  end
+
+  # VST vt, "offset(base)": vt в 16 байт памяти
+  def vst(vt, offset_base)
+    vector_memory(0b110011, 'VST', vt, offset_base)
+  end
+
+  # Поэлементно по четырём 32-битным дорожкам
+  def vadd(vd, vs1, vs2)
+    vector_op(0b000001, 'VADD', vreg_num(vd), vreg_num(vs1), vreg_num(vs2))
+  end
+
+  def vsub(vd, vs1, vs2)
+    vector_op(0b000010, 'VSUB', vreg_num(vd), vreg_num(vs1), vreg_num(vs2))
+  end
+
+  # Сложение с насыщением до INT32_MIN..INT32_MAX
+  def vadds(vd, vs1, vs2)
+    vector_op(0b000011, 'VADDS', vreg_num(vd), vreg_num(vs1), vreg_num(vs2))
+  end
+
+  # SSAT для каждой дорожки
+  def vssat(vd, vs, imm5)
+    imm5 = imm5.is_a?(String) && imm5.start_with?('#') ? imm5[1..-1].to_i : imm5.to_i
+    vector_op(0b000100, 'VSSAT', vreg_num(vd), vreg_num(vs), imm5)
+  end
+
+  # X[rs] во все дорожки vd
+  def vsplat(vd, rs)
+    vector_op(0b000101, 'VSPLAT', vreg_num(vd), reg_num(rs), 0)
+  end
+
+  # Сумма дорожек vs в X[rd]
+  def vredsum(rd, vs)
+    vector_op(0b000110, 'VREDSUM', reg_num(rd), vreg_num(vs), 0)
+  end
+
 
   private
 
+  # Заголовок, таблица сегментов, сегменты с выравниванием на страницу, символы
+  def image_bytes
+    segments = [[SEGMENT_CODE, @base, @code.pack('V*')]]
+    segments << [SEGMENT_DATA, @data_base, @data.pack('V*')] unless @data.empty?
+    segments << [SEGMENT_BSS, bss_base, ''] if @bss_size > 0
+
+    offset = align(32 + segments.size * 24)
+    table = segments.map do |kind, address, bytes|
+      memory_size = kind == SEGMENT_BSS ? @bss_size : bytes.bytesize
+      entry = [kind, address, bytes.empty? ? 0 : offset, bytes.bytesize, memory_size, 0].pack('V6')
+      offset = align(offset + bytes.bytesize)
+      entry
+    end
+
+    symbols = @labels.sort_by { |_, address| address }
+    symbol_offset = symbols.empty? ? 0 : offset
+    entry = @entry ? address_of(@entry) : @base
+
+    out = [IMAGE_MAGIC, IMAGE_VERSION, segments.size, entry, symbol_offset, symbols.size, 0, 0, 0]
+            .pack('a4vvV6').b
+    out << table.join
+    segments.each do |_, _, bytes|
+      next if bytes.empty?
+      out << "\0" * (align(out.bytesize) - out.bytesize)
+      out << bytes
+    end
+
+    unless symbols.empty?
+      out << "\0" * (symbol_offset - out.bytesize)
+      name_offset = 0
+      symbols.each do |name, address|
+        out << [address, name_offset].pack('V2')
+        name_offset += name.bytesize + 1
+      end
+      symbols.each { |name, _| out << name.b << "\0" }
+    end
+
+    out
+  end
+
   def emit(instruction)
     @code << instruction
     @pc += 4
   end
 
+  def vector_op(funct, name, a, b, c)
+    opcode = 0b100000
+    instruction = (opcode << 26) | (a << 21) | (b << 16) | (c << 11) | funct
+    emit(instruction)
+    puts "#{name} #{a}, #{b}, #{c}"
+  end
+
+  def vector_memory(opcode, name, vt, offset_base)
+    offset_str, base_str = offset_base.split('(')
+    base_str = base_str.chomp(')')
+    offset = offset_str.empty? ? 0 : offset_str.to_i
+
+    instruction = (opcode << 26) | (reg_num(base_str) << 21) | (vreg_num(vt) << 16) | (offset & 0xFFFF)
+    emit(instruction)
+    puts "#{name} #{vt}, #{offset}(#{base_str})"
+  end
+
 def reg_num(reg)
   reg.to_s.delete('r').to_i
 end
 
+def vreg_num(reg)
+  reg.to_s.delete('v').to_i
+end
+
+  def align(value)
+    (value + IMAGE_ALIGNMENT - 1) & ~(IMAGE_ALIGNMENT - 1)
+  end
+
+  def bss_base
+    align(@data_base + @data.size * 4)
+  end
+
   def generate_binary
     puts "\nGenerating bin file: #{@output_path}"
 
@@ -229,8 +416,12 @@ end
     FileUtils.mkdir_p(dir) unless dir.empty?
 
     File.open(@output_path, 'wb') do |file|
-      @code.each do |instruction|
-        file.write([instruction].pack('V'))
+      if @format == :image
+        file.write(image_bytes)
+      else
+        @code.each do |instruction|
+          file.write([instruction].pack('V'))
+        end
       end
     end
 
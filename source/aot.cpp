@@ -0,0 +1,664 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdexcept>
+
+#include "aot.hpp"
+#include "disassembler.hpp"
+#include "image.hpp"
+#include "machine.hpp"
+
+namespace
+{
+    // Поля слова — как в CPU::Instruction
+    struct Fields
+    {
+        uint8_t opcode, funct, rd, rs1, rs2;
+        uint32_t imm;           // знакорасширенный [15:0]
+        uint32_t offset;        // знакорасширенный [10:0] (STP)
+        uint32_t target;        // [25:0] (J)
+
+        explicit Fields(uint32_t word)
+            : opcode(word >> 26), funct(word & 0x3F), rd((word >> 21) & 0x1F), rs1((word >> 16) & 0x1F),
+              rs2((word >> 11) & 0x1F),
+              imm(static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(word & 0xFFFF)))),
+              offset(static_cast<uint32_t>((static_cast<int32_t>(word << 21)) >> 21)),
+              target(word & 0x3FFFFFF) {}
+    };
+
+    enum Kind : uint8_t
+    {
+        K_LD, K_ST, K_STP, K_CAS, K_FENCE,
+        K_ADD, K_SUB, K_ADDI, K_CLS, K_BEXT, K_SSAT, K_SBIT,
+        K_BNE, K_BEQ, K_J, K_SYSCALL,
+        K_VLD, K_VST, K_VADD, K_VSUB, K_VADDS, K_VSSAT, K_VSPLAT, K_VREDSUM,
+        K_OTHER     // неизвестная инструкция: выполнит (и поднимет ошибку) интерпретатор
+    };
+
+    // Коды — как в CPU::Opcode, CPU::Funct и CPU::VectorFunct
+    Kind kind_of(const Fields& f)
+    {
+        if (f.opcode == 0b000000)
+        {
+            switch (f.funct)
+            {
+                case 0b001010: return K_CLS;
+                case 0b010010: return K_ADD;
+                case 0b010100: return K_BEXT;
+                case 0b101000: return K_SYSCALL;
+                case 0b110110: return K_SUB;
+                case 0b011110: return K_CAS;
+                case 0b111000: return K_FENCE;
+                default:       return K_OTHER;
+            }
+        }
+
+        if (f.opcode == 0b100000)
+        {
+            switch (f.funct)
+            {
+                case 0b000001: return K_VADD;
+                case 0b000010: return K_VSUB;
+                case 0b000011: return K_VADDS;
+                case 0b000100: return K_VSSAT;
+                case 0b000101: return K_VSPLAT;
+                case 0b000110: return K_VREDSUM;
+                default:       return K_OTHER;
+            }
+        }
+
+        switch (f.opcode)
+        {
+            case 0b001101: return K_SSAT;
+            case 0b010101: return K_STP;
+            case 0b011000: return K_BNE;
+            case 0b011010: return K_BEQ;
+            case 0b011100: return K_SBIT;
+            case 0b011111: return K_J;
+            case 0b101101: return K_ADDI;
+            case 0b110001: return K_VLD;
+            case 0b110011: return K_VST;
+            case 0b110111: return K_ST;
+            case 0b111001: return K_LD;
+            default:       return K_OTHER;
+        }
+    }
+
+    uint32_t branch_target(uint32_t pc, const Fields& f, Kind kind)
+    {
+        if (kind == K_J)
+        {
+            return (pc & 0xFFFFF000) | (f.target << 2);
+        }
+        return pc + (f.imm << 2);
+    }
+
+    // Есть ли у инструкции следующая по адресу (SYSCALL — после интерпретатора)
+    bool falls_through(Kind kind)
+    {
+        return kind != K_J && kind != K_OTHER;
+    }
+
+    std::string hex(uint32_t value)
+    {
+        std::ostringstream out;
+        out << "0x" << std::hex << std::setw(8) << std::setfill('0') << value << "u";
+        return out.str();
+    }
+
+    std::string label(uint32_t pc)
+    {
+        std::ostringstream out;
+        out << "L_" << std::hex << std::setw(8) << std::setfill('0') << pc;
+        return out.str();
+    }
+
+    std::string x(uint8_t index) { return "x" + std::to_string(index); }
+    std::string v(uint8_t index) { return "v" + std::to_string(index); }
+
+    class Translator
+    {
+    public:
+        Translator(const Memory& memory, const std::vector<std::pair<uint32_t, uint32_t>>& code, uint32_t entry,
+                   const AotOptions& options)
+            : memory(memory), code(code), entry(entry), options(options) {}
+
+        std::string run()
+        {
+            discover();
+            emit();
+            return out.str();
+        }
+
+    private:
+        const Memory& memory;
+        const std::vector<std::pair<uint32_t, uint32_t>>& code;
+        uint32_t entry;
+        const AotOptions& options;
+
+        std::map<uint32_t, uint32_t> words;     // достижимые инструкции
+        std::set<uint32_t> leaders;
+        std::set<uint8_t> used_x, used_v;
+        uint32_t code_lo = UINT32_MAX;
+        uint64_t code_hi = 0;
+
+        std::ostringstream out;
+        uint32_t in_block = 0;                  // выполнено инструкций текущего блока до текущей
+
+        bool in_code(uint32_t pc) const
+        {
+            if (pc & 3)
+            {
+                return false;
+            }
+            for (const auto& range : code)
+            {
+                if (pc >= range.first && uint64_t{pc} + 4 <= range.second && uint64_t{pc} + 4 <= memory.size())
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        // Граф потока управления: все переходы статические, поэтому обход от entry
+        // находит весь код, до которого может дойти программа
+        void discover()
+        {
+            std::vector<uint32_t> work;
+            auto reach = [&](uint32_t pc, bool leader)
+            {
+                if (!in_code(pc))
+                {
+                    return;
+                }
+                if (leader)
+                {
+                    leaders.insert(pc);
+                }
+                if (words.emplace(pc, memory.read<uint32_t>(pc)).second)
+                {
+                    work.push_back(pc);
+                }
+            };
+
+            reach(entry, true);
+            while (!work.empty())
+            {
+                uint32_t pc = work.back();
+                work.pop_back();
+
+                Fields f(words[pc]);
+                Kind kind = kind_of(f);
+                note_registers(f, kind);
+
+                if (kind == K_BNE || kind == K_BEQ || kind == K_J)
+                {
+                    reach(branch_target(pc, f, kind), true);
+                }
+                if (falls_through(kind))
+                {
+                    // После ветвления и SYSCALL начинается новый блок; в него же входит run_aot
+                    reach(pc + 4, kind == K_BNE || kind == K_BEQ || kind == K_SYSCALL);
+                }
+            }
+
+            for (const auto& [pc, word] : words)
+            {
+                code_lo = std::min(code_lo, pc);
+                code_hi = std::max(code_hi, uint64_t{pc} + 4);
+            }
+        }
+
+        void note_registers(const Fields& f, Kind kind)
+        {
+            switch (kind)
+            {
+                case K_LD: case K_ST: case K_ADDI: case K_CLS: case K_SSAT:
+                    used_x.insert({ f.rd, f.rs1 });
+                    break;
+                case K_STP: case K_CAS: case K_ADD: case K_SUB: case K_BEXT:
+                    used_x.insert({ f.rd, f.rs1, f.rs2 });
+                    break;
+                case K_SBIT:
+                    used_x.insert(f.rd);
+                    break;
+                case K_BNE: case K_BEQ:
+                    used_x.insert({ f.rd, f.rs1 });
+                    break;
+                case K_VLD: case K_VST:
+                    used_x.insert(f.rd);
+                    used_v.insert(f.rs1);
+                    break;
+                case K_VADD: case K_VSUB: case K_VADDS:
+                    used_v.insert({ f.rd, f.rs1, f.rs2 });
+                    break;
+                case K_VSSAT:
+                    used_v.insert({ f.rd, f.rs1 });
+                    break;
+                case K_VSPLAT:
+                    used_v.insert(f.rd);
+                    used_x.insert(f.rs1);
+                    break;
+                case K_VREDSUM:
+                    used_x.insert(f.rd);
+                    used_v.insert(f.rs1);
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // Выход перед инструкцией по pc: она не выполнена и не посчитана
+        std::string leave(uint32_t pc, const char* why = nullptr) const
+        {
+            std::string text = "{ ";
+            if (in_block)
+            {
+                text += "n += " + std::to_string(in_block) + "; ";
+            }
+            text += "pc = " + hex(pc) + "; ";
+            if (why)
+            {
+                text += std::string("why = ") + why + "; ";
+            }
+            return text + "goto leave; }";
+        }
+
+        // Переход после выполненной инструкции: в блок или, если цели нет, к интерпретатору
+        std::string jump(uint32_t target) const
+        {
+            std::string count = "n += " + std::to_string(in_block + 1) + "; ";
+            if (leaders.count(target))
+            {
+                return "{ " + count + "goto " + label(target) + "; }";
+            }
+            return "{ " + count + "pc = " + hex(target) + "; goto leave; }";
+        }
+
+        // Проверки обращения: за size() — выход к интерпретатору (он поднимет ловушку),
+        // запись в оттранслированный код — выход насовсем
+        void access(uint32_t pc, uint32_t bytes, bool store, const std::string& indent = "        ")
+        {
+            out << indent << "if (uint64_t{a} + " << bytes << " > size) " << leave(pc) << "\n";
+            if (store)
+            {
+                out << indent << "if (uint64_t{a} + " << bytes << " > " << hex(code_lo) << " && a <= "
+                    << hex(static_cast<uint32_t>(code_hi - 1)) << ") " << leave(pc, "AotExit::CodeWrite") << "\n";
+            }
+        }
+
+        void emit_instruction(uint32_t pc, uint32_t word)
+        {
+            Fields f(word);
+            Kind kind = kind_of(f);
+
+            out << "    // " << hex(pc).substr(0, 10) << "  " << disassemble(word, pc) << "\n";
+            switch (kind)
+            {
+                case K_ADDI:
+                    out << "    " << x(f.rs1) << " = " << x(f.rd) << " + " << hex(f.imm) << ";\n";
+                    break;
+                case K_ADD:
+                    out << "    " << x(f.rs2) << " = " << x(f.rd) << " + " << x(f.rs1) << ";\n";
+                    break;
+                case K_SUB:
+                    out << "    " << x(f.rs2) << " = " << x(f.rd) << " - " << x(f.rs1) << ";\n";
+                    break;
+                case K_CLS:
+                    out << "    " << x(f.rd) << " = count_leading_signs(" << x(f.rs1) << ");\n";
+                    break;
+                case K_BEXT:
+                    out << "    " << x(f.rd) << " = extract_bits(" << x(f.rs1) << ", " << x(f.rs2) << ");\n";
+                    break;
+                case K_SBIT:
+                    out << "    " << x(f.rd) << " = " << hex(uint32_t{1} << f.rs2) << ";\n";
+                    break;
+                case K_SSAT:
+                    if (f.rs2 == 0 || f.rs2 > 31)
+                    {
+                        out << "    " << x(f.rd) << " = 0u;\n";
+                    }
+                    else
+                    {
+                        int32_t max_positive = static_cast<int32_t>((uint32_t{1} << (f.rs2 - 1)) - 1);
+                        int32_t min_negative = -max_positive - 1;
+                        out << "    {\n"
+                            << "        int32_t value = static_cast<int32_t>(" << x(f.rs1) << ");\n"
+                            << "        " << x(f.rd) << " = static_cast<uint32_t>(value > " << max_positive << " ? "
+                            << max_positive << " : value < " << min_negative << " ? " << min_negative
+                            << " : value);\n"
+                            << "    }\n";
+                    }
+                    break;
+                case K_LD:
+                    out << "    {\n        uint32_t a = " << x(f.rd) << " + " << hex(f.imm) << ";\n";
+                    access(pc, 4, false);
+                    out << "        " << x(f.rs1) << " = memory.read<uint32_t>(a);\n    }\n";
+                    break;
+                case K_ST:
+                    // Невыровненный ST ничего не пишет
+                    out << "    {\n        uint32_t a = " << x(f.rd) << " + " << hex(f.imm) << ";\n"
+                        << "        if ((a & 3) == 0)\n        {\n";
+                    access(pc, 4, true, "            ");
+                    out << "            memory.write<uint32_t>(a, " << x(f.rs1) << ");\n        }\n    }\n";
+                    break;
+                case K_STP:
+                    out << "    {\n        uint32_t a = " << x(f.rd) << " + " << hex(f.offset) << ";\n";
+                    access(pc, 8, true);
+                    out << "        memory.write<uint32_t>(a, " << x(f.rs1) << ");\n"
+                        << "        memory.write<uint32_t>(a + 4, " << x(f.rs2) << ");\n    }\n";
+                    break;
+                case K_CAS:
+                    out << "    {\n        uint32_t a = " << x(f.rd) << ";\n"
+                        << "        if ((a & 3) != 0) " << leave(pc) << "\n";
+                    access(pc, 4, true);
+                    out << "        " << x(f.rs2) << " = memory.compare_exchange(a, " << x(f.rs1) << ", " << x(f.rs2)
+                        << ");\n    }\n";
+                    break;
+                case K_FENCE:
+                    out << "    Memory::fence();\n";
+                    break;
+                case K_VLD:
+                    out << "    {\n        uint32_t a = " << x(f.rd) << " + " << hex(f.imm) << ";\n";
+                    access(pc, 16, false);
+                    out << "        " << v(f.rs1) << " = memory.read<VectorRegister>(a);\n    }\n";
+                    break;
+                case K_VST:
+                    out << "    {\n        uint32_t a = " << x(f.rd) << " + " << hex(f.imm) << ";\n";
+                    access(pc, 16, true);
+                    out << "        memory.write<VectorRegister>(a, " << v(f.rs1) << ");\n    }\n";
+                    break;
+                case K_VADD:
+                    out << "    " << v(f.rd) << " = vector_add(" << v(f.rs1) << ", " << v(f.rs2) << ");\n";
+                    break;
+                case K_VSUB:
+                    out << "    " << v(f.rd) << " = vector_sub(" << v(f.rs1) << ", " << v(f.rs2) << ");\n";
+                    break;
+                case K_VADDS:
+                    out << "    " << v(f.rd) << " = vector_add_saturated(" << v(f.rs1) << ", " << v(f.rs2) << ");\n";
+                    break;
+                case K_VSSAT:
+                    out << "    " << v(f.rd) << " = vector_saturate(" << v(f.rs1) << ", " << unsigned{f.rs2} << ");\n";
+                    break;
+                case K_VSPLAT:
+                    out << "    " << v(f.rd) << " = vector_splat(" << x(f.rs1) << ");\n";
+                    break;
+                case K_VREDSUM:
+                    out << "    " << x(f.rd) << " = vector_sum(" << v(f.rs1) << ");\n";
+                    break;
+                case K_BNE:
+                case K_BEQ:
+                    out << "    if (" << x(f.rd) << (kind == K_BNE ? " != " : " == ") << x(f.rs1) << ") "
+                        << jump(branch_target(pc, f, kind)) << "\n";
+                    break;
+                case K_J:
+                    out << "    " << jump(branch_target(pc, f, kind)) << "\n";
+                    break;
+                case K_SYSCALL:
+                case K_OTHER:
+                    out << "    " << leave(pc) << "\n";
+                    break;
+            }
+
+            if (kind != K_SYSCALL && kind != K_OTHER)
+            {
+                in_block++;
+            }
+        }
+
+        void emit()
+        {
+            const std::string& name = options.name;
+
+            out << "// Оттранслировано cpu_emulator aot" << (options.source.empty() ? "" : " из " + options.source)
+                << "; не редактировать.\n"
+                << "// Базовые блоки — метки, регистры — локальные переменные; инструкции, которые\n"
+                << "// здесь не выполнить (SYSCALL, ошибки, запись в код), исполняет интерпретатор (run_aot)\n"
+                << "#include \"aot.hpp\"\n\n"
+                << "namespace\n{\n"
+                << "    const AotWord " << name << "_words[] =\n    {\n";
+            for (const auto& [pc, word] : words)
+            {
+                out << "        { " << hex(pc) << ", " << hex(word) << " },\n";
+            }
+            out << "    };\n\n";
+
+            out << "    AotExit " << name << "_run(CPU::State& state, Memory& memory, uint64_t& retired)\n    {\n";
+            std::ostringstream body;
+            out.swap(body);
+            emit_body();
+            std::string text = out.str();
+            out.swap(body);
+
+            // Тело функции с отступом пространства имён
+            std::istringstream lines(text);
+            std::string line;
+            while (std::getline(lines, line))
+            {
+                if (!line.empty() && line.back() != ':')
+                {
+                    out << "    ";
+                }
+                out << line << "\n";
+            }
+            out << "    }\n}\n\n";
+
+            out << "extern const AotProgram " << name << " =\n{\n"
+                << "    " << name << "_run, " << name << "_words, " << words.size() << ", " << hex(options.load_address)
+                << ", " << options.memory_size << "u\n};\n\n"
+                << "#ifndef AOT_NO_MAIN\n"
+                << "int main(int argc, char** argv)\n{\n"
+                << "    return aot_main(" << name << ", argc, argv);\n}\n"
+                << "#endif\n";
+        }
+
+        void emit_body()
+        {
+            for (uint8_t r : used_x)
+            {
+                out << "    uint32_t " << x(r) << " = state.gpr[" << unsigned{r} << "];\n";
+            }
+            for (uint8_t r : used_v)
+            {
+                out << "    VectorRegister " << v(r) << " = state.vr[" << unsigned{r} << "];\n";
+            }
+            out << "    [[maybe_unused]] const uint64_t size = memory.size();\n"
+                << "    uint64_t n = 0;\n"
+                << "    uint32_t pc = state.pc;\n"
+                << "    AotExit why = AotExit::Interpret;\n\n"
+                << "    switch (state.pc)\n    {\n";
+            for (uint32_t pc : leaders)
+            {
+                out << "        case " << hex(pc) << ": goto " << label(pc) << ";\n";
+            }
+            out << "        default: goto leave;\n    }\n";
+
+            bool open = false;          // предыдущая инструкция проваливается в следующую
+            uint32_t next = 0;
+            for (const auto& [pc, word] : words)
+            {
+                if (open && next != pc)
+                {
+                    // Следующее слово за пределами кода
+                    out << "    " << leave(next) << "\n";
+                    open = false;
+                }
+
+                if (leaders.count(pc))
+                {
+                    if (open && in_block)
+                    {
+                        out << "    n += " << in_block << ";\n";
+                    }
+                    out << "\n" << label(pc) << ":\n";
+                    in_block = 0;
+                }
+
+                emit_instruction(pc, word);
+                Kind kind = kind_of(Fields(word));
+                open = falls_through(kind) && kind != K_SYSCALL;
+                next = pc + 4;
+            }
+            if (open)
+            {
+                out << "    " << leave(next) << "\n";
+            }
+
+            out << "\nleave:\n";
+            for (uint8_t r : used_x)
+            {
+                out << "    state.gpr[" << unsigned{r} << "] = " << x(r) << ";\n";
+            }
+            for (uint8_t r : used_v)
+            {
+                out << "    state.vr[" << unsigned{r} << "] = " << v(r) << ";\n";
+            }
+            out << "    state.pc = pc;\n"
+                << "    retired += n;\n"
+                << "    return why;\n";
+        }
+    };
+
+    bool is_syscall(uint32_t word)
+    {
+        return (word >> 26) == 0 && (word & 0x3F) == 0b101000;
+    }
+}
+
+std::string translate_to_cpp(const Memory& memory, const std::vector<std::pair<uint32_t, uint32_t>>& code,
+                             uint32_t entry, const AotOptions& options)
+{
+    return Translator(memory, code, entry, options).run();
+}
+
+std::string translate_image(const std::string& path, AotOptions options)
+{
+    Memory memory(options.memory_size);
+    LoadedImage image = load_image(memory, path, options.load_address);
+
+    std::vector<std::pair<uint32_t, uint32_t>> code;
+    for (const ImageSegment& segment : image.segments)
+    {
+        if (segment.kind == SegmentKind::Code)
+        {
+            code.emplace_back(segment.address, segment.address + segment.file_size);
+        }
+    }
+
+    if (options.source.empty())
+    {
+        options.source = path;
+    }
+    return translate_to_cpp(memory, code, image.entry, options);
+}
+
+// Трансляция выходит к интерпретатору по одной инструкции за раз. SYS_READ_STR
+// в оттранслированный код и выход CodeWrite переводят остаток программы на интерпретатор
+CPU::RunStatus run_aot(const AotProgram& program, Machine& machine)
+{
+    CPU& cpu = machine.get_cpu();
+    Memory& memory = machine.get_memory();
+
+    uint32_t code_lo = UINT32_MAX;
+    uint64_t code_hi = 0;
+    for (size_t i = 0; i < program.word_count; i++)
+    {
+        const AotWord& word = program.words[i];
+        if (memory.host_bytes(word.address, 4) == nullptr || memory.read<uint32_t>(word.address) != word.word)
+        {
+            std::ostringstream message;
+            message << "Program image does not match the translation at 0x" << std::hex << word.address;
+            throw std::runtime_error(message.str());
+        }
+        code_lo = std::min(code_lo, word.address);
+        code_hi = std::max(code_hi, uint64_t{word.address} + 4);
+    }
+
+    bool quiet = cpu.is_quiet();
+    if (!quiet)
+    {
+        std::cout << "Starting execution " << std::endl;
+    }
+
+    CPU::RunStatus status = CPU::RunStatus::Running;
+    while (status == CPU::RunStatus::Running)
+    {
+        CPU::State state = cpu.get_state();
+        uint64_t retired = 0;
+        AotExit exit = program.run(state, memory, retired);
+        cpu.set_state(state);
+        cpu.add_retired(retired);
+
+        if (exit == AotExit::CodeWrite)
+        {
+            cpu.set_quiet(true);
+            status = cpu.run(memory);
+            cpu.set_quiet(quiet);
+            break;
+        }
+
+        uint32_t word = memory.host_bytes(state.pc, 4) ? memory.read<uint32_t>(state.pc) : 0;
+        bool read_str = is_syscall(word) && state.gpr[8] == 4;
+        uint32_t buffer = state.gpr[3];
+
+        status = cpu.step(memory);
+
+        uint32_t length = cpu.get_register(3);
+        if (status == CPU::RunStatus::Running && read_str && length != UINT32_MAX &&
+            buffer < code_hi && uint64_t{buffer} + length > code_lo)
+        {
+            cpu.set_quiet(true);
+            status = cpu.run(memory);
+            cpu.set_quiet(quiet);
+        }
+    }
+
+    cpu.get_io().flush();
+    if (status == CPU::RunStatus::Halted && !quiet)
+    {
+        std::cout << "Program halted normally" << std::endl;
+    }
+    return status;
+}
+
+int aot_main(const AotProgram& program, int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage: " << (argc > 0 ? argv[0] : "program") << " IMAGE" << std::endl;
+        return 1;
+    }
+
+    Machine machine(program.memory_size);
+    CPU::RunStatus status;
+    auto start = std::chrono::steady_clock::now();
+    try
+    {
+        machine.load(argv[1], program.load_address);
+        start = std::chrono::steady_clock::now();
+        status = run_aot(program, machine);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const CPU& cpu = machine.get_cpu();
+    if (status == CPU::RunStatus::Faulted)
+    {
+        std::cerr << "Guest fault: " << CPU::fault_name(cpu.get_fault()) << " at PC 0x" << std::hex
+                  << cpu.get_fault_pc() << " (address 0x" << cpu.get_fault_address() << ")" << std::dec << std::endl;
+    }
+
+    std::cerr << "Executed " << cpu.get_retired() << " instructions in " << std::fixed << std::setprecision(3)
+              << seconds << " s (" << std::setprecision(1) << (seconds > 0 ? cpu.get_retired() / seconds / 1e6 : 0.0)
+              << " MIPS)" << std::endl;
+    return status == CPU::RunStatus::Faulted ? 2 : 0;
+}
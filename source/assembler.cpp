@@ -0,0 +1,892 @@
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+
+#include "assembler.hpp"
+
+namespace
+{
+    // Как раскладываются операнды по полям; кодировки — см. ReadMe
+    enum class Form : uint8_t
+    {
+        Addi,           // rt, rs, imm16            rs [25:21], rt [20:16]
+        Arith,          // rd, rs, rt               rs [25:21], rt [20:16], rd [15:11]
+        Cls,            // rd, rs                   rd [25:21], rs [20:16]
+        Bext,           // rd, rs1, rs2             по порядку в [25:21], [20:16], [15:11]
+        Bit,            // rd, rs, #imm5            imm5 в [15:11]
+        Memory,         // rt, offset(base)         base [25:21], rt [20:16]
+        Pair,           // rt1, rt2, offset(base)   offset — 11 бит
+        Branch,         // rs, rt, target
+        Jump,           // target
+        Plain,          // без операндов
+        VectorMemory,   // vt, offset(base)
+        Vector,         // vd, vs1, vs2
+        VectorBit,      // vd, vs, #imm5
+        Splat,          // vd, rs
+        Reduce          // rd, vs
+    };
+
+    struct Mnemonic
+    {
+        Form form;
+        uint32_t bits;          // opcode и funct
+    };
+
+    constexpr uint32_t encode(uint32_t opcode, uint32_t funct = 0)
+    {
+        return opcode << 26 | funct;
+    }
+
+    const std::unordered_map<std::string_view, Mnemonic>& mnemonics()
+    {
+        static const std::unordered_map<std::string_view, Mnemonic> table =
+        {
+            { "ADDI",    { Form::Addi,         encode(0b101101) } },
+            { "ADD",     { Form::Arith,        encode(0b000000, 0b010010) } },
+            { "SUB",     { Form::Arith,        encode(0b000000, 0b110110) } },
+            { "CAS",     { Form::Arith,        encode(0b000000, 0b011110) } },
+            { "CLS",     { Form::Cls,          encode(0b000000, 0b001010) } },
+            { "BEXT",    { Form::Bext,         encode(0b000000, 0b010100) } },
+            { "SYSCALL", { Form::Plain,        encode(0b000000, 0b101000) } },
+            { "FENCE",   { Form::Plain,        encode(0b000000, 0b111000) } },
+            { "SBIT",    { Form::Bit,          encode(0b011100) } },
+            { "SSAT",    { Form::Bit,          encode(0b001101) } },
+            { "LD",      { Form::Memory,       encode(0b111001) } },
+            { "ST",      { Form::Memory,       encode(0b110111) } },
+            { "STP",     { Form::Pair,         encode(0b010101) } },
+            { "BNE",     { Form::Branch,       encode(0b011000) } },
+            { "BEQ",     { Form::Branch,       encode(0b011010) } },
+            { "J",       { Form::Jump,         encode(0b011111) } },
+            { "VLD",     { Form::VectorMemory, encode(0b110001) } },
+            { "VST",     { Form::VectorMemory, encode(0b110011) } },
+            { "VADD",    { Form::Vector,       encode(0b100000, 0b000001) } },
+            { "VSUB",    { Form::Vector,       encode(0b100000, 0b000010) } },
+            { "VADDS",   { Form::Vector,       encode(0b100000, 0b000011) } },
+            { "VSSAT",   { Form::VectorBit,    encode(0b100000, 0b000100) } },
+            { "VSPLAT",  { Form::Splat,        encode(0b100000, 0b000101) } },
+            { "VREDSUM", { Form::Reduce,       encode(0b100000, 0b000110) } },
+        };
+        return table;
+    }
+
+    enum class Section : uint8_t
+    {
+        Text,
+        Data,
+        Bss
+    };
+
+    // Поле, куда в конце дописывается адрес метки
+    enum class Patch : uint8_t
+    {
+        Branch,         // [15:0] — смещение от PC в инструкциях
+        Jump,           // [25:0] — индекс
+        Imm16,          // [15:0] — адрес как число со знаком
+        Offset11,       // [10:0] (STP)
+        Word            // слово .word целиком
+    };
+
+    struct Label
+    {
+        std::string_view name;
+        Section section;
+        uint32_t offset;
+        size_t line;
+    };
+
+    struct Reference
+    {
+        Section section;
+        Patch patch;
+        uint32_t offset;        // байт в секции
+        std::string_view label; // ссылается на исходный текст: он живёт, пока идёт сборка
+        size_t line;
+    };
+
+    // Число или метка
+    struct Value
+    {
+        int64_t number = 0;
+        std::string_view label;
+    };
+
+    constexpr uint32_t PAGE = IMAGE_ALIGNMENT;
+
+    uint64_t align_up(uint64_t value, uint64_t alignment)
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    std::string_view trim(std::string_view text)
+    {
+        size_t begin = 0;
+        while (begin < text.size() && std::isspace(static_cast<unsigned char>(text[begin])))
+        {
+            begin++;
+        }
+        size_t end = text.size();
+        while (end > begin && std::isspace(static_cast<unsigned char>(text[end - 1])))
+        {
+            end--;
+        }
+        return text.substr(begin, end - begin);
+    }
+
+    bool is_identifier_start(char c)
+    {
+        return std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+    }
+
+    bool is_identifier_char(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.' || c == '$';
+    }
+
+    size_t identifier_length(std::string_view text)
+    {
+        if (text.empty() || !is_identifier_start(text[0]))
+        {
+            return 0;
+        }
+        size_t length = 1;
+        while (length < text.size() && is_identifier_char(text[length]))
+        {
+            length++;
+        }
+        return length;
+    }
+
+    // '#' — комментарий, если за ним не число: "#5" и "#-3" — непосредственные операнды
+    std::string_view strip_comment(std::string_view text)
+    {
+        bool in_string = false;
+        for (size_t i = 0; i < text.size(); i++)
+        {
+            char c = text[i];
+            if (in_string)
+            {
+                if (c == '\\')
+                {
+                    i++;
+                }
+                else if (c == '"')
+                {
+                    in_string = false;
+                }
+                continue;
+            }
+
+            char next = i + 1 < text.size() ? text[i + 1] : '\0';
+            if (c == '"')
+            {
+                in_string = true;
+            }
+            else if (c == ';' || (c == '/' && next == '/') ||
+                     (c == '#' && !std::isdigit(static_cast<unsigned char>(next)) && next != '-' && next != '+'))
+            {
+                return text.substr(0, i);
+            }
+        }
+        return text;
+    }
+
+    // Десятичное, 0x или 0b, со знаком и необязательным '#'
+    bool parse_number(std::string_view text, int64_t& value)
+    {
+        if (!text.empty() && text[0] == '#')
+        {
+            text.remove_prefix(1);
+        }
+
+        bool negative = false;
+        if (!text.empty() && (text[0] == '-' || text[0] == '+'))
+        {
+            negative = text[0] == '-';
+            text.remove_prefix(1);
+        }
+
+        unsigned radix = 10;
+        if (text.size() > 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X'))
+        {
+            radix = 16;
+            text.remove_prefix(2);
+        }
+        else if (text.size() > 2 && text[0] == '0' && (text[1] == 'b' || text[1] == 'B'))
+        {
+            radix = 2;
+            text.remove_prefix(2);
+        }
+
+        if (text.empty())
+        {
+            return false;
+        }
+
+        uint64_t result = 0;
+        for (char c : text)
+        {
+            unsigned digit;
+            if (c >= '0' && c <= '9')
+            {
+                digit = static_cast<unsigned>(c - '0');
+            }
+            else if (c >= 'a' && c <= 'f')
+            {
+                digit = static_cast<unsigned>(c - 'a' + 10);
+            }
+            else if (c >= 'A' && c <= 'F')
+            {
+                digit = static_cast<unsigned>(c - 'A' + 10);
+            }
+            else
+            {
+                return false;
+            }
+
+            if (digit >= radix)
+            {
+                return false;
+            }
+            result = result * radix + digit;
+            if (result > (uint64_t{1} << 40))
+            {
+                return false;
+            }
+        }
+
+        value = negative ? -static_cast<int64_t>(result) : static_cast<int64_t>(result);
+        return true;
+    }
+
+    class Parser
+    {
+    public:
+        Parser(const AssemblerOptions& options, const std::string& name)
+            : options(options), name(name)
+        {
+            if (options.base % 4 != 0)
+            {
+                throw std::invalid_argument("Code base address must be word-aligned");
+            }
+        }
+
+        // Меток не больше, чем двоеточий в тексте: таблица не перестраивается по ходу
+        void reserve_labels(size_t count)
+        {
+            labels.reserve(count);
+            label_index.reserve(count);
+        }
+
+        void parse(std::string_view text, size_t number)
+        {
+            line = number;
+            text = strip_comment(text);
+
+            // Метки в начале строки, за ними может идти инструкция
+            for (;;)
+            {
+                text = trim(text);
+                size_t length = identifier_length(text);
+                if (length == 0 || length >= text.size() || text[length] != ':')
+                {
+                    break;
+                }
+                define(text.substr(0, length));
+                text.remove_prefix(length + 1);
+            }
+
+            if (text.empty())
+            {
+                return;
+            }
+
+            size_t split = 0;
+            while (split < text.size() && !std::isspace(static_cast<unsigned char>(text[split])))
+            {
+                split++;
+            }
+            std::string_view head = text.substr(0, split);
+            split_operands(trim(text.substr(split)));
+
+            if (head[0] == '.')
+            {
+                directive(head);
+            }
+            else
+            {
+                instruction(head);
+            }
+        }
+
+        Assembly finish()
+        {
+            uint64_t text_end = uint64_t{options.base} + code.size() * 4;
+            uint64_t data_base = options.data_base ? options.data_base : align_up(text_end, PAGE);
+            uint64_t bss_base = align_up(data_base + data.size(), PAGE);
+            if (bss_base + bss_size > Memory::ADDRESS_SPACE)
+            {
+                throw AssemblyError(name, line, "program does not fit into 4 GiB");
+            }
+            if (options.data_base && (!data.empty() || bss_size) && data_base < text_end &&
+                bss_base + bss_size > options.base)
+            {
+                throw AssemblyError(name, line, "data overlaps code");
+            }
+
+            const uint64_t bases[] = { options.base, data_base, bss_base };
+            auto address = [&](const Label& label) { return static_cast<uint32_t>(bases[static_cast<int>(label.section)] + label.offset); };
+
+            for (const Reference& reference : references)
+            {
+                auto found = label_index.find(reference.label);
+                if (found == label_index.end())
+                {
+                    throw AssemblyError(name, reference.line, "undefined label '" + std::string(reference.label) + "'");
+                }
+                line = reference.line;
+                resolve(reference, address(labels[found->second]), static_cast<uint32_t>(bases[static_cast<int>(reference.section)] + reference.offset));
+            }
+
+            Assembly assembly;
+            assembly.instructions = instructions;
+            assembly.entry = options.base;
+            if (!entry.empty())
+            {
+                auto found = label_index.find(entry);
+                if (found == label_index.end())
+                {
+                    throw AssemblyError(name, entry_line, "undefined entry label '" + entry + "'");
+                }
+                assembly.entry = address(labels[found->second]);
+            }
+
+            std::vector<uint8_t> code_bytes(code.size() * 4);
+            for (size_t i = 0; i < code.size(); i++)
+            {
+                put_word(code_bytes, i * 4, code[i]);
+            }
+            uint32_t code_size = static_cast<uint32_t>(code_bytes.size());
+            assembly.segments.push_back({ SegmentKind::Code, options.base, code_size, code_size, std::move(code_bytes) });
+
+            if (!data.empty())
+            {
+                uint32_t data_size = static_cast<uint32_t>(data.size());
+                assembly.segments.push_back({ SegmentKind::Data, static_cast<uint32_t>(data_base), data_size, data_size, std::move(data) });
+            }
+            if (bss_size)
+            {
+                assembly.segments.push_back({ SegmentKind::Bss, static_cast<uint32_t>(bss_base), 0, bss_size, {} });
+            }
+
+            assembly.symbols.reserve(labels.size());
+            for (const Label& label : labels)
+            {
+                assembly.symbols.push_back({ address(label), std::string(label.name) });
+            }
+            // В порядке определения адреса внутри секции уже растут: обычно сортировать нечего
+            auto before = [](const ImageSymbol& a, const ImageSymbol& b)
+            {
+                return a.address != b.address ? a.address < b.address : a.name < b.name;
+            };
+            if (!std::is_sorted(assembly.symbols.begin(), assembly.symbols.end(), before))
+            {
+                std::sort(assembly.symbols.begin(), assembly.symbols.end(), before);
+            }
+
+            return assembly;
+        }
+
+    private:
+        AssemblerOptions options;
+        std::string name;
+        size_t line = 0;
+
+        Section section = Section::Text;
+        std::vector<uint32_t> code;
+        std::vector<uint8_t> data;
+        uint32_t bss_size = 0;
+        size_t instructions = 0;
+
+        std::vector<Label> labels;                                  // в порядке определения
+        std::unordered_map<std::string_view, size_t> label_index;
+        std::vector<Reference> references;
+        std::string entry;
+        size_t entry_line = 0;
+
+        std::vector<std::string_view> operands;
+
+        [[noreturn]] void error(const std::string& message) const
+        {
+            throw AssemblyError(name, line, message);
+        }
+
+        static void put_word(std::vector<uint8_t>& bytes, size_t offset, uint32_t word)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                bytes[offset + i] = static_cast<uint8_t>(word >> (8 * i));
+            }
+        }
+
+        uint32_t here() const
+        {
+            switch (section)
+            {
+                case Section::Text: return static_cast<uint32_t>(code.size() * 4);
+                case Section::Data: return static_cast<uint32_t>(data.size());
+                case Section::Bss:  return bss_size;
+            }
+            return 0;
+        }
+
+        void define(std::string_view label)
+        {
+            auto inserted = label_index.emplace(label, labels.size());
+            if (!inserted.second)
+            {
+                error("label '" + std::string(label) + "' already defined at line " +
+                      std::to_string(labels[inserted.first->second].line));
+            }
+            labels.push_back({ label, section, here(), line });
+        }
+
+        void split_operands(std::string_view text)
+        {
+            operands.clear();
+            if (text.empty())
+            {
+                return;
+            }
+
+            bool in_string = false;
+            size_t start = 0;
+            for (size_t i = 0; i < text.size(); i++)
+            {
+                if (text[i] == '"' && (i == 0 || text[i - 1] != '\\'))
+                {
+                    in_string = !in_string;
+                }
+                else if (text[i] == ',' && !in_string)
+                {
+                    operands.push_back(trim(text.substr(start, i - start)));
+                    start = i + 1;
+                }
+            }
+            operands.push_back(trim(text.substr(start)));
+        }
+
+        void expect(size_t count, const char* syntax) const
+        {
+            if (operands.size() != count)
+            {
+                error(std::string("expected ") + syntax);
+            }
+        }
+
+        unsigned reg(std::string_view text, char prefix) const
+        {
+            int64_t number;
+            if (text.size() >= 2 && std::tolower(static_cast<unsigned char>(text[0])) == prefix &&
+                std::isdigit(static_cast<unsigned char>(text[1])) && parse_number(text.substr(1), number) &&
+                number >= 0 && number <= 31)
+            {
+                return static_cast<unsigned>(number);
+            }
+            error(std::string("expected register ") + prefix + "0.." + prefix + "31, got '" + std::string(text) + "'");
+        }
+
+        Value value(std::string_view text) const
+        {
+            Value result;
+            if (parse_number(text, result.number))
+            {
+                return result;
+            }
+            if (identifier_length(text) != text.size() || text.empty())
+            {
+                error("bad operand '" + std::string(text) + "'");
+            }
+            result.label = text;
+            return result;
+        }
+
+        uint32_t number(std::string_view text, int64_t low, int64_t high, const char* what) const
+        {
+            int64_t result;
+            if (!parse_number(text, result))
+            {
+                error(std::string("expected ") + what + ", got '" + std::string(text) + "'");
+            }
+            if (result < low || result > high)
+            {
+                error(std::string(what) + " " + std::to_string(result) + " is out of range " +
+                      std::to_string(low) + ".." + std::to_string(high));
+            }
+            return static_cast<uint32_t>(result);
+        }
+
+        // Число сразу в поле или ссылка на метку, которая допишется в finish
+        uint32_t field(std::string_view text, Patch patch, int64_t low, int64_t high, uint32_t mask, const char* what)
+        {
+            Value operand = value(text);
+            if (!operand.label.empty())
+            {
+                references.push_back({ section, patch, here(), operand.label, line });
+                return 0;
+            }
+            if (operand.number < low || operand.number > high)
+            {
+                error(std::string(what) + " " + std::to_string(operand.number) + " is out of range " +
+                      std::to_string(low) + ".." + std::to_string(high));
+            }
+            return static_cast<uint32_t>(operand.number) & mask;
+        }
+
+        // "offset(base)"; пустое смещение — ноль
+        uint32_t memory(std::string_view text, Patch patch, int64_t low, int64_t high, uint32_t mask, unsigned& base)
+        {
+            size_t open = text.find('(');
+            if (open == std::string_view::npos || text.back() != ')')
+            {
+                error("expected offset(base), got '" + std::string(text) + "'");
+            }
+            base = reg(trim(text.substr(open + 1, text.size() - open - 2)), 'r');
+
+            std::string_view offset = trim(text.substr(0, open));
+            return offset.empty() ? 0 : field(offset, patch, low, high, mask, "offset");
+        }
+
+        void instruction(std::string_view head)
+        {
+            std::string upper(head);
+            for (char& c : upper)
+            {
+                c = static_cast<char>(std::toupper(static_cast<unsigned char>(c)));
+            }
+
+            auto found = mnemonics().find(upper);
+            if (found == mnemonics().end())
+            {
+                error("unknown instruction '" + std::string(head) + "'");
+            }
+            if (section != Section::Text)
+            {
+                error("instructions must be in .text");
+            }
+
+            const Mnemonic& mnemonic = found->second;
+            uint32_t word = mnemonic.bits;
+            unsigned base;
+
+            switch (mnemonic.form)
+            {
+                case Form::Addi:
+                    expect(3, "rt, rs, imm");
+                    word |= reg(operands[1], 'r') << 21 | reg(operands[0], 'r') << 16 |
+                            field(operands[2], Patch::Imm16, INT16_MIN, INT16_MAX, 0xFFFF, "immediate");
+                    break;
+                case Form::Arith:
+                    expect(3, "rd, rs, rt");
+                    word |= reg(operands[1], 'r') << 21 | reg(operands[2], 'r') << 16 | reg(operands[0], 'r') << 11;
+                    break;
+                case Form::Cls:
+                    expect(2, "rd, rs");
+                    word |= reg(operands[0], 'r') << 21 | reg(operands[1], 'r') << 16;
+                    break;
+                case Form::Bext:
+                    expect(3, "rd, rs1, rs2");
+                    word |= reg(operands[0], 'r') << 21 | reg(operands[1], 'r') << 16 | reg(operands[2], 'r') << 11;
+                    break;
+                case Form::Bit:
+                    expect(3, "rd, rs, #imm5");
+                    word |= reg(operands[0], 'r') << 21 | reg(operands[1], 'r') << 16 |
+                            number(operands[2], 0, 31, "imm5") << 11;
+                    break;
+                case Form::Memory:
+                {
+                    expect(2, "rt, offset(base)");
+                    uint32_t offset = memory(operands[1], Patch::Imm16, INT16_MIN, INT16_MAX, 0xFFFF, base);
+                    word |= base << 21 | reg(operands[0], 'r') << 16 | offset;
+                    break;
+                }
+                case Form::Pair:
+                {
+                    expect(3, "rt1, rt2, offset(base)");
+                    uint32_t offset = memory(operands[2], Patch::Offset11, -1024, 1023, 0x7FF, base);
+                    word |= base << 21 | reg(operands[0], 'r') << 16 | reg(operands[1], 'r') << 11 | offset;
+                    break;
+                }
+                case Form::Branch:
+                    expect(3, "rs, rt, label");
+                    word |= reg(operands[0], 'r') << 21 | reg(operands[1], 'r') << 16 |
+                            field(operands[2], Patch::Branch, INT16_MIN, INT16_MAX, 0xFFFF, "branch offset");
+                    break;
+                case Form::Jump:
+                    expect(1, "label");
+                    word |= field(operands[0], Patch::Jump, 0, 0x3FFFFFF, 0x3FFFFFF, "jump index");
+                    break;
+                case Form::Plain:
+                    expect(0, "no operands");
+                    break;
+                case Form::VectorMemory:
+                {
+                    expect(2, "vt, offset(base)");
+                    uint32_t offset = memory(operands[1], Patch::Imm16, INT16_MIN, INT16_MAX, 0xFFFF, base);
+                    word |= base << 21 | reg(operands[0], 'v') << 16 | offset;
+                    break;
+                }
+                case Form::Vector:
+                    expect(3, "vd, vs1, vs2");
+                    word |= reg(operands[0], 'v') << 21 | reg(operands[1], 'v') << 16 | reg(operands[2], 'v') << 11;
+                    break;
+                case Form::VectorBit:
+                    expect(3, "vd, vs, #imm5");
+                    word |= reg(operands[0], 'v') << 21 | reg(operands[1], 'v') << 16 |
+                            number(operands[2], 0, 31, "imm5") << 11;
+                    break;
+                case Form::Splat:
+                    expect(2, "vd, rs");
+                    word |= reg(operands[0], 'v') << 21 | reg(operands[1], 'r') << 16;
+                    break;
+                case Form::Reduce:
+                    expect(2, "rd, vs");
+                    word |= reg(operands[0], 'r') << 21 | reg(operands[1], 'v') << 16;
+                    break;
+            }
+
+            code.push_back(word);
+            instructions++;
+        }
+
+        void directive(std::string_view head)
+        {
+            if (head == ".text" || head == ".data" || head == ".bss")
+            {
+                expect(0, "no operands");
+                section = head == ".text" ? Section::Text : head == ".data" ? Section::Data : Section::Bss;
+            }
+            else if (head == ".word")
+            {
+                if (section == Section::Bss || operands.empty())
+                {
+                    error(section == Section::Bss ? ".word is not allowed in .bss" : "expected values");
+                }
+                for (std::string_view operand : operands)
+                {
+                    uint32_t word = field(operand, Patch::Word, INT32_MIN, UINT32_MAX, 0xFFFFFFFF, "word");
+                    if (section == Section::Text)
+                    {
+                        code.push_back(word);
+                    }
+                    else
+                    {
+                        data.resize(data.size() + 4);
+                        put_word(data, data.size() - 4, word);
+                    }
+                }
+            }
+            else if (head == ".ascii")
+            {
+                expect(1, "\"text\"");
+                if (section != Section::Data)
+                {
+                    error(".ascii is allowed only in .data");
+                }
+                ascii(operands[0]);
+            }
+            else if (head == ".space")
+            {
+                expect(1, "size");
+                uint32_t size = number(operands[0], 0, INT32_MAX, "size");
+                if (section == Section::Text)
+                {
+                    error(".space is not allowed in .text");
+                }
+                if (section == Section::Data)
+                {
+                    data.resize(data.size() + size);
+                }
+                else
+                {
+                    bss_size += size;
+                }
+            }
+            else if (head == ".align")
+            {
+                expect(1, "alignment");
+                uint32_t alignment = number(operands[0], 1, PAGE, "alignment");
+                if (alignment & (alignment - 1))
+                {
+                    error("alignment must be a power of two");
+                }
+                if (section == Section::Text)
+                {
+                    if (alignment > 4)
+                    {
+                        error(".text is aligned to words only");
+                    }
+                }
+                else if (section == Section::Data)
+                {
+                    data.resize(align_up(data.size(), alignment));
+                }
+                else
+                {
+                    bss_size = static_cast<uint32_t>(align_up(bss_size, alignment));
+                }
+            }
+            else if (head == ".entry")
+            {
+                expect(1, "label");
+                if (identifier_length(operands[0]) != operands[0].size() || operands[0].empty())
+                {
+                    error("expected label, got '" + std::string(operands[0]) + "'");
+                }
+                entry = std::string(operands[0]);
+                entry_line = line;
+            }
+            else
+            {
+                error("unknown directive '" + std::string(head) + "'");
+            }
+        }
+
+        void ascii(std::string_view text)
+        {
+            if (text.size() < 2 || text.front() != '"' || text.back() != '"')
+            {
+                error("expected \"text\", got '" + std::string(text) + "'");
+            }
+            text = text.substr(1, text.size() - 2);
+
+            for (size_t i = 0; i < text.size(); i++)
+            {
+                char c = text[i];
+                if (c == '\\' && i + 1 < text.size())
+                {
+                    switch (text[++i])
+                    {
+                        case 'n':  c = '\n'; break;
+                        case 't':  c = '\t'; break;
+                        case '0':  c = '\0'; break;
+                        case '\\': c = '\\'; break;
+                        case '"':  c = '"';  break;
+                        default:   error(std::string("unknown escape \\") + text[i]);
+                    }
+                }
+                data.push_back(static_cast<uint8_t>(c));
+            }
+        }
+
+        void resolve(const Reference& reference, uint32_t target, uint32_t at)
+        {
+            std::string_view label = reference.label;
+            uint32_t value = 0;
+            int64_t signed_target = static_cast<int32_t>(target);
+
+            switch (reference.patch)
+            {
+                case Patch::Branch:
+                {
+                    int64_t delta = int64_t{target} - int64_t{at};
+                    if (delta % 4 != 0 || delta / 4 < INT16_MIN || delta / 4 > INT16_MAX)
+                    {
+                        error("branch to '" + std::string(label) + "' is out of range");
+                    }
+                    value = static_cast<uint32_t>(delta / 4) & 0xFFFF;
+                    break;
+                }
+                case Patch::Jump:
+                {
+                    // PC = (PC & 0xFFFFF000) | (index << 2): старшие биты PC остаются
+                    uint32_t index = (target >> 2) & 0x3FFFFFF;
+                    if (target % 4 != 0 || ((at & 0xFFFFF000) | (index << 2)) != target)
+                    {
+                        error("J cannot reach '" + std::string(label) + "' from this address");
+                    }
+                    value = index;
+                    break;
+                }
+                case Patch::Imm16:
+                    if (signed_target < INT16_MIN || signed_target > INT16_MAX)
+                    {
+                        error("address of '" + std::string(label) + "' does not fit into a 16-bit signed field");
+                    }
+                    value = target & 0xFFFF;
+                    break;
+                case Patch::Offset11:
+                    if (signed_target < -1024 || signed_target > 1023)
+                    {
+                        error("address of '" + std::string(label) + "' does not fit into an 11-bit signed field");
+                    }
+                    value = target & 0x7FF;
+                    break;
+                case Patch::Word:
+                    value = target;
+                    break;
+            }
+
+            if (reference.section == Section::Text)
+            {
+                code[reference.offset / 4] |= value;
+            }
+            else
+            {
+                put_word(data, reference.offset, value);
+            }
+        }
+    };
+}
+
+Assembly assemble(const std::string& source, const AssemblerOptions& options, const std::string& name)
+{
+    Parser parser(options, name);
+    parser.reserve_labels(static_cast<size_t>(std::count(source.begin(), source.end(), ':')));
+
+    std::string_view text(source);
+    size_t number = 0;
+    while (!text.empty())
+    {
+        size_t end = text.find('\n');
+        std::string_view line = text.substr(0, end);
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.remove_suffix(1);
+        }
+        parser.parse(line, ++number);
+
+        if (end == std::string_view::npos)
+        {
+            break;
+        }
+        text.remove_prefix(end + 1);
+    }
+
+    return parser.finish();
+}
+
+Assembly assemble_file(const std::string& path, const AssemblerOptions& options)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Cannot open file: " + path);
+    }
+
+    std::ostringstream source;
+    source << file.rdbuf();
+    return assemble(source.str(), options, path);
+}
+
+bool is_assembly_source(const std::string& path)
+{
+    auto ends_with = [&](const char* suffix)
+    {
+        size_t length = std::char_traits<char>::length(suffix);
+        return path.size() > length && path.compare(path.size() - length, length, suffix) == 0;
+    };
+    return ends_with(".s") || ends_with(".asm");
+}
@@ -0,0 +1,318 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "batch.hpp"
+#include "lockstep.hpp"
+
+namespace
+{
+    // Очередь рабочего потока: владелец берёт с начала, остальные крадут с конца
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<size_t> jobs;
+
+        bool pop_front(size_t& job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobs.empty()) return false;
+            job = jobs.front();
+            jobs.pop_front();
+            return true;
+        }
+
+        bool steal_back(size_t& job)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (jobs.empty()) return false;
+            job = jobs.back();
+            jobs.pop_back();
+            return true;
+        }
+    };
+
+    // Снимки машины сразу после загрузки, общие для всех потоков: снимок неизменяем,
+    // его память разделяется копированием при записи
+    class ProgramCache
+    {
+    public:
+        bool find(const std::string& program, Machine::Snapshot& snapshot)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = loaded.find(program);
+            if (it == loaded.end()) return false;
+            snapshot = it->second;
+            return true;
+        }
+
+        void insert(const std::string& program, const Machine::Snapshot& snapshot)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            loaded.emplace(program, snapshot);
+        }
+
+    private:
+        std::mutex mutex;
+        std::unordered_map<std::string, Machine::Snapshot> loaded;
+    };
+
+    class Worker
+    {
+    public:
+        Worker(const BatchOptions& options, ProgramCache& cache)
+            : options(options), machine(options.memory_size), cache(cache)
+        {
+            machine.set_engine(options.engine);
+            machine.set_fusion_enabled(options.fusion);
+            machine.set_decode_cache_enabled(options.decode_cache);
+            machine.set_instruction_limit(options.max_instructions);
+            machine.set_time_limit(options.time_limit);
+            machine.get_cpu().set_quiet(true);
+            machine.get_cpu().set_io(io);
+            empty = machine.snapshot();
+        }
+
+        void run(const BatchJob& job, BatchResult& result)
+        {
+            Machine::Snapshot snapshot;
+            if (!cache.find(job.program, snapshot))
+            {
+                try
+                {
+                    machine.restore(empty);
+                    machine.load(job.program);
+                }
+                catch (const std::exception& e)
+                {
+                    result.error = e.what();
+                    return;
+                }
+                snapshot = machine.snapshot();
+                cache.insert(job.program, snapshot);
+            }
+
+            machine.restore(snapshot);
+
+            std::string input;
+            for (int32_t value : job.input)
+            {
+                input += std::to_string(value);
+                input += ' ';
+            }
+            io.set_input(std::move(input));
+            io.clear_output();
+
+            CPU& cpu = machine.get_cpu();
+
+            result.status = machine.run();
+            result.fault = cpu.get_fault();
+            result.fault_pc = cpu.get_fault_pc();
+            result.stop_reason = cpu.get_stop_reason();
+            result.result = cpu.get_register(3);
+            result.instructions = machine.get_stats().instructions;
+            result.output = io.output();
+        }
+
+        // Группа заданий одной программы в лок-степе; своя LockstepRunner на программу
+        void run_lockstep(const std::vector<BatchJob>& jobs, const std::vector<size_t>& group,
+                          std::vector<BatchResult>& results)
+        {
+            const std::string& program = jobs[group.front()].program;
+            auto it = lockstep.find(program);
+            if (it == lockstep.end())
+            {
+                LockstepOptions lockstep_options;
+                lockstep_options.lanes = options.lanes;
+                lockstep_options.memory_size = options.memory_size;
+                lockstep_options.max_instructions = options.max_instructions;
+                lockstep_options.time_limit = options.time_limit;
+                try
+                {
+                    it = lockstep.emplace(program, std::make_unique<LockstepRunner>(program, lockstep_options)).first;
+                }
+                catch (const std::exception& e)
+                {
+                    for (size_t job : group)
+                    {
+                        results[job].error = e.what();
+                    }
+                    return;
+                }
+            }
+
+            std::vector<std::vector<int32_t>> inputs;
+            for (size_t job : group)
+            {
+                inputs.push_back(jobs[job].input);
+            }
+            std::vector<BatchResult> group_results = it->second->run(inputs);
+            for (size_t k = 0; k < group.size(); k++)
+            {
+                results[group[k]] = std::move(group_results[k]);
+            }
+        }
+
+    private:
+        BatchOptions options;
+        Machine machine;
+        ProgramCache& cache;
+        std::unordered_map<std::string, std::unique_ptr<LockstepRunner>> lockstep;
+        Machine::Snapshot empty;
+
+        BufferedIO io;      // вывод остаётся в памяти, без рамок
+    };
+}
+
+std::vector<BatchJob> read_manifest(const std::string& path)
+{
+    std::ifstream file(path);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Cannot open manifest: " + path);
+    }
+
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    std::vector<BatchJob> jobs;
+    std::string line;
+    size_t line_number = 0;
+
+    while (std::getline(file, line))
+    {
+        line_number++;
+
+        std::istringstream fields(line);
+        std::string program;
+        if (!(fields >> program) || program[0] == '#')
+        {
+            continue;
+        }
+
+        BatchJob job;
+        std::filesystem::path program_path(program);
+        job.program = program_path.is_relative() ? (directory / program_path).string() : program;
+
+        int64_t value;
+        while (fields >> value)
+        {
+            job.input.push_back(static_cast<int32_t>(value));
+        }
+        if (!fields.eof())
+        {
+            throw std::runtime_error("Bad input value in " + path + " line " + std::to_string(line_number));
+        }
+
+        jobs.push_back(std::move(job));
+    }
+
+    return jobs;
+}
+
+std::vector<BatchResult> BatchRunner::run(const std::vector<BatchJob>& jobs)
+{
+    std::vector<BatchResult> results(jobs.size());
+
+    // Задания одной программы идут подряд и достаются одному потоку:
+    // его машина и кэши кода остаются тёплыми, пока работу не украдут
+    std::vector<size_t> order(jobs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return jobs[a].program < jobs[b].program; });
+
+    // Единица работы — задание или, в лок-степе, группа до lanes заданий одной программы
+    size_t lanes = std::max<size_t>(options.lanes, 1);
+    std::vector<std::vector<size_t>> units;
+    for (size_t job : order)
+    {
+        if (units.empty() || units.back().size() == lanes || jobs[units.back().front()].program != jobs[job].program)
+        {
+            units.emplace_back();
+        }
+        units.back().push_back(job);
+    }
+
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = static_cast<unsigned>(std::min<size_t>(threads, std::max<size_t>(units.size(), 1)));
+
+    std::vector<WorkQueue> queues(threads);
+    for (size_t i = 0; i < units.size(); i++)
+    {
+        queues[i * threads / units.size()].jobs.push_back(i);
+    }
+
+    ProgramCache cache;
+    std::atomic<uint64_t> instructions{0};
+    std::atomic<uint64_t> steals{0};
+
+    auto work = [&](unsigned id)
+    {
+        Worker worker(options, cache);
+        uint64_t retired = 0;
+        uint64_t stolen = 0;
+        size_t index;
+
+        for (;;)
+        {
+            bool found = queues[id].pop_front(index);
+
+            for (unsigned k = 1; !found && k < threads; k++)
+            {
+                found = queues[(id + k) % threads].steal_back(index);
+                stolen += found;
+            }
+
+            // Новых заданий не появляется: все очереди пусты — работа кончилась
+            if (!found)
+            {
+                break;
+            }
+
+            const std::vector<size_t>& unit = units[index];
+            if (lanes > 1)
+            {
+                worker.run_lockstep(jobs, unit, results);
+            }
+            else
+            {
+                worker.run(jobs[unit.front()], results[unit.front()]);
+            }
+            for (size_t k : unit)
+            {
+                retired += results[k].instructions;
+            }
+        }
+
+        instructions += retired;
+        steals += stolen;
+    };
+
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> pool;
+    for (unsigned id = 1; id < threads; id++)
+    {
+        pool.emplace_back(work, id);
+    }
+    work(0);
+    for (std::thread& thread : pool)
+    {
+        thread.join();
+    }
+
+    stats.jobs = jobs.size();
+    stats.threads = threads;
+    stats.instructions = instructions;
+    stats.steals = steals;
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return results;
+}
@@ -0,0 +1,172 @@
+#include <cstring>
+
+#include "bitops.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BITOPS_X86_64 1
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <immintrin.h>
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+#else
+#define BITOPS_X86_64 0
+#endif
+
+namespace
+{
+    // Hacker's Delight, 7-4: пять раундов параллельного префиксного XOR сдвигают
+    // каждый выбранный бит вправо на число нулей mask под ним
+    uint32_t extract_portable(uint32_t value, uint32_t mask)
+    {
+        uint32_t x = value & mask;
+        uint32_t mk = ~mask << 1;
+
+        for (uint32_t i = 0; i < 5; i++)
+        {
+            uint32_t mp = mk ^ (mk << 1);
+            mp ^= mp << 2;
+            mp ^= mp << 4;
+            mp ^= mp << 8;
+            mp ^= mp << 16;
+
+            uint32_t mv = mp & mask;
+            mask = (mask ^ mv) | (mv >> (1u << i));
+
+            uint32_t t = x & mv;
+            x = (x ^ t) | (t >> (1u << i));
+            mk &= ~mp;
+        }
+        return x;
+    }
+
+    const BitExtract PORTABLE = { "portable", extract_portable };
+
+#if BITOPS_X86_64
+
+#if defined(_MSC_VER) && !defined(__clang__)
+    uint32_t extract_pext(uint32_t value, uint32_t mask)
+    {
+        return _pext_u32(value, mask);
+    }
+#else
+    __attribute__((target("bmi2")))
+    uint32_t extract_pext(uint32_t value, uint32_t mask)
+    {
+        return _pext_u32(value, mask);
+    }
+#endif
+
+    const BitExtract PEXT = { "pext", extract_pext };
+
+    void cpuid(uint32_t leaf, uint32_t regs[4])
+    {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int out[4];
+        __cpuidex(out, static_cast<int>(leaf), 0);
+        std::memcpy(regs, out, sizeof(out));
+#else
+        __cpuid_count(leaf, 0, regs[0], regs[1], regs[2], regs[3]);
+#endif
+    }
+
+    bool has_bmi2()
+    {
+        uint32_t regs[4];
+        cpuid(0, regs);
+        if (regs[0] < 7)
+        {
+            return false;
+        }
+        cpuid(7, regs);
+        return (regs[1] & (1u << 8)) != 0;          // EBX.BMI2
+    }
+
+    // У AMD до Zen 3 (family 19h) pext микрокодный, в сотни тактов,
+    // и переносимая выборка выгоднее
+    bool fast_pext()
+    {
+        if (!has_bmi2())
+        {
+            return false;
+        }
+
+        uint32_t regs[4];
+        cpuid(0, regs);
+        char vendor[13] = {};
+        std::memcpy(vendor, &regs[1], 4);
+        std::memcpy(vendor + 4, &regs[3], 4);
+        std::memcpy(vendor + 8, &regs[2], 4);
+
+        if (std::strcmp(vendor, "AuthenticAMD") != 0)
+        {
+            return true;
+        }
+
+        cpuid(1, regs);
+        uint32_t family = (regs[0] >> 8) & 0xF;
+        if (family == 0xF)
+        {
+            family += (regs[0] >> 20) & 0xFF;
+        }
+        return family >= 0x19;
+    }
+
+#endif
+
+    const BitExtract* best_bit_extract()
+    {
+#if BITOPS_X86_64
+        if (fast_pext())
+        {
+            return &PEXT;
+        }
+#endif
+        return &PORTABLE;
+    }
+}
+
+const BitExtract* bit_extract = &PORTABLE;
+
+namespace
+{
+    // Выбор при запуске; до него действует переносимая реализация
+    const bool bit_extract_selected = (bit_extract = best_bit_extract(), true);
+}
+
+const std::vector<BitExtract>& bit_extract_implementations()
+{
+    static const std::vector<BitExtract> implementations = []
+    {
+        std::vector<BitExtract> list;
+#if BITOPS_X86_64
+        if (has_bmi2())
+        {
+            list.push_back(PEXT);
+        }
+#endif
+        list.push_back(PORTABLE);
+        return list;
+    }();
+    return implementations;
+}
+
+bool select_bit_extract(const std::string& name)
+{
+    (void)bit_extract_selected;
+
+#if BITOPS_X86_64
+    if (name == PEXT.name && has_bmi2())
+    {
+        bit_extract = &PEXT;
+        return true;
+    }
+#endif
+    if (name == PORTABLE.name)
+    {
+        bit_extract = &PORTABLE;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,435 @@
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "cache_model.hpp"
+#include "disassembler.hpp"
+#include "memory.hpp"
+
+namespace
+{
+    bool is_power_of_two(uint32_t value)
+    {
+        return value && (value & (value - 1)) == 0;
+    }
+
+    uint32_t log2(uint32_t value)
+    {
+        uint32_t shift = 0;
+        while ((1u << shift) < value)
+        {
+            shift++;
+        }
+        return shift;
+    }
+
+    const char* replacement_name(Replacement replacement)
+    {
+        switch (replacement)
+        {
+            case Replacement::Lru:    return "lru";
+            case Replacement::Fifo:   return "fifo";
+            case Replacement::Random: return "random";
+        }
+        return "?";
+    }
+
+    double percent(uint64_t part, uint64_t total)
+    {
+        return total ? 100.0 * static_cast<double>(part) / static_cast<double>(total) : 0.0;
+    }
+
+    void hex(std::ostream& out, uint32_t value)
+    {
+        out << "0x" << std::hex << std::setw(8) << std::setfill('0') << value << std::dec << std::setfill(' ');
+    }
+
+    void level_line(std::ostream& out, const char* name, const Cache& cache)
+    {
+        const CacheConfig& config = cache.get_config();
+        const Cache::Stats& stats = cache.get_stats();
+        out << "  " << std::left << std::setw(5) << name << std::right << std::setw(10) << config.size
+            << std::setw(6) << config.ways << std::setw(6) << config.line << "  " << std::left << std::setw(7)
+            << replacement_name(config.replacement) << std::right << std::setw(14) << stats.accesses
+            << std::setw(12) << stats.misses << std::fixed << std::setprecision(2) << std::setw(9)
+            << 100.0 * stats.miss_rate() << std::setw(12) << stats.writebacks << std::endl;
+    }
+
+    uint32_t parse_size(const std::string& text)
+    {
+        size_t used = 0;
+        unsigned long value = std::stoul(text, &used);
+        std::string suffix = text.substr(used);
+        if (suffix == "K" || suffix == "k")
+        {
+            value *= 1024;
+        }
+        else if (suffix == "M" || suffix == "m")
+        {
+            value *= 1024 * 1024;
+        }
+        else if (!suffix.empty())
+        {
+            throw std::invalid_argument("Bad cache size: " + text);
+        }
+        if (value > UINT32_MAX)
+        {
+            throw std::invalid_argument("Cache size too large: " + text);
+        }
+        return static_cast<uint32_t>(value);
+    }
+
+    std::vector<std::string> split(const std::string& text, char separator)
+    {
+        std::vector<std::string> parts;
+        std::istringstream stream(text);
+        std::string part;
+        while (std::getline(stream, part, separator))
+        {
+            parts.push_back(part);
+        }
+        return parts;
+    }
+}
+
+Cache::Cache(const CacheConfig& config) : config(config)
+{
+    if (!is_power_of_two(config.size) || !is_power_of_two(config.ways) || !is_power_of_two(config.line) ||
+        config.line < 4 || uint64_t{config.ways} * config.line > config.size)
+    {
+        throw std::invalid_argument("Cache size, ways and line must be powers of two with size >= ways * line");
+    }
+
+    line_shift = log2(config.line);
+    set_mask = config.size / (config.ways * config.line) - 1;
+
+    size_t slots = config.size / config.line;
+    tags.assign(slots, 0);
+    stamps.assign(slots, 0);
+    dirty.assign(slots, 0);
+}
+
+bool Cache::lookup(uint32_t line, bool write, uint32_t& writeback)
+{
+    const uint32_t ways = config.ways;
+    const size_t base = size_t{line & set_mask} * ways;
+    const uint32_t tag = line + 1;
+    clock++;
+
+    for (uint32_t way = 0; way < ways; way++)
+    {
+        if (tags[base + way] == tag)
+        {
+            size_t slot = base + way;
+            if (config.replacement == Replacement::Lru)
+            {
+                stamps[slot] = clock;
+            }
+            dirty[slot] |= write;
+            last_line = line;
+            last_slot = slot;
+            writeback = NONE;
+            return true;
+        }
+    }
+
+    stats.misses++;
+
+    // Сначала свободный путь, затем жертва по политике
+    uint32_t victim = ways;
+    for (uint32_t way = 0; way < ways; way++)
+    {
+        if (tags[base + way] == 0)
+        {
+            victim = way;
+            break;
+        }
+    }
+    if (victim == ways)
+    {
+        if (config.replacement == Replacement::Random)
+        {
+            random_state ^= random_state << 13;
+            random_state ^= random_state >> 7;
+            random_state ^= random_state << 17;
+            victim = static_cast<uint32_t>(random_state) & (ways - 1);
+        }
+        else
+        {
+            victim = 0;
+            for (uint32_t way = 1; way < ways; way++)
+            {
+                if (stamps[base + way] < stamps[base + victim])
+                {
+                    victim = way;
+                }
+            }
+        }
+    }
+
+    size_t slot = base + victim;
+    writeback = NONE;
+    if (tags[slot] && dirty[slot])
+    {
+        writeback = (tags[slot] - 1) << line_shift;
+        stats.writebacks++;
+    }
+
+    tags[slot] = tag;
+    stamps[slot] = clock;
+    dirty[slot] = write;
+    last_line = line;
+    last_slot = slot;
+    return false;
+}
+
+void Cache::clear()
+{
+    std::fill(tags.begin(), tags.end(), 0);
+    std::fill(stamps.begin(), stamps.end(), 0);
+    std::fill(dirty.begin(), dirty.end(), 0);
+    clock = 0;
+    last_line = NONE;
+    last_slot = 0;
+    stats = {};
+}
+
+CacheModel::CacheModel(const CacheModelOptions& options)
+    : options(options), l1i(options.l1i), l1d(options.l1d),
+      l2(options.has_l2 ? std::make_unique<Cache>(options.l2) : nullptr),
+      data_shift(log2(options.l1d.line))
+{
+    if (options.region_shift < 2 || options.region_shift > 31)
+    {
+        throw std::invalid_argument("Cache region shift must be in 2..31");
+    }
+}
+
+CacheLevel CacheModel::access_line(uint32_t pc, uint32_t address, bool write)
+{
+    Counters& counters = at(pc).data;
+
+    Counters& region = region_at(address);
+
+    counters.accesses++;
+    region.accesses++;
+
+    uint32_t writeback;
+    if (l1d.access(address, write, writeback))
+    {
+        return CacheLevel::L1;
+    }
+    counters.l1_misses++;
+    region.l1_misses++;
+    if (next_level(address, writeback))
+    {
+        return CacheLevel::L2;
+    }
+    counters.l2_misses++;
+    region.l2_misses++;
+    return CacheLevel::Memory;
+}
+
+bool CacheModel::next_level(uint32_t address, uint32_t writeback)
+{
+    if (!l2)
+    {
+        return false;
+    }
+
+    uint32_t evicted;
+    if (writeback != Cache::NONE)
+    {
+        l2->access(writeback, true, evicted);
+    }
+    return l2->access(address, false, evicted);
+}
+
+const CacheModel::PcCounters* CacheModel::find(uint32_t pc) const
+{
+    auto it = pages.find(pc >> PAGE_SHIFT);
+    if (it == pages.end())
+    {
+        return nullptr;
+    }
+
+    const PcCounters& counters = it->second->counters[(pc & ((1u << PAGE_SHIFT) - 1)) >> 2];
+    return counters.fetch.accesses || counters.data.accesses ? &counters : nullptr;
+}
+
+const CacheModel::Counters* CacheModel::find_region(uint32_t address) const
+{
+    uint32_t index = address >> options.region_shift;
+    auto it = region_pages.find(index >> REGION_PAGE_SHIFT);
+    if (it == region_pages.end())
+    {
+        return nullptr;
+    }
+
+    const Counters& counters = it->second->counters[index & ((1u << REGION_PAGE_SHIFT) - 1)];
+    return counters.accesses ? &counters : nullptr;
+}
+
+void CacheModel::clear()
+{
+    l1i.clear();
+    l1d.clear();
+    if (l2)
+    {
+        l2->clear();
+    }
+    pages.clear();
+    last_index = UINT32_MAX;
+    last_page = nullptr;
+    region_pages.clear();
+    last_region_index = UINT32_MAX;
+    last_region_page = nullptr;
+}
+
+void CacheModel::report(std::ostream& out, const Memory& memory, size_t top) const
+{
+    struct Row
+    {
+        uint32_t pc;
+        PcCounters counters;
+        uint64_t misses;
+    };
+
+    std::vector<Row> rows;
+    for (const auto& page : pages)
+    {
+        for (uint32_t slot = 0; slot < PAGE_WORDS; slot++)
+        {
+            const PcCounters& counters = page.second->counters[slot];
+            uint64_t misses = counters.fetch.l1_misses + counters.data.l1_misses;
+            if (misses)
+            {
+                rows.push_back({ (page.first << PAGE_SHIFT) | (slot << 2), counters, misses });
+            }
+        }
+    }
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b)
+    {
+        return a.misses != b.misses ? a.misses > b.misses : a.pc < b.pc;
+    });
+
+    out << "=== Cache model: " << l1i.get_stats().accesses << " instruction fetches, "
+        << l1d.get_stats().accesses << " data accesses ===" << std::endl;
+
+    out << std::endl << "Levels:" << std::endl;
+    out << "  level       size  ways  line  policy       accesses      misses   miss %  writebacks" << std::endl;
+    level_line(out, "L1I", l1i);
+    level_line(out, "L1D", l1d);
+    if (l2)
+    {
+        level_line(out, "L2", *l2);
+    }
+
+    out << std::endl << "Instructions with most L1 misses (fetch + data):" << std::endl;
+    out << "  pc             fetch      data   L1 misses   miss %   L2 misses  instruction" << std::endl;
+    for (size_t i = 0; i < std::min(top, rows.size()); i++)
+    {
+        const Row& row = rows[i];
+        uint64_t accesses = row.counters.fetch.accesses + row.counters.data.accesses;
+        uint32_t word = uint64_t{row.pc} + 4 <= memory.size() ? memory.read<uint32_t>(row.pc) : 0;
+
+        out << "  ";
+        hex(out, row.pc);
+        out << std::setw(10) << row.counters.fetch.accesses << std::setw(10) << row.counters.data.accesses
+            << std::setw(12) << row.misses << std::fixed << std::setprecision(2) << std::setw(9)
+            << percent(row.misses, accesses) << std::setw(12)
+            << row.counters.fetch.l2_misses + row.counters.data.l2_misses << "  " << disassemble(word, row.pc)
+            << std::endl;
+    }
+
+    out << std::endl << "Data regions with most L1 misses (" << (1u << options.region_shift) << "-byte ranges):" << std::endl;
+    out << "  start         accesses   L1 misses   miss %   L2 misses" << std::endl;
+    std::vector<std::pair<uint32_t, const Counters*>> order;
+    for (const auto& page : region_pages)
+    {
+        for (uint32_t slot = 0; slot < page.second->counters.size(); slot++)
+        {
+            if (page.second->counters[slot].accesses)
+            {
+                order.push_back({ (page.first << REGION_PAGE_SHIFT) | slot, &page.second->counters[slot] });
+            }
+        }
+    }
+    std::sort(order.begin(), order.end(), [](const auto& a, const auto& b)
+    {
+        return a.second->l1_misses != b.second->l1_misses ? a.second->l1_misses > b.second->l1_misses : a.first < b.first;
+    });
+    for (size_t i = 0; i < std::min(top, order.size()); i++)
+    {
+        const Counters& region = *order[i].second;
+        out << "  ";
+        hex(out, static_cast<uint32_t>(uint64_t{order[i].first} << options.region_shift));
+        out << std::setw(12) << region.accesses << std::setw(12) << region.l1_misses << std::fixed
+            << std::setprecision(2) << std::setw(9) << percent(region.l1_misses, region.accesses)
+            << std::setw(12) << region.l2_misses << std::endl;
+    }
+}
+
+CacheModelOptions parse_cache_options(const std::string& spec)
+{
+    CacheModelOptions options;
+
+    for (const std::string& item : split(spec, ','))
+    {
+        size_t equals = item.find('=');
+        if (equals == std::string::npos)
+        {
+            throw std::invalid_argument("Expected LEVEL=SIZE:WAYS:LINE[:POLICY], got: " + item);
+        }
+        std::string level = item.substr(0, equals);
+        std::string value = item.substr(equals + 1);
+
+        if (level == "l2" && value == "none")
+        {
+            options.has_l2 = false;
+            continue;
+        }
+
+        CacheConfig* config = level == "l1i" ? &options.l1i
+                            : level == "l1d" ? &options.l1d
+                            : level == "l2"  ? &options.l2
+                                             : nullptr;
+        if (!config)
+        {
+            throw std::invalid_argument("Unknown cache level: " + level);
+        }
+
+        std::vector<std::string> fields = split(value, ':');
+        if (fields.size() < 3 || fields.size() > 4)
+        {
+            throw std::invalid_argument("Expected SIZE:WAYS:LINE[:POLICY] for " + level + ", got: " + value);
+        }
+
+        try
+        {
+            config->size = parse_size(fields[0]);
+            config->ways = static_cast<uint32_t>(std::stoul(fields[1]));
+            config->line = static_cast<uint32_t>(std::stoul(fields[2]));
+        }
+        catch (const std::logic_error&)
+        {
+            throw std::invalid_argument("Bad cache geometry for " + level + ": " + value);
+        }
+
+        if (fields.size() == 4)
+        {
+            if (fields[3] == "lru")         config->replacement = Replacement::Lru;
+            else if (fields[3] == "fifo")   config->replacement = Replacement::Fifo;
+            else if (fields[3] == "random") config->replacement = Replacement::Random;
+            else throw std::invalid_argument("Unknown replacement policy: " + fields[3]);
+        }
+        if (level == "l2")
+        {
+            options.has_l2 = true;
+        }
+    }
+    return options;
+}
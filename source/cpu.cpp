@@ -1,11 +1,20 @@
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
 #include <vector>
 #include <memory>
 #include <array>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 
+#include "bitops.hpp"
 #include "cpu.hpp"
 #include "memory.hpp"
+#include "cache_model.hpp"
+#include "timing_model.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
 
 enum Syscalls_
 {
@@ -14,6 +23,8 @@ enum Syscalls_
     SYS_PRINT_STR   = 2,
     SYS_READ_INT    = 3,
     SYS_READ_STR    = 4,
+    SYS_HART_ID     = 5,
+    SYS_HART_COUNT  = 6,
 };
 
 void CPU::execute_LD(CPU& cpu, Instruction instr, Memory& memory)
@@ -32,32 +43,14 @@ void CPU::execute_CLS(CPU& cpu, Instruction instr)
     uint8_t rd = instr.rd;
     uint8_t rs = instr.rs1;
 
-    uint32_t value = cpu.gpr[rs];
-    uint32_t sign_bit = (value >> 31) & 1;
-
-    int count = 0;
-    for (int i = 31; i >= 0; i--)
-    {
-        bool bit = (value >> i) & 1;
-
-        if (bit == sign_bit)
-        {
-            count++;
-
-        }
-        else
-        {
-
-            break;
-        }
-
-    }
-
-    cpu.gpr[rd] = count;
-
+    cpu.gpr[rd] = count_leading_signs(cpu.gpr[rs]);
 }
 
-void CPU::execute_SYSCALL(CPU& cpu)
+// Строки: r3 — адрес, r4 — длина (для SYS_READ_STR — ёмкость буфера).
+// SYS_READ_STR возвращает в r3 число прочитанных байт, 0xFFFFFFFF — конец ввода.
+// Если SyscallIO ещё не готов отдать ввод, CPU останавливается перед SYSCALL (StopReason::InputWait).
+// Диапазон за пределами памяти — ошибка доступа, ничего не выводится и не пишется
+void CPU::execute_SYSCALL(CPU& cpu, Memory& memory)
 {
     uint32_t syscall_num = cpu.gpr[8];
 
@@ -69,24 +62,72 @@ void CPU::execute_SYSCALL(CPU& cpu)
             break;
 
         case SYS_PRINT_INT:
-            std::cout << "=========================================================\n";
-            std::cout << "Output: " << std::dec << cpu.gpr[3] << std::endl;
-             std::cout << "=========================================================\n";
+            cpu.io->print_int(cpu.gpr[3]);
             cpu.gpr[0] = 0;
             break;
 
+        case SYS_PRINT_STR:
+        {
+            const uint8_t* text = memory.host_bytes(cpu.gpr[3], cpu.gpr[4]);
+            if (!text)
+            {
+                cpu.raise_fault(Fault::MemoryAccess, cpu.gpr[3]);
+                break;
+            }
+            cpu.io->print_str(std::string_view(reinterpret_cast<const char*>(text), cpu.gpr[4]));
+            break;
+        }
 
        case SYS_READ_INT:
+       {
+            if (!cpu.io->can_read_int())
+            {
+                cpu.raise_fault(Fault::InputWait, cpu.pc);
+                break;
+            }
+            uint32_t value = 0;
+            cpu.io->read_int(value);
+            cpu.gpr[3] = value;
+            break;
+       }
+
+        case SYS_READ_STR:
+        {
+            uint32_t address = cpu.gpr[3];
+            if (!memory.host_bytes(address, cpu.gpr[4]))
+            {
+                cpu.raise_fault(Fault::MemoryAccess, address);
+                break;
+            }
 
-            std::cout << "Input: ";
-            std::cin >> cpu.gpr[3];
-            std::cout << std::endl;
+            if (!cpu.io->can_read_line(cpu.gpr[4]))
+            {
+                cpu.raise_fault(Fault::InputWait, cpu.pc);
+                break;
+            }
 
+            std::string_view line;
+            if (!cpu.io->read_line(line, cpu.gpr[4]))
+            {
+                cpu.gpr[3] = 0xFFFFFFFF;
+                break;
+            }
+            memory.write_block(address, line.data(), line.size());
+            cpu.invalidate_code(address, static_cast<uint32_t>(line.size()));
+            cpu.gpr[3] = static_cast<uint32_t>(line.size());
+            break;
+        }
+
+        case SYS_HART_ID:
+            cpu.gpr[3] = cpu.hart_id;
+            break;
+
+        case SYS_HART_COUNT:
+            cpu.gpr[3] = cpu.hart_count;
             break;
 
         default:
-            std::cerr << "Unknown syscall: " << syscall_num << std::endl;
-            cpu.should_halt = true;
+            cpu.raise_fault(Fault::UnknownSyscall, cpu.pc);
             break;
     }
 }
@@ -134,24 +175,7 @@ void CPU::execute_BEXT(CPU& cpu, Instruction instr)
     uint8_t rs1 = instr.rs1;
     uint8_t rs2 = instr.rs2;
 
-    uint32_t result = 0;
-    uint32_t mask = cpu.gpr[rs2];
-
-    for (int i = 0, count = 0; i < 32; i++)
-    {
-        if (mask & (1u << i))
-        {
-            bool bit = (cpu.gpr[rs1] & (1u << i));
-
-            if (bit)
-            {
-                result |= (1u << count);
-            }
-            count++;
-        }
-    }
-
-    cpu.gpr[rd] = result;
+    cpu.gpr[rd] = extract_bits(cpu.gpr[rs1], cpu.gpr[rs2]);
 }
 
 void CPU::execute_SUB(CPU& cpu, Instruction instr)
@@ -245,6 +269,7 @@ void CPU::execute_ST(CPU& cpu, Instruction instr, Memory& memory)
         return;
     }
     memory.write<uint32_t>(address, cpu.gpr[rt]);
+    cpu.invalidate_code(address, 4);
 }
 
 void CPU::execute_STP(CPU& cpu, Instruction instr, Memory& memory)
@@ -258,5 +283,1040 @@ void CPU::execute_STP(CPU& cpu, Instruction instr, Memory& memory)
 
     memory.write<uint32_t>(addr, cpu.gpr[rt1]);
     memory.write<uint32_t>(addr + 4, cpu.gpr[rt2]);
+    cpu.invalidate_code(addr, 8);
+
+}
+
+// CAS rd, rs, rt: если слово по адресу X[rs] равно X[rt], туда пишется X[rd];
+// X[rd] получает прежнее значение слова. Атомарна относительно других CPU
+// на той же Memory и упорядочена с их обращениями как полный барьер
+void CPU::execute_CAS(CPU& cpu, Instruction instr, Memory& memory)
+{
+    uint8_t rs = instr.rd;
+    uint8_t rt = instr.rs1;
+    uint8_t rd = instr.rs2;
+
+    uint32_t address = cpu.gpr[rs];
+    uint32_t expected = cpu.gpr[rt];
+
+    if ((address & 0x3) != 0)
+    {
+        cpu.raise_fault(Fault::MemoryAccess, address);
+        return;
+    }
+
+    uint32_t old = memory.compare_exchange(address, expected, cpu.gpr[rd]);
+    cpu.gpr[rd] = old;
+
+    if (old == expected)
+    {
+        cpu.invalidate_code(address, 4);
+    }
+}
+
+void CPU::execute_FENCE()
+{
+    Memory::fence();
+}
+
+// VLD/VST: 16 байт по base + offset, выравнивание не требуется
+void CPU::execute_VLD(CPU& cpu, Instruction instr, Memory& memory)
+{
+    uint8_t base = instr.rd;
+    uint8_t vt = instr.rs1;
+    int16_t offset = instr.imm;
+
+    cpu.vr[vt] = memory.read<VectorRegister>(cpu.gpr[base] + offset);
+}
+
+void CPU::execute_VST(CPU& cpu, Instruction instr, Memory& memory)
+{
+    uint8_t base = instr.rd;
+    uint8_t vt = instr.rs1;
+    int16_t offset = instr.imm;
+
+    uint32_t address = cpu.gpr[base] + offset;
+
+    memory.write<VectorRegister>(address, cpu.vr[vt]);
+    cpu.invalidate_code(address, sizeof(VectorRegister));
+}
+
+void CPU::execute_VADD(CPU& cpu, Instruction instr)
+{
+    cpu.vr[instr.rd] = vector_add(cpu.vr[instr.rs1], cpu.vr[instr.rs2]);
+}
+
+void CPU::execute_VSUB(CPU& cpu, Instruction instr)
+{
+    cpu.vr[instr.rd] = vector_sub(cpu.vr[instr.rs1], cpu.vr[instr.rs2]);
+}
+
+void CPU::execute_VADDS(CPU& cpu, Instruction instr)
+{
+    cpu.vr[instr.rd] = vector_add_saturated(cpu.vr[instr.rs1], cpu.vr[instr.rs2]);
+}
+
+void CPU::execute_VSSAT(CPU& cpu, Instruction instr)
+{
+    uint8_t imm5 = instr.rs2;
+
+    cpu.vr[instr.rd] = vector_saturate(cpu.vr[instr.rs1], imm5);
+}
+
+// VSPLAT vd, rs: X[rs] во все дорожки
+void CPU::execute_VSPLAT(CPU& cpu, Instruction instr)
+{
+    cpu.vr[instr.rd] = vector_splat(cpu.gpr[instr.rs1]);
+}
+
+// VREDSUM rd, vs: сумма дорожек в X[rd]
+void CPU::execute_VREDSUM(CPU& cpu, Instruction instr)
+{
+    cpu.gpr[instr.rd] = vector_sum(cpu.vr[instr.rs1]);
+}
+
+void CPU::execute_ADDI_BNE(CPU& cpu, Instruction instr)
+{
+    execute_ADDI(cpu, instr);
+    cpu.fusion_stats.executed[FUSE_ADDI_BNE]++;
 
+    if (cpu.gpr[instr.fused_rs] != cpu.gpr[instr.fused_rt])
+    {
+        int16_t offset = instr.fused_imm;
+        int32_t target = (offset) << 2;
+        cpu.pc += 4 + target;
+        cpu.branch_flag = true;
+    }
+}
+
+void CPU::execute_MOVE_PAIR(CPU& cpu, Instruction instr)
+{
+    execute_ADD(cpu, instr);
+    cpu.fusion_stats.executed[FUSE_MOVE_PAIR]++;
+
+    cpu.gpr[instr.fused_rd] = cpu.gpr[instr.fused_rs] + cpu.gpr[instr.fused_rt];
+}
+
+// PC продвигается до SYSCALL заранее: ловушка неизвестного вызова укажет на него
+void CPU::execute_SYSCALL_IMM(CPU& cpu, Instruction instr, Memory& memory)
+{
+    execute_ADDI(cpu, instr);
+    cpu.fusion_stats.executed[FUSE_SYSCALL_IMM]++;
+
+    cpu.pc += 4;
+    execute_SYSCALL(cpu, memory);
+}
+
+// Пара сливается, только если вторая инструкция — ровно та, что ждёт идиома;
+// семантика остаётся общей (r0 не обязан быть нулём), меняется лишь число диспатчей
+bool CPU::fuse(Instruction& first, const Instruction& second, Fusion& kind)
+{
+    // ADDI: rs = rd, rt = rs1; BNE: rs = rd, rt = rt
+    if (first.handler == H_ADDI && second.handler == H_BNE &&
+        first.rd == first.rs1 && (second.rd == first.rs1 || second.rt == first.rs1))
+    {
+        first.handler = H_ADDI_BNE;
+        first.fused_rs = second.rd;
+        first.fused_rt = second.rt;
+        first.fused_imm = second.imm;
+        kind = FUSE_ADDI_BNE;
+        return true;
+    }
+
+    // ADD: rs = rd, rt = rs1, rd = rs2; пересылка — ADD rd, r0, rs
+    if (first.handler == H_ADD && second.handler == H_ADD && first.rd == 0 && second.rd == 0)
+    {
+        first.handler = H_MOVE_PAIR;
+        first.fused_rs = second.rd;
+        first.fused_rt = second.rs1;
+        first.fused_rd = second.rs2;
+        kind = FUSE_MOVE_PAIR;
+        return true;
+    }
+
+    if (first.handler == H_ADDI && second.handler == H_SYSCALL && first.rs1 == 8 && first.rd == 0)
+    {
+        first.handler = H_SYSCALL_IMM;
+        kind = FUSE_SYSCALL_IMM;
+        return true;
+    }
+
+    return false;
+}
+
+void CPU::predecode(Memory& memory, uint32_t begin, uint32_t end)
+{
+    if (!decode_cache_enabled)
+    {
+        return;
+    }
+
+    begin &= ~3u;
+    if (end > memory.size())
+    {
+        end = static_cast<uint32_t>(memory.size());
+    }
+
+    for (uint32_t addr = begin; uint64_t{addr} + 4 <= end; addr += 4)
+    {
+        Instruction first(memory.read<uint32_t>(addr));
+        Fusion kind;
+
+        if (fusion_enabled && uint64_t{addr} + 8 <= end &&
+            fuse(first, Instruction(memory.read<uint32_t>(addr + 4)), kind))
+        {
+            fusion_stats.sites[kind]++;
+        }
+
+        decode_cache.insert(addr, first);
+    }
+}
+
+void CPU::arm_limits()
+{
+    run_limit = instruction_limit ? retired + instruction_limit : UINT64_MAX;
+    next_check = run_limit;
+
+    if (time_limit > std::chrono::steady_clock::duration::zero())
+    {
+        deadline = std::chrono::steady_clock::now() + time_limit;
+        next_check = std::min(run_limit, retired + CHECK_INTERVAL);
+    }
+}
+
+bool CPU::checkpoint()
+{
+    // Инструкция на границе лимита сама остановила CPU (SYS_EXIT, ошибка)
+    if (should_halt)
+    {
+        return true;
+    }
+
+    StopReason reason = StopReason::None;
+
+    if (retired >= run_limit)
+    {
+        reason = StopReason::InstructionLimit;
+    }
+    else if (std::chrono::steady_clock::now() >= deadline)
+    {
+        reason = StopReason::TimeLimit;
+    }
+
+    if (reason == StopReason::None)
+    {
+        next_check = std::min(run_limit, retired + CHECK_INTERVAL);
+        return false;
+    }
+
+    stop_reason = reason;
+    should_halt = true;
+    return true;
+}
+
+// Эталонный цикл: по одной инструкции, как step_unguarded. Политика включает
+// профиль, трассу, модели кэшей и конвейера и проверки кэша декодирования. Адрес обращения к памяти
+// и прежние значения регистров берутся до выполнения, потому что инструкция может переписать
+// базу; инструкция, вызвавшая ошибку, в профиль и трассу не попадает (в трассе — событие,
+// см. trace_end), а в модели кэшей её обращения уже учтены. Профиль и трасса смотрят на opcode, а не на handler: он может быть слитым
+template <class Policy>
+void CPU::run_reference(Memory& memory)
+{
+    if constexpr (Policy::trace)
+    {
+        if (!tracer->started())
+        {
+            tracer->start(pc, gpr.data(), vr.data());
+        }
+    }
+
+    while (!should_halt)
+    {
+        Instruction instr_obj = fetch(memory);
+        [[maybe_unused]] uint32_t at = pc;
+
+        if constexpr (Policy::checked)
+        {
+            check_decoded(memory, instr_obj);
+        }
+
+        [[maybe_unused]] CacheLevel fetch_level = CacheLevel::L1;
+        [[maybe_unused]] CacheLevel data_level = CacheLevel::L1;
+        if constexpr (Policy::model)
+        {
+            if (cache_model)
+            {
+                model_caches(instr_obj, memory, fetch_level, data_level);
+            }
+        }
+
+        if constexpr (Policy::profile)
+        {
+            switch (instr_obj.opcode)
+            {
+                case OP_LD:
+                    profiler->access(gpr[instr_obj.rd] + instr_obj.imm, false);
+                    break;
+                case OP_ST:
+                    profiler->access(gpr[instr_obj.rd] + instr_obj.imm, true);
+                    break;
+                case OP_STP:
+                    profiler->access(gpr[instr_obj.rd] + instr_obj.offset, true);
+                    profiler->access(gpr[instr_obj.rd] + instr_obj.offset + 4, true);
+                    break;
+                case OP_VLD:
+                    profiler->access(gpr[instr_obj.rd] + instr_obj.imm, false);
+                    break;
+                case OP_VST:
+                    profiler->access(gpr[instr_obj.rd] + instr_obj.imm, true);
+                    break;
+                case OP_R_FORMAT:
+                    if (instr_obj.funct == F_CAS)
+                    {
+                        profiler->access(gpr[instr_obj.rd], false);
+                        profiler->access(gpr[instr_obj.rd], true);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        // SYSCALL может поменять r0 и r3; у остальных не больше одного регистра
+        [[maybe_unused]] uint32_t word = 0;
+        [[maybe_unused]] uint8_t handler = 0;
+        [[maybe_unused]] bool has_address = false;
+        [[maybe_unused]] uint32_t address = 0;
+        [[maybe_unused]] int destination = -1;
+        [[maybe_unused]] int vector_destination = -1;
+        [[maybe_unused]] uint32_t old_value = 0;
+        [[maybe_unused]] uint32_t old_r0 = 0;
+        if constexpr (Policy::trace)
+        {
+            word = memory.read<uint32_t>(pc);
+            handler = classify(instr_obj.opcode, instr_obj.funct);
+
+            has_address = true;
+            switch (handler)
+            {
+                case H_LD: case H_ST: case H_VLD: case H_VST:
+                    address = gpr[instr_obj.rd] + instr_obj.imm;
+                    break;
+                case H_STP:
+                    address = gpr[instr_obj.rd] + instr_obj.offset;
+                    break;
+                case H_CAS:
+                    address = gpr[instr_obj.rd];
+                    break;
+                default:
+                    has_address = false;
+            }
+
+            switch (handler)
+            {
+                case H_ADDI: case H_LD:
+                    destination = instr_obj.rs1;
+                    break;
+                case H_ADD: case H_SUB: case H_CAS:
+                    destination = instr_obj.rs2;
+                    break;
+                case H_CLS: case H_BEXT: case H_SSAT: case H_SBIT: case H_VREDSUM:
+                    destination = instr_obj.rd;
+                    break;
+                case H_SYSCALL:
+                    destination = 3;
+                    break;
+                case H_VLD:
+                    vector_destination = instr_obj.rs1;
+                    break;
+                case H_VADD: case H_VSUB: case H_VADDS: case H_VSSAT: case H_VSPLAT:
+                    vector_destination = instr_obj.rd;
+                    break;
+                default:
+                    break;
+            }
+            old_value = destination >= 0 ? gpr[destination] : 0;
+            old_r0 = gpr[0];
+        }
+
+        branch_flag = false;
+        if constexpr (Policy::flat_dispatch)
+        {
+            execute_handler<Policy::fused>(instr_obj, memory);
+        }
+        else
+        {
+            execute_instruction(instr_obj, memory);
+        }
+
+        if (fault != Fault::None)
+        {
+            break;
+        }
+
+        [[maybe_unused]] bool taken = branch_flag;
+        if constexpr (Policy::model)
+        {
+            if (timing_model)
+            {
+                model_timing(instr_obj, at, taken, fetch_level, data_level);
+            }
+        }
+        if constexpr (Policy::profile)
+        {
+            taken = taken && (instr_obj.opcode == OP_BNE || instr_obj.opcode == OP_BEQ || instr_obj.opcode == OP_J);
+            profiler->count(at, instr_obj.opcode, instr_obj.funct, taken);
+        }
+
+        if constexpr (Policy::trace)
+        {
+            tracer->begin(at, word);
+            if (has_address)
+            {
+                tracer->memory(address);
+            }
+            if (handler == H_SYSCALL && gpr[0] != old_r0)
+            {
+                tracer->register_write(0, old_r0, gpr[0]);
+            }
+            if (destination >= 0 && gpr[destination] != old_value)
+            {
+                tracer->register_write(static_cast<uint8_t>(destination), old_value, gpr[destination]);
+            }
+            if (vector_destination >= 0)
+            {
+                tracer->vector(static_cast<uint8_t>(vector_destination), vr[vector_destination]);
+            }
+            tracer->commit();
+        }
+
+        // Лимиты сверяются только на взятых переходах (B*, J, остановка на SYSCALL):
+        // любой цикл проходит через них, а остальные инструкции проверки не платят
+        retired++;
+        if (!branch_flag)
+        {
+            pc += 4;
+        }
+        else if (retired >= next_check && checkpoint())
+        {
+            break;
+        }
+    }
+}
+
+template void CPU::run_reference<CPU::FastPolicy>(Memory& memory);
+template void CPU::run_reference<CPU::CheckedPolicy>(Memory& memory);
+template void CPU::run_reference<CPU::ProfiledPolicy>(Memory& memory);
+template void CPU::run_reference<CPU::TracedPolicy>(Memory& memory);
+template void CPU::run_reference<CPU::ModeledPolicy>(Memory& memory);
+
+// Адреса берутся до выполнения, как в профиле. Обращения за пределы памяти
+// в модель не попадают: инструкция кончится ошибкой
+void CPU::model_caches(const Instruction& instr_obj, const Memory& memory, CacheLevel& fetch_level, CacheLevel& data_level)
+{
+    fetch_level = cache_model->fetch(pc);
+
+    uint32_t address;
+    uint32_t size;
+    bool write;
+    switch (instr_obj.opcode)
+    {
+        case OP_LD:  address = gpr[instr_obj.rd] + instr_obj.imm;    size = 4;  write = false; break;
+        case OP_ST:
+            // Невыровненный ST ничего не пишет (execute_ST) — и в кэш не идёт
+            address = gpr[instr_obj.rd] + instr_obj.imm;
+            if ((address & 0x3) != 0)
+            {
+                return;
+            }
+            size = 4;
+            write = true;
+            break;
+        case OP_STP: address = gpr[instr_obj.rd] + instr_obj.offset; size = 8;  write = true;  break;
+        case OP_VLD: address = gpr[instr_obj.rd] + instr_obj.imm;    size = 16; write = false; break;
+        case OP_VST: address = gpr[instr_obj.rd] + instr_obj.imm;    size = 16; write = true;  break;
+        case OP_R_FORMAT:
+            if (instr_obj.funct != F_CAS)
+            {
+                return;
+            }
+            address = gpr[instr_obj.rd];
+            size = 4;
+            write = true;
+            break;
+        default:
+            return;
+    }
+
+    if (uint64_t{address} + size <= memory.size())
+    {
+        data_level = cache_model->data(pc, address, size, write);
+    }
+}
+
+// Операнды — как у execute_*: что инструкция читает, куда пишет, куда ведёт переход
+void CPU::model_timing(const Instruction& instr_obj, uint32_t at, bool taken, CacheLevel fetch_level, CacheLevel data_level)
+{
+    using Unit = TimingModel::Unit;
+
+    TimingModel::Event event;
+    event.pc = at;
+    event.fetch = fetch_level;
+    event.data = data_level;
+
+    auto x = [](uint8_t reg) { return 1u << reg; };
+    auto writes = [](uint8_t reg) { return static_cast<int8_t>(reg); };
+
+    switch (classify(instr_obj.opcode, instr_obj.funct))
+    {
+        case H_ADDI:
+            event.reads = x(instr_obj.rd);
+            event.writes = writes(instr_obj.rs1);
+            break;
+        case H_ADD: case H_SUB:
+            event.reads = x(instr_obj.rd) | x(instr_obj.rs1);
+            event.writes = writes(instr_obj.rs2);
+            break;
+        case H_SBIT:
+            event.writes = writes(instr_obj.rd);
+            break;
+        case H_CLS:
+            event.unit = Unit::Cls;
+            event.reads = x(instr_obj.rs1);
+            event.writes = writes(instr_obj.rd);
+            break;
+        case H_SSAT:
+            event.unit = Unit::Ssat;
+            event.reads = x(instr_obj.rs1);
+            event.writes = writes(instr_obj.rd);
+            break;
+        case H_BEXT:
+            event.unit = Unit::Bext;
+            event.reads = x(instr_obj.rs1) | x(instr_obj.rs2);
+            event.writes = writes(instr_obj.rd);
+            break;
+        case H_LD:
+            event.unit = Unit::Load;
+            event.reads = x(instr_obj.rd);
+            event.writes = writes(instr_obj.rs1);
+            break;
+        case H_ST:
+            event.unit = Unit::Store;
+            event.reads = x(instr_obj.rd) | x(instr_obj.rs1);
+            break;
+        case H_STP:
+            event.unit = Unit::Store;
+            event.reads = x(instr_obj.rd) | x(instr_obj.rs1) | x(instr_obj.rs2);
+            break;
+        case H_CAS:
+            event.unit = Unit::Load;
+            event.reads = x(instr_obj.rd) | x(instr_obj.rs1) | x(instr_obj.rs2);
+            event.writes = writes(instr_obj.rs2);
+            break;
+        case H_VLD:
+            event.unit = Unit::Load;
+            event.reads = x(instr_obj.rd);
+            event.vector_writes = writes(instr_obj.rs1);
+            break;
+        case H_VST:
+            event.unit = Unit::Store;
+            event.reads = x(instr_obj.rd);
+            event.vector_reads = x(instr_obj.rs1);
+            break;
+        case H_VADD: case H_VSUB: case H_VADDS:
+            event.vector_reads = x(instr_obj.rs1) | x(instr_obj.rs2);
+            event.vector_writes = writes(instr_obj.rd);
+            break;
+        case H_VSSAT:
+            event.vector_reads = x(instr_obj.rs1);
+            event.vector_writes = writes(instr_obj.rd);
+            break;
+        case H_VSPLAT:
+            event.reads = x(instr_obj.rs1);
+            event.vector_writes = writes(instr_obj.rd);
+            break;
+        case H_VREDSUM:
+            event.vector_reads = x(instr_obj.rs1);
+            event.writes = writes(instr_obj.rd);
+            break;
+        case H_BNE: case H_BEQ:
+            event.unit = Unit::Branch;
+            event.reads = x(instr_obj.rd) | x(instr_obj.rt);
+            event.taken = taken;
+            event.target = at + static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(instr_obj.imm)) << 2);
+            break;
+        case H_J:
+            event.unit = Unit::Jump;
+            event.taken = true;
+            event.target = (at & 0xFFFFF000) | (instr_obj.target << 2);
+            break;
+        case H_SYSCALL:
+            event.unit = Unit::Syscall;
+            event.reads = x(8) | x(3) | x(4);
+            event.writes = writes(3);
+            break;
+        default:
+            break;
+    }
+
+    timing_model->retire(event);
+}
+
+// Запись в кэше должна совпадать со свежим декодированием слова по PC, а слитая —
+// с тем, что fuse собрал бы из этого слова и следующего
+void CPU::check_decoded(Memory& memory, const Instruction& cached)
+{
+    Instruction fresh(memory.read<uint32_t>(pc));
+
+    bool same = cached.opcode == fresh.opcode && cached.funct == fresh.funct && cached.rd == fresh.rd &&
+                cached.rs1 == fresh.rs1 && cached.rs2 == fresh.rs2 && cached.imm == fresh.imm &&
+                cached.target == fresh.target && cached.offset == fresh.offset;
+
+    if (same && cached.handler != fresh.handler)
+    {
+        Fusion kind;
+        same = uint64_t{pc} + 8 <= memory.size() &&
+               fuse(fresh, Instruction(memory.read<uint32_t>(pc + 4)), kind) &&
+               cached.handler == fresh.handler && cached.fused_rs == fresh.fused_rs &&
+               cached.fused_rt == fresh.fused_rt && cached.fused_rd == fresh.fused_rd &&
+               cached.fused_imm == fresh.fused_imm;
+    }
+
+    if (!same)
+    {
+        std::ostringstream message;
+        message << "Stale decode cache entry at PC 0x" << std::hex << pc;
+        throw std::logic_error(message.str());
+    }
+}
+
+// Вне Memory::guarded: ловушка доступа прерывает run_reference до события
+void CPU::trace_end()
+{
+    if (!tracer->started())
+    {
+        tracer->start(pc, gpr.data(), vr.data());
+    }
+
+    if (fault != Fault::None)
+    {
+        tracer->event(TraceEvent::Fault, fault_pc, static_cast<uint8_t>(fault), fault_address);
+    }
+    else if (stop_reason != StopReason::None)
+    {
+        tracer->event(TraceEvent::Stop, pc);
+    }
+    else if (should_halt)
+    {
+        tracer->event(TraceEvent::Halt, pc);
+    }
+}
+
+// Шитый код: каждый обработчик сам продвигает PC и сразу переходит
+// к обработчику следующей инструкции, без общего switch. Запись кэша декодирования
+// хранит адрес своего обработчика (thread_label), поэтому следующая инструкция
+// и цель перехода внутри страницы кэша берутся прямо из массива её записей,
+// без поиска. Неразрешённая запись (новая, сброшенная invalidate_code, страж
+// за концом страницы) ведёт в do_RESOLVE — обычную выборку через кэш.
+// PC и retired живут в локальных переменных; в CPU они пишутся на выходах,
+// перед обращениями к памяти (ловушка должна застать точный PC) и перед SYSCALL
+#if defined(__GNUC__) || defined(__clang__)
+
+void CPU::run_threaded(Memory& memory)
+{
+    using Cache = DecodeCache<Instruction>;
+
+#define LABEL(name) static_cast<int32_t>(static_cast<char*>(&&do_##name) - static_cast<char*>(&&do_RESOLVE))
+
+    static const int32_t labels[H_COUNT] =
+    {
+        LABEL(CLS), LABEL(ADD), LABEL(BEXT),
+        LABEL(SYSCALL), LABEL(SUB), LABEL(SSAT),
+        LABEL(STP), LABEL(BNE), LABEL(BEQ),
+        LABEL(SBIT), LABEL(J), LABEL(ADDI),
+        LABEL(ST), LABEL(LD), LABEL(CAS),
+        LABEL(FENCE), LABEL(VLD), LABEL(VST),
+        LABEL(VADD), LABEL(VSUB), LABEL(VADDS),
+        LABEL(VSSAT), LABEL(VSPLAT), LABEL(VREDSUM),
+        LABEL(ADDI_BNE), LABEL(MOVE_PAIR), LABEL(SYSCALL_IMM),
+        LABEL(ILLEGAL), LABEL(ILLEGAL)
+    };
+
+    if (should_halt)
+    {
+        return;
+    }
+
+    uint32_t local_pc = pc;
+    uint64_t local_retired = retired;
+
+    const Instruction* instr = nullptr;
+    const Instruction* page = nullptr;          // записи страницы кэша, где лежит instr
+    uint64_t page_index = UINT64_MAX;           // её номер; UINT64_MAX — instr во временной записи
+    Instruction scratch[3]{};                   // без кэша декодирования: запись и два стража
+
+#define DISPATCH()                          \
+    goto *(static_cast<char*>(&&do_RESOLVE) + instr->thread_label)
+
+#define SYNC()                              \
+    do                                      \
+    {                                       \
+        pc = local_pc;                      \
+        retired = local_retired;            \
+    } while (0)
+
+#define NEXT(words)                         \
+    do                                      \
+    {                                       \
+        local_pc += 4 * (words);            \
+        local_retired += (words);           \
+        instr += (words);                   \
+        DISPATCH();                         \
+    } while (0)
+
+// Лимиты run() проверяются только на переходах: любой цикл проходит через них
+#define CHECK_LIMITS()                      \
+    do                                      \
+    {                                       \
+        if (local_retired >= next_check)    \
+        {                                   \
+            SYNC();                         \
+            if (checkpoint()) return;       \
+        }                                   \
+    } while (0)
+
+#define JUMP(target, words)                 \
+    do                                      \
+    {                                       \
+        local_pc = (target);                \
+        local_retired += (words);           \
+        CHECK_LIMITS();                     \
+        if ((local_pc >> Cache::PAGE_SHIFT) != page_index) goto do_RESOLVE; \
+        instr = page + ((local_pc & (Cache::PAGE_SIZE - 1)) >> 2); \
+        DISPATCH();                         \
+    } while (0)
+
+#define FALL_THROUGH(words)                 \
+    do                                      \
+    {                                       \
+        local_pc += 4 * (words);            \
+        local_retired += (words);           \
+        instr += (words);                   \
+        CHECK_LIMITS();                     \
+        DISPATCH();                         \
+    } while (0)
+
+    goto do_RESOLVE;
+
+do_CLS:     gpr[instr->rd] = count_leading_signs(gpr[instr->rs1]);               NEXT(1);
+do_ADD:     gpr[instr->rs2] = gpr[instr->rd] + gpr[instr->rs1];                  NEXT(1);
+do_BEXT:    gpr[instr->rd] = extract_bits(gpr[instr->rs1], gpr[instr->rs2]);     NEXT(1);
+do_SUB:     gpr[instr->rs2] = gpr[instr->rd] - gpr[instr->rs1];                  NEXT(1);
+do_SSAT:    execute_SSAT(*this, *instr);                                         NEXT(1);
+do_SBIT:    gpr[instr->rd] = 1u << instr->rs2;                                   NEXT(1);
+do_ADDI:    gpr[instr->rs1] = gpr[instr->rd] + instr->imm;                       NEXT(1);
+do_FENCE:   execute_FENCE();                                                     NEXT(1);
+do_VADD:    execute_VADD(*this, *instr);                                         NEXT(1);
+do_VSUB:    execute_VSUB(*this, *instr);                                         NEXT(1);
+do_VADDS:   execute_VADDS(*this, *instr);                                        NEXT(1);
+do_VSSAT:   execute_VSSAT(*this, *instr);                                        NEXT(1);
+do_VSPLAT:  execute_VSPLAT(*this, *instr);                                       NEXT(1);
+do_VREDSUM: execute_VREDSUM(*this, *instr);                                      NEXT(1);
+
+do_LD:
+    SYNC();
+    gpr[instr->rs1] = memory.read<uint32_t>(gpr[instr->rd] + instr->imm);
+    NEXT(1);
+
+do_ST:
+    SYNC();
+    execute_ST(*this, *instr, memory);
+    NEXT(1);
+
+do_STP:
+    SYNC();
+    execute_STP(*this, *instr, memory);
+    NEXT(1);
+
+do_VLD:
+    SYNC();
+    execute_VLD(*this, *instr, memory);
+    NEXT(1);
+
+do_VST:
+    SYNC();
+    execute_VST(*this, *instr, memory);
+    NEXT(1);
+
+do_CAS:
+    SYNC();
+    execute_CAS(*this, *instr, memory);
+    if (should_halt)
+    {
+        return;
+    }
+    NEXT(1);
+
+do_BNE:
+    if (gpr[instr->rd] != gpr[instr->rt])
+    {
+        JUMP(local_pc + (static_cast<uint32_t>(instr->imm) << 2), 1);
+    }
+    FALL_THROUGH(1);
+
+do_BEQ:
+    if (gpr[instr->rd] == gpr[instr->rt])
+    {
+        JUMP(local_pc + (static_cast<uint32_t>(instr->imm) << 2), 1);
+    }
+    FALL_THROUGH(1);
+
+do_J:
+    JUMP((local_pc & 0xFFFFF000) | (instr->target << 2), 1);
+
+do_ADDI_BNE:
+    gpr[instr->rs1] = gpr[instr->rd] + instr->imm;
+    fusion_stats.executed[FUSE_ADDI_BNE]++;
+    if (gpr[instr->fused_rs] != gpr[instr->fused_rt])
+    {
+        JUMP(local_pc + 4 + (static_cast<uint32_t>(instr->fused_imm) << 2), 2);
+    }
+    FALL_THROUGH(2);
+
+do_MOVE_PAIR:
+    gpr[instr->rs2] = gpr[instr->rd] + gpr[instr->rs1];
+    gpr[instr->fused_rd] = gpr[instr->fused_rs] + gpr[instr->fused_rt];
+    fusion_stats.executed[FUSE_MOVE_PAIR]++;
+    NEXT(2);
+
+// ADDI засчитывается сразу; дальше — обычный SYSCALL по следующему слову
+do_SYSCALL_IMM:
+    gpr[instr->rs1] = gpr[instr->rd] + instr->imm;
+    fusion_stats.executed[FUSE_SYSCALL_IMM]++;
+    local_pc += 4;
+    local_retired++;
+    instr++;
+    goto do_SYSCALL;
+
+// Ошибка и ожидание ввода оставляют PC на SYSCALL, и он не засчитан
+do_SYSCALL:
+    SYNC();
+    branch_flag = false;
+    execute_SYSCALL(*this, memory);
+    if (branch_flag)
+    {
+        return;
+    }
+    if (should_halt)
+    {
+        pc = local_pc + 4;
+        retired = local_retired + 1;
+        return;
+    }
+    FALL_THROUGH(1);
+
+do_ILLEGAL:
+    SYNC();
+    raise_fault(Fault::IllegalInstruction, local_pc);
+    return;
+
+// Выборка может попасть в ловушку: PC и retired уже должны быть в CPU
+do_RESOLVE:
+    SYNC();
+    if (decode_cache_enabled && (local_pc & 0x3) == 0)
+    {
+        Instruction* entry = decode_cache.lookup(local_pc);
+        if (!entry)
+        {
+            entry = &decode_cache.insert(local_pc, Instruction(memory.read<uint32_t>(local_pc)));
+        }
+        entry->thread_label = labels[entry->handler];
+        instr = entry;
+        page = entry - ((local_pc & (Cache::PAGE_SIZE - 1)) >> 2);
+        page_index = local_pc >> Cache::PAGE_SHIFT;
+    }
+    else
+    {
+        scratch[0] = Instruction(memory.read<uint32_t>(local_pc));
+        scratch[0].thread_label = labels[scratch[0].handler];
+        instr = scratch;
+        page = nullptr;
+        page_index = UINT64_MAX;
+    }
+    DISPATCH();
+
+#undef FALL_THROUGH
+#undef JUMP
+#undef CHECK_LIMITS
+#undef NEXT
+#undef SYNC
+#undef DISPATCH
+#undef LABEL
+}
+
+#else
+
+// Без computed goto: таблица обработчиков, каждый вызывается через один косвенный вызов
+void CPU::run_threaded(Memory& memory)
+{
+    using ThreadedHandler = void (*)(CPU& cpu, const Instruction& instr, Memory& memory);
+
+    // Обработчики конца блока (переход, J, SYSCALL) сами считают свои инструкции
+    // и сверяют лимиты run(): остальные инструкции проверки не платят
+    static const auto end_block = [](CPU& cpu, uint64_t words)
+    {
+        cpu.retired += words;
+        if (cpu.retired >= cpu.next_check) cpu.checkpoint();
+    };
+
+    static const ThreadedHandler handlers[H_COUNT] =
+    {
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_CLS(cpu, instr);  cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_ADD(cpu, instr);  cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_BEXT(cpu, instr); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction&, Memory& memory)
+        {
+            cpu.branch_flag = false;
+            execute_SYSCALL(cpu, memory);
+            if (!cpu.branch_flag) cpu.pc += 4;
+            end_block(cpu, cpu.fault == Fault::None);
+        },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_SUB(cpu, instr);  cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_SSAT(cpu, instr); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory& memory) { execute_STP(cpu, instr, memory); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&)
+        {
+            cpu.branch_flag = false;
+            execute_BNE(cpu, instr);
+            if (!cpu.branch_flag) cpu.pc += 4;
+            end_block(cpu, 1);
+        },
+        [](CPU& cpu, const Instruction& instr, Memory&)
+        {
+            cpu.branch_flag = false;
+            execute_BEQ(cpu, instr);
+            if (!cpu.branch_flag) cpu.pc += 4;
+            end_block(cpu, 1);
+        },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_SBIT(cpu, instr); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_J(cpu, instr); end_block(cpu, 1); },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_ADDI(cpu, instr); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory& memory) { execute_ST(cpu, instr, memory); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory& memory) { execute_LD(cpu, instr, memory); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory& memory)
+        {
+            cpu.branch_flag = false;
+            execute_CAS(cpu, instr, memory);
+            if (!cpu.branch_flag) cpu.pc += 4;
+        },
+        [](CPU& cpu, const Instruction&, Memory&) { execute_FENCE(); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory& memory) { execute_VLD(cpu, instr, memory); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory& memory) { execute_VST(cpu, instr, memory); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_VADD(cpu, instr);    cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_VSUB(cpu, instr);    cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_VADDS(cpu, instr);   cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_VSSAT(cpu, instr);   cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_VSPLAT(cpu, instr);  cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_VREDSUM(cpu, instr); cpu.pc += 4; },
+        [](CPU& cpu, const Instruction& instr, Memory&)
+        {
+            cpu.branch_flag = false;
+            execute_ADDI_BNE(cpu, instr);
+            if (!cpu.branch_flag) cpu.pc += 8;
+            end_block(cpu, 2);
+        },
+        [](CPU& cpu, const Instruction& instr, Memory&) { execute_MOVE_PAIR(cpu, instr);   cpu.pc += 8; },
+        [](CPU& cpu, const Instruction& instr, Memory& memory)
+        {
+            cpu.branch_flag = false;
+            execute_SYSCALL_IMM(cpu, instr, memory);
+            if (!cpu.branch_flag) cpu.pc += 4;
+            end_block(cpu, cpu.fault == Fault::None ? 2 : 1);
+        },
+        [](CPU& cpu, const Instruction&, Memory&) { cpu.raise_fault(Fault::IllegalInstruction, cpu.pc); },
+        [](CPU& cpu, const Instruction&, Memory&) { cpu.raise_fault(Fault::IllegalInstruction, cpu.pc); },
+    };
+
+    // Сколько инструкций выполняет обработчик; обработчики конца блока считают себя сами
+    static const uint8_t weights[H_COUNT] =
+    {
+        1, 1, 1, 0, 1, 1, 1, 0, 0, 1, 0, 1, 1, 1, 1, 1,
+        1, 1, 1, 1, 1, 1, 1, 1,
+        0, 2, 0, 0, 0
+    };
+
+    while (!should_halt)
+    {
+        Instruction instr = fetch(memory);
+        handlers[instr.handler](*this, instr, memory);
+        retired += fault == Fault::None ? weights[instr.handler] : 0;
+    }
+}
+
+#endif
+
+// Интерпретирует инструкции до конца базового блока (переход, J, SYSCALL);
+// слитые пары — целиком, как switch-движок
+void CPU::interpret_block(Memory& memory)
+{
+    bool block_end = false;
+
+    while (!block_end && !should_halt)
+    {
+        Instruction instr_obj = fetch(memory);
+        branch_flag = false;
+        execute_handler<true>(instr_obj, memory);
+
+        if (!branch_flag)
+        {
+            pc += 4;
+        }
+        retired += fault == Fault::None;
+
+        switch (instr_obj.handler)
+        {
+            case H_BNE:
+            case H_BEQ:
+            case H_J:
+            case H_SYSCALL:
+            case H_ADDI_BNE:
+            case H_SYSCALL_IMM:
+                block_end = true;
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+void CPU::run_jit(Memory& memory)
+{
+    if (!Jit::supported())
+    {
+        run_threaded(memory);
+        return;
+    }
+
+    while (!should_halt)
+    {
+        if (Jit::BlockFn block = jit.lookup(pc))
+        {
+            uint64_t result = block(gpr.data(), &memory, this, &retired, next_check - retired, vr.data());
+            pc = static_cast<uint32_t>(result);
+
+            if (result & Jit::BAILOUT)
+            {
+                step_unguarded(memory);
+            }
+        }
+        else if (!jit.should_compile(pc) || !jit.compile(pc, memory))
+        {
+            interpret_block(memory);
+        }
+
+        if (retired >= next_check && checkpoint())
+        {
+            break;
+        }
+    }
 }
@@ -0,0 +1,210 @@
+#include <cstdio>
+
+#include "disassembler.hpp"
+
+namespace
+{
+    // Коды совпадают с Opcode/Funct в cpu.hpp
+    enum : uint8_t
+    {
+        OP_R_FORMAT = 0b000000,
+        OP_SSAT     = 0b001101,
+        OP_STP      = 0b010101,
+        OP_BNE      = 0b011000,
+        OP_BEQ      = 0b011010,
+        OP_SBIT     = 0b011100,
+        OP_J        = 0b011111,
+        OP_VECTOR   = 0b100000,
+        OP_ADDI     = 0b101101,
+        OP_VLD      = 0b110001,
+        OP_VST      = 0b110011,
+        OP_ST       = 0b110111,
+        OP_LD       = 0b111001
+    };
+
+    enum : uint8_t
+    {
+        F_CLS     = 0b001010,
+        F_ADD     = 0b010010,
+        F_BEXT    = 0b010100,
+        F_CAS     = 0b011110,
+        F_SYSCALL = 0b101000,
+        F_SUB     = 0b110110,
+        F_FENCE   = 0b111000
+    };
+
+    enum : uint8_t
+    {
+        VF_VADD    = 0b000001,
+        VF_VSUB    = 0b000010,
+        VF_VADDS   = 0b000011,
+        VF_VSSAT   = 0b000100,
+        VF_VSPLAT  = 0b000101,
+        VF_VREDSUM = 0b000110
+    };
+
+    struct Fields
+    {
+        uint8_t opcode, funct;
+        unsigned a, b, c;           // [25:21], [20:16], [15:11]
+        int32_t imm;                // [15:0] со знаком
+        int32_t offset;             // [10:0] со знаком (STP)
+        uint32_t index;             // [25:0] (J)
+
+        explicit Fields(uint32_t word)
+            : opcode((word >> 26) & 0x3F), funct(word & 0x3F),
+              a((word >> 21) & 0x1F), b((word >> 16) & 0x1F), c((word >> 11) & 0x1F),
+              imm(static_cast<int16_t>(word & 0xFFFF)),
+              offset(static_cast<int32_t>((word & 0x7FF) ^ 0x400) - 0x400),
+              index(word & 0x3FFFFFF) {}
+    };
+}
+
+const char* mnemonic(uint32_t word)
+{
+    Fields f(word);
+
+    if (f.opcode == OP_R_FORMAT)
+    {
+        switch (f.funct)
+        {
+            case F_CLS:     return "CLS";
+            case F_ADD:     return "ADD";
+            case F_BEXT:    return "BEXT";
+            case F_CAS:     return "CAS";
+            case F_SYSCALL: return "SYSCALL";
+            case F_SUB:     return "SUB";
+            case F_FENCE:   return "FENCE";
+            default:        return "???";
+        }
+    }
+
+    if (f.opcode == OP_VECTOR)
+    {
+        switch (f.funct)
+        {
+            case VF_VADD:    return "VADD";
+            case VF_VSUB:    return "VSUB";
+            case VF_VADDS:   return "VADDS";
+            case VF_VSSAT:   return "VSSAT";
+            case VF_VSPLAT:  return "VSPLAT";
+            case VF_VREDSUM: return "VREDSUM";
+            default:         return "???";
+        }
+    }
+
+    switch (f.opcode)
+    {
+        case OP_SSAT: return "SSAT";
+        case OP_STP:  return "STP";
+        case OP_BNE:  return "BNE";
+        case OP_BEQ:  return "BEQ";
+        case OP_SBIT: return "SBIT";
+        case OP_J:    return "J";
+        case OP_ADDI: return "ADDI";
+        case OP_ST:   return "ST";
+        case OP_LD:   return "LD";
+        case OP_VLD:  return "VLD";
+        case OP_VST:  return "VST";
+        default:      return "???";
+    }
+}
+
+bool ends_block(uint32_t word)
+{
+    Fields f(word);
+    return f.opcode == OP_BNE || f.opcode == OP_BEQ || f.opcode == OP_J ||
+           (f.opcode == OP_R_FORMAT && f.funct == F_SYSCALL);
+}
+
+std::string disassemble(uint32_t word, uint32_t pc)
+{
+    Fields f(word);
+    const char* name = mnemonic(word);
+    char text[64];
+
+    if (f.opcode == OP_R_FORMAT)
+    {
+        switch (f.funct)
+        {
+            case F_CLS:
+                std::snprintf(text, sizeof(text), "%s r%u, r%u", name, f.a, f.b);
+                break;
+            case F_ADD:
+            case F_SUB:
+            case F_CAS:
+                std::snprintf(text, sizeof(text), "%s r%u, r%u, r%u", name, f.c, f.a, f.b);
+                break;
+            case F_BEXT:
+                std::snprintf(text, sizeof(text), "%s r%u, r%u, r%u", name, f.a, f.b, f.c);
+                break;
+            case F_SYSCALL:
+            case F_FENCE:
+                std::snprintf(text, sizeof(text), "%s", name);
+                break;
+            default:
+                std::snprintf(text, sizeof(text), ".word 0x%08X", word);
+                break;
+        }
+        return text;
+    }
+
+    if (f.opcode == OP_VECTOR)
+    {
+        switch (f.funct)
+        {
+            case VF_VADD:
+            case VF_VSUB:
+            case VF_VADDS:
+                std::snprintf(text, sizeof(text), "%s v%u, v%u, v%u", name, f.a, f.b, f.c);
+                break;
+            case VF_VSSAT:
+                std::snprintf(text, sizeof(text), "%s v%u, v%u, #%u", name, f.a, f.b, f.c);
+                break;
+            case VF_VSPLAT:
+                std::snprintf(text, sizeof(text), "%s v%u, r%u", name, f.a, f.b);
+                break;
+            case VF_VREDSUM:
+                std::snprintf(text, sizeof(text), "%s r%u, v%u", name, f.a, f.b);
+                break;
+            default:
+                std::snprintf(text, sizeof(text), ".word 0x%08X", word);
+                break;
+        }
+        return text;
+    }
+
+    switch (f.opcode)
+    {
+        case OP_SSAT:
+        case OP_SBIT:
+            std::snprintf(text, sizeof(text), "%s r%u, r%u, #%u", name, f.a, f.b, f.c);
+            break;
+        case OP_STP:
+            std::snprintf(text, sizeof(text), "%s r%u, r%u, %d(r%u)", name, f.b, f.c, f.offset, f.a);
+            break;
+        case OP_BNE:
+        case OP_BEQ:
+            std::snprintf(text, sizeof(text), "%s r%u, r%u, 0x%X", name, f.a, f.b,
+                          pc + static_cast<uint32_t>(f.imm * 4));
+            break;
+        case OP_J:
+            std::snprintf(text, sizeof(text), "%s 0x%X", name, (pc & 0xFFFFF000) | (f.index << 2));
+            break;
+        case OP_ADDI:
+            std::snprintf(text, sizeof(text), "%s r%u, r%u, %d", name, f.b, f.a, f.imm);
+            break;
+        case OP_ST:
+        case OP_LD:
+            std::snprintf(text, sizeof(text), "%s r%u, %d(r%u)", name, f.b, f.imm, f.a);
+            break;
+        case OP_VLD:
+        case OP_VST:
+            std::snprintf(text, sizeof(text), "%s v%u, %d(r%u)", name, f.b, f.imm, f.a);
+            break;
+        default:
+            std::snprintf(text, sizeof(text), ".word 0x%08X", word);
+            break;
+    }
+    return text;
+}
@@ -0,0 +1,505 @@
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+#include "event_loop.hpp"
+
+namespace
+{
+    bool is_space(char c)
+    {
+        return std::isspace(static_cast<unsigned char>(c)) != 0;
+    }
+
+    void set_nonblocking(int fd)
+    {
+        int flags = fcntl(fd, F_GETFL);
+        if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "fcntl(O_NONBLOCK)");
+        }
+    }
+}
+
+// Ожидание готовности дескрипторов. Подписка одноразовая: после события
+// дескриптор снова нужно передать в watch(). wake_fd слушается всегда, его token — nullptr.
+// watch() и forget() вызываются из потоков планировщика, wait() — из потока ожидания
+class EventLoop::Poller
+{
+public:
+    explicit Poller(int wake_fd)
+    {
+#if defined(__linux__)
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd < 0)
+        {
+            throw std::system_error(errno, std::generic_category(), "epoll_create1");
+        }
+
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.ptr = nullptr;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event) < 0)
+        {
+            int error = errno;
+            close(epoll_fd);
+            throw std::system_error(error, std::generic_category(), "epoll_ctl");
+        }
+#else
+        watched.push_back({ wake_fd, POLLIN, nullptr });
+#endif
+    }
+
+    ~Poller()
+    {
+#if defined(__linux__)
+        close(epoll_fd);
+#endif
+    }
+
+    Poller(const Poller&) = delete;
+    Poller& operator=(const Poller&) = delete;
+
+    // added — есть ли fd уже в этом Poller. false — fd нельзя ждать (обычный файл):
+    // он всегда готов. Вне Linux wait() увидит новый fd, только когда его разбудят
+    bool watch(int fd, bool output, void* token, bool& added)
+    {
+#if defined(__linux__)
+        epoll_event event{};
+        event.events = (output ? EPOLLOUT : EPOLLIN) | EPOLLONESHOT;
+        event.data.ptr = token;
+
+        if (epoll_ctl(epoll_fd, added ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd, &event) < 0)
+        {
+            if (errno == EPERM)
+            {
+                return false;
+            }
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+        }
+#else
+        std::lock_guard<std::mutex> lock(mutex);
+        watched.push_back({ fd, static_cast<short>(output ? POLLOUT : POLLIN), token });
+#endif
+        added = true;
+        return true;
+    }
+
+    void forget(int fd, bool& added)
+    {
+        if (!added)
+        {
+            return;
+        }
+#if defined(__linux__)
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, nullptr);
+#else
+        std::lock_guard<std::mutex> lock(mutex);
+        watched.erase(std::remove_if(watched.begin() + 1, watched.end(),
+                                     [fd](const Watch& watch) { return watch.fd == fd; }),
+                      watched.end());
+#endif
+        added = false;
+    }
+
+    // Ждёт событий (timeout_ms < 0 — без срока) и дописывает их token в fired
+    void wait(int timeout_ms, std::vector<void*>& fired)
+    {
+#if defined(__linux__)
+        epoll_event events[64];
+        int count = epoll_wait(epoll_fd, events, 64, timeout_ms);
+        if (count < 0 && errno != EINTR)
+        {
+            throw std::system_error(errno, std::generic_category(), "epoll_wait");
+        }
+        for (int i = 0; i < count; i++)
+        {
+            fired.push_back(events[i].data.ptr);
+        }
+#else
+        std::vector<Watch> polled;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            polled = watched;
+        }
+
+        std::vector<pollfd> fds;
+        for (const Watch& watch : polled)
+        {
+            fds.push_back({ watch.fd, watch.events, 0 });
+        }
+        int count = poll(fds.data(), static_cast<nfds_t>(fds.size()), timeout_ms);
+        if (count < 0 && errno != EINTR)
+        {
+            throw std::system_error(errno, std::generic_category(), "poll");
+        }
+        if (count <= 0)
+        {
+            return;
+        }
+
+        // Пока шёл poll(), список мог пополниться: сработавшие подписки убираются по одной
+        std::lock_guard<std::mutex> lock(mutex);
+        for (size_t i = 0; i < fds.size(); i++)
+        {
+            if (fds[i].revents == 0)
+            {
+                continue;
+            }
+            fired.push_back(polled[i].token);
+            if (i == 0)
+            {
+                continue;
+            }
+            auto found = std::find_if(watched.begin() + 1, watched.end(), [&](const Watch& watch)
+            {
+                return watch.fd == polled[i].fd && watch.token == polled[i].token;
+            });
+            if (found != watched.end())
+            {
+                watched.erase(found);
+            }
+        }
+#endif
+    }
+
+private:
+#if defined(__linux__)
+    int epoll_fd = -1;
+#else
+    struct Watch
+    {
+        int fd;
+        short events;
+        void* token;
+    };
+    std::mutex mutex;
+    std::vector<Watch> watched;         // первым — wake_fd
+#endif
+};
+
+bool FdIO::fill()
+{
+    if (end_of_input)
+    {
+        return true;
+    }
+
+    char buffer[READ_CHUNK];
+    ssize_t count = read(input_fd, buffer, sizeof(buffer));
+
+    if (count > 0)
+    {
+        append_input(std::string_view(buffer, static_cast<size_t>(count)));
+        return true;
+    }
+    if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+    {
+        return false;
+    }
+    end_of_input = true;
+    return true;
+}
+
+bool FdIO::drain()
+{
+    while (!output().empty())
+    {
+        ssize_t count = write(output_fd, output().data(), output().size());
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return false;
+            }
+            clear_output();
+            break;
+        }
+        consume_output(static_cast<size_t>(count));
+    }
+    return true;
+}
+
+// Число готово, когда за токеном уже есть пробельный символ: иначе его хвост может быть ещё в пути
+bool FdIO::can_read_int()
+{
+    std::string_view input = unread_input();
+
+    size_t begin = 0;
+    while (begin < input.size() && is_space(input[begin]))
+    {
+        begin++;
+    }
+
+    size_t end = begin;
+    while (end < input.size() && !is_space(input[end]))
+    {
+        end++;
+    }
+    return (begin < input.size() && end < input.size()) || end_of_input;
+}
+
+bool FdIO::can_read_line(size_t max)
+{
+    std::string_view input = unread_input();
+    if (input.empty())
+    {
+        return end_of_input;
+    }
+    return input.size() >= max || input.find('\n') != std::string_view::npos || end_of_input;
+}
+
+struct EventLoop::Guest
+{
+    Scheduler::GuestId id = 0;
+    FdIO io;
+    int input_fd;
+    int output_fd;
+    Done done;
+    Machine* machine = nullptr;
+
+    // Пока гость спит, их трогает только поток ожидания, пока исполняется — только поток планировщика
+    bool input_added = false;           // в Poller; при input_fd == output_fd флаг общий
+    bool output_added = false;
+    bool waiting_output = false;
+    bool finishing = false;             // остановилась, осталось отдать вывод
+    CPU::RunStatus status = CPU::RunStatus::Running;
+
+    Guest(int input_fd, int output_fd, Done done)
+        : io(input_fd, output_fd), input_fd(input_fd), output_fd(output_fd), done(std::move(done))
+    {
+    }
+
+    bool& added(int fd) { return fd == input_fd ? input_added : output_added; }
+};
+
+EventLoop::EventLoop(const SchedulerOptions& options) : scheduler(options)
+{
+    int fds[2];
+    if (pipe(fds) < 0)
+    {
+        throw std::system_error(errno, std::generic_category(), "pipe");
+    }
+    wake_read = fds[0];
+    wake_write = fds[1];
+
+    try
+    {
+        set_nonblocking(wake_read);
+        set_nonblocking(wake_write);
+        poller = std::make_unique<Poller>(wake_read);
+    }
+    catch (...)
+    {
+        close(wake_read);
+        close(wake_write);
+        throw;
+    }
+}
+
+EventLoop::~EventLoop()
+{
+    poller.reset();
+    close(wake_read);
+    close(wake_write);
+}
+
+Scheduler::GuestId EventLoop::add(std::unique_ptr<Machine> machine, int input_fd, int output_fd, Done done, unsigned weight)
+{
+    if (weight == 0)
+    {
+        throw std::invalid_argument("Guest weight must be positive");
+    }
+    set_nonblocking(input_fd);
+    set_nonblocking(output_fd);
+
+    auto guest = std::make_unique<Guest>(input_fd, output_fd, std::move(done));
+    Guest* target = guest.get();
+    target->machine = machine.get();
+    machine->get_cpu().set_io(target->io);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        guests.push_back(std::move(guest));
+    }
+
+    // Гость может исполниться на другом потоке раньше, чем add() вернёт id,
+    // поэтому Pause запоминает id сам, до того как гость уснёт
+    live.fetch_add(1);
+    return scheduler.add(std::move(machine), weight,
+        [this, target](Scheduler::GuestId, Machine&, CPU::RunStatus status) { this->done(*target, status); },
+        [this, target](Scheduler::GuestId id, Machine& machine)
+        {
+            target->id = id;
+            return pause(*target, machine);
+        });
+}
+
+void EventLoop::run()
+{
+    stopping.store(false);
+    std::thread waiter([this] { serve(); });
+
+    scheduler.run();
+    {
+        // Остановившиеся гости могут ещё отдавать вывод
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return live.load() == 0; });
+    }
+
+    stopping.store(true);
+    wake();
+    waiter.join();
+}
+
+EventLoop::Stats EventLoop::get_stats() const
+{
+    Stats stats;
+    stats.guests = completed.load();
+    stats.quanta = scheduler.get_stats().quanta;
+    stats.input_waits = input_waits.load();
+    stats.output_waits = output_waits.load();
+    return stats;
+}
+
+bool EventLoop::pause(Guest& guest, Machine& machine)
+{
+    bool input_wait = machine.get_cpu().get_stop_reason() == CPU::StopReason::InputWait;
+
+    // Вывод уходит до ожидания ввода: гость мог напечатать приглашение
+    bool drained = guest.io.drain();
+    if (!drained && (input_wait || guest.io.output().size() >= BufferedIO::FLUSH_THRESHOLD))
+    {
+        return wait_output(guest);
+    }
+
+    if (input_wait && !guest.io.fill() && watch(guest, guest.input_fd, false))
+    {
+        input_waits++;
+        return true;
+    }
+    return false;
+}
+
+void EventLoop::done(Guest& guest, CPU::RunStatus status)
+{
+    guest.finishing = true;
+    guest.status = status;
+    if (guest.io.drain() || !wait_output(guest))
+    {
+        finish(guest);
+    }
+}
+
+// true — гость ждёт вывода, его разбудит поток ожидания
+bool EventLoop::wait_output(Guest& guest)
+{
+    guest.waiting_output = true;
+    output_waits++;
+    if (watch(guest, guest.output_fd, true))
+    {
+        return true;
+    }
+
+    // Обычный файл: запись не ждёт, пробуем снова в следующем кванте
+    guest.waiting_output = false;
+    return false;
+}
+
+bool EventLoop::watch(Guest& guest, int fd, bool output)
+{
+    if (!poller->watch(fd, output, &guest, guest.added(fd)))
+    {
+        return false;
+    }
+#if !defined(__linux__)
+    wake();
+#endif
+    return true;
+}
+
+// Поток ожидания: дескриптор гостя готов
+void EventLoop::ready(Guest& guest)
+{
+    if (guest.waiting_output)
+    {
+        if (!guest.io.drain() && watch(guest, guest.output_fd, true))
+        {
+            return;
+        }
+        guest.waiting_output = false;
+        if (guest.finishing)
+        {
+            finish(guest);
+            return;
+        }
+    }
+    else
+    {
+        guest.io.fill();
+    }
+    scheduler.wake(guest.id);
+}
+
+void EventLoop::finish(Guest& guest)
+{
+    poller->forget(guest.input_fd, guest.added(guest.input_fd));
+    poller->forget(guest.output_fd, guest.added(guest.output_fd));
+
+    if (guest.done)
+    {
+        guest.done(*guest.machine, guest.status);
+    }
+    completed++;
+
+    if (live.fetch_sub(1) == 1)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        finished.notify_all();
+    }
+}
+
+void EventLoop::serve()
+{
+    std::vector<void*> fired;
+
+    while (!stopping.load())
+    {
+        fired.clear();
+        poller->wait(-1, fired);
+
+        for (void* token : fired)
+        {
+            if (!token)
+            {
+                char bytes[64];
+                while (read(wake_read, bytes, sizeof(bytes)) > 0) {}
+                continue;
+            }
+            ready(*static_cast<Guest*>(token));
+        }
+    }
+}
+
+void EventLoop::wake()
+{
+    char byte = 0;
+    while (write(wake_write, &byte, 1) < 0 && errno == EINTR) {}
+}
@@ -0,0 +1,309 @@
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "assembler.hpp"
+#include "image.hpp"
+
+#if MEMORY_GUARD_PAGES
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Содержимое файла только для чтения: на POSIX — mmap, иначе — одно чтение в буфер
+    class FileView
+    {
+    public:
+        explicit FileView(const std::string& path)
+        {
+#if MEMORY_GUARD_PAGES
+            fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                throw std::runtime_error("Cannot open file: " + path);
+            }
+
+            struct stat info;
+            if (fstat(fd, &info) != 0)
+            {
+                close(fd);
+                throw std::runtime_error("Cannot stat file: " + path);
+            }
+
+            length = static_cast<size_t>(info.st_size);
+            if (length != 0)
+            {
+                void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapped == MAP_FAILED)
+                {
+                    close(fd);
+                    throw std::runtime_error("Cannot map file: " + path);
+                }
+                bytes = static_cast<const uint8_t*>(mapped);
+            }
+#else
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file.is_open())
+            {
+                throw std::runtime_error("Cannot open file: " + path);
+            }
+
+            buffer.resize(static_cast<size_t>(file.tellg()));
+            file.seekg(0);
+            file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+
+            bytes = buffer.data();
+            length = buffer.size();
+#endif
+        }
+
+        ~FileView()
+        {
+#if MEMORY_GUARD_PAGES
+            if (bytes)
+            {
+                munmap(const_cast<uint8_t*>(bytes), length);
+            }
+            close(fd);
+#endif
+        }
+
+        FileView(const FileView&) = delete;
+        FileView& operator=(const FileView&) = delete;
+
+        const uint8_t* data() const { return bytes; }
+        size_t size() const { return length; }
+
+        // Кладёт [offset, offset + size) файла в гостевую память по address:
+        // целые страницы отображаются, остаток копируется
+        void load(Memory& memory, uint64_t offset, uint32_t address, size_t size, LoadedImage& image) const
+        {
+            size_t mapped = 0;
+#if MEMORY_GUARD_PAGES
+            mapped = memory.map_file(fd, offset, address, size);
+#endif
+            memory.write_block(address + static_cast<uint32_t>(mapped), bytes + offset + mapped, size - mapped);
+
+            image.mapped_bytes += mapped;
+            image.copied_bytes += size - mapped;
+        }
+
+    private:
+        const uint8_t* bytes = nullptr;
+        size_t length = 0;
+#if MEMORY_GUARD_PAGES
+        int fd = -1;
+#else
+        std::vector<uint8_t> buffer;
+#endif
+    };
+
+    void check_fits(const Memory& memory, uint64_t address, uint64_t size, const std::string& path)
+    {
+        if (address + size > memory.size())
+        {
+            throw std::runtime_error("Program does not fit into guest memory: " + path);
+        }
+    }
+
+    void read_symbols(const FileView& file, const ImageHeader& header, LoadedImage& image, const std::string& path)
+    {
+        uint64_t entries_end = header.symbol_offset + uint64_t{header.symbol_count} * sizeof(ImageSymbolEntry);
+        if (entries_end > file.size())
+        {
+            throw std::runtime_error("Symbol table is out of file bounds: " + path);
+        }
+
+        const uint8_t* strings = file.data() + entries_end;
+        size_t strings_size = file.size() - entries_end;
+
+        image.symbols.reserve(header.symbol_count);
+        for (uint32_t i = 0; i < header.symbol_count; i++)
+        {
+            ImageSymbolEntry entry;
+            std::memcpy(&entry, file.data() + header.symbol_offset + i * sizeof(ImageSymbolEntry), sizeof(entry));
+
+            if (entry.name_offset >= strings_size)
+            {
+                throw std::runtime_error("Symbol name is out of file bounds: " + path);
+            }
+
+            const char* name = reinterpret_cast<const char*>(strings + entry.name_offset);
+            size_t name_length = strnlen(name, strings_size - entry.name_offset);
+            image.symbols.push_back({ entry.address, std::string(name, name_length) });
+        }
+    }
+}
+
+LoadedImage load_image(Memory& memory, const std::string& path, uint32_t load_address)
+{
+    LoadedImage image;
+
+    if (is_assembly_source(path))
+    {
+        // Исходный текст: собирается в памяти, код — по load_address
+        Assembly assembly = assemble_file(path, { load_address });
+        for (const ImageSegment& segment : assembly.segments)
+        {
+            check_fits(memory, segment.address, segment.memory_size, path);
+            memory.write_block(segment.address, segment.bytes.data(), segment.bytes.size());
+            memory.zero(segment.address + segment.file_size, segment.memory_size - segment.file_size);
+
+            image.copied_bytes += segment.file_size;
+            image.segments.push_back({ segment.kind, segment.address, segment.file_size, segment.memory_size, {} });
+        }
+        image.entry = assembly.entry;
+        image.symbols = std::move(assembly.symbols);
+        return image;
+    }
+
+    FileView file(path);
+
+    if (file.size() < sizeof(ImageHeader) || std::memcmp(file.data(), IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0)
+    {
+        // Сырой код: один сегмент по load_address, точка входа — его начало
+        uint32_t size = static_cast<uint32_t>(file.size() & ~size_t{3});
+        check_fits(memory, load_address, size, path);
+        file.load(memory, 0, load_address, size, image);
+
+        image.entry = load_address;
+        image.raw = true;
+        image.segments.push_back({ SegmentKind::Code, load_address, size, size, {} });
+        return image;
+    }
+
+    ImageHeader header;
+    std::memcpy(&header, file.data(), sizeof(header));
+
+    if (header.version != IMAGE_VERSION)
+    {
+        throw std::runtime_error("Unsupported image version in " + path);
+    }
+
+    uint64_t table_end = sizeof(ImageHeader) + uint64_t{header.segment_count} * sizeof(SegmentHeader);
+    if (table_end > file.size())
+    {
+        throw std::runtime_error("Segment table is out of file bounds: " + path);
+    }
+
+    image.entry = header.entry;
+    image.segments.reserve(header.segment_count);
+
+    for (uint16_t i = 0; i < header.segment_count; i++)
+    {
+        SegmentHeader segment;
+        std::memcpy(&segment, file.data() + sizeof(ImageHeader) + i * sizeof(SegmentHeader), sizeof(segment));
+
+        if (segment.kind == SegmentKind::Bss)
+        {
+            segment.file_size = 0;
+        }
+
+        if (segment.memory_size < segment.file_size ||
+            uint64_t{segment.file_offset} + segment.file_size > file.size())
+        {
+            throw std::runtime_error("Malformed segment in " + path);
+        }
+        check_fits(memory, segment.address, segment.memory_size, path);
+
+        file.load(memory, segment.file_offset, segment.address, segment.file_size, image);
+        memory.zero(segment.address + segment.file_size, segment.memory_size - segment.file_size);
+
+        image.segments.push_back({ segment.kind, segment.address, segment.file_size, segment.memory_size, {} });
+    }
+
+    if (header.symbol_offset != 0)
+    {
+        read_symbols(file, header, image, path);
+    }
+
+    return image;
+}
+
+void save_image(const std::string& path, uint32_t entry,
+                const std::vector<ImageSegment>& segments,
+                const std::vector<ImageSymbol>& symbols)
+{
+    auto align = [](uint64_t value) { return (value + IMAGE_ALIGNMENT - 1) & ~uint64_t{IMAGE_ALIGNMENT - 1}; };
+
+    ImageHeader header{};
+    std::memcpy(header.magic, IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+    header.version = IMAGE_VERSION;
+    header.segment_count = static_cast<uint16_t>(segments.size());
+    header.entry = entry;
+
+    std::vector<SegmentHeader> table;
+    uint64_t offset = align(sizeof(ImageHeader) + segments.size() * sizeof(SegmentHeader));
+
+    for (const ImageSegment& segment : segments)
+    {
+        SegmentHeader entry_header{};
+        entry_header.kind = segment.kind;
+        entry_header.address = segment.address;
+        entry_header.file_size = segment.kind == SegmentKind::Bss ? 0 : static_cast<uint32_t>(segment.bytes.size());
+        entry_header.memory_size = std::max(segment.memory_size, entry_header.file_size);
+        entry_header.file_offset = entry_header.file_size ? static_cast<uint32_t>(offset) : 0;
+
+        offset = align(offset + entry_header.file_size);
+        table.push_back(entry_header);
+    }
+
+    if (!symbols.empty())
+    {
+        header.symbol_offset = static_cast<uint32_t>(offset);
+        header.symbol_count = static_cast<uint32_t>(symbols.size());
+    }
+
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Cannot create file: " + path);
+    }
+
+    auto pad_to = [&file](uint64_t position)
+    {
+        static const char zeros[IMAGE_ALIGNMENT] = {};
+        uint64_t current = static_cast<uint64_t>(file.tellp());
+        file.write(zeros, static_cast<std::streamsize>(position - current));
+    };
+
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(SegmentHeader));
+
+    for (size_t i = 0; i < segments.size(); i++)
+    {
+        if (table[i].file_size == 0)
+        {
+            continue;
+        }
+        pad_to(table[i].file_offset);
+        file.write(reinterpret_cast<const char*>(segments[i].bytes.data()), table[i].file_size);
+    }
+
+    if (!symbols.empty())
+    {
+        pad_to(header.symbol_offset);
+
+        uint32_t name_offset = 0;
+        for (const ImageSymbol& symbol : symbols)
+        {
+            ImageSymbolEntry symbol_entry{ symbol.address, name_offset };
+            file.write(reinterpret_cast<const char*>(&symbol_entry), sizeof(symbol_entry));
+            name_offset += static_cast<uint32_t>(symbol.name.size() + 1);
+        }
+        for (const ImageSymbol& symbol : symbols)
+        {
+            file.write(symbol.name.c_str(), symbol.name.size() + 1);
+        }
+    }
+
+    if (!file)
+    {
+        throw std::runtime_error("Cannot write image: " + path);
+    }
+}
@@ -0,0 +1,1073 @@
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+#include "bitops.hpp"
+#include "cpu.hpp"
+#include "jit.hpp"
+#include "memory.hpp"
+
+#if CPU_JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+namespace
+{
+    constexpr size_t CODE_BUFFER_SIZE = 16 * 1024 * 1024;
+    constexpr uint32_t PAGE_SHIFT = 12;
+
+    // Вызовы из сгенерированного кода. Ошибок не бросают: при выходе за
+    // границы блок возвращает BAILOUT и инструкцию повторяет интерпретатор.
+    // Статус записи: 0 — ок, 1 — выход за границы, 2 — запись попала в код блоков
+
+    uint64_t jit_load(Memory* memory, uint32_t addr)
+    {
+        if (uint64_t{addr} + 4 > memory->size())
+        {
+            return uint64_t{1} << 32;
+        }
+        return memory->read<uint32_t>(addr);
+    }
+
+    uint32_t jit_store(CPU* cpu, Memory* memory, uint32_t addr, uint32_t value)
+    {
+        if ((addr & 0x3) != 0)
+        {
+            return 0;
+        }
+        if (uint64_t{addr} + 4 > memory->size())
+        {
+            return 1;
+        }
+
+        memory->write<uint32_t>(addr, value);
+        return cpu->invalidate_code(addr, 4) ? 2 : 0;
+    }
+
+    uint32_t jit_store_pair(CPU* cpu, Memory* memory, uint32_t addr, uint32_t first, uint32_t second)
+    {
+        if (uint64_t{addr} + 4 > memory->size())
+        {
+            return 1;
+        }
+        memory->write<uint32_t>(addr, first);
+
+        if (uint64_t{addr + 4} + 4 > memory->size())
+        {
+            return 1;
+        }
+        memory->write<uint32_t>(addr + 4, second);
+
+        return cpu->invalidate_code(addr, 8) ? 2 : 0;
+    }
+
+    uint32_t jit_vector_load(Memory* memory, uint32_t addr, VectorRegister* dst)
+    {
+        if (uint64_t{addr} + sizeof(VectorRegister) > memory->size())
+        {
+            return 1;
+        }
+        *dst = memory->read<VectorRegister>(addr);
+        return 0;
+    }
+
+    uint32_t jit_vector_store(CPU* cpu, Memory* memory, uint32_t addr, const VectorRegister* src)
+    {
+        if (uint64_t{addr} + sizeof(VectorRegister) > memory->size())
+        {
+            return 1;
+        }
+
+        memory->write<VectorRegister>(addr, *src);
+        return cpu->invalidate_code(addr, sizeof(VectorRegister)) ? 2 : 0;
+    }
+
+    enum Reg : uint8_t
+    {
+        RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+        R8,  R9,  R10, R11, R12, R13, R14, R15
+    };
+
+    enum Cond : uint8_t
+    {
+        CC_B  = 0x2,
+        CC_E  = 0x4,
+        CC_NE = 0x5,
+        CC_L  = 0xC,
+        CC_G  = 0xF
+    };
+
+    // Минимальный кодировщик x86-64: только то, что нужно трансляции блоков
+    class Emitter
+    {
+    public:
+        std::vector<uint8_t> code;
+
+        size_t pos() const { return code.size(); }
+
+        void byte(uint8_t b) { code.push_back(b); }
+
+        void u32(uint32_t v)
+        {
+            for (int i = 0; i < 4; i++) byte(static_cast<uint8_t>(v >> (8 * i)));
+        }
+
+        void u64(uint64_t v)
+        {
+            for (int i = 0; i < 8; i++) byte(static_cast<uint8_t>(v >> (8 * i)));
+        }
+
+        void patch(size_t at, size_t target)
+        {
+            int32_t rel = static_cast<int32_t>(static_cast<int64_t>(target) - static_cast<int64_t>(at + 4));
+            std::memcpy(&code[at], &rel, 4);
+        }
+
+        void rex(bool w, uint8_t reg, uint8_t rm)
+        {
+            uint8_t prefix = 0x40 | (w << 3) | ((reg >> 3) << 2) | (rm >> 3);
+            if (prefix != 0x40) byte(prefix);
+        }
+
+        void modrm_rr(uint8_t reg, uint8_t rm) { byte(0xC0 | ((reg & 7) << 3) | (rm & 7)); }
+
+        // op r/m, reg
+        void rr(uint8_t op, uint8_t reg, uint8_t rm, bool w = false)
+        {
+            rex(w, reg, rm);
+            byte(op);
+            modrm_rr(reg, rm);
+        }
+
+        void mov(uint8_t dst, uint8_t src)   { rr(0x89, src, dst); }
+        void mov64(uint8_t dst, uint8_t src) { rr(0x89, src, dst, true); }
+        void add(uint8_t dst, uint8_t src)   { rr(0x01, src, dst); }
+        void sub(uint8_t dst, uint8_t src)   { rr(0x29, src, dst); }
+        void xor_(uint8_t dst, uint8_t src)  { rr(0x31, src, dst); }
+        void cmp(uint8_t a, uint8_t b)       { rr(0x39, b, a); }
+        void test(uint8_t a, uint8_t b)      { rr(0x85, b, a); }
+
+        // mov reg, [rbx + disp32] / mov [rbx + disp32], reg
+        void load_rbx(uint8_t dst, uint32_t disp)
+        {
+            rex(false, dst, RBX);
+            byte(0x8B);
+            byte(0x80 | ((dst & 7) << 3) | RBX);
+            u32(disp);
+        }
+
+        void store_rbx(uint32_t disp, uint8_t src)
+        {
+            rex(false, src, RBX);
+            byte(0x89);
+            byte(0x80 | ((src & 7) << 3) | RBX);
+            u32(disp);
+        }
+
+        // 64-битные mov reg, [rsp + disp8] / mov [rsp + disp8], reg
+        void load_rsp64(uint8_t dst, uint8_t disp)
+        {
+            rex(true, dst, RSP);
+            byte(0x8B);
+            byte(0x40 | ((dst & 7) << 3) | RSP);
+            byte(0x24);
+            byte(disp);
+        }
+
+        // cmp reg, qword [rsp + disp8]
+        void cmp_rsp64(uint8_t reg, uint8_t disp)
+        {
+            rex(true, reg, RSP);
+            byte(0x3B);
+            byte(0x40 | ((reg & 7) << 3) | RSP);
+            byte(0x24);
+            byte(disp);
+        }
+
+        void store_rsp64(uint8_t disp, uint8_t src)
+        {
+            rex(true, src, RSP);
+            byte(0x89);
+            byte(0x40 | ((src & 7) << 3) | RSP);
+            byte(0x24);
+            byte(disp);
+        }
+
+        void mov_imm(uint8_t dst, uint32_t imm)
+        {
+            rex(false, 0, dst);
+            byte(0xB8 + (dst & 7));
+            u32(imm);
+        }
+
+        void mov_imm64(uint8_t dst, uint64_t imm)
+        {
+            rex(true, 0, dst);
+            byte(0xB8 + (dst & 7));
+            u64(imm);
+        }
+
+        void add64_imm(uint8_t dst, int32_t imm)
+        {
+            rex(true, 0, dst);
+            byte(0x81);
+            modrm_rr(0, dst);
+            u32(static_cast<uint32_t>(imm));
+        }
+
+        // add qword [base], src; base — не RSP/RBP/R12/R13
+        void add_mem64(uint8_t base, uint8_t src)
+        {
+            rex(true, src, base);
+            byte(0x01);
+            byte(((src & 7) << 3) | (base & 7));
+        }
+
+        void add_imm(uint8_t dst, uint32_t imm)
+        {
+            rex(false, 0, dst);
+            byte(0x81);
+            modrm_rr(0, dst);
+            u32(imm);
+        }
+
+        void or_imm8(uint8_t dst, uint8_t imm)
+        {
+            rex(false, 0, dst);
+            byte(0x83);
+            modrm_rr(1, dst);
+            byte(imm);
+        }
+
+        void cmp_imm8(uint8_t dst, uint8_t imm)
+        {
+            rex(false, 0, dst);
+            byte(0x83);
+            modrm_rr(7, dst);
+            byte(imm);
+        }
+
+        void sar_imm(uint8_t dst, uint8_t n)
+        {
+            rex(false, 0, dst);
+            byte(0xC1);
+            modrm_rr(7, dst);
+            byte(n);
+        }
+
+        void shr64_imm(uint8_t dst, uint8_t n)
+        {
+            rex(true, 0, dst);
+            byte(0xC1);
+            modrm_rr(5, dst);
+            byte(n);
+        }
+
+        void bsr(uint8_t dst, uint8_t src)
+        {
+            rex(false, dst, src);
+            byte(0x0F);
+            byte(0xBD);
+            modrm_rr(dst, src);
+        }
+
+        // pext dst, value, mask (BMI2, VEX.LZ.F3.0F38.W0 F5 /r): value в vvvv, mask в r/m
+        void pext(uint8_t dst, uint8_t value, uint8_t mask)
+        {
+            byte(0xC4);
+            byte(static_cast<uint8_t>(((~dst >> 3) & 1) << 7 | 1 << 6 | ((~mask >> 3) & 1) << 5 | 0x02));
+            byte(static_cast<uint8_t>((~value & 0xF) << 3 | 0x02));
+            byte(0xF5);
+            modrm_rr(dst, mask);
+        }
+
+        // SSE2 над xmm0..xmm7 (без REX): prefix 0F op /r, reg-reg
+        void sse(uint8_t prefix, uint8_t op, uint8_t xmm, uint8_t rm)
+        {
+            byte(prefix);
+            byte(0x0F);
+            byte(op);
+            modrm_rr(xmm, rm);
+        }
+
+        // То же с непосредственным байтом: pshufd, сдвиги (ext — поле reg)
+        void sse_imm(uint8_t op, uint8_t xmm, uint8_t rm, uint8_t imm)
+        {
+            sse(0x66, op, xmm, rm);
+            byte(imm);
+        }
+
+        // movdqu xmm, [rdx + disp32] / movdqu [rdx + disp32], xmm
+        void movdqu_load(uint8_t xmm, uint32_t disp)
+        {
+            byte(0xF3);
+            byte(0x0F);
+            byte(0x6F);
+            byte(0x80 | ((xmm & 7) << 3) | RDX);
+            u32(disp);
+        }
+
+        void movdqu_store(uint32_t disp, uint8_t xmm)
+        {
+            byte(0xF3);
+            byte(0x0F);
+            byte(0x7F);
+            byte(0x80 | ((xmm & 7) << 3) | RDX);
+            u32(disp);
+        }
+
+        void cmov(Cond cc, uint8_t dst, uint8_t src)
+        {
+            rex(false, dst, src);
+            byte(0x0F);
+            byte(0x40 + cc);
+            modrm_rr(dst, src);
+        }
+
+        void push(uint8_t r)
+        {
+            rex(false, 0, r);
+            byte(0x50 + (r & 7));
+        }
+
+        void pop(uint8_t r)
+        {
+            rex(false, 0, r);
+            byte(0x58 + (r & 7));
+        }
+
+        void sub_rsp(uint8_t imm) { byte(0x48); byte(0x83); byte(0xEC); byte(imm); }
+        void add_rsp(uint8_t imm) { byte(0x48); byte(0x83); byte(0xC4); byte(imm); }
+
+        void call(const void* fn)
+        {
+            mov_imm64(RAX, reinterpret_cast<uint64_t>(fn));
+            byte(0xFF);
+            byte(0xD0);
+        }
+
+        void ret() { byte(0xC3); }
+
+        // Возвращают позицию rel32 для последующего patch()
+        size_t jmp()
+        {
+            byte(0xE9);
+            u32(0);
+            return pos() - 4;
+        }
+
+        size_t jcc(Cond cc)
+        {
+            byte(0x0F);
+            byte(0x80 + cc);
+            u32(0);
+            return pos() - 4;
+        }
+    };
+
+    // Коды SSE2 (префикс 66)
+    enum Sse : uint8_t
+    {
+        SSE_MOVD_TO   = 0x6E,   // movd xmm, r32
+        SSE_MOVDQA    = 0x6F,
+        SSE_PSHUFD    = 0x70,
+        SSE_SHIFT_D   = 0x72,   // /2 psrld, /4 psrad
+        SSE_PCMPGTD   = 0x66,
+        SSE_PCMPEQD   = 0x76,
+        SSE_MOVD_FROM = 0x7E,   // movd r32, xmm
+        SSE_PAND      = 0xDB,
+        SSE_PANDN     = 0xDF,
+        SSE_POR       = 0xEB,
+        SSE_PXOR      = 0xEF,
+        SSE_PSUBD     = 0xFA,
+        SSE_PADDD     = 0xFE
+    };
+
+    constexpr uint8_t XMM0 = 0, XMM1 = 1, XMM2 = 2, XMM3 = 3;
+
+    // Регистры-кандидаты для гостевых регистров: callee-saved, переживают вызовы помощников
+    constexpr std::array<uint8_t, 5> HOST_POOL = { RBP, R12, R13, R14, R15 };
+
+    // Счётчик выполненных инструкций блока; caller-saved, сохраняется на стеке вокруг вызовов
+    constexpr uint8_t RETIRED = R10;
+
+    constexpr uint8_t STACK_MEMORY  = 0;
+    constexpr uint8_t STACK_CPU     = 8;
+    constexpr uint8_t STACK_RETIRED = 16;   // uint64_t* retired
+    constexpr uint8_t STACK_COUNT   = 24;   // RETIRED на время вызова помощника
+    constexpr uint8_t STACK_BUDGET  = 32;   // uint64_t budget
+    constexpr uint8_t STACK_VECTORS = 40;   // VectorRegister* vr
+    constexpr uint8_t FRAME_SIZE    = 56;   // 8 (адрес возврата) + 6 push + 56 = выравнивание на 16
+}
+
+Jit::Jit() = default;
+
+Jit::~Jit()
+{
+#if CPU_JIT_SUPPORTED
+    if (code_buffer)
+    {
+        munmap(code_buffer, code_capacity);
+    }
+#endif
+}
+
+void Jit::clear()
+{
+    blocks.clear();
+    counters.clear();
+    page_blocks.clear();
+    smc_pages.clear();
+    code_used = 0;
+    code_lo = UINT64_MAX;
+    code_hi = 0;
+}
+
+bool Jit::invalidate_slow(uint32_t addr, uint32_t size)
+{
+    uint64_t end = addr + uint64_t{size};
+    bool hit = false;
+
+    for (uint64_t page = addr >> PAGE_SHIFT; page <= (end - 1) >> PAGE_SHIFT; page++)
+    {
+        auto it = page_blocks.find(static_cast<uint32_t>(page));
+        if (it == page_blocks.end())
+        {
+            continue;
+        }
+
+        for (uint32_t start : it->second)
+        {
+            auto block = blocks.find(start);
+            if (block == blocks.end())
+            {
+                continue;
+            }
+
+            if (addr < block->second.end && end > block->second.start)
+            {
+                // Код блока не освобождается: запись могла прийти из него самого
+                blocks.erase(block);
+                stats.invalidations++;
+                hit = true;
+            }
+        }
+
+        if (hit)
+        {
+            smc_pages.insert(static_cast<uint32_t>(page));
+        }
+    }
+    return hit;
+}
+
+Jit::BlockFn Jit::compile(uint32_t pc, const Memory& memory)
+{
+#if !CPU_JIT_SUPPORTED
+    (void)pc;
+    (void)memory;
+    return nullptr;
+#else
+    if ((pc & 0x3) != 0)
+    {
+        return nullptr;
+    }
+
+    if (!code_buffer)
+    {
+        void* buffer = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer == MAP_FAILED)
+        {
+            return nullptr;
+        }
+        code_buffer = static_cast<uint8_t*>(buffer);
+        code_capacity = CODE_BUFFER_SIZE;
+    }
+
+    using Instruction = CPU::Instruction;
+
+    // Границы блока
+    std::vector<Instruction> instrs;
+    uint32_t addr = pc;
+
+    while (instrs.size() < MAX_BLOCK_INSTRUCTIONS && uint64_t{addr} + 4 <= memory.size() && addr < 0xFFFFFFFC)
+    {
+        if (smc_pages.count(addr >> PAGE_SHIFT))
+        {
+            break;
+        }
+
+        Instruction instr(memory.read<uint32_t>(addr));
+
+        // Атомарные операции и барьер исполняет интерпретатор
+        if (instr.handler == CPU::H_SYSCALL ||
+            instr.handler == CPU::H_CAS ||
+            instr.handler == CPU::H_FENCE ||
+            instr.handler == CPU::H_UNKNOWN_FUNCT ||
+            instr.handler == CPU::H_UNKNOWN_OPCODE)
+        {
+            break;
+        }
+
+        instrs.push_back(instr);
+        addr += 4;
+
+        if (instr.handler == CPU::H_J)
+        {
+            break;
+        }
+    }
+
+    if (instrs.empty())
+    {
+        return nullptr;
+    }
+
+    uint32_t end_pc = pc + static_cast<uint32_t>(instrs.size()) * 4;
+
+    // Какие гостевые регистры читаются/пишутся
+    std::array<uint32_t, 32> uses{};
+    std::array<bool, 32> written{};
+
+    for (const Instruction& instr : instrs)
+    {
+        switch (instr.handler)
+        {
+            case CPU::H_ADD:
+            case CPU::H_SUB:
+                uses[instr.rd]++; uses[instr.rs1]++; uses[instr.rs2]++;
+                written[instr.rs2] = true;
+                break;
+            case CPU::H_ADDI:
+            case CPU::H_LD:
+                uses[instr.rd]++; uses[instr.rs1]++;
+                written[instr.rs1] = true;
+                break;
+            case CPU::H_CLS:
+            case CPU::H_SSAT:
+                uses[instr.rs1]++; uses[instr.rd]++;
+                written[instr.rd] = true;
+                break;
+            case CPU::H_BEXT:
+                uses[instr.rs1]++; uses[instr.rs2]++; uses[instr.rd]++;
+                written[instr.rd] = true;
+                break;
+            case CPU::H_SBIT:
+                uses[instr.rd]++;
+                written[instr.rd] = true;
+                break;
+            case CPU::H_ST:
+            case CPU::H_BNE:
+            case CPU::H_BEQ:
+                uses[instr.rd]++; uses[instr.rs1]++;
+                break;
+            case CPU::H_STP:
+                uses[instr.rd]++; uses[instr.rs1]++; uses[instr.rs2]++;
+                break;
+            case CPU::H_VLD:
+            case CPU::H_VST:
+                uses[instr.rd]++;
+                break;
+            case CPU::H_VSPLAT:
+                uses[instr.rs1]++;
+                break;
+            case CPU::H_VREDSUM:
+                uses[instr.rd]++;
+                written[instr.rd] = true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    // Самые используемые регистры получают host-регистры
+    std::array<int, 32> host{};
+    host.fill(-1);
+    {
+        std::array<uint8_t, 32> order;
+        for (uint8_t i = 0; i < 32; i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(),
+                         [&](uint8_t a, uint8_t b) { return uses[a] > uses[b]; });
+
+        for (size_t i = 0; i < HOST_POOL.size() && uses[order[i]] > 0; i++)
+        {
+            host[order[i]] = HOST_POOL[i];
+        }
+    }
+
+    Emitter e;
+
+    auto load = [&](uint8_t dst, uint8_t guest)
+    {
+        if (host[guest] >= 0) e.mov(dst, static_cast<uint8_t>(host[guest]));
+        else e.load_rbx(dst, guest * 4u);
+    };
+
+    auto store = [&](uint8_t guest, uint8_t src)
+    {
+        if (host[guest] >= 0) e.mov(static_cast<uint8_t>(host[guest]), src);
+        else e.store_rbx(guest * 4u, src);
+    };
+
+    // Счёт ведётся по участкам: в начале каждого участка (вход, цель внутреннего
+    // перехода, продолжение после условного перехода) к RETIRED прибавляется его длина,
+    // ранний выход из середины участка вычитает невыполненный хвост
+    std::vector<bool> leader(instrs.size(), false);
+    leader[0] = true;
+    for (size_t i = 0; i < instrs.size(); i++)
+    {
+        const Instruction& instr = instrs[i];
+        uint32_t ipc = pc + static_cast<uint32_t>(i) * 4;
+        uint32_t target;
+
+        if (instr.handler == CPU::H_BNE || instr.handler == CPU::H_BEQ)
+        {
+            target = ipc + static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(instr.imm)) * 4);
+            if (i + 1 < instrs.size()) leader[i + 1] = true;
+        }
+        else if (instr.handler == CPU::H_J)
+        {
+            target = (ipc & 0xFFFFF000) | (instr.target << 2);
+        }
+        else
+        {
+            continue;
+        }
+
+        if (target >= pc && target < end_pc && (target & 0x3) == 0)
+        {
+            leader[(target - pc) / 4] = true;
+        }
+    }
+
+    std::vector<size_t> segment_end(instrs.size());
+    for (size_t i = instrs.size(); i-- > 0;)
+    {
+        segment_end[i] = (i + 1 == instrs.size() || leader[i + 1]) ? i + 1 : segment_end[i + 1];
+    }
+
+    auto call = [&](const void* fn)
+    {
+        e.store_rsp64(STACK_COUNT, RETIRED);
+        e.call(fn);
+        e.load_rsp64(RETIRED, STACK_COUNT);
+    };
+
+    // Пролог: rdi = gpr, rsi = Memory*, rdx = CPU*, rcx = uint64_t* retired, r8 = budget, r9 = vr
+    e.push(RBX);
+    e.push(RBP);
+    e.push(R12);
+    e.push(R13);
+    e.push(R14);
+    e.push(R15);
+    e.sub_rsp(FRAME_SIZE);
+    e.mov64(RBX, RDI);
+    e.store_rsp64(STACK_MEMORY, RSI);
+    e.store_rsp64(STACK_CPU, RDX);
+    e.store_rsp64(STACK_RETIRED, RCX);
+    e.store_rsp64(STACK_BUDGET, R8);
+    e.store_rsp64(STACK_VECTORS, R9);
+    e.xor_(RETIRED, RETIRED);
+
+    for (uint8_t g = 0; g < 32; g++)
+    {
+        if (host[g] >= 0) e.load_rbx(static_cast<uint8_t>(host[g]), g * 4u);
+    }
+
+    struct Exit
+    {
+        size_t fixup;
+        uint64_t result;
+        uint32_t unexecuted;    // инструкции участка, которые не выполнились
+    };
+
+    struct StoreExit
+    {
+        size_t fixup;
+        uint32_t pc;
+        uint32_t unexecuted;    // считая саму запись
+    };
+
+    std::vector<size_t> labels(instrs.size());
+    std::vector<std::pair<size_t, size_t>> internal;    // fixup -> индекс инструкции
+    std::vector<std::pair<size_t, size_t>> back_edges;  // то же для переходов назад
+    std::vector<Exit> exits;
+    std::vector<StoreExit> store_exits;
+    std::vector<size_t> to_epilogue;
+
+    auto branch_to = [&](size_t fixup, uint32_t target, uint32_t branch_pc)
+    {
+        if (target >= pc && target < end_pc && (target & 0x3) == 0)
+        {
+            size_t index = (target - pc) / 4;
+            if (target <= branch_pc)
+            {
+                back_edges.push_back({fixup, index});
+            }
+            else
+            {
+                internal.push_back({fixup, index});
+            }
+        }
+        else
+        {
+            exits.push_back({fixup, target, 0});
+        }
+    };
+
+    for (size_t i = 0; i < instrs.size(); i++)
+    {
+        const Instruction& instr = instrs[i];
+        uint32_t ipc = pc + static_cast<uint32_t>(i) * 4;
+        uint32_t tail = static_cast<uint32_t>(segment_end[i] - i);
+        labels[i] = e.pos();
+
+        if (leader[i])
+        {
+            e.add64_imm(RETIRED, tail);
+        }
+
+        switch (instr.handler)
+        {
+            case CPU::H_ADD:
+            case CPU::H_SUB:
+                load(RAX, instr.rd);
+                load(RCX, instr.rs1);
+                if (instr.handler == CPU::H_ADD) e.add(RAX, RCX);
+                else e.sub(RAX, RCX);
+                store(instr.rs2, RAX);
+                break;
+
+            case CPU::H_ADDI:
+                load(RAX, instr.rd);
+                e.add_imm(RAX, static_cast<uint32_t>(instr.imm));
+                store(instr.rs1, RAX);
+                break;
+
+            case CPU::H_SBIT:
+                e.mov_imm(RAX, 1u << instr.rs2);
+                store(instr.rd, RAX);
+                break;
+
+            case CPU::H_SSAT:
+                if (instr.rs2 == 0)
+                {
+                    e.mov_imm(RAX, 0);
+                }
+                else
+                {
+                    int32_t max_positive = (1 << (instr.rs2 - 1)) - 1;
+                    int32_t min_negative = -(1 << (instr.rs2 - 1));
+
+                    load(RAX, instr.rs1);
+                    e.mov_imm(RCX, static_cast<uint32_t>(max_positive));
+                    e.cmp(RAX, RCX);
+                    e.cmov(CC_G, RAX, RCX);
+                    e.mov_imm(RCX, static_cast<uint32_t>(min_negative));
+                    e.cmp(RAX, RCX);
+                    e.cmov(CC_L, RAX, RCX);
+                }
+                store(instr.rd, RAX);
+                break;
+
+            case CPU::H_CLS:
+                // x = v ^ (v >> 31); CLS = 32 - bsr((x << 1) | 1)
+                load(RAX, instr.rs1);
+                e.mov(RCX, RAX);
+                e.sar_imm(RCX, 31);
+                e.xor_(RAX, RCX);
+                e.add(RAX, RAX);
+                e.or_imm8(RAX, 1);
+                e.bsr(RAX, RAX);
+                e.mov_imm(RCX, 32);
+                e.sub(RCX, RAX);
+                store(instr.rd, RCX);
+                break;
+
+            case CPU::H_BEXT:
+                // С быстрым BMI2 — pext на месте, иначе вызов выбранной реализации
+                if (std::strcmp(bit_extract->name, "pext") == 0)
+                {
+                    load(RAX, instr.rs1);
+                    load(RCX, instr.rs2);
+                    e.pext(RAX, RAX, RCX);
+                    store(instr.rd, RAX);
+                }
+                else
+                {
+                    load(RDI, instr.rs1);
+                    load(RSI, instr.rs2);
+                    call(reinterpret_cast<const void*>(bit_extract->extract));
+                    store(instr.rd, RAX);
+                }
+                break;
+
+            case CPU::H_LD:
+                load(RSI, instr.rd);
+                e.add_imm(RSI, static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(instr.imm))));
+                e.load_rsp64(RDI, STACK_MEMORY);
+                call(reinterpret_cast<const void*>(&jit_load));
+                e.mov64(RDX, RAX);
+                e.shr64_imm(RDX, 32);
+                e.test(RDX, RDX);
+                exits.push_back({e.jcc(CC_NE), ipc | BAILOUT, tail});
+                store(instr.rs1, RAX);
+                break;
+
+            case CPU::H_ST:
+                load(RDX, instr.rd);
+                e.add_imm(RDX, static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(instr.imm))));
+                load(RCX, instr.rs1);
+                e.load_rsp64(RDI, STACK_CPU);
+                e.load_rsp64(RSI, STACK_MEMORY);
+                call(reinterpret_cast<const void*>(&jit_store));
+                e.test(RAX, RAX);
+                store_exits.push_back({e.jcc(CC_NE), ipc, tail});
+                break;
+
+            case CPU::H_STP:
+                load(RDX, instr.rd);
+                e.add_imm(RDX, static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(instr.offset))));
+                load(RCX, instr.rs1);
+                load(R8, instr.rs2);
+                e.load_rsp64(RDI, STACK_CPU);
+                e.load_rsp64(RSI, STACK_MEMORY);
+                call(reinterpret_cast<const void*>(&jit_store_pair));
+                e.test(RAX, RAX);
+                store_exits.push_back({e.jcc(CC_NE), ipc, tail});
+                break;
+
+            case CPU::H_VLD:
+                load(RSI, instr.rd);
+                e.add_imm(RSI, static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(instr.imm))));
+                e.load_rsp64(RDX, STACK_VECTORS);
+                e.add64_imm(RDX, instr.rs1 * 16);
+                e.load_rsp64(RDI, STACK_MEMORY);
+                call(reinterpret_cast<const void*>(&jit_vector_load));
+                e.test(RAX, RAX);
+                exits.push_back({e.jcc(CC_NE), ipc | BAILOUT, tail});
+                break;
+
+            case CPU::H_VST:
+                load(RDX, instr.rd);
+                e.add_imm(RDX, static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(instr.imm))));
+                e.load_rsp64(RCX, STACK_VECTORS);
+                e.add64_imm(RCX, instr.rs1 * 16);
+                e.load_rsp64(RDI, STACK_CPU);
+                e.load_rsp64(RSI, STACK_MEMORY);
+                call(reinterpret_cast<const void*>(&jit_vector_store));
+                e.test(RAX, RAX);
+                store_exits.push_back({e.jcc(CC_NE), ipc, tail});
+                break;
+
+            // Векторные операции — SSE2 на месте, rdx = vr
+            case CPU::H_VADD:
+            case CPU::H_VSUB:
+                e.load_rsp64(RDX, STACK_VECTORS);
+                e.movdqu_load(XMM0, instr.rs1 * 16u);
+                e.movdqu_load(XMM1, instr.rs2 * 16u);
+                e.sse(0x66, instr.handler == CPU::H_VADD ? SSE_PADDD : SSE_PSUBD, XMM0, XMM1);
+                e.movdqu_store(instr.rd * 16u, XMM0);
+                break;
+
+            case CPU::H_VADDS:
+                // sum = a + b; переполнение: знак (a ^ sum) & (b ^ sum);
+                // тогда (a >> 31) ^ INT32_MAX
+                e.load_rsp64(RDX, STACK_VECTORS);
+                e.movdqu_load(XMM0, instr.rs1 * 16u);
+                e.movdqu_load(XMM1, instr.rs2 * 16u);
+                e.sse(0x66, SSE_MOVDQA, XMM2, XMM0);
+                e.sse(0x66, SSE_PADDD, XMM2, XMM1);
+                e.sse(0x66, SSE_PXOR, XMM1, XMM2);
+                e.sse(0x66, SSE_MOVDQA, XMM3, XMM0);
+                e.sse(0x66, SSE_PXOR, XMM3, XMM2);
+                e.sse(0x66, SSE_PAND, XMM1, XMM3);
+                e.sse_imm(SSE_SHIFT_D, 4, XMM1, 31);
+                e.sse_imm(SSE_SHIFT_D, 4, XMM0, 31);
+                e.sse(0x66, SSE_PCMPEQD, XMM3, XMM3);
+                e.sse_imm(SSE_SHIFT_D, 2, XMM3, 1);
+                e.sse(0x66, SSE_PXOR, XMM0, XMM3);
+                e.sse(0x66, SSE_PAND, XMM0, XMM1);
+                e.sse(0x66, SSE_PANDN, XMM1, XMM2);
+                e.sse(0x66, SSE_POR, XMM0, XMM1);
+                e.movdqu_store(instr.rd * 16u, XMM0);
+                break;
+
+            case CPU::H_VSSAT:
+                e.load_rsp64(RDX, STACK_VECTORS);
+                if (instr.rs2 == 0)
+                {
+                    e.sse(0x66, SSE_PXOR, XMM0, XMM0);
+                    e.movdqu_store(instr.rd * 16u, XMM0);
+                }
+                else
+                {
+                    int32_t max_positive = (1 << (instr.rs2 - 1)) - 1;
+                    int32_t min_negative = -(1 << (instr.rs2 - 1));
+
+                    // x = x > max ? max : x; затем x = min > x ? min : x
+                    e.movdqu_load(XMM0, instr.rs1 * 16u);
+                    e.mov_imm(RAX, static_cast<uint32_t>(max_positive));
+                    e.sse(0x66, SSE_MOVD_TO, XMM1, RAX);
+                    e.sse_imm(SSE_PSHUFD, XMM1, XMM1, 0);
+                    e.sse(0x66, SSE_MOVDQA, XMM2, XMM0);
+                    e.sse(0x66, SSE_PCMPGTD, XMM2, XMM1);
+                    e.sse(0x66, SSE_PAND, XMM1, XMM2);
+                    e.sse(0x66, SSE_PANDN, XMM2, XMM0);
+                    e.sse(0x66, SSE_POR, XMM1, XMM2);
+
+                    e.mov_imm(RAX, static_cast<uint32_t>(min_negative));
+                    e.sse(0x66, SSE_MOVD_TO, XMM3, RAX);
+                    e.sse_imm(SSE_PSHUFD, XMM3, XMM3, 0);
+                    e.sse(0x66, SSE_MOVDQA, XMM2, XMM3);
+                    e.sse(0x66, SSE_PCMPGTD, XMM2, XMM1);
+                    e.sse(0x66, SSE_PAND, XMM3, XMM2);
+                    e.sse(0x66, SSE_PANDN, XMM2, XMM1);
+                    e.sse(0x66, SSE_POR, XMM3, XMM2);
+                    e.movdqu_store(instr.rd * 16u, XMM3);
+                }
+                break;
+
+            case CPU::H_VSPLAT:
+                load(RAX, instr.rs1);
+                e.load_rsp64(RDX, STACK_VECTORS);
+                e.sse(0x66, SSE_MOVD_TO, XMM0, RAX);
+                e.sse_imm(SSE_PSHUFD, XMM0, XMM0, 0);
+                e.movdqu_store(instr.rd * 16u, XMM0);
+                break;
+
+            case CPU::H_VREDSUM:
+                e.load_rsp64(RDX, STACK_VECTORS);
+                e.movdqu_load(XMM0, instr.rs1 * 16u);
+                e.sse_imm(SSE_PSHUFD, XMM1, XMM0, 0x4E);
+                e.sse(0x66, SSE_PADDD, XMM0, XMM1);
+                e.sse_imm(SSE_PSHUFD, XMM1, XMM0, 0xB1);
+                e.sse(0x66, SSE_PADDD, XMM0, XMM1);
+                e.sse(0x66, SSE_MOVD_FROM, XMM0, RAX);
+                store(instr.rd, RAX);
+                break;
+
+            case CPU::H_BNE:
+            case CPU::H_BEQ:
+            {
+                load(RAX, instr.rd);
+                load(RCX, instr.rt);
+                e.cmp(RAX, RCX);
+
+                int16_t offset = static_cast<int16_t>(instr.imm);
+                uint32_t target = ipc + static_cast<uint32_t>(static_cast<int32_t>(offset) * 4);
+                branch_to(e.jcc(instr.handler == CPU::H_BNE ? CC_NE : CC_E), target, ipc);
+                break;
+            }
+
+            case CPU::H_J:
+            {
+                uint32_t target = (ipc & 0xFFFFF000) | (instr.target << 2);
+                branch_to(e.jmp(), target, ipc);
+                break;
+            }
+
+            default:
+                break;
+        }
+    }
+
+    // Выход с конца блока
+    if (instrs.back().handler != CPU::H_J)
+    {
+        e.mov_imm(RAX, end_pc);
+    }
+
+    // Эпилог: rax = результат; вернуть закэшированные регистры в gpr, счётчик — в *retired
+    size_t epilogue = e.pos();
+    for (uint8_t g = 0; g < 32; g++)
+    {
+        if (host[g] >= 0 && written[g]) e.store_rbx(g * 4u, static_cast<uint8_t>(host[g]));
+    }
+    e.load_rsp64(RCX, STACK_RETIRED);
+    e.add_mem64(RCX, RETIRED);
+    e.add_rsp(FRAME_SIZE);
+    e.pop(R15);
+    e.pop(R14);
+    e.pop(R13);
+    e.pop(R12);
+    e.pop(RBP);
+    e.pop(RBX);
+    e.ret();
+
+    for (const Exit& exit : exits)
+    {
+        e.patch(exit.fixup, e.pos());
+        if (exit.unexecuted) e.add64_imm(RETIRED, -static_cast<int32_t>(exit.unexecuted));
+        e.mov_imm64(RAX, exit.result);
+        to_epilogue.push_back(e.jmp());
+    }
+
+    // Статус записи в eax: 1 — повторить инструкцию интерпретатором, 2 — код изменён, выйти за неё
+    for (const StoreExit& exit : store_exits)
+    {
+        e.patch(exit.fixup, e.pos());
+        e.cmp_imm8(RAX, 1);
+        size_t modified = e.jcc(CC_NE);
+        e.add64_imm(RETIRED, -static_cast<int32_t>(exit.unexecuted));
+        e.mov_imm64(RAX, exit.pc | BAILOUT);
+        to_epilogue.push_back(e.jmp());
+        e.patch(modified, e.pos());
+        if (exit.unexecuted > 1) e.add64_imm(RETIRED, -static_cast<int32_t>(exit.unexecuted - 1));
+        e.mov_imm64(RAX, exit.pc + 4);
+        to_epilogue.push_back(e.jmp());
+    }
+
+    // Переход назад сначала сверяет счётчик блока с budget: бесконечный цикл
+    // внутри блока не должен мешать CPU проверять лимиты run()
+    for (const auto& jump : back_edges)
+    {
+        e.patch(jump.first, e.pos());
+        e.cmp_rsp64(RETIRED, STACK_BUDGET);
+        internal.push_back({e.jcc(CC_B), jump.second});
+        e.mov_imm64(RAX, pc + static_cast<uint32_t>(jump.second) * 4);
+        to_epilogue.push_back(e.jmp());
+    }
+
+    for (const auto& jump : internal)
+    {
+        e.patch(jump.first, labels[jump.second]);
+    }
+
+    for (size_t fixup : to_epilogue)
+    {
+        e.patch(fixup, epilogue);
+    }
+
+    if (code_used + e.code.size() > code_capacity)
+    {
+        // Буфер кончился: выбрасываем всё оттранслированное и начинаем заново
+        clear();
+        if (e.code.size() > code_capacity)
+        {
+            return nullptr;
+        }
+    }
+
+    uint8_t* dst = code_buffer + code_used;
+    std::memcpy(dst, e.code.data(), e.code.size());
+    code_used += e.code.size();
+
+    BlockFn fn = reinterpret_cast<BlockFn>(dst);
+    blocks[pc] = Block{pc, end_pc, fn};
+
+    for (uint32_t page = pc >> PAGE_SHIFT; page <= (end_pc - 1) >> PAGE_SHIFT; page++)
+    {
+        page_blocks[page].push_back(pc);
+    }
+
+    code_lo = std::min<uint64_t>(code_lo, pc);
+    code_hi = std::max<uint64_t>(code_hi, end_pc);
+    stats.blocks_compiled++;
+
+    return fn;
+#endif
+}
@@ -0,0 +1,461 @@
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+#include "bitops.hpp"
+#include "lockstep.hpp"
+
+namespace
+{
+    constexpr size_t BLOCK = LockstepRunner::LANE_BLOCK;
+
+    // Часы смотрятся раз в столько шагов, как в CPU
+    constexpr uint64_t CLOCK_INTERVAL = 1u << 16;
+
+    uint32_t sign_extend16(uint32_t word)
+    {
+        return static_cast<uint32_t>(static_cast<int32_t>(static_cast<int16_t>(word & 0xFFFF)));
+    }
+
+    uint32_t saturate(uint32_t value, uint32_t bits)
+    {
+        if (bits == 0 || bits > 31)
+        {
+            return 0;
+        }
+        int32_t max_positive = static_cast<int32_t>((uint32_t{1} << (bits - 1)) - 1);
+        int32_t min_negative = -max_positive - 1;
+        return static_cast<uint32_t>(std::clamp(static_cast<int32_t>(value), min_negative, max_positive));
+    }
+
+    // dst[l] = fn(l) для дорожек из mask. Блок считается во временный массив, чтобы
+    // запись в dst (тот же регистр, что и источник) не мешала векторизации
+    template<typename Fn>
+    void apply(uint32_t* dst, const uint32_t* mask, size_t width, Fn fn)
+    {
+        for (size_t base = 0; base < width; base += BLOCK)
+        {
+            uint32_t value[BLOCK];
+            for (size_t j = 0; j < BLOCK; j++)
+            {
+                value[j] = fn(base + j);
+            }
+            for (size_t j = 0; j < BLOCK; j++)
+            {
+                dst[base + j] = (value[j] & mask[base + j]) | (dst[base + j] & ~mask[base + j]);
+            }
+        }
+    }
+
+    // Инструкции медленного пути, которые пишут в память: SYSCALL (SYS_READ_STR), STP, CAS, VST
+    bool may_write(uint32_t word)
+    {
+        uint32_t opcode = word >> 26;
+        uint32_t funct = word & 0x3F;
+        return (opcode == 0 && (funct == 0b101000 || funct == 0b011110)) || opcode == 0b010101 || opcode == 0b110011;
+    }
+}
+
+LockstepRunner::LockstepRunner(const std::string& program, const LockstepOptions& options)
+    : options(options), width((std::max<size_t>(options.lanes, 1) + BLOCK - 1) / BLOCK * BLOCK)
+{
+    for (size_t lane = 0; lane < width; lane++)
+    {
+        machines.push_back(std::make_unique<Machine>(options.memory_size));
+        ios.push_back(std::make_unique<BufferedIO>());
+
+        CPU& cpu = machines[lane]->get_cpu();
+        cpu.set_quiet(true);
+        cpu.set_io(*ios[lane]);
+    }
+
+    Machine& first = *machines[0];
+    first.load(program, options.load_address);
+    loaded = first.snapshot();
+
+    // Операции на всём охвате сегментов кода: запись в него уводит дорожку из лок-степа
+    if (!loaded.code_ranges.empty())
+    {
+        code_begin = UINT32_MAX;
+        for (const auto& range : loaded.code_ranges)
+        {
+            code_begin = std::min(code_begin, range.first & ~3u);
+            code_end = std::max(code_end, range.second);
+        }
+        code_end = static_cast<uint32_t>(std::min<uint64_t>(code_end, first.get_memory().size())) & ~3u;
+        code_end = std::max(code_end, code_begin);
+    }
+
+    const Memory& memory = first.get_memory();
+    for (uint32_t address = code_begin; address < code_end; address += 4)
+    {
+        uint32_t word = memory.read<uint32_t>(address);
+        Op op;
+        op.a = (word >> 21) & 0x1F;
+        op.b = (word >> 16) & 0x1F;
+        op.c = (word >> 11) & 0x1F;
+        op.imm = sign_extend16(word);
+
+        uint8_t opcode = word >> 26;
+        if (opcode == 0)
+        {
+            switch (word & 0x3F)
+            {
+                case 0b010010: op.kind = K_ADD; break;
+                case 0b110110: op.kind = K_SUB; break;
+                case 0b001010: op.kind = K_CLS; break;
+                case 0b010100: op.kind = K_BEXT; break;
+                default:       break;
+            }
+        }
+        else
+        {
+            switch (opcode)
+            {
+                case 0b101101: op.kind = K_ADDI; break;
+                case 0b011100: op.kind = K_SBIT; op.imm = uint32_t{1} << op.c; break;
+                case 0b001101: op.kind = K_SSAT; break;
+                case 0b111001: op.kind = K_LD; break;
+                case 0b110111: op.kind = K_ST; break;
+                case 0b011000: op.kind = K_BNE; op.imm = address + (op.imm << 2); break;
+                case 0b011010: op.kind = K_BEQ; op.imm = address + (op.imm << 2); break;
+                case 0b011111: op.kind = K_J; op.imm = (address & 0xFFFFF000) | ((word & 0x3FFFFFF) << 2); break;
+                default:       break;
+            }
+        }
+        ops.push_back(op);
+    }
+
+    if (code_end > code_begin)
+    {
+        const uint8_t* bytes = memory.host_bytes(code_begin, code_end - code_begin);
+        code_bytes.assign(bytes, bytes + (code_end - code_begin));
+    }
+
+    gpr.resize(32 * width);
+    pc.resize(width);
+    running.resize(width);
+    active.resize(width);
+    retired.resize(width);
+}
+
+const LockstepRunner::Op& LockstepRunner::op_at(uint32_t address) const
+{
+    static const Op scalar;
+    if (address < code_begin || address >= code_end || (address & 3))
+    {
+        return scalar;
+    }
+    return ops[(address - code_begin) >> 2];
+}
+
+std::vector<BatchResult> LockstepRunner::run(const std::vector<std::vector<int32_t>>& inputs)
+{
+    std::vector<BatchResult> results(inputs.size());
+    for (size_t first = 0; first < inputs.size(); first += width)
+    {
+        run_group(inputs, first, std::min(width, inputs.size() - first), results);
+    }
+    stats.jobs += inputs.size();
+    return results;
+}
+
+void LockstepRunner::run_group(const std::vector<std::vector<int32_t>>& inputs, size_t first, size_t count,
+                               std::vector<BatchResult>& results)
+{
+    for (size_t lane = 0; lane < count; lane++)
+    {
+        machines[lane]->restore(loaded);
+
+        std::string input;
+        for (int32_t value : inputs[first + lane])
+        {
+            input += std::to_string(value);
+            input += ' ';
+        }
+        ios[lane]->set_input(std::move(input));
+        ios[lane]->clear_output();
+    }
+
+    for (size_t r = 0; r < 32; r++)
+    {
+        std::fill_n(gpr.begin() + r * width, width, loaded.cpu.gpr[r]);
+    }
+    std::fill(pc.begin(), pc.end(), loaded.cpu.pc);
+    std::fill(retired.begin(), retired.end(), 0);
+    for (size_t lane = 0; lane < width; lane++)
+    {
+        running[lane] = lane < count ? ~0u : 0u;
+    }
+    running_count = count;
+
+    group_start = std::chrono::steady_clock::now();
+    uint64_t issues = 0;
+
+    // Пока все работающие дорожки на одном PC (converged), он же lead и поиск не нужен
+    uint32_t lead = 0;
+    bool converged = false;
+
+    while (running_count)
+    {
+        if (converged)
+        {
+            std::copy(running.begin(), running.end(), active.begin());
+        }
+        else
+        {
+            // Ведущий PC — наименьший среди работающих; маска — дорожки на нём
+            lead = UINT32_MAX;
+            for (size_t lane = 0; lane < width; lane++)
+            {
+                lead = std::min(lead, pc[lane] | ~running[lane]);
+            }
+            uint32_t differ = 0;
+            for (size_t lane = 0; lane < width; lane++)
+            {
+                active[lane] = running[lane] & (pc[lane] == lead ? ~0u : 0u);
+                differ |= active[lane] ^ running[lane];
+            }
+            converged = differ == 0;
+        }
+
+        const Op& op = op_at(lead);
+        const uint32_t* mask = active.data();
+        uint32_t* x = gpr.data();
+        uint32_t* rd = x + op.a * width;
+        const uint32_t* rs = x + op.b * width;
+        const uint32_t* rt = x + op.c * width;
+        const uint32_t imm = op.imm;
+        bool advance = true;
+
+        switch (op.kind)
+        {
+            case K_ADD:
+                apply(x + op.c * width, mask, width, [&](size_t l) { return rd[l] + rs[l]; });
+                break;
+            case K_SUB:
+                apply(x + op.c * width, mask, width, [&](size_t l) { return rd[l] - rs[l]; });
+                break;
+            case K_ADDI:
+                apply(x + op.b * width, mask, width, [&](size_t l) { return rd[l] + imm; });
+                break;
+            case K_SBIT:
+                apply(rd, mask, width, [&](size_t) { return imm; });
+                break;
+            case K_CLS:
+                apply(rd, mask, width, [&](size_t l) { return count_leading_signs(rs[l]); });
+                break;
+            case K_BEXT:
+                apply(rd, mask, width, [&](size_t l) { return extract_bits(rs[l], rt[l]); });
+                break;
+            case K_SSAT:
+                apply(rd, mask, width, [&](size_t l) { return saturate(rs[l], op.c); });
+                break;
+
+            // Обращения к памяти — в Machine своей дорожки; за size() — ловушку поднимет CPU::step
+            case K_LD:
+                for (size_t lane = 0; lane < width; lane++)
+                {
+                    if (!active[lane])
+                    {
+                        continue;
+                    }
+                    uint32_t address = rd[lane] + imm;
+                    const Memory& memory = machines[lane]->get_memory();
+                    if (uint64_t{address} + 4 > memory.size())
+                    {
+                        active[lane] = 0;
+                        converged = false;
+                        scalar_step(lane, false, results[first + lane]);
+                        continue;
+                    }
+                    x[op.b * width + lane] = memory.read<uint32_t>(address);
+                }
+                break;
+            case K_ST:
+                for (size_t lane = 0; lane < width; lane++)
+                {
+                    if (!active[lane])
+                    {
+                        continue;
+                    }
+                    uint32_t address = rd[lane] + imm;
+                    Memory& memory = machines[lane]->get_memory();
+                    if (address & 3)
+                    {
+                        continue;
+                    }
+                    bool code_write = uint64_t{address} + 4 > code_begin && address < code_end;
+                    if (uint64_t{address} + 4 > memory.size() || code_write)
+                    {
+                        active[lane] = 0;
+                        converged = false;
+                        scalar_step(lane, code_write, results[first + lane]);
+                        continue;
+                    }
+                    memory.write<uint32_t>(address, rs[lane]);
+                }
+                break;
+
+            case K_BNE:
+            case K_BEQ:
+            {
+                const uint32_t fallthrough = lead + 4;
+                const uint32_t equal_target = op.kind == K_BEQ ? imm : fallthrough;
+                const uint32_t differ_target = op.kind == K_BEQ ? fallthrough : imm;
+                apply(pc.data(), mask, width,
+                      [&](size_t l) { return rd[l] == rs[l] ? equal_target : differ_target; });
+                advance = false;
+                converged = false;
+                break;
+            }
+            case K_J:
+                apply(pc.data(), mask, width, [&](size_t) { return imm; });
+                lead = imm;
+                advance = false;
+                break;
+
+            case K_SCALAR:
+                for (size_t lane = 0; lane < width; lane++)
+                {
+                    if (active[lane])
+                    {
+                        active[lane] = 0;
+                        scalar_step(lane, false, results[first + lane]);
+                    }
+                }
+                advance = false;
+                converged = false;
+                break;
+        }
+
+        if (advance)
+        {
+            for (size_t lane = 0; lane < width; lane++)
+            {
+                pc[lane] += 4 & active[lane];
+            }
+            lead += 4;
+        }
+        for (size_t lane = 0; lane < width; lane++)
+        {
+            retired[lane] += active[lane] & 1;
+        }
+
+        issues++;
+
+        // Ни одна дорожка не выполнила больше инструкций, чем было шагов
+        if (options.max_instructions && issues >= options.max_instructions)
+        {
+            for (size_t lane = 0; lane < count; lane++)
+            {
+                if (running[lane] && retired[lane] >= options.max_instructions)
+                {
+                    BatchResult& result = results[first + lane];
+                    result.stop_reason = CPU::StopReason::InstructionLimit;
+                    finish(lane, CPU::RunStatus::Stopped, result);
+                }
+            }
+        }
+
+        if (options.time_limit.count() && (issues & (CLOCK_INTERVAL - 1)) == 0 &&
+            std::chrono::steady_clock::now() - group_start >= options.time_limit)
+        {
+            for (size_t lane = 0; lane < count; lane++)
+            {
+                if (running[lane])
+                {
+                    BatchResult& result = results[first + lane];
+                    result.stop_reason = CPU::StopReason::TimeLimit;
+                    finish(lane, CPU::RunStatus::Stopped, result);
+                }
+            }
+        }
+    }
+
+    for (size_t lane = 0; lane < count; lane++)
+    {
+        BatchResult& result = results[first + lane];
+        result.result = gpr[3 * width + lane];
+        result.instructions = retired[lane];
+        result.output = ios[lane]->output();
+    }
+
+    stats.issues += issues;
+    stats.instructions += std::accumulate(retired.begin(), retired.begin() + count, uint64_t{0});
+}
+
+void LockstepRunner::scalar_step(size_t lane, bool detach, BatchResult& result)
+{
+    Machine& machine = *machines[lane];
+    CPU& cpu = machine.get_cpu();
+    Memory& memory = machine.get_memory();
+
+    CPU::State state = cpu.get_state();
+    for (size_t r = 0; r < 32; r++)
+    {
+        state.gpr[r] = gpr[r * width + lane];
+    }
+    state.pc = pc[lane];
+    cpu.set_state(state);
+
+    const uint8_t* word = memory.host_bytes(state.pc, 4);
+    bool check_code = word && may_write(memory.read<uint32_t>(state.pc)) && !code_bytes.empty();
+
+    uint64_t before = cpu.get_retired();
+    CPU::RunStatus status = cpu.step(memory);
+    stats.scalar_steps++;
+
+    // Код изменился — дорожка больше не совпадает с ops и дорабатывает одна
+    if (status == CPU::RunStatus::Running && !detach && check_code)
+    {
+        detach = std::memcmp(memory.host_bytes(code_begin, code_bytes.size()), code_bytes.data(),
+                             code_bytes.size()) != 0;
+    }
+
+    if (status == CPU::RunStatus::Running && detach)
+    {
+        stats.detached++;
+
+        uint64_t done = retired[lane] + (cpu.get_retired() - before);
+        if (options.max_instructions)
+        {
+            cpu.set_instruction_limit(options.max_instructions > done ? options.max_instructions - done : 1);
+        }
+        if (options.time_limit.count())
+        {
+            auto elapsed = std::chrono::steady_clock::now() - group_start;
+            cpu.set_time_limit(std::max(options.time_limit - elapsed, std::chrono::steady_clock::duration{1}));
+        }
+
+        status = cpu.run(memory);
+        result.stop_reason = cpu.get_stop_reason();
+
+        cpu.set_instruction_limit(0);
+        cpu.set_time_limit({});
+    }
+
+    retired[lane] += cpu.get_retired() - before;
+    for (size_t r = 0; r < 32; r++)
+    {
+        gpr[r * width + lane] = cpu.get_register(static_cast<uint8_t>(r));
+    }
+    pc[lane] = cpu.get_pc();
+
+    if (status != CPU::RunStatus::Running)
+    {
+        finish(lane, status, result);
+    }
+}
+
+void LockstepRunner::finish(size_t lane, CPU::RunStatus status, BatchResult& result)
+{
+    const CPU& cpu = machines[lane]->get_cpu();
+
+    running[lane] = 0;
+    running_count--;
+
+    result.status = status;
+    result.fault = cpu.get_fault();
+    result.fault_pc = cpu.get_fault_pc();
+}
@@ -1,33 +1,21 @@
+#include <chrono>
 #include <iostream>
 #include <iomanip>
 #include <vector>
-#include <fstream>
 #include <stdexcept>
+#include <algorithm>
+#include <fstream>
 #include "CLI11.hpp"
 
+#include "aot.hpp"
+#include "assembler.hpp"
+#include "batch.hpp"
+#include "cache_model.hpp"
 #include "machine.hpp"
-
-void load_binary_file(Machine& machine, const std::string& filename, uint32_t load_address = 0x1000)
-{
-    std::ifstream file(filename, std::ios::binary);
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open file: " + filename);
-    }
-
-    uint32_t address = load_address;
-    uint32_t instruction;
-
-    std::cout << "=== BINARY FILE LOADING ===" << std::endl;
-
-    while (file.read(reinterpret_cast<char*>(&instruction), 4)) {
-        machine.get_memory().write<uint32_t>(address, instruction);
-        address += 4;
-    }
-
-    machine.set_start_address(load_address);
-    std::cout << "Loaded " << (address - load_address) / 4 << " instructions from " << filename << std::endl;
-    std::cout << "=== LOADING COMPLETE ===" << std::endl;
-}
+#include "profiler.hpp"
+#include "smp_machine.hpp"
+#include "timing_model.hpp"
+#include "trace.hpp"
 
 void print_registers(Machine& machine)
 {
@@ -43,6 +31,197 @@ void print_registers(Machine& machine)
     std::cout << "------------------------" << std::endl;
 }
 
+bool parse_engine(const std::string& name, CPU::Engine& engine)
+{
+    if (name == "switch")
+    {
+        engine = CPU::Engine::Switch;
+    }
+    else if (name == "threaded")
+    {
+        engine = CPU::Engine::Threaded;
+    }
+    else if (name == "jit")
+    {
+        engine = CPU::Engine::Jit;
+    }
+    else
+    {
+        std::cerr << "Unknown engine: " << name << std::endl;
+        return false;
+    }
+    return true;
+}
+
+std::chrono::steady_clock::duration seconds_to_duration(double seconds)
+{
+    return std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
+// Итог прогона в stderr, чтобы не смешиваться с выводом гостя
+void print_summary(uint64_t instructions, double seconds)
+{
+    std::cerr << "Executed " << instructions << " instructions in " << std::fixed << std::setprecision(3)
+              << seconds << " s (" << std::setprecision(1) << (seconds > 0 ? instructions / seconds / 1e6 : 0.0)
+              << " MIPS)" << std::endl;
+}
+
+// 2 — ошибка гостя, 3 — остановлен лимитом
+int exit_status(CPU::RunStatus status)
+{
+    switch (status)
+    {
+        case CPU::RunStatus::Faulted: return 2;
+        case CPU::RunStatus::Stopped: return 3;
+        default:                      return 0;
+    }
+}
+
+void print_stop(const CPU& cpu)
+{
+    std::cerr << "Stopped: " << CPU::stop_reason_name(cpu.get_stop_reason()) << " at PC 0x"
+              << std::hex << cpu.get_pc() << std::dec << std::endl;
+}
+
+int run_batch(const std::string& manifest, const BatchOptions& options, bool verbose)
+{
+    std::vector<BatchJob> jobs;
+    try
+    {
+        jobs = read_manifest(manifest);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    BatchRunner runner(options);
+    std::vector<BatchResult> results = runner.run(jobs);
+
+    int exit_code = 0;
+    for (size_t i = 0; i < jobs.size(); i++)
+    {
+        const BatchResult& result = results[i];
+        std::cout << "[" << i << "] " << jobs[i].program << ": ";
+
+        if (!result.error.empty())
+        {
+            std::cout << "error: " << result.error << std::endl;
+            exit_code = 1;
+            continue;
+        }
+
+        if (result.status == CPU::RunStatus::Faulted)
+        {
+            std::cout << "fault " << CPU::fault_name(result.fault) << " at PC 0x"
+                      << std::hex << result.fault_pc << std::dec;
+            exit_code = std::max(exit_code, 2);
+        }
+        else if (result.status == CPU::RunStatus::Stopped)
+        {
+            std::cout << "stopped: " << CPU::stop_reason_name(result.stop_reason);
+            exit_code = std::max(exit_code, 3);
+        }
+        else
+        {
+            std::cout << "r3 = " << static_cast<int32_t>(result.result);
+        }
+        std::cout << ", " << result.instructions << " instructions" << std::endl;
+
+        if (verbose && !result.output.empty())
+        {
+            std::cout << result.output;
+        }
+    }
+
+    const auto& stats = runner.get_stats();
+    std::cout << "Batch: " << stats.jobs << " jobs on " << stats.threads << " threads in "
+              << std::fixed << std::setprecision(3) << stats.seconds << " s, "
+              << std::setprecision(1) << stats.jobs_per_second() << " jobs/s, "
+              << stats.instructions_per_second() / 1e6 << " MIPS, "
+              << stats.steals << " steals" << std::endl;
+
+    return exit_code;
+}
+
+// Вывод гостя буферизуется; ввод — весь файл input_file или построчно из std::cin
+std::unique_ptr<BufferedIO> make_io(const std::string& input_file, bool raw_output)
+{
+    auto format = raw_output ? SyscallIO::Format::Raw : SyscallIO::Format::Banner;
+    auto io = std::make_unique<BufferedIO>(&std::cout, input_file.empty() ? &std::cin : nullptr, format);
+    if (!input_file.empty())
+    {
+        io->load_input(input_file);
+    }
+    return io;
+}
+
+// Все harts исполняют один образ над общей памятью; статус выхода как у одиночного запуска
+int run_harts(const std::string& binary_file, uint32_t load_address, size_t harts, uint64_t memory_size,
+              CPU::Engine engine, bool no_fusion, bool no_decode_cache, bool verbose,
+              const std::string& input_file, bool raw_output, uint64_t max_instructions, double timeout)
+{
+    SmpMachine machine(harts, memory_size);
+    machine.set_engine(engine);
+    machine.set_fusion_enabled(!no_fusion);
+    machine.set_decode_cache_enabled(!no_decode_cache);
+    machine.set_instruction_limit(max_instructions);
+    machine.set_time_limit(seconds_to_duration(timeout));
+
+    // У каждого hart свой буфер вывода и своя копия ввода
+    std::vector<std::unique_ptr<BufferedIO>> io;
+    try
+    {
+        for (size_t id = 0; id < harts; id++)
+        {
+            io.push_back(make_io(input_file, raw_output));
+            machine.get_hart(id).set_io(*io.back());
+        }
+        machine.load(binary_file, load_address);
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    CPU::RunStatus status = machine.run();
+
+    for (size_t id = 0; id < machine.hart_count(); id++)
+    {
+        const CPU& hart = machine.get_hart(id);
+        if (hart.get_fault() != CPU::Fault::None)
+        {
+            std::cerr << "Guest fault on hart " << id << ": " << CPU::fault_name(hart.get_fault())
+                      << " at PC 0x" << std::hex << hart.get_fault_pc()
+                      << " (address 0x" << hart.get_fault_address() << ")" << std::dec << std::endl;
+        }
+        else if (hart.get_stop_reason() != CPU::StopReason::None)
+        {
+            std::cerr << "Hart " << id << ": ";
+            print_stop(hart);
+        }
+    }
+
+    print_summary(machine.get_stats().instructions(), machine.get_stats().seconds);
+
+    if (verbose)
+    {
+        const auto& stats = machine.get_stats();
+        for (size_t id = 0; id < machine.hart_count(); id++)
+        {
+            std::cout << "Hart " << id << ": " << stats.retired[id] << " instructions, r3 = "
+                      << machine.get_hart(id).get_register(3) << std::endl;
+        }
+        std::cout << "Harts: " << machine.hart_count() << " in " << std::fixed << std::setprecision(3)
+                  << stats.seconds << " s, " << std::setprecision(1)
+                  << stats.instructions_per_second() / 1e6 << " MIPS total" << std::endl;
+    }
+
+    return exit_status(status);
+}
+
 int main(int argc, char** argv)
 {
 
@@ -51,14 +230,94 @@ int main(int argc, char** argv)
 
     std::string binary_file;
     bool verbose = false;
-    uint32_t load_address = 0x1000;
+    bool no_decode_cache = false;
+    std::string engine_name = "switch";
+    bool no_fusion = false;
+    uint64_t memory_size = Machine::DEFAULT_SIZE;
+    bool fusion_report = false;
+    uint32_t load_address = DEFAULT_LOAD_ADDRESS;
+    size_t harts = 1;
+    std::string input_file;
+    bool raw_output = false;
+    std::string profile_file;
+    std::string trace_file;
+    std::string cache_file;
+    std::string cache_spec;
+    std::string timing_file;
+    std::string timing_spec;
+    bool checked = false;
+    uint64_t max_instructions = 0;
+    double timeout = 0;
 
 
-    app.add_option("binary_file", binary_file, "Binary file to execute")
-        ->required()
+    app.add_option("binary_file", binary_file, "Executable image, raw binary or assembly source (.s, .asm) to execute")
         ->check(CLI::ExistingFile);
 
     app.add_flag("-v,--verbose", verbose, "Enable verbose output");
+    app.add_option("--load-address", load_address, "Load address of a raw binary without image header");
+    app.add_flag("--no-decode-cache", no_decode_cache, "Decode every instruction on fetch");
+    app.add_option("--engine", engine_name, "Execution engine: switch | threaded | jit");
+    app.add_option("--memory-size", memory_size, "Guest memory size in bytes (up to 4 GiB, pages are allocated lazily)");
+    app.add_flag("--no-fusion", no_fusion, "Do not fuse instruction pairs at load time");
+    app.add_flag("--fusion-report", fusion_report, "Print which fusions fired and dispatches saved");
+    app.add_option("--harts", harts, "Number of CPUs sharing guest memory, each on its own thread");
+    app.add_option("--input", input_file, "Read all guest input from this file instead of stdin")
+        ->check(CLI::ExistingFile);
+    app.add_flag("--raw-output", raw_output, "Print SYS_PRINT_INT values one per line, without banners and prompts");
+    app.add_option("--max-instructions", max_instructions, "Stop after about this many instructions (0 — no limit)");
+    app.add_option("--timeout", timeout, "Stop after this many seconds of wall-clock time (0 — no limit)");
+    app.add_option("--profile", profile_file, "Count executions per PC and opcode and write a report here ('-' for stdout)");
+    app.add_option("--trace", trace_file, "Record every executed instruction into this binary trace file");
+    app.add_option("--cache-report", cache_file, "Simulate L1/L2 caches and write hit/miss rates here ('-' for stdout)");
+    app.add_option("--cache", cache_spec, "Cache geometry: LEVEL=SIZE:WAYS:LINE[:lru|fifo|random],... (l1i, l1d, l2; l2=none)");
+    app.add_option("--timing-report", timing_file, "Estimate 5-stage pipeline cycles and write CPI, stalls and mispredicts here ('-' for stdout)");
+    app.add_option("--timing", timing_spec, "Pipeline options: predictor=static|bimodal|gshare,bits=N,mispredict=N,load-use=N,cls=N,bext=N,ssat=N,l2=N,memory=N");
+    app.add_flag("--checked", checked, "Run the reference interpreter with debug checks of the decode cache");
+
+    std::string manifest;
+    unsigned threads = 0;
+    size_t lanes = 0;
+    CLI::App* batch = app.add_subcommand("batch", "Run every job of a manifest on a thread pool");
+    batch->add_option("manifest", manifest, "Job list: program path and SYS_READ_INT values per line")
+        ->required()
+        ->check(CLI::ExistingFile);
+    batch->add_option("--threads", threads, "Worker threads (0 — one per core)");
+    batch->add_option("--engine", engine_name, "Execution engine: switch | threaded | jit");
+    batch->add_option("--memory-size", memory_size, "Guest memory size of every worker");
+    batch->add_option("--max-instructions", max_instructions, "Instruction limit of every job (0 — no limit)");
+    batch->add_option("--timeout", timeout, "Wall-clock limit of every job in seconds (0 — no limit)");
+    batch->add_option("--lanes", lanes, "Run jobs of one program K at a time in lockstep SIMT lanes (0 — off)");
+    batch->add_flag("-v,--verbose", verbose, "Print program output of every job");
+
+    std::string dump_file;
+    uint64_t dump_limit = 0;
+    CLI::App* trace_dump = app.add_subcommand("trace-dump", "Print a binary trace as text");
+    trace_dump->add_option("trace_file", dump_file, "Trace written by --trace")
+        ->required()
+        ->check(CLI::ExistingFile);
+    trace_dump->add_option("--limit", dump_limit, "Print only this many records (0 — all)");
+
+    std::string aot_image;
+    std::string aot_output;
+    std::string aot_name = "aot_program";
+    CLI::App* aot = app.add_subcommand("aot", "Translate a program image to C++ ahead of time");
+    aot->add_option("image", aot_image, "Executable image or raw binary to translate")
+        ->required()
+        ->check(CLI::ExistingFile);
+    aot->add_option("-o,--output", aot_output, "C++ file to write")->required();
+    aot->add_option("--name", aot_name, "Name of the exported AotProgram");
+    aot->add_option("--load-address", load_address, "Load address of a raw binary without image header");
+    aot->add_option("--memory-size", memory_size, "Guest memory size of the translated program");
+
+    std::string asm_source;
+    std::string asm_output;
+    CLI::App* assembler = app.add_subcommand("asm", "Assemble a source file into an image or a raw binary");
+    assembler->add_option("source", asm_source, "Assembly source")
+        ->required()
+        ->check(CLI::ExistingFile);
+    assembler->add_option("-o,--output", asm_output, "Image to write: *.cexe — CEXE image, otherwise raw code")->required();
+    assembler->add_option("--load-address", load_address, "Address of the first instruction");
+    assembler->add_flag("-v,--verbose", verbose, "Print how many instructions and labels were assembled");
 
     try
     {
@@ -69,22 +328,355 @@ int main(int argc, char** argv)
         return app.exit(e);
     }
 
+    if (memory_size > Memory::ADDRESS_SPACE)
+    {
+        std::cerr << "Memory size exceeds 4 GiB" << std::endl;
+        return 1;
+    }
+
+    CPU::Engine engine;
+    if (!parse_engine(engine_name, engine))
+    {
+        return 1;
+    }
+
+    if (*trace_dump)
+    {
+        try
+        {
+            TraceReader reader(dump_file);
+            dump_trace(reader, std::cout, dump_limit);
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (*aot)
+    {
+        AotOptions options;
+        options.name = aot_name;
+        options.load_address = load_address;
+        options.memory_size = memory_size;
+        try
+        {
+            std::string text = translate_image(aot_image, options);
+            std::ofstream out(aot_output, std::ios::trunc);
+            if (!out.is_open() || !(out << text))
+            {
+                std::cerr << "Cannot write " << aot_output << std::endl;
+                return 1;
+            }
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (*assembler)
+    {
+        try
+        {
+            Assembly assembly = assemble_file(asm_source, { load_address });
+            bool image = asm_output.size() > 5 && asm_output.compare(asm_output.size() - 5, 5, ".cexe") == 0;
+            if (image)
+            {
+                save_image(asm_output, assembly.entry, assembly.segments, assembly.symbols);
+            }
+            else
+            {
+                if (assembly.segments.size() > 1 || assembly.entry != load_address)
+                {
+                    std::cerr << "A raw binary holds only code starting at its first instruction; write a .cexe image" << std::endl;
+                    return 1;
+                }
+                const std::vector<uint8_t>& code = assembly.segments.front().bytes;
+                std::ofstream out(asm_output, std::ios::binary | std::ios::trunc);
+                if (!out.is_open() || !out.write(reinterpret_cast<const char*>(code.data()), static_cast<std::streamsize>(code.size())))
+                {
+                    std::cerr << "Cannot write " << asm_output << std::endl;
+                    return 1;
+                }
+            }
+            if (verbose)
+            {
+                std::cout << "Assembled " << assembly.instructions << " instructions, "
+                          << assembly.symbols.size() << " labels" << std::endl;
+            }
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (*batch)
+    {
+        BatchOptions options;
+        options.threads = threads;
+        options.memory_size = memory_size;
+        options.engine = engine;
+        options.max_instructions = max_instructions;
+        options.time_limit = seconds_to_duration(timeout);
+        options.lanes = lanes;
+        return run_batch(manifest, options, verbose);
+    }
+
+    if (binary_file.empty())
+    {
+        std::cerr << "binary_file is required" << std::endl;
+        return 1;
+    }
+
+    if (harts == 0)
+    {
+        std::cerr << "At least one hart is required" << std::endl;
+        return 1;
+    }
 
     if (verbose)
     {
         std::cout << "CPU Emulator starting..." << std::endl;
         std::cout << "Binary file: " << binary_file << std::endl;
-        std::cout << "Load address: 0x" << std::hex << load_address << std::endl;
+        std::cout << "Load address: 0x" << std::hex << load_address << std::dec << std::endl;
 
     }
 
-    Machine machine;
+    if (harts > 1 && !profile_file.empty())
+    {
+        std::cerr << "--profile supports a single hart only" << std::endl;
+        return 1;
+    }
 
-    load_binary_file(machine, binary_file, load_address);
+    if (harts > 1 && !trace_file.empty())
+    {
+        std::cerr << "--trace supports a single hart only" << std::endl;
+        return 1;
+    }
+
+    if (harts > 1 && checked)
+    {
+        std::cerr << "--checked supports a single hart only" << std::endl;
+        return 1;
+    }
+
+    if (!profile_file.empty() && !trace_file.empty())
+    {
+        std::cerr << "--profile and --trace cannot be combined" << std::endl;
+        return 1;
+    }
+
+    if (!cache_file.empty() && (harts > 1 || !profile_file.empty() || !trace_file.empty()))
+    {
+        std::cerr << "--cache-report supports a single hart and cannot be combined with --profile or --trace" << std::endl;
+        return 1;
+    }
+
+    if (!timing_file.empty() && (harts > 1 || !profile_file.empty() || !trace_file.empty()))
+    {
+        std::cerr << "--timing-report supports a single hart and cannot be combined with --profile or --trace" << std::endl;
+        return 1;
+    }
 
+    std::unique_ptr<CacheModel> cache_model;
+    std::unique_ptr<TimingModel> timing_model;
+    try
+    {
+        CacheModelOptions cache_options = parse_cache_options(cache_spec);
+        if (!cache_file.empty())
+        {
+            cache_model = std::make_unique<CacheModel>(cache_options);
+        }
+        TimingOptions timing_options = parse_timing_options(timing_spec);
+        if (!timing_file.empty())
+        {
+            timing_model = std::make_unique<TimingModel>(timing_options);
+        }
+    }
+    catch (const std::invalid_argument& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
 
-    machine.run();
+    if (harts > 1)
+    {
+        return run_harts(binary_file, load_address, harts, memory_size, engine, no_fusion, no_decode_cache, verbose,
+                         input_file, raw_output, max_instructions, timeout);
+    }
+
+    Machine machine(memory_size);
+    machine.set_decode_cache_enabled(!no_decode_cache);
+    machine.set_fusion_enabled(!no_fusion);
+    machine.set_engine(engine);
+    machine.set_checked(checked);
+    machine.set_instruction_limit(max_instructions);
+    machine.set_time_limit(seconds_to_duration(timeout));
 
+    std::unique_ptr<BufferedIO> io;
+    std::unique_ptr<TraceWriter> tracer;
+    LoadedImage image;
+    try
+    {
+        io = make_io(input_file, raw_output);
+        machine.get_cpu().set_io(*io);
+        image = machine.load(binary_file, load_address);
+        if (!trace_file.empty())
+        {
+            tracer = std::make_unique<TraceWriter>(trace_file);
+            machine.get_cpu().set_tracer(tracer.get());
+        }
+    }
+    catch (const std::runtime_error& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+
+    if (verbose)
+    {
+        std::cout << "Loaded " << (image.raw ? "raw binary" : "image") << ": " << std::dec
+                  << image.segments.size() << " segments, " << image.symbols.size() << " symbols, "
+                  << image.mapped_bytes << " bytes mapped, " << image.copied_bytes << " bytes copied, entry 0x"
+                  << std::hex << image.entry << std::dec << std::endl;
+    }
+
+    Profiler profiler;
+    if (!profile_file.empty())
+    {
+        machine.get_cpu().set_profiler(&profiler);
+    }
+    machine.get_cpu().set_cache_model(cache_model.get());
+    machine.get_cpu().set_timing_model(timing_model.get());
+
+    CPU::RunStatus status;
+    try
+    {
+        status = machine.run();
+    }
+    catch (const std::logic_error& e)
+    {
+        std::cerr << "Check failed: " << e.what() << std::endl;
+        return 1;
+    }
+
+    if (status == CPU::RunStatus::Faulted)
+    {
+        const CPU& cpu = machine.get_cpu();
+        std::cerr << "Guest fault: " << CPU::fault_name(cpu.get_fault())
+                  << " at PC 0x" << std::hex << cpu.get_fault_pc()
+                  << " (address 0x" << cpu.get_fault_address() << ")" << std::dec << std::endl;
+    }
+    else if (status == CPU::RunStatus::Stopped)
+    {
+        print_stop(machine.get_cpu());
+    }
+
+    print_summary(machine.get_stats().instructions, machine.get_stats().seconds);
+
+    if (tracer)
+    {
+        try
+        {
+            tracer->close();
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::cerr << "Trace: " << tracer->instructions() << " instructions, " << tracer->bytes() << " bytes written to "
+                  << trace_file << std::endl;
+    }
+
+    if (verbose && !no_decode_cache)
+    {
+        const auto& stats = machine.get_cpu().get_decode_cache_stats();
+        std::cout << "Decode cache: " << std::dec << stats.hits << " hits, "
+                  << stats.misses << " misses, " << stats.invalidations << " invalidations ("
+                  << std::fixed << std::setprecision(2) << stats.hit_rate() * 100.0 << "% hit rate)" << std::endl;
+    }
+
+    if (fusion_report)
+    {
+        const auto& stats = machine.get_cpu().get_fusion_stats();
+        std::cout << "Fusion report:" << std::endl;
+        for (size_t kind = 0; kind < CPU::FUSE_COUNT; kind++)
+        {
+            std::cout << "  " << std::left << std::setw(16) << CPU::FusionStats::name(kind) << std::right
+                      << std::dec << stats.sites[kind] << " sites, " << stats.executed[kind] << " executed" << std::endl;
+        }
+        std::cout << "  Dispatches saved: " << stats.dispatches_saved() << std::endl;
+    }
+
+    if (verbose && engine_name == "jit")
+    {
+        const auto& stats = machine.get_cpu().get_jit_stats();
+        std::cout << "JIT: " << std::dec << stats.blocks_compiled << " blocks compiled, "
+                  << stats.block_runs << " block runs, " << stats.invalidations << " invalidations" << std::endl;
+    }
+
+    if (!profile_file.empty())
+    {
+        if (profile_file == "-")
+        {
+            profiler.report(std::cout, machine.get_memory());
+        }
+        else
+        {
+            std::ofstream report(profile_file);
+            if (!report.is_open())
+            {
+                std::cerr << "Cannot open profile file: " << profile_file << std::endl;
+                return 1;
+            }
+            profiler.report(report, machine.get_memory());
+        }
+    }
+
+    if (cache_model)
+    {
+        if (cache_file == "-")
+        {
+            cache_model->report(std::cout, machine.get_memory());
+        }
+        else
+        {
+            std::ofstream report(cache_file);
+            if (!report.is_open())
+            {
+                std::cerr << "Cannot open cache report file: " << cache_file << std::endl;
+                return 1;
+            }
+            cache_model->report(report, machine.get_memory());
+        }
+    }
+
+    if (timing_model)
+    {
+        if (timing_file == "-")
+        {
+            timing_model->report(std::cout, machine.get_memory());
+        }
+        else
+        {
+            std::ofstream report(timing_file);
+            if (!report.is_open())
+            {
+                std::cerr << "Cannot open timing report file: " << timing_file << std::endl;
+                return 1;
+            }
+            timing_model->report(report, machine.get_memory());
+        }
+    }
 
-    return 0;
+    return exit_status(status);
 }
@@ -0,0 +1,553 @@
+#include <algorithm>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <cstring>
+#include <stdexcept>
+
+#include "memory.hpp"
+
+#if MEMORY_GUARD_PAGES
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace
+{
+    struct sigaction previous_segv;
+    struct sigaction previous_bus;
+}
+
+// Записи не освобождаются, а переходят к следующей памяти: обработчик сигнала
+// может идти по списку в любой момент. Владелец пишется последним и стирается первым
+struct Memory::Registration
+{
+    std::atomic<Memory*> owner{nullptr};
+    std::atomic<const uint8_t*> lo{nullptr};
+    std::atomic<const uint8_t*> hi{nullptr};
+    Registration* next = nullptr;
+};
+
+std::atomic<Memory::Registration*> Memory::registrations{nullptr};
+
+namespace
+{
+    std::mutex registrations_mutex;
+}
+
+size_t Memory::page_size()
+{
+    static const size_t size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    return size;
+}
+
+void Memory::install_trap_handler()
+{
+    static std::once_flag installed;
+
+    std::call_once(installed, []
+    {
+        struct sigaction action{};
+        action.sa_sigaction = &Memory::trap_handler;
+        sigemptyset(&action.sa_mask);
+        // SA_NODEFER: выход через siglongjmp без восстановления маски не оставит SIGSEGV заблокированным
+        action.sa_flags = SA_SIGINFO | SA_NODEFER;
+
+        sigaction(SIGSEGV, &action, &previous_segv);
+        sigaction(SIGBUS, &action, &previous_bus);      // macOS сообщает о PROT_NONE через SIGBUS
+    });
+}
+
+void Memory::trap_handler(int signal, siginfo_t* info, void*)
+{
+    const uint8_t* addr = static_cast<const uint8_t*>(info->si_addr);
+
+    // Запись в закрытую неизменённую страницу: открыть её и повторить запись.
+    // Гость пишет изнутри guarded() — его память находится по цепочке без реестра.
+    // SIGBUS на Linux — обращение за конец файла из map_file, а не защита
+#if defined(__APPLE__)
+    bool protection = true;
+#else
+    bool protection = signal == SIGSEGV && info->si_code == SEGV_ACCERR;
+#endif
+    for (TrapScope* scope = active_scope(); protection && scope; scope = scope->previous)
+    {
+        if (const_cast<Memory*>(static_cast<const Memory*>(scope->owner))->open_page(addr))
+        {
+            return;
+        }
+    }
+    for (Registration* entry = registrations.load(std::memory_order_acquire); protection && entry; entry = entry->next)
+    {
+        Memory* owner = entry->owner.load(std::memory_order_acquire);
+        if (owner && addr >= entry->lo.load(std::memory_order_relaxed) &&
+            addr < entry->hi.load(std::memory_order_relaxed) && owner->open_page(addr))
+        {
+            return;
+        }
+    }
+
+    for (TrapScope* scope = active_scope(); scope; scope = scope->previous)
+    {
+        if (addr >= scope->lo && addr < scope->hi)
+        {
+            scope->fault_address = static_cast<uint32_t>(addr - scope->lo);
+            siglongjmp(scope->env, 1);
+        }
+    }
+
+    // Не гостевая ошибка: возвращаем прежний обработчик, инструкция повторится и упадёт как обычно
+    sigaction(signal, signal == SIGBUS ? &previous_bus : &previous_segv, nullptr);
+}
+
+Memory::Memory(size_t size_in_bytes)
+{
+    if (size_in_bytes > ADDRESS_SPACE)
+    {
+        throw std::invalid_argument("Memory size exceeds the 4 GiB guest address space");
+    }
+
+    install_trap_handler();
+
+    void* reserved = mmap(nullptr, ADDRESS_SPACE + GUARD_SIZE, PROT_NONE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+
+    base = static_cast<uint8_t*>(reserved);
+    limit = (size_in_bytes + page_size() - 1) & ~(page_size() - 1);
+
+    // Страницы открыты для записи: защита и учёт изменённых страниц включаются
+    // с первым baseline (snapshot или restore), до него запись ничего не стоит
+    if (limit != 0 && mprotect(base, limit, PROT_READ | PROT_WRITE) != 0)
+    {
+        munmap(base, ADDRESS_SPACE + GUARD_SIZE);
+        throw std::bad_alloc();
+    }
+
+    init_page_tracking(page_size());
+
+    std::lock_guard<std::mutex> lock(registrations_mutex);
+    for (Registration* entry = registrations.load(std::memory_order_relaxed); entry; entry = entry->next)
+    {
+        if (!entry->owner.load(std::memory_order_relaxed))
+        {
+            registration = entry;
+            break;
+        }
+    }
+    if (!registration)
+    {
+        registration = new Registration();
+        registration->next = registrations.load(std::memory_order_relaxed);
+        registrations.store(registration, std::memory_order_release);
+    }
+    registration->lo.store(base, std::memory_order_relaxed);
+    registration->hi.store(base + limit, std::memory_order_relaxed);
+    registration->owner.store(this, std::memory_order_release);
+}
+
+Memory::~Memory()
+{
+    if (registration)
+    {
+        std::lock_guard<std::mutex> lock(registrations_mutex);
+        registration->owner.store(nullptr, std::memory_order_release);
+    }
+    if (base)
+    {
+        munmap(base, ADDRESS_SPACE + GUARD_SIZE);
+    }
+}
+
+Memory::Memory(Memory&& other) noexcept
+    : page_shift(other.page_shift), page_state(std::move(other.page_state)),
+      dirty_pages(std::move(other.dirty_pages)), baseline(std::move(other.baseline)),
+      base(other.base), limit(other.limit), registration(other.registration)
+{
+    other.base = nullptr;
+    other.limit = 0;
+    other.registration = nullptr;
+    if (registration)
+    {
+        registration->owner.store(this, std::memory_order_release);
+    }
+}
+
+bool Memory::open_page(const uint8_t* addr) noexcept
+{
+    if (!baseline || addr < base || addr >= base + limit)
+    {
+        return false;
+    }
+
+    uint32_t offset = static_cast<uint32_t>(addr - base);
+    size_t page = size_t{1} << page_shift;
+
+    // Страницу мог уже открыть другой поток, который писал в неё одновременно:
+    // mprotect повторяется в любом случае
+    mark_dirty(offset);
+    return mprotect(base + (offset & ~(page - 1)), page, PROT_READ | PROT_WRITE) == 0 || open_all();
+}
+
+bool Memory::open_all() noexcept
+{
+    if (limit != 0 && mprotect(base, limit, PROT_READ | PROT_WRITE) != 0)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < page_state.size(); i++)
+    {
+        mark_dirty(static_cast<uint32_t>(i << page_shift));
+    }
+    return true;
+}
+
+void Memory::mark_dirty_range(uint32_t address, size_t size)
+{
+    // До первого baseline страницы открыты и не учитываются
+    if (size == 0 || !baseline)
+    {
+        return;
+    }
+
+    uint64_t first = address >> page_shift;
+    uint64_t last = (address + uint64_t{size} - 1) >> page_shift;
+    for (uint64_t page = first; page <= last; page++)
+    {
+        mark_dirty(static_cast<uint32_t>(page << page_shift));
+    }
+
+    if (mprotect(base + (first << page_shift), (last - first + 1) << page_shift, PROT_READ | PROT_WRITE) != 0 &&
+        !open_all())
+    {
+        throw std::runtime_error("Cannot unprotect guest memory");
+    }
+}
+
+void Memory::write_block(uint32_t address, const void* src, size_t size)
+{
+    if (address + uint64_t{size} > limit)
+    {
+        throw std::out_of_range("Memory block out of range");
+    }
+    mark_dirty_range(address, size);
+    std::memcpy(base + address, src, size);
+}
+
+void Memory::zero(uint32_t address, size_t size)
+{
+    uint64_t end = address + uint64_t{size};
+    if (end > limit)
+    {
+        throw std::out_of_range("Memory block out of range");
+    }
+
+    uint64_t first_page = (address + page_size() - 1) & ~uint64_t{page_size() - 1};
+    uint64_t last_page = end & ~uint64_t{page_size() - 1};
+
+    mark_dirty_range(address, size);
+
+    if (first_page >= last_page)
+    {
+        std::memset(base + address, 0, size);
+        return;
+    }
+
+    std::memset(base + address, 0, first_page - address);
+    std::memset(base + last_page, 0, end - last_page);
+
+    // Новое анонимное отображение поверх старого: нулевые страницы без касания памяти
+    void* fresh = mmap(base + first_page, last_page - first_page, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+    if (fresh == MAP_FAILED)
+    {
+        std::memset(base + first_page, 0, last_page - first_page);
+    }
+}
+
+size_t Memory::map_file(int fd, uint64_t file_offset, uint32_t address, size_t size)
+{
+    if (address + uint64_t{size} > limit)
+    {
+        throw std::out_of_range("Memory block out of range");
+    }
+
+    size_t mask = page_size() - 1;
+    size_t length = size & ~mask;
+
+    if ((address & mask) != 0 || (file_offset & mask) != 0 || length == 0)
+    {
+        return 0;
+    }
+
+    void* mapped = mmap(base + address, length, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_FIXED, fd, static_cast<off_t>(file_offset));
+    if (mapped == MAP_FAILED)
+    {
+        return 0;
+    }
+
+    mark_dirty_range(address, length);
+    return length;
+}
+
+namespace
+{
+    int create_image_file(size_t size)
+    {
+#if defined(__linux__)
+        int fd = memfd_create("guest-memory", MFD_CLOEXEC);
+#else
+        char name[] = "/tmp/guest-memory-XXXXXX";
+        int fd = mkstemp(name);
+        if (fd >= 0)
+        {
+            unlink(name);
+        }
+#endif
+        if (fd < 0 || ftruncate(fd, static_cast<off_t>(size)) != 0)
+        {
+            if (fd >= 0)
+            {
+                close(fd);
+            }
+            throw std::runtime_error("Cannot create memory snapshot file");
+        }
+        return fd;
+    }
+
+    bool all_zero(const uint8_t* bytes, size_t size)
+    {
+        uint64_t any = 0;
+        for (size_t i = 0; i < size; i += sizeof(uint64_t))
+        {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, sizeof(word));
+            any |= word;
+        }
+        return any == 0;
+    }
+}
+
+MemoryImage::~MemoryImage()
+{
+    if (view)
+    {
+        munmap(const_cast<uint8_t*>(view), length);
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+    }
+}
+
+std::shared_ptr<const MemoryImage> Memory::snapshot()
+{
+    if (baseline && dirty_pages.empty())
+    {
+        return baseline;
+    }
+
+    std::shared_ptr<MemoryImage> image(new MemoryImage());
+    image->length = limit;
+    image->pages = page_state.size();
+    image->page_shift = page_shift;
+    image->present.assign(image->pages, 0);
+    image->fd = create_image_file(limit);
+
+    if (limit != 0)
+    {
+        void* view = mmap(nullptr, limit, PROT_READ | PROT_WRITE, MAP_SHARED, image->fd, 0);
+        if (view == MAP_FAILED)
+        {
+            throw std::runtime_error("Cannot map memory snapshot file");
+        }
+        image->view = static_cast<const uint8_t*>(view);
+
+        // В файл попадают только ненулевые страницы, остальные остаются дырами.
+        // До первого baseline записи не учитывались: нули ищутся в каждой странице
+        size_t page = size_t{1} << page_shift;
+        bool tracked = baseline != nullptr;
+        for (size_t i = 0; i < page_state.size(); i++)
+        {
+            if (tracked ? page_state[i].load(std::memory_order_relaxed) != PAGE_ZERO
+                        : !all_zero(base + (i << page_shift), page))
+            {
+                std::memcpy(static_cast<uint8_t*>(view) + (i << page_shift), base + (i << page_shift), page);
+                image->present[i] = 1;
+                page_state[i].store(PAGE_CLEAN, std::memory_order_relaxed);
+            }
+        }
+        mprotect(view, limit, PROT_READ);
+        mprotect(base, limit, PROT_READ);
+    }
+
+    dirty_pages.clear();
+    baseline = image;
+    return baseline;
+}
+
+void Memory::restore(const std::shared_ptr<const MemoryImage>& image)
+{
+    if (!image || image->length != limit)
+    {
+        throw std::invalid_argument("Snapshot size does not match memory size");
+    }
+
+    if (image == baseline)
+    {
+        size_t page = size_t{1} << page_shift;
+        for (uint32_t i : dirty_pages)
+        {
+            uint8_t* target = base + (size_t{i} << page_shift);
+            if (image->present[i])
+            {
+                std::memcpy(target, image->view + (size_t{i} << page_shift), page);
+                page_state[i].store(PAGE_CLEAN, std::memory_order_relaxed);
+            }
+            else
+            {
+                std::memset(target, 0, page);
+                page_state[i].store(PAGE_ZERO, std::memory_order_relaxed);
+            }
+        }
+        // Одним вызовом на всю память: закрытие по странице дробило бы отображение
+        if (!dirty_pages.empty())
+        {
+            mprotect(base, limit, PROT_READ);
+        }
+        dirty_pages.clear();
+        return;
+    }
+
+    // Чужой снимок: вся память — частное отображение его файла, страницы
+    // разделяются со снимком до первой записи
+    if (limit != 0 && mmap(base, limit, PROT_READ, MAP_PRIVATE | MAP_FIXED, image->fd, 0) == MAP_FAILED)
+    {
+        throw std::runtime_error("Cannot map memory snapshot");
+    }
+
+    for (size_t i = 0; i < page_state.size(); i++)
+    {
+        page_state[i].store(image->present[i] ? PAGE_CLEAN : PAGE_ZERO, std::memory_order_relaxed);
+    }
+    dirty_pages.clear();
+    baseline = image;
+}
+
+#else
+
+Memory::Memory(size_t size_in_bytes) : data(size_in_bytes, 0)
+{
+    init_page_tracking(4096);
+}
+
+Memory::~Memory() = default;
+
+Memory::Memory(Memory&& other) noexcept
+    : page_shift(other.page_shift), page_state(std::move(other.page_state)),
+      dirty_pages(std::move(other.dirty_pages)), baseline(std::move(other.baseline)),
+      data(std::move(other.data))
+{
+}
+
+MemoryImage::~MemoryImage() = default;
+
+std::shared_ptr<const MemoryImage> Memory::snapshot()
+{
+    if (baseline && dirty_pages.empty())
+    {
+        return baseline;
+    }
+
+    std::shared_ptr<MemoryImage> image(new MemoryImage());
+    image->length = data.size();
+    image->pages = page_state.size();
+    image->page_shift = page_shift;
+    image->present.assign(image->pages, 1);
+    image->data = data;
+
+    std::fill(page_state.begin(), page_state.end(), PAGE_CLEAN);
+    dirty_pages.clear();
+    baseline = image;
+    return baseline;
+}
+
+// Без mmap страницы не разделяются: чужой снимок копируется целиком
+void Memory::restore(const std::shared_ptr<const MemoryImage>& image)
+{
+    if (!image || image->length != data.size())
+    {
+        throw std::invalid_argument("Snapshot size does not match memory size");
+    }
+
+    if (image == baseline)
+    {
+        size_t page = size_t{1} << page_shift;
+        for (uint32_t i : dirty_pages)
+        {
+            size_t offset = size_t{i} << page_shift;
+            size_t count = std::min(page, data.size() - offset);
+            std::copy_n(image->data.begin() + offset, count, data.begin() + offset);
+            page_state[i].store(PAGE_CLEAN, std::memory_order_relaxed);
+        }
+        dirty_pages.clear();
+        return;
+    }
+
+    data = image->data;
+    std::fill(page_state.begin(), page_state.end(), PAGE_CLEAN);
+    dirty_pages.clear();
+    baseline = image;
+}
+
+void Memory::write_block(uint32_t address, const void* src, size_t size)
+{
+    if (address + uint64_t{size} > data.size())
+    {
+        throw std::out_of_range("Memory block out of range");
+    }
+    std::copy_n(static_cast<const uint8_t*>(src), size, data.begin() + address);
+    mark_dirty_range(address, size);
+}
+
+void Memory::zero(uint32_t address, size_t size)
+{
+    if (address + uint64_t{size} > data.size())
+    {
+        throw std::out_of_range("Memory block out of range");
+    }
+    std::fill_n(data.begin() + address, size, 0);
+    mark_dirty_range(address, size);
+}
+
+void Memory::mark_dirty_range(uint32_t address, size_t size)
+{
+    if (size == 0)
+    {
+        return;
+    }
+
+    uint64_t last = (address + uint64_t{size} - 1) >> page_shift;
+    for (uint64_t page = address >> page_shift; page <= last; page++)
+    {
+        mark_dirty(static_cast<uint32_t>(page << page_shift));
+    }
+}
+
+#endif
+
+void Memory::init_page_tracking(size_t page_size)
+{
+    page_shift = 0;
+    while ((size_t{1} << page_shift) < page_size)
+    {
+        page_shift++;
+    }
+
+    size_t pages = (size() + page_size - 1) >> page_shift;
+    page_state = std::vector<std::atomic<uint8_t>>(pages);     // PAGE_ZERO
+    dirty_pages.reserve(pages);
+}
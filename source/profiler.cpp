@@ -0,0 +1,241 @@
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <vector>
+
+#include "disassembler.hpp"
+#include "memory.hpp"
+#include "profiler.hpp"
+
+namespace
+{
+    struct Executed
+    {
+        uint32_t pc;
+        Profiler::PcCounters counters;
+    };
+
+    struct Block
+    {
+        size_t first, last;             // индексы в executed, включительно
+        uint64_t entries;
+        uint64_t instructions;
+    };
+
+    struct Loop
+    {
+        uint32_t head, branch;
+        uint64_t iterations;            // сколько раз ушли назад
+        uint64_t instructions;          // выполнено внутри [head, branch]
+    };
+
+    constexpr uint8_t OP_BNE = 0b011000;
+    constexpr uint8_t OP_BEQ = 0b011010;
+    constexpr uint8_t OP_J   = 0b011111;
+
+    // Куда ведёт BNE/BEQ/J; false для прочих инструкций
+    bool branch_target(uint32_t word, uint32_t pc, uint32_t& target)
+    {
+        uint8_t opcode = (word >> 26) & 0x3F;
+        if (opcode == OP_BNE || opcode == OP_BEQ)
+        {
+            target = pc + static_cast<uint32_t>(static_cast<int16_t>(word & 0xFFFF) * 4);
+            return true;
+        }
+        if (opcode == OP_J)
+        {
+            target = (pc & 0xFFFFF000) | ((word & 0x3FFFFFF) << 2);
+            return true;
+        }
+        return false;
+    }
+
+    double percent(uint64_t part, uint64_t total)
+    {
+        return total ? 100.0 * static_cast<double>(part) / static_cast<double>(total) : 0.0;
+    }
+
+    void hex(std::ostream& out, uint32_t value)
+    {
+        out << "0x" << std::hex << std::setw(8) << std::setfill('0') << value << std::dec << std::setfill(' ');
+    }
+}
+
+const Profiler::PcCounters* Profiler::find(uint32_t pc) const
+{
+    auto it = pages.find(pc >> PAGE_SHIFT);
+    if (it == pages.end())
+    {
+        return nullptr;
+    }
+
+    const PcCounters& counters = it->second->counters[(pc & ((1u << PAGE_SHIFT) - 1)) >> 2];
+    return counters.executed ? &counters : nullptr;
+}
+
+void Profiler::clear()
+{
+    pages.clear();
+    last_index = UINT32_MAX;
+    last_page = nullptr;
+    mix.fill(0);
+    total = 0;
+    traffic.clear();
+}
+
+void Profiler::report(std::ostream& out, const Memory& memory, size_t top) const
+{
+    std::vector<Executed> executed;
+    for (const auto& page : pages)
+    {
+        for (uint32_t slot = 0; slot < PAGE_WORDS; slot++)
+        {
+            if (page.second->counters[slot].executed)
+            {
+                executed.push_back({ (page.first << PAGE_SHIFT) | (slot << 2), page.second->counters[slot] });
+            }
+        }
+    }
+    std::sort(executed.begin(), executed.end(), [](const Executed& a, const Executed& b) { return a.pc < b.pc; });
+
+    auto word_at = [&](uint32_t pc) { return uint64_t{pc} + 4 <= memory.size() ? memory.read<uint32_t>(pc) : 0; };
+
+    // Базовый блок — подряд идущие инструкции с одинаковым счётчиком, внутри нет переходов
+    std::vector<Block> blocks;
+    for (size_t i = 0; i < executed.size(); i++)
+    {
+        bool continues = !blocks.empty() && executed[i].pc == executed[i - 1].pc + 4 &&
+                         !ends_block(word_at(executed[i - 1].pc)) &&
+                         executed[i].counters.executed == executed[i - 1].counters.executed;
+        if (continues)
+        {
+            blocks.back().last = i;
+            blocks.back().instructions += executed[i].counters.executed;
+        }
+        else
+        {
+            blocks.push_back({ i, i, executed[i].counters.executed, executed[i].counters.executed });
+        }
+    }
+
+    // Цикл — переход назад, который хоть раз состоялся
+    std::vector<uint64_t> prefix(executed.size() + 1, 0);
+    for (size_t i = 0; i < executed.size(); i++)
+    {
+        prefix[i + 1] = prefix[i] + executed[i].counters.executed;
+    }
+    auto index_of = [&](uint32_t pc)
+    {
+        return static_cast<size_t>(std::lower_bound(executed.begin(), executed.end(), pc,
+            [](const Executed& e, uint32_t value) { return e.pc < value; }) - executed.begin());
+    };
+
+    std::vector<Loop> loops;
+    for (size_t i = 0; i < executed.size(); i++)
+    {
+        uint32_t target;
+        if (executed[i].counters.taken && branch_target(word_at(executed[i].pc), executed[i].pc, target) &&
+            target <= executed[i].pc)
+        {
+            loops.push_back({ target, executed[i].pc, executed[i].counters.taken,
+                              prefix[i + 1] - prefix[index_of(target)] });
+        }
+    }
+
+    std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) { return a.instructions > b.instructions; });
+    std::sort(loops.begin(), loops.end(), [](const Loop& a, const Loop& b) { return a.instructions > b.instructions; });
+
+    out << "=== Profile: " << total << " instructions, " << executed.size() << " distinct PCs ===" << std::endl;
+
+    out << std::endl << "Hot basic blocks:" << std::endl;
+    out << "  start       end         entries        instructions      %" << std::endl;
+    for (size_t i = 0; i < std::min(top, blocks.size()); i++)
+    {
+        const Block& block = blocks[i];
+        out << "  ";
+        hex(out, executed[block.first].pc);
+        out << "  ";
+        hex(out, executed[block.last].pc + 4);
+        out << std::setw(10) << block.entries << std::setw(20) << block.instructions
+            << std::fixed << std::setprecision(2) << std::setw(8) << percent(block.instructions, total) << std::endl;
+    }
+
+    out << std::endl << "Hot loops:" << std::endl;
+    out << "  head        back edge   iterations     instructions      %" << std::endl;
+    for (size_t i = 0; i < std::min(top, loops.size()); i++)
+    {
+        const Loop& loop = loops[i];
+        out << "  ";
+        hex(out, loop.head);
+        out << "  ";
+        hex(out, loop.branch);
+        out << std::setw(12) << loop.iterations << std::setw(18) << loop.instructions
+            << std::fixed << std::setprecision(2) << std::setw(8) << percent(loop.instructions, total) << std::endl;
+    }
+
+    out << std::endl << "Instruction mix:" << std::endl;
+    std::vector<std::pair<uint64_t, size_t>> mix_order;
+    for (size_t index = 0; index < mix.size(); index++)
+    {
+        if (mix[index])
+        {
+            mix_order.emplace_back(mix[index], index);
+        }
+    }
+    std::sort(mix_order.rbegin(), mix_order.rend());
+    for (const auto& entry : mix_order)
+    {
+        uint32_t word = entry.second < 64  ? static_cast<uint32_t>(entry.second) << 26
+                      : entry.second < 128 ? static_cast<uint32_t>(entry.second - 64)
+                                           : uint32_t{VECTOR_OPCODE} << 26 | static_cast<uint32_t>(entry.second - 128);
+        double share = percent(entry.first, total);
+        out << "  " << std::left << std::setw(8) << mnemonic(word) << std::right << std::setw(16) << entry.first
+            << std::fixed << std::setprecision(2) << std::setw(8) << share << "%  "
+            << std::string(static_cast<size_t>(share / 2), '#') << std::endl;
+    }
+
+    out << std::endl << "Memory traffic (" << (1u << range_shift) << "-byte ranges):" << std::endl;
+    std::vector<std::pair<uint32_t, Traffic>> ranges(traffic.begin(), traffic.end());
+    std::sort(ranges.begin(), ranges.end(), [](const auto& a, const auto& b)
+    {
+        return a.second.loads + a.second.stores > b.second.loads + b.second.stores;
+    });
+    for (size_t i = 0; i < std::min(top, ranges.size()); i++)
+    {
+        out << "  ";
+        hex(out, ranges[i].first << range_shift);
+        out << "  loads " << std::setw(14) << ranges[i].second.loads
+            << "  stores " << std::setw(14) << ranges[i].second.stores << std::endl;
+    }
+
+    out << std::endl << "Annotated hot code:" << std::endl;
+    for (size_t i = 0; i < std::min(top, blocks.size()); i++)
+    {
+        const Block& block = blocks[i];
+        out << "  block #" << i + 1 << std::endl;
+
+        for (size_t k = block.first; k <= block.last; k++)
+        {
+            uint32_t pc = executed[k].pc;
+            uint32_t word = word_at(pc);
+            const PcCounters& counters = executed[k].counters;
+
+            out << "    ";
+            hex(out, pc);
+            out << std::setw(14) << counters.executed << std::fixed << std::setprecision(2)
+                << std::setw(8) << percent(counters.executed, total) << "%  ";
+
+            uint32_t target;
+            if (branch_target(word, pc, target) && ((word >> 26) & 0x3F) != OP_J)
+            {
+                out << std::left << std::setw(28) << disassemble(word, pc) << std::right
+                    << "taken " << counters.taken << ", not taken " << counters.executed - counters.taken;
+            }
+            else
+            {
+                out << disassemble(word, pc);
+            }
+            out << std::endl;
+        }
+    }
+}
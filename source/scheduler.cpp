@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+#include "scheduler.hpp"
+
+struct Scheduler::Guest
+{
+    GuestId id;
+    std::unique_ptr<Machine> machine;
+    Done done;
+    Pause pause;
+    GuestStats stats;
+    uint64_t vtime = 0;
+    bool woken = false;                 // wake() пришёл, пока гость исполнялся
+    bool held = false;                  // ждёт, потому что так решил Pause
+};
+
+Scheduler::Scheduler(const SchedulerOptions& options)
+    : options(options),
+      threads(options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency()))
+{
+    if (options.quantum == 0)
+    {
+        throw std::invalid_argument("Scheduler quantum must be positive");
+    }
+}
+
+Scheduler::~Scheduler() = default;
+
+Scheduler::GuestId Scheduler::add(std::unique_ptr<Machine> machine, unsigned weight, Done done, Pause pause)
+{
+    if (weight == 0)
+    {
+        throw std::invalid_argument("Guest weight must be positive");
+    }
+
+    machine->get_cpu().set_quiet(true);
+    machine->set_time_limit({});
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto guest = std::make_unique<Guest>();
+    guest->id = guests.size();
+    guest->machine = std::move(machine);
+    guest->done = std::move(done);
+    guest->pause = std::move(pause);
+    guest->stats.weight = weight;
+    guest->vtime = min_vtime;
+
+    queue.emplace(guest->vtime, guest->id);
+    guests.push_back(std::move(guest));
+    changed.notify_one();
+    return guests.size() - 1;
+}
+
+void Scheduler::set_weight(GuestId id, unsigned weight)
+{
+    if (weight == 0)
+    {
+        throw std::invalid_argument("Guest weight must be positive");
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    find(id).stats.weight = weight;
+}
+
+void Scheduler::wake(GuestId id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Guest& guest = find(id);
+
+    if (guest.stats.state == State::Waiting)
+    {
+        held -= guest.held;
+        guest.held = false;
+        enqueue(guest);
+        changed.notify_one();
+    }
+    else if (guest.stats.state == State::Running)
+    {
+        guest.woken = true;
+    }
+}
+
+void Scheduler::run()
+{
+    std::vector<std::thread> workers;
+    for (unsigned i = 1; i < threads; i++)
+    {
+        workers.emplace_back([this] { work(); });
+    }
+    work();
+
+    for (std::thread& worker : workers)
+    {
+        worker.join();
+    }
+}
+
+Scheduler::GuestStats Scheduler::get_guest_stats(GuestId id) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return find(id).stats;
+}
+
+Scheduler::Stats Scheduler::get_stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+size_t Scheduler::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return guests.size();
+}
+
+Machine& Scheduler::get_machine(GuestId id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return *find(id).machine;
+}
+
+Scheduler::Guest& Scheduler::find(GuestId id) const
+{
+    if (id >= guests.size())
+    {
+        throw std::out_of_range("Unknown guest id");
+    }
+    return *guests[id];
+}
+
+void Scheduler::enqueue(Guest& guest)
+{
+    guest.vtime = std::max(guest.vtime, min_vtime);
+    guest.stats.state = State::Runnable;
+    queue.emplace(guest.vtime, guest.id);
+}
+
+void Scheduler::work()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    const Guest* previous = nullptr;
+
+    for (;;)
+    {
+        if (queue.empty())
+        {
+            if (running == 0 && held == 0)
+            {
+                changed.notify_all();
+                return;
+            }
+            changed.wait(lock);
+            continue;
+        }
+
+        Guest& guest = *guests[queue.begin()->second];
+        queue.erase(queue.begin());
+        guest.stats.state = State::Running;
+        min_vtime = std::max(min_vtime, guest.vtime);
+        running++;
+
+        stats.quanta++;
+        if (previous && previous != &guest)
+        {
+            stats.switches++;
+        }
+        previous = &guest;
+
+        uint64_t quantum = options.quantum;
+        if (options.max_instructions)
+        {
+            quantum = std::min(quantum, options.max_instructions - guest.stats.instructions);
+        }
+
+        // Машиной владеет только этот поток, пока гость в состоянии Running
+        lock.unlock();
+        Machine& machine = *guest.machine;
+        machine.set_instruction_limit(quantum);
+        CPU::RunStatus status = machine.run();
+        const Machine::Stats& run = machine.get_stats();
+        lock.lock();
+
+        guest.stats.status = status;
+        guest.stats.instructions += run.instructions;
+        guest.stats.cpu_seconds += run.seconds;
+        guest.stats.quanta++;
+        guest.vtime += run.instructions * WEIGHT_SCALE / guest.stats.weight;
+
+        bool limited = options.max_instructions && guest.stats.instructions >= options.max_instructions;
+        if (status == CPU::RunStatus::Stopped && !limited)
+        {
+            bool input_wait = machine.get_cpu().get_stop_reason() == CPU::StopReason::InputWait;
+            bool wait = input_wait;
+            if (guest.pause)
+            {
+                lock.unlock();
+                wait = guest.pause(guest.id, machine);
+                lock.lock();
+            }
+
+            if (wait && !guest.woken)
+            {
+                guest.stats.state = State::Waiting;
+                guest.stats.waits += input_wait;
+                guest.held = static_cast<bool>(guest.pause);
+                held += guest.held;
+            }
+            else
+            {
+                enqueue(guest);
+                changed.notify_one();
+            }
+            guest.woken = false;
+            running--;
+            continue;
+        }
+
+        guest.stats.state = State::Done;
+        stats.finished++;
+        if (guest.done)
+        {
+            lock.unlock();
+            guest.done(guest.id, machine, status);
+            lock.lock();
+        }
+        running--;
+    }
+}
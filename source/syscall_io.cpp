@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+#include "syscall_io.hpp"
+
+namespace
+{
+    const char BANNER[] = "=========================================================\n";
+}
+
+void BufferedIO::set_input(std::string data)
+{
+    in = std::move(data);
+    in_pos = 0;
+}
+
+void BufferedIO::append_input(std::string_view data)
+{
+    in.erase(0, in_pos);
+    in_pos = 0;
+    in.append(data.data(), data.size());
+}
+
+void BufferedIO::load_input(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+    {
+        throw std::runtime_error("Cannot open input file: " + path);
+    }
+    set_input(std::string(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()));
+}
+
+void BufferedIO::print_int(uint32_t value)
+{
+    char digits[16];
+    char* end = std::to_chars(digits, digits + sizeof(digits), value).ptr;
+
+    if (format == Format::Banner)
+    {
+        out += BANNER;
+        out += "Output: ";
+        out.append(digits, end);
+        out += '\n';
+        out += BANNER;
+    }
+    else
+    {
+        out.append(digits, end);
+        out += '\n';
+    }
+    written();
+}
+
+void BufferedIO::print_str(std::string_view text)
+{
+    out.append(text.data(), text.size());
+    written();
+}
+
+bool BufferedIO::read_int(uint32_t& value)
+{
+    if (format == Format::Banner)
+    {
+        out += "Input: ";
+    }
+
+    for (;;)
+    {
+        while (in_pos < in.size() && std::isspace(static_cast<unsigned char>(in[in_pos])))
+        {
+            in_pos++;
+        }
+        if (in_pos < in.size() || !refill())
+        {
+            break;
+        }
+    }
+
+    if (format == Format::Banner)
+    {
+        out += '\n';
+    }
+
+    if (in_pos == in.size())
+    {
+        return false;
+    }
+
+    // Токен целиком; отрицательные числа записываются в регистр по модулю 2^32
+    size_t end = in_pos;
+    while (end < in.size() && !std::isspace(static_cast<unsigned char>(in[end])))
+    {
+        end++;
+    }
+
+    int64_t parsed = 0;
+    auto result = std::from_chars(in.data() + in_pos, in.data() + end, parsed);
+    bool ok = result.ec == std::errc() && result.ptr == in.data() + end;
+    in_pos = end;
+
+    if (ok)
+    {
+        value = static_cast<uint32_t>(parsed);
+    }
+    return ok;
+}
+
+bool BufferedIO::read_line(std::string_view& line, size_t max)
+{
+    if (in_pos == in.size() && !refill())
+    {
+        return false;
+    }
+
+    size_t limit = std::min(in.size() - in_pos, max);
+    size_t newline = in.find('\n', in_pos);
+    size_t length = newline != std::string::npos && newline - in_pos <= limit ? newline - in_pos : limit;
+
+    line = std::string_view(in.data() + in_pos, length);
+    in_pos += length;
+
+    if (in_pos < in.size() && in[in_pos] == '\n')
+    {
+        in_pos++;
+    }
+    return true;
+}
+
+void BufferedIO::flush()
+{
+    if (sink && !out.empty())
+    {
+        sink->write(out.data(), static_cast<std::streamsize>(out.size()));
+        sink->flush();
+        out.clear();
+    }
+}
+
+bool BufferedIO::refill()
+{
+    if (!source)
+    {
+        return false;
+    }
+
+    flush();
+
+    std::string line;
+    if (!std::getline(*source, line))
+    {
+        return false;
+    }
+
+    append_input(line);
+    in += '\n';
+    return true;
+}
@@ -0,0 +1,269 @@
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+#include "disassembler.hpp"
+#include "memory.hpp"
+#include "timing_model.hpp"
+
+namespace
+{
+    const char* predictor_name(PredictorKind kind)
+    {
+        switch (kind)
+        {
+            case PredictorKind::Static:  return "static";
+            case PredictorKind::Bimodal: return "bimodal";
+            case PredictorKind::Gshare:  return "gshare";
+        }
+        return "?";
+    }
+
+    double percent(uint64_t part, uint64_t total)
+    {
+        return total ? 100.0 * static_cast<double>(part) / static_cast<double>(total) : 0.0;
+    }
+
+    void hex(std::ostream& out, uint32_t value)
+    {
+        out << "0x" << std::hex << std::setw(8) << std::setfill('0') << value << std::dec << std::setfill(' ');
+    }
+
+    void stall_line(std::ostream& out, const char* name, uint64_t cycles, uint64_t total)
+    {
+        out << "  " << std::left << std::setw(12) << name << std::right << std::setw(14) << cycles << std::fixed
+            << std::setprecision(2) << std::setw(9) << percent(cycles, total) << std::endl;
+    }
+}
+
+TimingModel::TimingModel(const TimingOptions& options)
+    : options(options)
+{
+    if (options.predictor_bits < 1 || options.predictor_bits > 24)
+    {
+        throw std::invalid_argument("Predictor bits must be in 1..24");
+    }
+    if (options.cls_latency == 0 || options.bext_latency == 0 || options.ssat_latency == 0)
+    {
+        throw std::invalid_argument("Execute latency must be positive");
+    }
+
+    table_mask = (1u << options.predictor_bits) - 1;
+    counters.assign(table_mask + 1, 1);
+}
+
+void TimingModel::retire(const Event& event)
+{
+    retired++;
+    stalls.fetch_miss += latency(event.fetch);
+
+    // С обходом результат ALU доступен следующей инструкции сразу, а результат
+    // загрузки — только после MEM: один пузырь
+    if ((pending_load >= 0 && (event.reads >> pending_load) & 1) ||
+        (pending_vector_load >= 0 && (event.vector_reads >> pending_vector_load) & 1))
+    {
+        stalls.load_use += options.load_use_penalty;
+    }
+    pending_load = -1;
+    pending_vector_load = -1;
+
+    switch (event.unit)
+    {
+        case Unit::Load:
+            stalls.data_miss += latency(event.data);
+            pending_load = event.writes;
+            pending_vector_load = event.vector_writes;
+            break;
+        case Unit::Store:
+            stalls.data_miss += latency(event.data);
+            break;
+        case Unit::Cls:
+            stalls.execute += options.cls_latency - 1;
+            break;
+        case Unit::Bext:
+            stalls.execute += options.bext_latency - 1;
+            break;
+        case Unit::Ssat:
+            stalls.execute += options.ssat_latency - 1;
+            break;
+        case Unit::Branch:
+        {
+            BranchCounters& counters = at(event.pc);
+            counters.executed++;
+            counters.taken += event.taken;
+            branches++;
+            if (!predict(event.pc, event.target, event.taken))
+            {
+                counters.mispredicted++;
+                mispredicted++;
+                stalls.branch += options.mispredict_penalty;
+            }
+            break;
+        }
+        case Unit::Jump:
+        {
+            BranchCounters& counters = at(event.pc);
+            counters.executed++;
+            counters.taken++;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+bool TimingModel::predict(uint32_t pc, uint32_t target, bool taken)
+{
+    if (options.predictor == PredictorKind::Static)
+    {
+        return (target <= pc) == taken;
+    }
+
+    uint32_t index = pc >> 2;
+    if (options.predictor == PredictorKind::Gshare)
+    {
+        index ^= history;
+        history = ((history << 1) | taken) & table_mask;
+    }
+
+    uint8_t& counter = counters[index & table_mask];
+    bool predicted = counter >= 2;
+    if (taken && counter < 3)
+    {
+        counter++;
+    }
+    else if (!taken && counter > 0)
+    {
+        counter--;
+    }
+    return predicted == taken;
+}
+
+const TimingModel::BranchCounters* TimingModel::find_branch(uint32_t pc) const
+{
+    auto it = branch_counters.find(pc);
+    return it == branch_counters.end() ? nullptr : &it->second;
+}
+
+void TimingModel::clear()
+{
+    std::fill(counters.begin(), counters.end(), 1);
+    history = 0;
+    retired = branches = mispredicted = 0;
+    stalls = {};
+    pending_load = pending_vector_load = -1;
+    branch_counters.clear();
+    last_branch = nullptr;
+}
+
+void TimingModel::report(std::ostream& out, const Memory& memory, size_t top) const
+{
+    uint64_t total = cycles();
+
+    out << "=== Timing model: " << retired << " instructions, " << total << " cycles, CPI " << std::fixed
+        << std::setprecision(3) << cpi() << " ===" << std::endl;
+
+    out << std::endl << "Stall cycles:" << std::endl;
+    out << "  cause               cycles  % cycles" << std::endl;
+    stall_line(out, "load-use", stalls.load_use, total);
+    stall_line(out, "execute", stalls.execute, total);
+    stall_line(out, "branch", stalls.branch, total);
+    stall_line(out, "fetch miss", stalls.fetch_miss, total);
+    stall_line(out, "data miss", stalls.data_miss, total);
+    stall_line(out, "total", stalls.total(), total);
+
+    out << std::endl << "Branches: " << predictor_name(options.predictor);
+    if (options.predictor != PredictorKind::Static)
+    {
+        out << " (" << options.predictor_bits << " bits)";
+    }
+    out << ", " << branches << " conditional, " << mispredicted << " mispredicted (" << std::fixed
+        << std::setprecision(2) << 100.0 * mispredict_rate() << "%)" << std::endl;
+
+    std::vector<std::pair<uint32_t, BranchCounters>> rows(branch_counters.begin(), branch_counters.end());
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b)
+    {
+        if (a.second.mispredicted != b.second.mispredicted)
+        {
+            return a.second.mispredicted > b.second.mispredicted;
+        }
+        return a.second.executed != b.second.executed ? a.second.executed > b.second.executed : a.first < b.first;
+    });
+
+    out << std::endl << "Branches with most mispredictions:" << std::endl;
+    out << "  pc            executed   taken %  mispredicted   miss %  instruction" << std::endl;
+    for (size_t i = 0; i < std::min(top, rows.size()); i++)
+    {
+        uint32_t pc = rows[i].first;
+        const BranchCounters& counters = rows[i].second;
+        uint32_t word = uint64_t{pc} + 4 <= memory.size() ? memory.read<uint32_t>(pc) : 0;
+
+        out << "  ";
+        hex(out, pc);
+        out << std::setw(12) << counters.executed << std::fixed << std::setprecision(2) << std::setw(10)
+            << percent(counters.taken, counters.executed) << std::setw(14) << counters.mispredicted
+            << std::setw(9) << percent(counters.mispredicted, counters.executed) << "  "
+            << disassemble(word, pc) << std::endl;
+    }
+}
+
+TimingOptions parse_timing_options(const std::string& spec)
+{
+    TimingOptions options;
+
+    std::istringstream items(spec);
+    std::string item;
+    while (std::getline(items, item, ','))
+    {
+        size_t equals = item.find('=');
+        if (equals == std::string::npos)
+        {
+            throw std::invalid_argument("Expected KEY=VALUE, got: " + item);
+        }
+        std::string key = item.substr(0, equals);
+        std::string value = item.substr(equals + 1);
+
+        if (key == "predictor")
+        {
+            if (value == "static")       options.predictor = PredictorKind::Static;
+            else if (value == "bimodal") options.predictor = PredictorKind::Bimodal;
+            else if (value == "gshare")  options.predictor = PredictorKind::Gshare;
+            else throw std::invalid_argument("Unknown branch predictor: " + value);
+            continue;
+        }
+
+        uint32_t* field = key == "bits"       ? &options.predictor_bits
+                        : key == "mispredict" ? &options.mispredict_penalty
+                        : key == "load-use"   ? &options.load_use_penalty
+                        : key == "cls"        ? &options.cls_latency
+                        : key == "bext"       ? &options.bext_latency
+                        : key == "ssat"       ? &options.ssat_latency
+                        : key == "l2"         ? &options.l2_latency
+                        : key == "memory"     ? &options.memory_latency
+                                              : nullptr;
+        if (!field)
+        {
+            throw std::invalid_argument("Unknown timing option: " + key);
+        }
+
+        size_t used = 0;
+        unsigned long number = 0;
+        try
+        {
+            number = std::stoul(value, &used);
+        }
+        catch (const std::logic_error&)
+        {
+            used = 0;
+        }
+        if (used == 0 || used != value.size() || number > UINT32_MAX)
+        {
+            throw std::invalid_argument("Bad value for " + key + ": " + value);
+        }
+        *field = static_cast<uint32_t>(number);
+    }
+    return options;
+}
@@ -0,0 +1,445 @@
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+#include "disassembler.hpp"
+#include "trace.hpp"
+
+namespace
+{
+    const char TRACE_MAGIC[4] = { 'C', 'T', 'R', 'C' };
+
+    uint32_t unzigzag(uint32_t value)
+    {
+        return (value >> 1) ^ (0u - (value & 1));
+    }
+
+    const char* event_name(TraceEvent kind)
+    {
+        switch (kind)
+        {
+            case TraceEvent::Halt:  return "halted";
+            case TraceEvent::Fault: return "fault";
+            case TraceEvent::Stop:  return "stopped";
+        }
+        return "event";
+    }
+}
+
+TraceRing::TraceRing(size_t capacity)
+{
+    size_t size = 1;
+    while (size < capacity)
+    {
+        size <<= 1;
+    }
+    buffer.resize(size);
+    mask = size - 1;
+}
+
+void TraceRing::push(const uint8_t* data, size_t size)
+{
+    size_t position = head.load(std::memory_order_relaxed);
+
+    // Место освобождает потребитель; ждать его — дешевле, чем терять записи
+    while (position + size - tail.load(std::memory_order_acquire) > buffer.size())
+    {
+        std::this_thread::yield();
+    }
+
+    size_t index = position & mask;
+    size_t first = std::min(size, buffer.size() - index);
+    std::memcpy(buffer.data() + index, data, first);
+    std::memcpy(buffer.data(), data + first, size - first);
+
+    head.store(position + size, std::memory_order_release);
+}
+
+size_t TraceRing::peek(const uint8_t*& data) const
+{
+    size_t position = tail.load(std::memory_order_relaxed);
+    size_t ready = head.load(std::memory_order_acquire) - position;
+    size_t index = position & mask;
+
+    data = buffer.data() + index;
+    return std::min(ready, buffer.size() - index);
+}
+
+void TraceRing::consume(size_t size)
+{
+    tail.store(tail.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+TraceWriter::TraceWriter(const std::string& path, size_t ring_size)
+    : chunk(CHUNK_SIZE), ring(std::max(ring_size, 2 * CHUNK_SIZE)), out(path, std::ios::binary | std::ios::trunc)
+{
+    if (!out.is_open())
+    {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+    writer = std::thread([this] { drain(); });
+}
+
+TraceWriter::~TraceWriter()
+{
+    try
+    {
+        close();
+    }
+    catch (const std::runtime_error&)
+    {
+    }
+}
+
+void TraceWriter::start(uint32_t pc, const uint32_t* gpr, const VectorRegister* vr)
+{
+    std::memcpy(chunk.data(), TRACE_MAGIC, sizeof(TRACE_MAGIC));
+    used = sizeof(TRACE_MAGIC);
+    chunk[used++] = static_cast<uint8_t>(TRACE_VERSION);
+    chunk[used++] = static_cast<uint8_t>(TRACE_VERSION >> 8);
+    chunk[used++] = 0;
+    chunk[used++] = 0;
+    put_u32(pc);
+    for (size_t i = 0; i < 32; i++)
+    {
+        put_u32(gpr[i]);
+    }
+    for (size_t i = 0; i < 32; i++)
+    {
+        for (uint32_t lane : vr[i].lane)
+        {
+            put_u32(lane);
+        }
+    }
+
+    next_pc = pc;
+    is_started = true;
+}
+
+void TraceWriter::event(TraceEvent kind, uint32_t pc, uint8_t code, uint32_t address)
+{
+    if (used > CHUNK_SIZE - MAX_RECORD)
+    {
+        flush_chunk();
+    }
+
+    chunk[used++] = TRACE_EVENT;
+    chunk[used++] = static_cast<uint8_t>(kind);
+    put_u32(pc);
+    if (kind == TraceEvent::Fault)
+    {
+        chunk[used++] = code;
+        put_u32(address);
+    }
+    next_pc = pc;
+}
+
+void TraceWriter::flush_chunk()
+{
+    ring.push(chunk.data(), used);
+    flushed += used;
+    used = 0;
+}
+
+void TraceWriter::close()
+{
+    if (closed)
+    {
+        return;
+    }
+    closed = true;
+
+    if (used)
+    {
+        flush_chunk();
+    }
+    stopping.store(true, std::memory_order_release);
+    writer.join();
+
+    out.close();
+    if (failed.load() || out.fail())
+    {
+        throw std::runtime_error("Cannot write trace file");
+    }
+}
+
+// Фоновый поток: пока есть данные — пишет их, иначе спит, чтобы не отнимать ядро у CPU.
+// После ошибки записи данные всё равно забираются, иначе производитель ждал бы вечно
+void TraceWriter::drain()
+{
+    for (;;)
+    {
+        const uint8_t* data;
+        size_t size = ring.peek(data);
+        if (size)
+        {
+            if (!failed.load(std::memory_order_relaxed))
+            {
+                out.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+                if (!out)
+                {
+                    failed.store(true);
+                }
+            }
+            ring.consume(size);
+            continue;
+        }
+
+        // push видим раньше stopping, поэтому после stopping кольцо проверяется ещё раз
+        if (stopping.load(std::memory_order_acquire))
+        {
+            if (ring.peek(data) == 0)
+            {
+                break;
+            }
+            continue;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    out.flush();
+    if (!out)
+    {
+        failed.store(true);
+    }
+}
+
+TraceReader::TraceReader(const std::string& path) : in(path, std::ios::binary)
+{
+    if (!in.is_open())
+    {
+        throw std::runtime_error("Cannot open trace file: " + path);
+    }
+
+    char magic[sizeof(TRACE_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, TRACE_MAGIC, sizeof(magic)) != 0)
+    {
+        throw std::runtime_error("Not a trace file: " + path);
+    }
+    offset = sizeof(magic);
+
+    uint32_t version = get_u32() & 0xFFFF;
+    if (version != TRACE_VERSION)
+    {
+        throw std::runtime_error("Unsupported trace version " + std::to_string(version) + ": " + path);
+    }
+
+    start_pc = next_pc = get_u32();
+    for (uint32_t& value : gpr)
+    {
+        value = get_u32();
+    }
+    for (VectorRegister& value : vr)
+    {
+        for (uint32_t& lane : value.lane)
+        {
+            lane = get_u32();
+        }
+    }
+    word_pcs.fill(UINT32_MAX);
+}
+
+uint8_t TraceReader::get_u8()
+{
+    int value = in.get();
+    if (value == std::char_traits<char>::eof())
+    {
+        throw std::runtime_error("Trace is truncated");
+    }
+    offset++;
+    return static_cast<uint8_t>(value);
+}
+
+uint32_t TraceReader::get_u32()
+{
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        value |= uint32_t{get_u8()} << (8 * i);
+    }
+    return value;
+}
+
+uint32_t TraceReader::get_varint()
+{
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        uint8_t byte = get_u8();
+        value |= uint32_t{byte & 0x7Fu} << shift;
+        if (!(byte & 0x80))
+        {
+            return value;
+        }
+    }
+    throw std::runtime_error("Trace is corrupted: varint too long");
+}
+
+bool TraceReader::next(TraceRecord& record)
+{
+    if (in.peek() == std::char_traits<char>::eof())
+    {
+        return false;
+    }
+
+    record = TraceRecord{};
+    uint8_t tag = get_u8();
+
+    if (tag == TRACE_EVENT)
+    {
+        record.is_event = true;
+        record.event = static_cast<TraceEvent>(get_u8());
+        record.pc = next_pc = get_u32();
+        if (record.event == TraceEvent::Fault)
+        {
+            record.fault_code = get_u8();
+            record.fault_address = get_u32();
+        }
+        return true;
+    }
+
+    record.pc = next_pc;
+    if (tag & TRACE_JUMP)
+    {
+        record.pc += unzigzag(get_varint());
+    }
+    next_pc = record.pc + 4;
+
+    size_t slot = (record.pc >> 2) & (TRACE_WORD_CACHE - 1);
+    if (tag & TRACE_WORD)
+    {
+        word_pcs[slot] = record.pc;
+        words[slot] = get_u32();
+    }
+    else if (word_pcs[slot] != record.pc)
+    {
+        throw std::runtime_error("Trace is corrupted: no instruction word for a PC");
+    }
+    record.word = words[slot];
+
+    if (tag & TRACE_MEMORY)
+    {
+        record.has_memory = true;
+        last_address += unzigzag(get_varint());
+        record.address = last_address;
+    }
+
+    if (tag & TRACE_REGISTER)
+    {
+        uint8_t index;
+        do
+        {
+            index = get_u8();
+            if (record.register_count == record.registers.size())
+            {
+                throw std::runtime_error("Trace is corrupted: too many register writes");
+            }
+            uint8_t reg = index & 0x1F;
+            record.registers[record.register_count] = reg;
+            record.old_values[record.register_count] = gpr[reg];
+            record.register_count++;
+            gpr[reg] += unzigzag(get_varint());
+        } while (index & 0x80);
+    }
+
+    if (tag & TRACE_VECTOR)
+    {
+        record.has_vector = true;
+        record.vector = get_u8() & 0x1F;
+        for (uint32_t& lane : vr[record.vector].lane)
+        {
+            lane = get_u32();
+        }
+    }
+
+    records++;
+    return true;
+}
+
+// Поля инструкции — как в CPU::Instruction: база LD/ST/VLD/VST в [25:21], данные в [20:16]
+void dump_trace(TraceReader& reader, std::ostream& out, uint64_t limit)
+{
+    TraceRecord record;
+    uint64_t shown = 0;
+
+    out << std::hex << std::setfill('0');
+    while ((limit == 0 || shown < limit) && reader.next(record))
+    {
+        shown++;
+
+        if (record.is_event)
+        {
+            out << "            " << event_name(record.event) << " at 0x" << std::setw(8) << record.pc;
+            if (record.event == TraceEvent::Fault)
+            {
+                out << " (code " << std::dec << unsigned{record.fault_code} << std::hex
+                    << ", address 0x" << std::setw(8) << record.fault_address << ")";
+            }
+            out << "\n";
+            continue;
+        }
+
+        std::string text = disassemble(record.word, record.pc);
+        out << std::dec << std::setfill(' ') << std::setw(10) << reader.instructions() << "  "
+            << std::hex << std::setfill('0') << "0x" << std::setw(8) << record.pc << "  " << text;
+        if (record.has_memory || record.register_count || record.has_vector)
+        {
+            out << std::string(text.size() < 28 ? 28 - text.size() : 1, ' ');
+        }
+
+        if (record.has_memory)
+        {
+            uint8_t opcode = (record.word >> 26) & 0x3F;
+            uint8_t data = (record.word >> 16) & 0x1F;
+            out << "  [0x" << std::setw(8) << record.address;
+            if (opcode == 0b110111)                         // ST
+            {
+                out << " <- 0x" << std::setw(8) << reader.get_register(data);
+            }
+            else if (opcode == 0b010101)                    // STP
+            {
+                out << " <- 0x" << std::setw(8) << reader.get_register(data)
+                    << ", 0x" << std::setw(8) << reader.get_register((record.word >> 11) & 0x1F);
+            }
+            else if (opcode == 0b110011)                    // VST
+            {
+                const VectorRegister& value = reader.get_vector(data);
+                out << " <-";
+                for (uint32_t lane : value.lane)
+                {
+                    out << " 0x" << std::setw(8) << lane;
+                }
+            }
+            out << "]";
+        }
+
+        for (uint8_t i = 0; i < record.register_count; i++)
+        {
+            uint8_t reg = record.registers[i];
+            out << "  r" << std::dec << unsigned{reg} << std::hex << "=0x" << std::setw(8) << reader.get_register(reg);
+        }
+
+        if (record.has_vector)
+        {
+            out << "  v" << std::dec << unsigned{record.vector} << std::hex << "=";
+            const VectorRegister& value = reader.get_vector(record.vector);
+            for (uint32_t lane = 0; lane < VECTOR_LANES; lane++)
+            {
+                out << (lane ? "," : "") << "0x" << std::setw(8) << value.lane[lane];
+            }
+        }
+        out << "\n";
+    }
+
+    out << std::dec << std::setfill(' ') << reader.instructions() << " instructions, " << reader.bytes()
+        << " bytes";
+    if (reader.instructions())
+    {
+        out << " (" << std::fixed << std::setprecision(2)
+            << static_cast<double>(reader.bytes() - TRACE_HEADER_SIZE) / reader.instructions()
+            << " bytes/instruction)";
+    }
+    out << "\n";
+}
@@ -0,0 +1,269 @@
+// Оттранслировано cpu_emulator aot из aot_sample.bin; не редактировать.
+// Базовые блоки — метки, регистры — локальные переменные; инструкции, которые
+// здесь не выполнить (SYSCALL, ошибки, запись в код), исполняет интерпретатор (run_aot)
+#include "aot.hpp"
+
+namespace
+{
+    const AotWord aot_sample_words[] =
+    {
+        { 0x00001000u, 0xb4010064u },
+        { 0x00001004u, 0xb4022000u },
+        { 0x00001008u, 0xe4440000u },
+        { 0x0000100cu, 0x00812012u },
+        { 0x00001010u, 0x0124000au },
+        { 0x00001014u, 0x3544a000u },
+        { 0x00001018u, 0xdc4a0400u },
+        { 0x0000101cu, 0xb4420004u },
+        { 0x00001020u, 0xb421ffffu },
+        { 0x00001024u, 0x6020fff9u },
+        { 0x00001028u, 0x01644814u },
+        { 0x0000102cu, 0x71803800u },
+        { 0x00001030u, 0x016c1836u },
+        { 0x00001034u, 0xb40d3000u },
+        { 0x00001038u, 0x55a36000u },
+        { 0x0000103cu, 0xb5ae0010u },
+        { 0x00001040u, 0x01c0601eu },
+        { 0x00001044u, 0x00000038u },
+        { 0x00001048u, 0xc5a10000u },
+        { 0x0000104cu, 0x80440005u },
+        { 0x00001050u, 0x80611003u },
+        { 0x00001054u, 0xcda30020u },
+        { 0x00001058u, 0x81e30006u },
+        { 0x0000105cu, 0x68a00003u },
+        { 0x00001060u, 0xb4101068u },
+        { 0x00001064u, 0xde000000u },
+        { 0x00001068u, 0x006f1812u },
+        { 0x0000106cu, 0x68c00003u },
+        { 0x00001070u, 0xb412fffcu },
+        { 0x00001074u, 0xe6530000u },
+        { 0x00001078u, 0xb4080001u },
+        { 0x0000107cu, 0x00000028u },
+        { 0x00001080u, 0x7c000422u },
+        { 0x00001088u, 0xb4080000u },
+        { 0x0000108cu, 0x00000028u },
+    };
+
+    AotExit aot_sample_run(CPU::State& state, Memory& memory, uint64_t& retired)
+    {
+        uint32_t x0 = state.gpr[0];
+        uint32_t x1 = state.gpr[1];
+        uint32_t x2 = state.gpr[2];
+        uint32_t x3 = state.gpr[3];
+        uint32_t x4 = state.gpr[4];
+        uint32_t x5 = state.gpr[5];
+        uint32_t x6 = state.gpr[6];
+        uint32_t x8 = state.gpr[8];
+        uint32_t x9 = state.gpr[9];
+        uint32_t x10 = state.gpr[10];
+        uint32_t x11 = state.gpr[11];
+        uint32_t x12 = state.gpr[12];
+        uint32_t x13 = state.gpr[13];
+        uint32_t x14 = state.gpr[14];
+        uint32_t x15 = state.gpr[15];
+        uint32_t x16 = state.gpr[16];
+        uint32_t x18 = state.gpr[18];
+        uint32_t x19 = state.gpr[19];
+        VectorRegister v1 = state.vr[1];
+        VectorRegister v2 = state.vr[2];
+        VectorRegister v3 = state.vr[3];
+        [[maybe_unused]] const uint64_t size = memory.size();
+        uint64_t n = 0;
+        uint32_t pc = state.pc;
+        AotExit why = AotExit::Interpret;
+
+        switch (state.pc)
+        {
+            case 0x00001000u: goto L_00001000;
+            case 0x00001008u: goto L_00001008;
+            case 0x00001028u: goto L_00001028;
+            case 0x00001060u: goto L_00001060;
+            case 0x00001068u: goto L_00001068;
+            case 0x00001070u: goto L_00001070;
+            case 0x00001078u: goto L_00001078;
+            case 0x00001080u: goto L_00001080;
+            case 0x00001088u: goto L_00001088;
+            default: goto leave;
+        }
+
+L_00001000:
+        // 0x00001000  ADDI r1, r0, 100
+        x1 = x0 + 0x00000064u;
+        // 0x00001004  ADDI r2, r0, 8192
+        x2 = x0 + 0x00002000u;
+        n += 2;
+
+L_00001008:
+        // 0x00001008  LD r4, 0(r2)
+        {
+            uint32_t a = x2 + 0x00000000u;
+            if (uint64_t{a} + 4 > size) { pc = 0x00001008u; goto leave; }
+            x4 = memory.read<uint32_t>(a);
+        }
+        // 0x0000100c  ADD r4, r4, r1
+        x4 = x4 + x1;
+        // 0x00001010  CLS r9, r4
+        x9 = count_leading_signs(x4);
+        // 0x00001014  SSAT r10, r4, #20
+        {
+            int32_t value = static_cast<int32_t>(x4);
+            x10 = static_cast<uint32_t>(value > 524287 ? 524287 : value < -524288 ? -524288 : value);
+        }
+        // 0x00001018  ST r10, 1024(r2)
+        {
+            uint32_t a = x2 + 0x00000400u;
+            if ((a & 3) == 0)
+            {
+                if (uint64_t{a} + 4 > size) { n += 4; pc = 0x00001018u; goto leave; }
+                if (uint64_t{a} + 4 > 0x00001000u && a <= 0x0000108fu) { n += 4; pc = 0x00001018u; why = AotExit::CodeWrite; goto leave; }
+                memory.write<uint32_t>(a, x10);
+            }
+        }
+        // 0x0000101c  ADDI r2, r2, 4
+        x2 = x2 + 0x00000004u;
+        // 0x00001020  ADDI r1, r1, -1
+        x1 = x1 + 0xffffffffu;
+        // 0x00001024  BNE r1, r0, 0x1008
+        if (x1 != x0) { n += 8; goto L_00001008; }
+        n += 8;
+
+L_00001028:
+        // 0x00001028  BEXT r11, r4, r9
+        x11 = extract_bits(x4, x9);
+        // 0x0000102c  SBIT r12, r0, #7
+        x12 = 0x00000080u;
+        // 0x00001030  SUB r3, r11, r12
+        x3 = x11 - x12;
+        // 0x00001034  ADDI r13, r0, 12288
+        x13 = x0 + 0x00003000u;
+        // 0x00001038  STP r3, r12, 0(r13)
+        {
+            uint32_t a = x13 + 0x00000000u;
+            if (uint64_t{a} + 8 > size) { n += 4; pc = 0x00001038u; goto leave; }
+            if (uint64_t{a} + 8 > 0x00001000u && a <= 0x0000108fu) { n += 4; pc = 0x00001038u; why = AotExit::CodeWrite; goto leave; }
+            memory.write<uint32_t>(a, x3);
+            memory.write<uint32_t>(a + 4, x12);
+        }
+        // 0x0000103c  ADDI r14, r13, 16
+        x14 = x13 + 0x00000010u;
+        // 0x00001040  CAS r12, r14, r0
+        {
+            uint32_t a = x14;
+            if ((a & 3) != 0) { n += 6; pc = 0x00001040u; goto leave; }
+            if (uint64_t{a} + 4 > size) { n += 6; pc = 0x00001040u; goto leave; }
+            if (uint64_t{a} + 4 > 0x00001000u && a <= 0x0000108fu) { n += 6; pc = 0x00001040u; why = AotExit::CodeWrite; goto leave; }
+            x12 = memory.compare_exchange(a, x0, x12);
+        }
+        // 0x00001044  FENCE
+        Memory::fence();
+        // 0x00001048  VLD v1, 0(r13)
+        {
+            uint32_t a = x13 + 0x00000000u;
+            if (uint64_t{a} + 16 > size) { n += 8; pc = 0x00001048u; goto leave; }
+            v1 = memory.read<VectorRegister>(a);
+        }
+        // 0x0000104c  VSPLAT v2, r4
+        v2 = vector_splat(x4);
+        // 0x00001050  VADDS v3, v1, v2
+        v3 = vector_add_saturated(v1, v2);
+        // 0x00001054  VST v3, 32(r13)
+        {
+            uint32_t a = x13 + 0x00000020u;
+            if (uint64_t{a} + 16 > size) { n += 11; pc = 0x00001054u; goto leave; }
+            if (uint64_t{a} + 16 > 0x00001000u && a <= 0x0000108fu) { n += 11; pc = 0x00001054u; why = AotExit::CodeWrite; goto leave; }
+            memory.write<VectorRegister>(a, v3);
+        }
+        // 0x00001058  VREDSUM r15, v3
+        x15 = vector_sum(v3);
+        // 0x0000105c  BEQ r5, r0, 0x1068
+        if (x5 == x0) { n += 14; goto L_00001068; }
+        n += 14;
+
+L_00001060:
+        // 0x00001060  ADDI r16, r0, 4200
+        x16 = x0 + 0x00001068u;
+        // 0x00001064  ST r0, 0(r16)
+        {
+            uint32_t a = x16 + 0x00000000u;
+            if ((a & 3) == 0)
+            {
+                if (uint64_t{a} + 4 > size) { n += 1; pc = 0x00001064u; goto leave; }
+                if (uint64_t{a} + 4 > 0x00001000u && a <= 0x0000108fu) { n += 1; pc = 0x00001064u; why = AotExit::CodeWrite; goto leave; }
+                memory.write<uint32_t>(a, x0);
+            }
+        }
+        n += 2;
+
+L_00001068:
+        // 0x00001068  ADD r3, r3, r15
+        x3 = x3 + x15;
+        // 0x0000106c  BEQ r6, r0, 0x1078
+        if (x6 == x0) { n += 2; goto L_00001078; }
+        n += 2;
+
+L_00001070:
+        // 0x00001070  ADDI r18, r0, -4
+        x18 = x0 + 0xfffffffcu;
+        // 0x00001074  LD r19, 0(r18)
+        {
+            uint32_t a = x18 + 0x00000000u;
+            if (uint64_t{a} + 4 > size) { n += 1; pc = 0x00001074u; goto leave; }
+            x19 = memory.read<uint32_t>(a);
+        }
+        n += 2;
+
+L_00001078:
+        // 0x00001078  ADDI r8, r0, 1
+        x8 = x0 + 0x00000001u;
+        // 0x0000107c  SYSCALL
+        { n += 1; pc = 0x0000107cu; goto leave; }
+
+L_00001080:
+        // 0x00001080  J 0x1088
+        { n += 1; goto L_00001088; }
+
+L_00001088:
+        // 0x00001088  ADDI r8, r0, 0
+        x8 = x0 + 0x00000000u;
+        // 0x0000108c  SYSCALL
+        { n += 1; pc = 0x0000108cu; goto leave; }
+
+leave:
+        state.gpr[0] = x0;
+        state.gpr[1] = x1;
+        state.gpr[2] = x2;
+        state.gpr[3] = x3;
+        state.gpr[4] = x4;
+        state.gpr[5] = x5;
+        state.gpr[6] = x6;
+        state.gpr[8] = x8;
+        state.gpr[9] = x9;
+        state.gpr[10] = x10;
+        state.gpr[11] = x11;
+        state.gpr[12] = x12;
+        state.gpr[13] = x13;
+        state.gpr[14] = x14;
+        state.gpr[15] = x15;
+        state.gpr[16] = x16;
+        state.gpr[18] = x18;
+        state.gpr[19] = x19;
+        state.vr[1] = v1;
+        state.vr[2] = v2;
+        state.vr[3] = v3;
+        state.pc = pc;
+        retired += n;
+        return why;
+    }
+}
+
+extern const AotProgram aot_sample =
+{
+    aot_sample_run, aot_sample_words, 35, 0x00001000u, 65536u
+};
+
+#ifndef AOT_NO_MAIN
+int main(int argc, char** argv)
+{
+    return aot_main(aot_sample, argc, argv);
+}
+#endif
@@ -0,0 +1,651 @@
+#include "../include/assembler.hpp"
+#include "../include/cpu.hpp"
+#include "../include/memory.hpp"
+#include "../include/image.hpp"
+#include "../include/machine.hpp"
+#include "../include/batch.hpp"
+#include "../include/lockstep.hpp"
+#include "../include/scheduler.hpp"
+#include "../include/syscall_io.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+// Бенчмарки эмулятора: микро (диспетчеризация, переходы, память, битовые
+// операции, системные вызовы) на каждом движке и макро (создание и загрузка
+// Machine). Результат — JSON в stdout или --output, ход прогона — в stderr
+
+namespace
+{
+    // Кодировщик: поля как в ReadMe, a = [25:21], b = [20:16], c = [15:11]
+    class Program
+    {
+    public:
+        std::vector<uint32_t> words;
+
+        uint32_t here() const { return static_cast<uint32_t>(words.size()); }
+
+        void add(uint32_t rd, uint32_t rs, uint32_t rt)   { r(rs, rt, rd, 0b010010); }
+        void cls(uint32_t rd, uint32_t rs)                { r(rd, rs, 0, 0b001010); }
+        void bext(uint32_t rd, uint32_t rs, uint32_t mask){ r(rd, rs, mask, 0b010100); }
+        void syscall()                                    { r(0, 0, 0, 0b101000); }
+        void sbit(uint32_t rd, uint32_t bit)              { words.push_back((0b011100u << 26) | (rd << 21) | (bit << 11)); }
+        void addi(uint32_t rt, uint32_t rs, int32_t imm)  { i(0b101101, rs, rt, imm); }
+        void ld(uint32_t rt, int32_t offset, uint32_t base) { i(0b111001, base, rt, offset); }
+        void st(uint32_t rt, int32_t offset, uint32_t base) { i(0b110111, base, rt, offset); }
+        void ssat(uint32_t rd, uint32_t rs, uint32_t bits){ words.push_back((0b001101u << 26) | (rd << 21) | (rs << 16) | (bits << 11)); }
+
+        // Векторные: v-регистры в тех же полях
+        void vld(uint32_t vt, int32_t offset, uint32_t base) { i(0b110001, base, vt, offset); }
+        void vst(uint32_t vt, int32_t offset, uint32_t base) { i(0b110011, base, vt, offset); }
+        void vadd(uint32_t vd, uint32_t vs1, uint32_t vs2)  { v(vd, vs1, vs2, 0b000001); }
+        void vssat(uint32_t vd, uint32_t vs, uint32_t bits) { v(vd, vs, bits, 0b000100); }
+        void vsplat(uint32_t vd, uint32_t rs)               { v(vd, rs, 0, 0b000101); }
+        void vredsum(uint32_t rd, uint32_t vs)              { v(rd, vs, 0, 0b000110); }
+
+        void stp(uint32_t rt1, uint32_t rt2, int32_t offset, uint32_t base)
+        {
+            words.push_back((0b010101u << 26) | (base << 21) | (rt1 << 16) | (rt2 << 11) |
+                            (static_cast<uint32_t>(offset) & 0x7FF));
+        }
+
+        // Переходы на индекс слова target
+        void bne(uint32_t rs, uint32_t rt, uint32_t target) { i(0b011000, rs, rt, relative(target)); }
+        void beq(uint32_t rs, uint32_t rt, uint32_t target) { i(0b011010, rs, rt, relative(target)); }
+
+        // Переход вперёд: цель ещё неизвестна, patch() допишет смещение
+        uint32_t beq_forward(uint32_t rs, uint32_t rt) { i(0b011010, rs, rt, 0); return here() - 1; }
+        uint32_t bne_forward(uint32_t rs, uint32_t rt) { i(0b011000, rs, rt, 0); return here() - 1; }
+        void patch(uint32_t branch) { words[branch] |= static_cast<uint32_t>(here() - branch) & 0xFFFF; }
+
+        void exit()
+        {
+            addi(8, 0, 0);
+            syscall();
+        }
+
+    private:
+        void r(uint32_t a, uint32_t b, uint32_t c, uint32_t funct) { words.push_back((a << 21) | (b << 16) | (c << 11) | funct); }
+        void v(uint32_t a, uint32_t b, uint32_t c, uint32_t funct) { words.push_back((0b100000u << 26) | (a << 21) | (b << 16) | (c << 11) | funct); }
+
+        void i(uint32_t opcode, uint32_t a, uint32_t b, int32_t imm)
+        {
+            words.push_back((opcode << 26) | (a << 21) | (b << 16) | (static_cast<uint32_t>(imm) & 0xFFFF));
+        }
+
+        int32_t relative(uint32_t target) const
+        {
+            return static_cast<int32_t>(target) - static_cast<int32_t>(here());
+        }
+    };
+
+    // Приёмник вывода, который всё выбрасывает: меряем эмулятор, а не терминал
+    class NullBuffer : public std::streambuf
+    {
+    protected:
+        int overflow(int c) override { return c; }
+        std::streamsize xsputn(const char*, std::streamsize n) override { return n; }
+    };
+
+    struct Kernel
+    {
+        const char* name;
+        size_t memory_size;
+        std::function<Program(uint32_t)> build;     // аргумент — log2 числа итераций
+        uint32_t shift;
+    };
+
+    // ADD/ADDI без зависимостей между соседями: цена одной диспетчеризации
+    Program dispatch_alu(uint32_t shift)
+    {
+        Program p;
+        p.sbit(1, shift);
+        p.addi(2, 0, 1);
+        uint32_t loop = p.here();
+        for (int k = 0; k < 4; k++)
+        {
+            p.add(3, 3, 2);
+            p.addi(4, 4, 3);
+            p.add(5, 5, 4);
+            p.addi(6, 6, -1);
+        }
+        p.addi(1, 1, -1);
+        p.bne(1, 0, loop);
+        p.add(3, 3, 5);
+        p.exit();
+        return p;
+    }
+
+    // Условные переходы, исход которых меняется от итерации к итерации
+    Program branches(uint32_t shift)
+    {
+        Program p;
+        p.sbit(1, shift);
+        p.addi(6, 0, 1);
+        p.addi(7, 0, 6);
+        uint32_t loop = p.here();
+        p.bext(5, 1, 6);                // младший бит счётчика
+        uint32_t even = p.beq_forward(5, 0);
+        p.addi(3, 3, 1);
+        p.addi(3, 3, 1);
+        p.patch(even);
+        p.bext(5, 1, 7);                // биты 1..2
+        uint32_t skip = p.bne_forward(5, 0);
+        p.addi(4, 4, 1);
+        p.patch(skip);
+        p.addi(1, 1, -1);
+        p.bne(1, 0, loop);
+        p.add(3, 3, 4);
+        p.exit();
+        return p;
+    }
+
+    // LD, LD, STP по буферу в 4 МиБ за 1 << shift проходов
+    Program memory_stream(uint32_t shift)
+    {
+        Program p;
+        p.sbit(9, shift);
+        uint32_t outer = p.here();
+        p.sbit(2, 20);                  // буфер с 0x100000
+        p.sbit(6, 22);
+        p.add(6, 6, 2);                 // конец буфера, 0x500000
+        uint32_t inner = p.here();
+        p.ld(4, 0, 2);
+        p.ld(5, 4, 2);
+        p.add(3, 3, 4);
+        p.add(3, 3, 5);
+        p.stp(3, 4, 8, 2);
+        p.addi(2, 2, 16);
+        p.bne(2, 6, inner);
+        p.addi(9, 9, -1);
+        p.bne(9, 0, outer);
+        p.st(3, 0, 0);
+        p.exit();
+        return p;
+    }
+
+    // CLS и BEXT над меняющимися данными
+    Program bit_manipulation(uint32_t shift)
+    {
+        Program p;
+        p.sbit(1, shift);
+        p.addi(3, 0, 12345);
+        uint32_t loop = p.here();
+        p.cls(4, 3);
+        p.bext(5, 3, 1);
+        p.add(3, 3, 4);
+        p.add(3, 3, 5);
+        p.addi(3, 3, 7);
+        p.cls(4, 1);
+        p.bext(5, 1, 3);
+        p.add(3, 3, 4);
+        p.add(3, 3, 5);
+        p.addi(1, 1, -1);
+        p.bne(1, 0, loop);
+        p.exit();
+        return p;
+    }
+
+    // Усиление с насыщением по буферу в 64 КиБ: x = SSAT(x + 1000, 16), сумма в r3.
+    // saturate_vector делает ту же работу по четыре слова за инструкцию
+    Program saturate_scalar(uint32_t shift)
+    {
+        Program p;
+        p.sbit(9, shift);
+        p.addi(7, 0, 1000);
+        uint32_t outer = p.here();
+        p.sbit(2, 20);
+        p.sbit(6, 16);
+        p.add(6, 6, 2);
+        uint32_t inner = p.here();
+        p.ld(4, 0, 2);
+        p.add(4, 4, 7);
+        p.ssat(4, 4, 16);
+        p.st(4, 0, 2);
+        p.add(3, 3, 4);
+        p.addi(2, 2, 4);
+        p.bne(2, 6, inner);
+        p.addi(9, 9, -1);
+        p.bne(9, 0, outer);
+        p.exit();
+        return p;
+    }
+
+    Program saturate_vector(uint32_t shift)
+    {
+        Program p;
+        p.sbit(9, shift);
+        p.addi(7, 0, 1000);
+        p.vsplat(7, 7);
+        uint32_t outer = p.here();
+        p.sbit(2, 20);
+        p.sbit(6, 16);
+        p.add(6, 6, 2);
+        uint32_t inner = p.here();
+        p.vld(4, 0, 2);
+        p.vadd(4, 4, 7);
+        p.vssat(4, 4, 16);
+        p.vst(4, 0, 2);
+        p.vadd(3, 3, 4);
+        p.addi(2, 2, 16);
+        p.bne(2, 6, inner);
+        p.addi(9, 9, -1);
+        p.bne(9, 0, outer);
+        p.vredsum(3, 3);
+        p.exit();
+        return p;
+    }
+
+    // SYS_PRINT_INT в цикле через BufferedIO без рамок
+    Program syscall_output(uint32_t shift)
+    {
+        Program p;
+        p.sbit(1, shift);
+        uint32_t loop = p.here();
+        p.add(3, 0, 1);
+        p.addi(8, 0, 1);
+        p.syscall();
+        p.addi(1, 1, -1);
+        p.bne(1, 0, loop);
+        p.exit();
+        return p;
+    }
+
+    // Задание для SIMT: n = SYS_READ_INT, 1024 прохода по n итераций; разные n — расхождение дорожек
+    Program read_and_loop()
+    {
+        Program p;
+        p.addi(8, 0, 3);
+        p.syscall();
+        p.add(1, 0, 3);
+        p.sbit(2, 10);
+        uint32_t outer = p.here();
+        p.addi(4, 1, 0);
+        uint32_t inner = p.here();
+        p.add(5, 5, 4);
+        p.addi(6, 6, 3);
+        p.cls(7, 5);
+        p.addi(4, 4, -1);
+        p.bne(4, 0, inner);
+        p.addi(2, 2, -1);
+        p.bne(2, 0, outer);
+        p.add(3, 5, 6);
+        p.exit();
+        return p;
+    }
+
+    struct Options
+    {
+        std::vector<CPU::Engine> engines = { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit };
+        std::string filter;
+        std::string output;
+        unsigned repetitions = 5;
+        bool quick = false;
+    };
+
+    const char* engine_name(CPU::Engine engine)
+    {
+        switch (engine)
+        {
+            case CPU::Engine::Switch:   return "switch";
+            case CPU::Engine::Threaded: return "threaded";
+            case CPU::Engine::Jit:      return "jit";
+        }
+        return "?";
+    }
+
+    struct Timing
+    {
+        double best = 0;
+        double median = 0;
+    };
+
+    Timing summarize(std::vector<double> seconds)
+    {
+        std::sort(seconds.begin(), seconds.end());
+        return { seconds.front(), seconds[seconds.size() / 2] };
+    }
+
+    bool selected(const Options& options, const std::string& name)
+    {
+        return options.filter.empty() || name.find(options.filter) != std::string::npos;
+    }
+
+    // Прогоняет ядро на каждом движке; на всех движках должен получиться один r3,
+    // а threaded должен обогнать switch
+    bool run_kernel(const Options& options, const Kernel& kernel, std::ostream& json, bool& first)
+    {
+        uint32_t shift = options.quick ? kernel.shift - std::min<uint32_t>(kernel.shift, 4) : kernel.shift;
+        Program program = kernel.build(shift);
+        NullBuffer discard;
+        std::ostream sink(&discard);
+
+        bool have_reference = false;
+        uint32_t reference = 0;
+        double switch_ns = 0;
+
+        for (CPU::Engine engine : options.engines)
+        {
+            std::vector<double> seconds;
+            uint64_t instructions = 0;
+
+            for (unsigned repetition = 0; repetition < options.repetitions; repetition++)
+            {
+                Machine machine(kernel.memory_size);
+                BufferedIO io(&sink, nullptr, SyscallIO::Format::Raw);
+                machine.get_cpu().set_io(io);
+                machine.get_cpu().set_quiet(true);
+                machine.set_engine(engine);
+
+                for (uint32_t k = 0; k < program.here(); k++)
+                {
+                    machine.get_memory().write<uint32_t>(DEFAULT_LOAD_ADDRESS + k * 4, program.words[k]);
+                }
+                machine.prepare_code(DEFAULT_LOAD_ADDRESS, DEFAULT_LOAD_ADDRESS + program.here() * 4);
+                machine.set_start_address(DEFAULT_LOAD_ADDRESS);
+
+                if (machine.run() != CPU::RunStatus::Halted)
+                {
+                    std::cerr << kernel.name << " on " << engine_name(engine) << ": guest did not halt normally" << std::endl;
+                    return false;
+                }
+
+                uint32_t result = machine.get_cpu().get_register(3);
+                if (have_reference && result != reference)
+                {
+                    std::cerr << kernel.name << " on " << engine_name(engine) << ": r3 = " << result
+                              << ", expected " << reference << std::endl;
+                    return false;
+                }
+                have_reference = true;
+                reference = result;
+
+                seconds.push_back(machine.get_stats().seconds);
+                instructions = machine.get_stats().instructions;
+            }
+
+            Timing timing = summarize(seconds);
+            double ns = timing.median * 1e9 / static_cast<double>(instructions);
+
+            std::cerr << std::left << std::setw(20) << kernel.name << std::setw(10) << engine_name(engine) << std::right
+                      << std::fixed << std::setprecision(2) << std::setw(8) << ns << " ns/instr "
+                      << std::setprecision(1) << std::setw(10) << 1e3 / ns << " MIPS" << std::endl;
+
+            json << (first ? "" : ",\n") << "    {\"name\": \"" << kernel.name << "\", \"engine\": \""
+                 << engine_name(engine) << "\", \"instructions\": " << instructions
+                 << ", \"repetitions\": " << options.repetitions << std::setprecision(9)
+                 << ", \"best_seconds\": " << timing.best << ", \"median_seconds\": " << timing.median
+                 << std::setprecision(3) << ", \"ns_per_instruction\": " << ns
+                 << ", \"mips\": " << 1e3 / ns;
+
+            // Шитый код существует только ради скорости: медленнее switch он не нужен.
+            // С --quick прогоны слишком короткие, там только предупреждение
+            if (engine == CPU::Engine::Switch)
+            {
+                switch_ns = ns;
+            }
+            else if (engine == CPU::Engine::Threaded && switch_ns > 0)
+            {
+                json << std::setprecision(3) << ", \"speedup_vs_switch\": " << switch_ns / ns;
+                if (ns > switch_ns)
+                {
+                    std::cerr << kernel.name << ": threaded is slower than switch" << std::endl;
+                    if (!options.quick)
+                    {
+                        return false;
+                    }
+                }
+            }
+            json << "}";
+            first = false;
+        }
+        return true;
+    }
+
+    // Стоимость операции над Machine: iterations повторов, медиана по repetitions
+    void run_macro(const Options& options, const char* name, uint32_t iterations,
+                   const std::function<void()>& operation, std::ostream& json, bool& first)
+    {
+        if (options.quick)
+        {
+            iterations = std::max<uint32_t>(1, iterations / 16);
+        }
+
+        std::vector<double> seconds;
+        for (unsigned repetition = 0; repetition < options.repetitions; repetition++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (uint32_t k = 0; k < iterations; k++)
+            {
+                operation();
+            }
+            seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+
+        Timing timing = summarize(seconds);
+        double us = timing.median * 1e6 / iterations;
+
+        std::cerr << std::left << std::setw(30) << name << std::right << std::fixed << std::setprecision(2)
+                  << std::setw(10) << us << " us/op" << std::endl;
+
+        json << (first ? "" : ",\n") << "    {\"name\": \"" << name << "\", \"iterations\": " << iterations
+             << ", \"repetitions\": " << options.repetitions << std::setprecision(9)
+             << ", \"best_seconds\": " << timing.best << ", \"median_seconds\": " << timing.median
+             << std::setprecision(3) << ", \"ns_per_operation\": " << timing.median * 1e9 / iterations << "}";
+        first = false;
+    }
+
+    bool parse_options(int argc, char** argv, Options& options)
+    {
+        for (int k = 1; k < argc; k++)
+        {
+            std::string arg = argv[k];
+            bool has_value = k + 1 < argc;
+
+            if (arg == "--engine" && has_value)
+            {
+                std::string name = argv[++k];
+                if (name == "switch")        options.engines = { CPU::Engine::Switch };
+                else if (name == "threaded") options.engines = { CPU::Engine::Threaded };
+                else if (name == "jit")      options.engines = { CPU::Engine::Jit };
+                else if (name != "all")
+                {
+                    std::cerr << "Unknown engine: " << name << std::endl;
+                    return false;
+                }
+            }
+            else if (arg == "--filter" && has_value)
+            {
+                options.filter = argv[++k];
+            }
+            else if (arg == "--repetitions" && has_value)
+            {
+                options.repetitions = std::max(1, std::atoi(argv[++k]));
+            }
+            else if (arg == "--output" && has_value)
+            {
+                options.output = argv[++k];
+            }
+            else if (arg == "--quick")
+            {
+                options.quick = true;
+            }
+            else
+            {
+                std::cerr << "Usage: cpu_emulator_bench [--engine switch|threaded|jit|all] [--filter NAME]\n"
+                             "                          [--repetitions N] [--quick] [--output FILE]" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options))
+    {
+        return 1;
+    }
+
+    const std::vector<Kernel> kernels =
+    {
+        { "dispatch_alu",     Machine::DEFAULT_SIZE, dispatch_alu,     20 },
+        { "branches",         Machine::DEFAULT_SIZE, branches,         21 },
+        { "memory_stream",    8 * 1024 * 1024,       memory_stream,    3 },
+        { "bit_manipulation", Machine::DEFAULT_SIZE, bit_manipulation, 20 },
+        { "syscall_output",   Machine::DEFAULT_SIZE, syscall_output,   18 },
+        { "saturate_scalar",  2 * 1024 * 1024,       saturate_scalar,  7 },
+        { "saturate_vector",  2 * 1024 * 1024,       saturate_vector,  7 },
+    };
+
+    std::ostringstream json;
+    json << std::fixed;
+    bool first = true;
+
+    for (const Kernel& kernel : kernels)
+    {
+        if (selected(options, kernel.name) && !run_kernel(options, kernel, json, first))
+        {
+            return 1;
+        }
+    }
+
+    // Образы для загрузки: сырой код и CEXE с мегабайтом данных и bss
+    Program code = dispatch_alu(10);
+    std::vector<uint8_t> code_bytes(code.words.size() * 4);
+    std::memcpy(code_bytes.data(), code.words.data(), code_bytes.size());
+
+    const std::string raw_path = "cpu_emulator_bench_code.bin";
+    const std::string image_path = "cpu_emulator_bench_image.cexe";
+    {
+        std::ofstream raw(raw_path, std::ios::binary);
+        raw.write(reinterpret_cast<const char*>(code_bytes.data()), static_cast<std::streamsize>(code_bytes.size()));
+    }
+    save_image(image_path, DEFAULT_LOAD_ADDRESS,
+        {
+            { SegmentKind::Code, DEFAULT_LOAD_ADDRESS, 0, 0, code_bytes },
+            { SegmentKind::Data, 0x100000, 0, 0, std::vector<uint8_t>(1024 * 1024, 0x5A) },
+            { SegmentKind::Bss, 0x200000, 0, 1024 * 1024, {} },
+        });
+
+    if (selected(options, "machine_construct"))
+    {
+        run_macro(options, "machine_construct", 2000, [] { Machine machine; }, json, first);
+        run_macro(options, "machine_construct_64MiB", 2000, [] { Machine machine(64 * 1024 * 1024); }, json, first);
+    }
+    if (selected(options, "machine_load"))
+    {
+        run_macro(options, "machine_load_raw", 2000, [&] { Machine machine; machine.load(raw_path); }, json, first);
+        run_macro(options, "machine_load_image_1MiB", 200,
+                  [&] { Machine machine(16 * 1024 * 1024); machine.load(image_path); }, json, first);
+    }
+
+    // 100 тыс. строк: 50 тыс. меток, за каждой — переход назад на неё
+    if (selected(options, "assemble"))
+    {
+        std::string source;
+        for (int k = 0; k < 50000; k++)
+        {
+            std::string label = "l" + std::to_string(k);
+            source += label + ":  ADDI r1, r1, 1   ; step\n    BNE r1, r0, " + label + "\n";
+        }
+        run_macro(options, "assemble_100k_lines", 5, [&] { assemble(source); }, json, first);
+    }
+
+    // Одна программа на 64 входах: по очереди на одной Machine и в лок-степе по 32 дорожки
+    if (selected(options, "simt"))
+    {
+        const std::string simt_path = "cpu_emulator_bench_simt.bin";
+        Program simt = read_and_loop();
+        {
+            std::ofstream raw(simt_path, std::ios::binary);
+            raw.write(reinterpret_cast<const char*>(simt.words.data()),
+                      static_cast<std::streamsize>(simt.words.size() * 4));
+        }
+
+        std::vector<BatchJob> jobs;
+        std::vector<std::vector<int32_t>> inputs;
+        for (int32_t k = 0; k < 64; k++)
+        {
+            jobs.push_back({ simt_path, { 20 + k % 17 } });
+            inputs.push_back(jobs.back().input);
+        }
+
+        BatchOptions separate;
+        separate.threads = 1;
+        run_macro(options, "simt_separate_64_jobs", 4, [&] { BatchRunner(separate).run(jobs); }, json, first);
+
+        LockstepOptions lanes;
+        lanes.lanes = 32;
+        LockstepRunner lockstep(simt_path, lanes);
+        run_macro(options, "simt_lockstep_64_jobs", 4, [&] { lockstep.run(inputs); }, json, first);
+
+        std::remove(simt_path.c_str());
+    }
+
+    // 16 гостей по очереди до конца и вперемешку квантами по 10000 инструкций: цена вытеснения
+    if (selected(options, "scheduler"))
+    {
+        Program guest = branches(16);
+        auto make = [&]
+        {
+            auto machine = std::make_unique<Machine>();
+            for (uint32_t k = 0; k < guest.here(); k++)
+            {
+                machine->get_memory().write<uint32_t>(DEFAULT_LOAD_ADDRESS + k * 4, guest.words[k]);
+            }
+            machine->prepare_code(DEFAULT_LOAD_ADDRESS, DEFAULT_LOAD_ADDRESS + guest.here() * 4);
+            machine->set_start_address(DEFAULT_LOAD_ADDRESS);
+            return machine;
+        };
+
+        for (uint64_t quantum : { uint64_t{10000}, uint64_t{1} << 40 })
+        {
+            SchedulerOptions scheduling;
+            scheduling.quantum = quantum;
+            const char* name = quantum > 10000 ? "scheduler_run_to_completion_16" : "scheduler_quantum_10000_16";
+
+            run_macro(options, name, 4, [&]
+            {
+                Scheduler scheduler(scheduling);
+                for (int k = 0; k < 16; k++)
+                {
+                    scheduler.add(make());
+                }
+                scheduler.run();
+            }, json, first);
+        }
+    }
+
+    std::remove(raw_path.c_str());
+    std::remove(image_path.c_str());
+
+    std::string report = "{\n  \"benchmarks\": [\n" + json.str() + "\n  ]\n}\n";
+    if (options.output.empty())
+    {
+        std::cout << report;
+    }
+    else
+    {
+        std::ofstream file(options.output);
+        if (!file.is_open())
+        {
+            std::cerr << "Cannot open output file: " << options.output << std::endl;
+            return 1;
+        }
+        file << report;
+    }
+    return 0;
+}
@@ -1,8 +1,33 @@
 #include "../include/cpu.hpp"
 #include "../include/memory.hpp"
+#include "../include/image.hpp"
+#include "../include/machine.hpp"
+#include "../include/batch.hpp"
+#include "../include/lockstep.hpp"
+#include "../include/smp_machine.hpp"
+#include "../include/profiler.hpp"
+#include "../include/bitops.hpp"
+#include "../include/trace.hpp"
+#include "../include/aot.hpp"
+#include "../include/assembler.hpp"
+#include "../include/event_loop.hpp"
+#include "../include/scheduler.hpp"
+#include "../include/cache_model.hpp"
+#include "../include/disassembler.hpp"
+#include "../include/timing_model.hpp"
+#include <algorithm>
+#include <array>
+#include <sstream>
 #include <iostream>
 #include <vector>
 #include <cstdint>
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <chrono>
+#include <thread>
+#include <unistd.h>
 
 void write_code_to_memory(const std::vector<uint32_t>& program, Memory& memory, CPU& cpu)
 {
@@ -17,29 +42,2000 @@ void write_code_to_memory(const std::vector<uint32_t>& program, Memory& memory,
     cpu.set_pc(code_start_address);
 }
 
+bool same_state(const CPU& a, const Memory& mem_a, const CPU& b, const Memory& mem_b)
+{
+    for (uint8_t i = 0; i < 32; i++)
+    {
+        if (a.get_register(i) != b.get_register(i))
+        {
+            return false;
+        }
+    }
+
+    if (a.get_pc() != b.get_pc() || mem_a.size() != mem_b.size() ||
+        a.get_fault() != b.get_fault() || a.get_fault_address() != b.get_fault_address() ||
+        a.get_retired() != b.get_retired())
+    {
+        return false;
+    }
+
+    for (uint32_t addr = 0; addr < mem_a.size(); addr += 4)
+    {
+        if (mem_a.read<uint32_t>(addr) != mem_b.read<uint32_t>(addr))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void test_(const std::vector<uint32_t>& program, uint32_t expected_result, const std::string& test_name)
+{
+    std::cout << "=== " << test_name << " ===" << std::endl;
+    Memory memory(64 * 1024);
+    CPU cpu;
+
+    write_code_to_memory(program, memory, cpu);
+    cpu.run(memory);
+
+    uint32_t result = cpu.get_register(3); // r3
+    std::cout << "Result: r3 = " << result << std::endl;
+
+    if (result == expected_result)
+    {
+        std::cout << "✓ TEST PASSED" << std::endl;
+    }
+    else
+    {
+        std::cout << "✗ TEST FAILED - Expected " << expected_result << ", got " << result << std::endl;
+    }
+
+    // Тот же код на остальных движках и на switch со слитыми парами должен дать
+    // побитово то же состояние; switch и шитый код сливают одни и те же пары
+    std::array<uint64_t, 3> dispatches_saved{};
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+    {
+        Memory engine_memory(64 * 1024);
+        CPU engine_cpu;
+        engine_cpu.set_engine(engine);
+
+        write_code_to_memory(program, engine_memory, engine_cpu);
+        engine_cpu.predecode(engine_memory, 0x1000, 0x1000 + program.size() * 4);
+        engine_cpu.run(engine_memory);
+        dispatches_saved[static_cast<size_t>(engine)] = engine_cpu.get_fusion_stats().dispatches_saved();
+
+        if (!same_state(cpu, memory, engine_cpu, engine_memory))
+        {
+            std::cout << "✗ TEST FAILED - engine " << static_cast<int>(engine)
+                      << " state differs from switch engine" << std::endl;
+        }
+    }
+    if (dispatches_saved[0] != dispatches_saved[1])
+    {
+        std::cout << "✗ TEST FAILED - switch engine executed " << dispatches_saved[0]
+                  << " fused pairs, threaded " << dispatches_saved[1] << std::endl;
+    }
+
+    // Отладочный цикл со сверкой кэша декодирования — то же состояние, что и быстрый
+    Memory checked_memory(64 * 1024);
+    CPU checked_cpu;
+    checked_cpu.set_checked(true);
+    write_code_to_memory(program, checked_memory, checked_cpu);
+    checked_cpu.predecode(checked_memory, 0x1000, 0x1000 + program.size() * 4);
+    checked_cpu.run(checked_memory);
+
+    if (!same_state(cpu, memory, checked_cpu, checked_memory))
+    {
+        std::cout << "✗ TEST FAILED - checked run differs from switch engine" << std::endl;
+    }
+    std::cout << "------------------------" << std::endl;
+}
+void test_memory_traps()
+{
+    std::cout << "=== Memory: 1 GiB lazily backed, access beyond size traps ===" << std::endl;
+    bool passed = true;
+
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+    {
+        // Страницы выделяются при первом обращении — 1 GiB не занимает физической памяти
+        Memory large_memory(1024u * 1024 * 1024);
+        CPU cpu;
+        cpu.set_engine(engine);
+
+        write_code_to_memory(
+            {
+                UINT32_C(0b01110000001000001110100000000000), // SBIT r1, r0, 29 (0x20000000)
+                UINT32_C(0b10110100000000100000000001001101), // ADDI r2, r0, 77
+                UINT32_C(0b11011100001000100111111111111100), // ST r2, 0x7FFC(r1)
+                UINT32_C(0b11100100001000110111111111111100), // LD r3, 0x7FFC(r1)
+                UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+                UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            },
+            large_memory, cpu);
+        cpu.run(large_memory);
+        passed = passed && cpu.get_register(3) == 77;
+
+        Memory small_memory(64 * 1024);
+        CPU trapping_cpu;
+        trapping_cpu.set_engine(engine);
+
+        write_code_to_memory(
+            {
+                UINT32_C(0b01110000001000001010000000000000), // SBIT r1, r0, 20 (1 MiB)
+                UINT32_C(0b11100100001000110000000000000000), // LD r3, 0(r1)
+                UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+                UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            },
+            small_memory, trapping_cpu);
+
+        CPU::RunStatus status = trapping_cpu.run(small_memory);
+        passed = passed && status == CPU::RunStatus::Faulted &&
+                 trapping_cpu.get_fault() == CPU::Fault::MemoryAccess &&
+                 trapping_cpu.get_pc() == 0x1004 && trapping_cpu.get_fault_pc() == 0x1004 &&
+                 trapping_cpu.get_fault_address() == 0x100000 && trapping_cpu.get_register(3) == 0;
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - large memory or trap misbehaved") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_image_loader()
+{
+    std::cout << "=== Image: code, data and bss segments with symbols ===" << std::endl;
+    const std::string path = "test_image.cexe";
+
+    auto words = [](const std::vector<uint32_t>& values)
+    {
+        std::vector<uint8_t> bytes(values.size() * 4);
+        std::memcpy(bytes.data(), values.data(), bytes.size());
+        return bytes;
+    };
+
+    // Страница данных плюс одно слово: целая страница отображается, хвост копируется
+    std::vector<uint32_t> data(1025, 0);
+    data[1024] = 40;
+
+    save_image(path, 0x1000,
+        {
+            { SegmentKind::Code, 0x1000, 0, 0, words({
+                UINT32_C(0b01110000001000000111000000000000), // SBIT r1, r0, 14 (0x4000)
+                UINT32_C(0b11100100001000110001000000000000), // LD r3, 0x1000(r1)
+                UINT32_C(0b11100100001001000010000000000000), // LD r4, 0x2000(r1)
+                UINT32_C(0b00000000011001000001100000010010), // ADD r3, r3, r4
+                UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+                UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            }) },
+            { SegmentKind::Data, 0x4000, 0, 0, words(data) },
+            { SegmentKind::Bss, 0x6000, 0, 0x1000, {} },
+        },
+        { { 0x1000, "main" }, { 0x4000, "table" } });
+
+    Memory memory(64 * 1024);
+    memory.write<uint32_t>(0x6000, 0xDEADBEEF);     // BSS обязан обнулиться
+
+    LoadedImage image = load_image(memory, path);
+    std::remove(path.c_str());
+
+    CPU cpu;
+    cpu.set_pc(image.entry);
+    cpu.run(memory);
+
+    bool passed = !image.raw && image.segments.size() == 3 && image.symbols.size() == 2 &&
+                  image.symbols[1].name == "table" && image.symbols[1].address == 0x4000 &&
+                  memory.read<uint32_t>(0x6000) == 0 && cpu.get_register(3) == 40 &&
+                  image.mapped_bytes + image.copied_bytes == 24 + 1025 * 4;
+#if MEMORY_GUARD_PAGES
+    passed = passed && (Memory::page_size() != 4096 || image.mapped_bytes == 4096);
+#endif
+
+    // Файл без заголовка — сырой код по адресу загрузки
+    std::vector<uint8_t> raw = words({
+        UINT32_C(0b10110100000000110000000000000111), // ADDI r3, r0, 7
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    });
+    {
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(raw.data()), raw.size());
+    }
+
+    Memory raw_memory(64 * 1024);
+    LoadedImage raw_image = load_image(raw_memory, path, 0x2000);
+    std::remove(path.c_str());
+
+    CPU raw_cpu;
+    raw_cpu.set_pc(raw_image.entry);
+    raw_cpu.run(raw_memory);
+    passed = passed && raw_image.raw && raw_image.entry == 0x2000 && raw_cpu.get_register(3) == 7;
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - image was not loaded as written") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_snapshots()
+{
+    std::cout << "=== Snapshot: restore, fork and self-modifying code ===" << std::endl;
+    bool passed = true;
+
+    const std::vector<uint32_t> counter =
+    {
+        UINT32_C(0b11100100000000110010000000000000), // LD r3, 0x2000(r0)
+        UINT32_C(0b10110100011000110000000000000001), // ADDI r3, r3, 1
+        UINT32_C(0b11011100000000110010000000000000), // ST r3, 0x2000(r0)
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    Machine machine;
+    machine.set_engine(CPU::Engine::Threaded);
+    write_code_to_memory(counter, machine.get_memory(), machine.get_cpu());
+    machine.prepare_code(0x1000, 0x1000 + counter.size() * 4);
+    machine.get_memory().write<uint32_t>(0x2000, 10);
+
+    Machine::Snapshot initial = machine.snapshot();
+
+    for (int i = 0; i < 3; i++)
+    {
+        machine.run();
+        passed = passed && machine.get_cpu().get_register(3) == 11 && machine.get_memory().get_dirty_pages().size() == 1;
+        machine.restore(initial);
+        passed = passed && machine.get_pc() == 0x1000 && !machine.is_halted() &&
+                 machine.get_memory().read<uint32_t>(0x2000) == 10 && machine.get_memory().get_dirty_pages().empty();
+    }
+
+    // Дочерняя машина пишет в свои копии страниц, родитель их не видит
+    std::unique_ptr<Machine> child = machine.fork(initial);
+    child->get_memory().write<uint32_t>(0x2000, 20);
+    child->run();
+    passed = passed && child->get_cpu().get_register(3) == 21 && child->get_engine() == CPU::Engine::Threaded &&
+             machine.get_memory().read<uint32_t>(0x2000) == 10;
+
+    machine.run();
+    passed = passed && machine.get_cpu().get_register(3) == 11;
+
+    // До первого снимка страницы не учитываются, но снимок видит все записи.
+    // Потом неизменённые страницы закрыты от записи: запись хоста вне guarded(), запись
+    // через границу страниц и CAS отмечают их изменёнными, restore закрывает снова
+    Memory tracked(1024 * 1024);
+    uint32_t page = uint32_t{1} << tracked.get_page_shift();
+    tracked.write<uint32_t>(0, 1);
+    tracked.write<uint32_t>(5 * page, 9);
+#if MEMORY_GUARD_PAGES
+    passed = passed && tracked.get_dirty_pages().empty();
+#endif
+    std::shared_ptr<const MemoryImage> image = tracked.snapshot();
+    passed = passed && image->read_word(0) == 1 && image->read_word(5 * page) == 9;
+    tracked.write<uint32_t>(2 * page - 2, 0xAABBCCDD);
+    tracked.compare_exchange(3 * page, 0, 7);
+    passed = passed && tracked.get_dirty_pages().size() == 3 && tracked.read<uint32_t>(2 * page - 2) == 0xAABBCCDD &&
+             tracked.read<uint32_t>(3 * page) == 7;
+    tracked.restore(image);
+    passed = passed && tracked.get_dirty_pages().empty() && tracked.read<uint32_t>(2 * page - 2) == 0 &&
+             tracked.read<uint32_t>(3 * page) == 0 && tracked.read<uint32_t>(0) == 1;
+    tracked.write<uint32_t>(0, 2);
+    passed = passed && tracked.get_dirty_pages().size() == 1 && tracked.read<uint32_t>(0) == 2;
+
+    // Код, переписанный программой, после восстановления снова исходный
+    const std::vector<uint32_t> patching =
+    {
+        UINT32_C(0b10110100000000110000000000000000), // ADDI r3, r0, 0
+        UINT32_C(0b10110100000001010000000000000010), // ADDI r5, r0, 2
+        UINT32_C(0b10110100011000110000000000000001), // ADDI r3, r3, 1 (patched at 0x1008)
+        UINT32_C(0b11100100000001100001000000100100), // LD r6, 0x1024(r0)
+        UINT32_C(0b11011100000001100001000000001000), // ST r6, 0x1008(r0)
+        UINT32_C(0b10110100101001011111111111111111), // ADDI r5, r5, -1
+        UINT32_C(0b01100000101000001111111111111100), // BNE r5, r0, -4
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b10110100011000110000000001100100), // data: ADDI r3, r3, 100
+    };
+
+    Machine patcher;
+    patcher.set_engine(CPU::Engine::Threaded);
+    write_code_to_memory(patching, patcher.get_memory(), patcher.get_cpu());
+    patcher.prepare_code(0x1000, 0x1000 + patching.size() * 4);
+
+    Machine::Snapshot before_patch = patcher.snapshot();
+    for (int i = 0; i < 2; i++)
+    {
+        patcher.run();
+        passed = passed && patcher.get_cpu().get_register(3) == 101;
+        patcher.restore(before_patch);
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - snapshot state differs") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_fault(const std::vector<uint32_t>& program, CPU::Fault expected_fault, uint32_t expected_pc,
+                const std::string& test_name)
+{
+    std::cout << "=== " << test_name << " ===" << std::endl;
+    bool passed = true;
+
+    for (int variant = 0; variant < 4; variant++)
+    {
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_engine(variant == 1 ? CPU::Engine::Threaded : variant == 2 ? CPU::Engine::Jit : CPU::Engine::Switch);
+        cpu.set_checked(variant == 3);
+
+        write_code_to_memory(program, memory, cpu);
+        cpu.predecode(memory, 0x1000, 0x1000 + program.size() * 4);
+
+        CPU::RunStatus status = cpu.run(memory);
+        passed = passed && status == CPU::RunStatus::Faulted && cpu.get_fault() == expected_fault &&
+                 cpu.get_pc() == expected_pc && cpu.get_fault_pc() == expected_pc;
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - fault is missing or imprecise") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_batch_runner()
+{
+    std::cout << "=== Batch: jobs with input on a work-stealing pool ===" << std::endl;
+
+    auto save_code = [](const std::string& path, const std::vector<uint32_t>& code)
+    {
+        std::vector<uint8_t> bytes(code.size() * 4);
+        std::memcpy(bytes.data(), code.data(), bytes.size());
+        save_image(path, 0x1000, { { SegmentKind::Code, 0x1000, 0, 0, bytes } });
+    };
+
+    save_code("test_batch_sum.cexe",
+        {
+            UINT32_C(0b10110100000010000000000000000011), // ADDI r8, r0, 3 (READ_INT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            UINT32_C(0b00000000000000110010000000010010), // ADD r4, r0, r3 (move)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            UINT32_C(0b00000000011001000001100000010010), // ADD r3, r3, r4
+            UINT32_C(0b10110100000010000000000000000001), // ADDI r8, r0, 1 (PRINT_INT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        });
+    save_code("test_batch_fault.cexe",
+        {
+            UINT32_C(0b10110100000000110000000000000001), // ADDI r3, r0, 1
+            UINT32_C(0b11111100000000000000000000000000), // unknown opcode 0x3F
+        });
+
+    std::vector<BatchJob> jobs;
+    for (int32_t i = 0; i < 40; i++)
+    {
+        jobs.push_back({ i % 5 == 4 ? "test_batch_fault.cexe" : "test_batch_sum.cexe", { i, -2 * i } });
+    }
+    jobs.push_back({ "test_batch_missing.cexe", {} });
+
+    bool passed = true;
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+    {
+        BatchOptions options;
+        options.threads = 3;
+        options.memory_size = 64 * 1024;
+        options.engine = engine;
+
+        BatchRunner runner(options);
+        std::vector<BatchResult> results = runner.run(jobs);
+
+        uint64_t instructions = 0;
+        for (int32_t i = 0; i < 40; i++)
+        {
+            const BatchResult& result = results[i];
+            instructions += result.instructions;
+
+            if (i % 5 == 4)
+            {
+                passed = passed && result.status == CPU::RunStatus::Faulted &&
+                         result.fault == CPU::Fault::IllegalInstruction && result.fault_pc == 0x1004 &&
+                         result.instructions == 1;
+            }
+            else
+            {
+                passed = passed && result.status == CPU::RunStatus::Halted && result.error.empty() &&
+                         static_cast<int32_t>(result.result) == -i && result.instructions == 9 &&
+                         result.output == std::to_string(static_cast<uint32_t>(-i)) + "\n";
+            }
+        }
+
+        const BatchResult& missing = results.back();
+        passed = passed && !missing.error.empty() && missing.instructions == 0 &&
+                 runner.get_stats().jobs == jobs.size() && runner.get_stats().threads == 3 &&
+                 runner.get_stats().instructions == instructions;
+    }
+
+    std::remove("test_batch_sum.cexe");
+    std::remove("test_batch_fault.cexe");
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - batch results differ from single runs") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_lockstep()
+{
+    std::cout << "=== Lockstep: SIMT lanes match separate runs ===" << std::endl;
+
+    // Цикл на n итераций с ветвлением по чётности: дорожки расходятся и сходятся.
+    // n = 13 — ошибка доступа, n = 7 — переписывает свой код и уходит из лок-степа
+    std::vector<uint32_t> code =
+        {
+            UINT32_C(0b10110100000010000000000000000011), // ADDI r8, r0, 3 (READ_INT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            UINT32_C(0b00000000011000000000100000010010), // ADD r1, r3, r0
+            UINT32_C(0b10110100000010100000000000001101), // ADDI r10, r0, 13
+            UINT32_C(0b01100000011010100000000000000011), // BNE r3, r10, +3
+            UINT32_C(0b10110100000010111111111111111100), // ADDI r11, r0, -4
+            UINT32_C(0b11100101011011000000000000000000), // LD r12, 0(r11) — n = 13: ошибка доступа
+            UINT32_C(0b10110100000010100000000000000111), // ADDI r10, r0, 7
+            UINT32_C(0b01100000011010100000000000000011), // BNE r3, r10, +3
+            UINT32_C(0b11100100000011010001000001110100), // LD r13, 0x1074(r0) — n = 7: ADDI r5, r5, 3 становится ADDI r5, r5, 5
+            UINT32_C(0b11011100000011010001000001000100), // ST r13, 0x1044(r0)
+            UINT32_C(0b10110100000000100010000000000000), // ADDI r2, r0, 0x2000
+            UINT32_C(0b10110100000001010000000000000000), // ADDI r5, r0, 0
+            UINT32_C(0b10110100000010010000000000000001), // ADDI r9, r0, 1
+            UINT32_C(0b01101000001000000000000000001010), // BEQ r1, r0, +10 (цикл n раз)
+            UINT32_C(0b00000000110000010100100000010100), // BEXT r6, r1, r9
+            UINT32_C(0b01101000110000000000000000000010), // BEQ r6, r0, +2 (нечётные — ещё +3)
+            UINT32_C(0b10110100101001010000000000000011), // ADDI r5, r5, 3
+            UINT32_C(0b11100100010001110000000000000000), // LD r7, 0(r2)
+            UINT32_C(0b00000000111000010011100000010010), // ADD r7, r7, r1
+            UINT32_C(0b11011100010001110000000000000000), // ST r7, 0(r2)
+            UINT32_C(0b00000000101001110010100000010010), // ADD r5, r5, r7
+            UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+            UINT32_C(0b01111100000000000000010000001110), // J 0x1038
+            UINT32_C(0b00000000101000000001100000010010), // ADD r3, r5, r0
+            UINT32_C(0b10110100000010000000000000000001), // ADDI r8, r0, 1 (PRINT_INT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            UINT32_C(0b10110100101001010000000000000101), // ADDI r5, r5, 5 (только данные)
+        };
+    std::vector<uint8_t> bytes(code.size() * 4);
+    std::memcpy(bytes.data(), code.data(), bytes.size());
+    save_image("test_lockstep.cexe", 0x1000, { { SegmentKind::Code, 0x1000, 0, 0, bytes } });
+
+    std::vector<BatchJob> jobs;
+    std::vector<std::vector<int32_t>> inputs;
+    for (int32_t n = 0; n < 40; n++)
+    {
+        jobs.push_back({ "test_lockstep.cexe", { (n * 7) % 40 } });
+        inputs.push_back(jobs.back().input);
+    }
+
+    auto same = [](const BatchResult& a, const BatchResult& b)
+    {
+        return a.status == b.status && a.fault == b.fault && a.fault_pc == b.fault_pc && a.result == b.result &&
+               a.instructions == b.instructions && a.output == b.output && a.error == b.error;
+    };
+
+    bool passed = true;
+
+    BatchOptions options;
+    options.threads = 2;
+    std::vector<BatchResult> expected = BatchRunner(options).run(jobs);
+
+    LockstepOptions lockstep_options;
+    lockstep_options.lanes = 12;
+    LockstepRunner lockstep("test_lockstep.cexe", lockstep_options);
+    std::vector<BatchResult> results = lockstep.run(inputs);
+
+    for (size_t k = 0; k < jobs.size(); k++)
+    {
+        passed = passed && same(results[k], expected[k]);
+    }
+    const LockstepRunner::Stats& stats = lockstep.get_stats();
+    passed = passed && lockstep.lanes() == 16 && stats.jobs == 40 && stats.detached == 1 &&
+             stats.lane_utilization(lockstep.lanes()) > 0.2 && stats.lane_utilization(lockstep.lanes()) < 1.0;
+
+    // Через пакетный режим, с лимитом: длинные задания останавливаются
+    options.lanes = 8;
+    options.max_instructions = 200;
+    std::vector<BatchResult> limited = BatchRunner(options).run(jobs);
+    for (size_t k = 0; k < jobs.size(); k++)
+    {
+        if (expected[k].instructions <= 200)
+        {
+            passed = passed && same(limited[k], expected[k]);
+        }
+        else
+        {
+            passed = passed && limited[k].status == CPU::RunStatus::Stopped &&
+                     limited[k].stop_reason == CPU::StopReason::InstructionLimit &&
+                     limited[k].instructions >= 200;
+        }
+    }
+
+    std::remove("test_lockstep.cexe");
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - lockstep lanes differ from separate runs") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_harts()
+{
+    std::cout << "=== Harts: shared counter incremented with CAS ===" << std::endl;
+
+    // Каждый hart пишет id + 1 в 0x2100 + 4 * id и 1000 раз прибавляет 1 к слову 0x2000
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000010000000000000000101), // ADDI r8, r0, 5 (HART_ID)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b00000000011000110010100000010010), // ADD r5, r3, r3
+        UINT32_C(0b00000000101001010010100000010010), // ADD r5, r5, r5
+        UINT32_C(0b10110100011001100000000000000001), // ADDI r6, r3, 1
+        UINT32_C(0b11011100101001100010000100000000), // ST r6, 0x2100(r5)
+        UINT32_C(0b10110100000000010000001111101000), // ADDI r1, r0, 1000
+        UINT32_C(0b10110100000000100010000000000000), // ADDI r2, r0, 0x2000
+        UINT32_C(0b11100100010001000000000000000000), // LD r4, 0(r2)
+        UINT32_C(0b10110100100001110000000000000001), // ADDI r7, r4, 1
+        UINT32_C(0b00000000010001000011100000011110), // CAS r7, r2, r4
+        UINT32_C(0b01100000111001001111111111111101), // BNE r7, r4, -3 (lost the race)
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111011), // BNE r1, r0, -5
+        UINT32_C(0b00000000000000000000000000111000), // FENCE
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    const size_t harts = 4;
+    bool passed = true;
+
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+    {
+        SmpMachine machine(harts, 64 * 1024);
+        machine.set_engine(engine);
+
+        for (size_t i = 0; i < program.size(); i++)
+        {
+            machine.get_memory().write<uint32_t>(0x1000 + static_cast<uint32_t>(i) * 4, program[i]);
+        }
+        machine.prepare_code(0x1000, 0x1000 + static_cast<uint32_t>(program.size()) * 4);
+        machine.set_start_address(0x1000);
+
+        passed = passed && machine.run() == CPU::RunStatus::Halted &&
+                 machine.get_memory().read<uint32_t>(0x2000) == harts * 1000;
+
+        for (size_t id = 0; id < harts; id++)
+        {
+            passed = passed && machine.get_memory().read<uint32_t>(0x2100 + static_cast<uint32_t>(id) * 4) == id + 1 &&
+                     machine.get_hart(id).get_hart_id() == id && machine.get_stats().retired[id] >= 8 + 6 * 1000;
+        }
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - increments were lost or harts misidentified") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_syscall_io()
+{
+    std::cout << "=== Syscall I/O: strings and numbers through a memory buffer ===" << std::endl;
+
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000000110010000000000000), // ADDI r3, r0, 0x2000
+        UINT32_C(0b10110100000001000000000000010000), // ADDI r4, r0, 16
+        UINT32_C(0b10110100000010000000000000000100), // ADDI r8, r0, 4 (READ_STR)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b00000000000000110010000000010010), // ADD r4, r0, r3
+        UINT32_C(0b10110100000000110010000000000000), // ADDI r3, r0, 0x2000
+        UINT32_C(0b10110100000010000000000000000010), // ADDI r8, r0, 2 (PRINT_STR)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b10110100000010000000000000000011), // ADDI r8, r0, 3 (READ_INT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b00000000000000110010100000010010), // ADD r5, r0, r3
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b00000000011001010001100000010010), // ADD r3, r3, r5
+        UINT32_C(0b10110100000010000000000000000001), // ADDI r8, r0, 1 (PRINT_INT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b10110100000000110010000000000000), // ADDI r3, r0, 0x2000
+        UINT32_C(0b10110100000001000000000000010000), // ADDI r4, r0, 16
+        UINT32_C(0b10110100000010000000000000000100), // ADDI r8, r0, 4 (READ_STR)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL (end of input)
+        UINT32_C(0b00000000000000110011000000010010), // ADD r6, r0, r3
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    bool passed = true;
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+    {
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_engine(engine);
+        cpu.set_quiet(true);
+
+        BufferedIO io;
+        io.set_input("hello, guest\n40 -2");
+        cpu.set_io(io);
+
+        write_code_to_memory(program, memory, cpu);
+        cpu.predecode(memory, 0x1000, 0x1000 + program.size() * 4);
+        cpu.run(memory);
+
+        char text[13] = {};
+        for (uint32_t i = 0; i < 12; i++)
+        {
+            text[i] = static_cast<char>(memory.read<uint8_t>(0x2000 + i));
+        }
+
+        passed = passed && io.output() == "hello, guest38\n" && std::string(text) == "hello, guest" &&
+                 cpu.get_register(6) == 0xFFFFFFFF && cpu.get_fault() == CPU::Fault::None;
+    }
+
+    // Рамки и приглашения — формат по умолчанию
+    BufferedIO banner(nullptr, nullptr, SyscallIO::Format::Banner);
+    banner.print_int(7);
+    passed = passed && banner.output().find("Output: 7\n") != std::string::npos && banner.output().front() == '=';
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - guest I/O differs") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_profiler()
+{
+    std::cout << "=== Profiler: per-PC counts, branch outcomes, memory traffic ===" << std::endl;
+
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000000010000000000001010), // ADDI r1, r0, 10
+        UINT32_C(0b10110100000000100010000000000000), // ADDI r2, r0, 0x2000
+        UINT32_C(0b11100100010001000000000000000000), // LD r4, 0(r2)
+        UINT32_C(0b10110100100001000000000000000001), // ADDI r4, r4, 1
+        UINT32_C(0b11011100010001000000000000000000), // ST r4, 0(r2)
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111100), // BNE r1, r0, -4
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    bool passed = true;
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+    {
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_engine(engine);
+        cpu.set_quiet(true);
+
+        Profiler profiler;
+        cpu.set_profiler(&profiler);
+
+        // Слитые ADDI+BNE в кэше декодирования профиль не искажают
+        write_code_to_memory(program, memory, cpu);
+        cpu.predecode(memory, 0x1000, 0x1000 + program.size() * 4);
+        cpu.run(memory);
+
+        const Profiler::PcCounters* head = profiler.find(0x1008);
+        const Profiler::PcCounters* branch = profiler.find(0x1018);
+        const auto& traffic = profiler.get_traffic();
+        auto data = traffic.find(0x2000 >> profiler.get_range_shift());
+
+        passed = passed && cpu.get_fault() == CPU::Fault::None && memory.read<uint32_t>(0x2000) == 10 &&
+                 profiler.instructions() == 54 && cpu.get_retired() == 54 &&
+                 head && head->executed == 10 && branch && branch->executed == 10 && branch->taken == 9 &&
+                 profiler.find(0x1000)->executed == 1 && !profiler.find(0x1024) &&
+                 profiler.opcode_count(0b111001) == 10 && profiler.opcode_count(0b101101) == 23 &&
+                 profiler.funct_count(0b101000) == 1 &&
+                 data != traffic.end() && data->second.loads == 10 && data->second.stores == 10;
+
+        std::ostringstream report;
+        profiler.report(report, memory);
+        passed = passed && report.str().find("LD r4, 0(r2)") != std::string::npos &&
+                 report.str().find("taken 9, not taken 1") != std::string::npos;
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - profile differs") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_run_limits()
+{
+    std::cout << "=== Run limits: instruction budget, timeout, resume ===" << std::endl;
+
+    const std::vector<uint32_t> loop =
+    {
+        UINT32_C(0b10110100000000010000001111101000), // ADDI r1, r0, 1000
+        UINT32_C(0b10110100011000110000000000000010), // ADDI r3, r3, 2
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111110), // BNE r1, r0, -2
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+    const std::vector<uint32_t> spin =
+    {
+        UINT32_C(0b01111100000000000000000000000000), // J 0x1000
+    };
+
+    bool passed = true;
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+    {
+        // Бесконечный цикл останавливается лимитом, перебор — не больше блока
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_engine(engine);
+        cpu.set_quiet(true);
+        cpu.set_instruction_limit(10000);
+        write_code_to_memory(spin, memory, cpu);
+
+        passed = passed && cpu.run(memory) == CPU::RunStatus::Stopped &&
+                 cpu.get_stop_reason() == CPU::StopReason::InstructionLimit &&
+                 cpu.get_retired() >= 10000 && cpu.get_retired() <= 10000 + Jit::MAX_BLOCK_INSTRUCTIONS;
+
+        cpu.set_instruction_limit(0);
+        cpu.set_time_limit(std::chrono::milliseconds(20));
+        passed = passed && cpu.run(memory) == CPU::RunStatus::Stopped &&
+                 cpu.get_stop_reason() == CPU::StopReason::TimeLimit && cpu.get_fault() == CPU::Fault::None;
+
+        // Остановленный run() продолжается следующим вызовом без потерь;
+        // SYS_EXIT ровно на границе лимита — это Halted, а не Stopped
+        for (uint64_t limit : { 500, 3003 })
+        {
+            Machine machine;
+            machine.set_engine(engine);
+            machine.get_cpu().set_quiet(true);
+            machine.set_instruction_limit(limit);
+            write_code_to_memory(loop, machine.get_memory(), machine.get_cpu());
+            machine.prepare_code(0x1000, 0x1000 + loop.size() * 4);
+
+            uint64_t total = 0;
+            int runs = 0;
+            CPU::RunStatus status;
+            do
+            {
+                status = machine.run();
+                total += machine.get_stats().instructions;
+                runs++;
+            } while (status == CPU::RunStatus::Stopped && runs < 100);
+
+            passed = passed && status == CPU::RunStatus::Halted && machine.get_cpu().get_register(3) == 2000 &&
+                     total == 3003 && machine.get_cpu().get_retired() == 3003 && (limit == 500 ? runs >= 6 : runs == 1);
+        }
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - run limits") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+// Исходные побитовые CLS и BEXT — эталон для ускоренных реализаций
+uint32_t reference_cls(uint32_t value)
+{
+    uint32_t sign_bit = (value >> 31) & 1;
+    uint32_t count = 0;
+    for (int i = 31; i >= 0 && ((value >> i) & 1) == sign_bit; i--)
+    {
+        count++;
+    }
+    return count;
+}
+
+uint32_t reference_bext(uint32_t value, uint32_t mask)
+{
+    uint32_t result = 0;
+    for (uint32_t i = 0, count = 0; i < 32; i++)
+    {
+        if (mask & (1u << i))
+        {
+            result |= ((value >> i) & 1) << count++;
+        }
+    }
+    return result;
+}
+
+void test_bit_ops()
+{
+    std::cout << "=== CLS/BEXT: every implementation and engine against the bit loops ===" << std::endl;
+
+    std::vector<uint32_t> inputs = { 0, 1, 0x7FFFFFFF, 0x80000000, 0xFFFFFFFF, 0xFFFFFFFE, 0x55555555, 0xAAAAAAAA };
+    uint32_t state = 2463534242u;
+    auto next = [&state]
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        return state;
+    };
+
+    bool passed = true;
+    for (uint32_t a : inputs)
+    {
+        passed = passed && count_leading_signs(a) == reference_cls(a);
+    }
+    for (int i = 0; i < (1 << 20); i++)
+    {
+        uint32_t value = next();
+        passed = passed && count_leading_signs(value) == reference_cls(value) &&
+                 count_leading_signs(value >> (i & 31)) == reference_cls(value >> (i & 31));
+    }
+
+    for (const BitExtract& implementation : bit_extract_implementations())
+    {
+        for (uint32_t a : inputs)
+        {
+            for (uint32_t b : inputs)
+            {
+                passed = passed && implementation.extract(a, b) == reference_bext(a, b);
+            }
+        }
+        for (int i = 0; i < (1 << 20); i++)
+        {
+            uint32_t value = next();
+            uint32_t mask = next();
+            passed = passed && implementation.extract(value, mask) == reference_bext(value, mask);
+        }
+    }
+
+    // 256 пар (value, mask) из 0x4000, результаты CLS/BEXT парами в 0x6000;
+    // цикл горячий, так что JIT его транслирует
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000000010000000100000000), // ADDI r1, r0, 256
+        UINT32_C(0b10110100000000100100000000000000), // ADDI r2, r0, 0x4000
+        UINT32_C(0b10110100000010010110000000000000), // ADDI r9, r0, 0x6000
+        UINT32_C(0b11100100010001000000000000000000), // LD r4, 0(r2)
+        UINT32_C(0b11100100010001010000000000000100), // LD r5, 4(r2)
+        UINT32_C(0b00000000110001000000000000001010), // CLS r6, r4
+        UINT32_C(0b00000000111001000010100000010100), // BEXT r7, r4, r5
+        UINT32_C(0b01010101001001100011100000000000), // STP r6, r7, 0(r9)
+        UINT32_C(0b10110100010000100000000000001000), // ADDI r2, r2, 8
+        UINT32_C(0b10110101001010010000000000001000), // ADDI r9, r9, 8
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111000), // BNE r1, r0, -8
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    std::vector<uint32_t> data;
+    for (uint32_t a : inputs)
+    {
+        for (uint32_t b : inputs)
+        {
+            data.push_back(a);
+            data.push_back(b);
+        }
+    }
+    while (data.size() < 512)
+    {
+        data.push_back(next() >> (next() & 31));
+        data.push_back(next());
+    }
+
+    std::string selected = bit_extract->name;
+    for (const BitExtract& implementation : bit_extract_implementations())
+    {
+        select_bit_extract(implementation.name);
+        for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+        {
+            Memory memory(64 * 1024);
+            CPU cpu;
+            cpu.set_engine(engine);
+            cpu.set_quiet(true);
+            write_code_to_memory(program, memory, cpu);
+            for (size_t i = 0; i < data.size(); i++)
+            {
+                memory.write<uint32_t>(static_cast<uint32_t>(0x4000 + i * 4), data[i]);
+            }
+
+            bool ok = cpu.run(memory) == CPU::RunStatus::Halted;
+            for (size_t i = 0; ok && i < data.size(); i += 2)
+            {
+                uint32_t out = static_cast<uint32_t>(0x6000 + i * 4);
+                ok = memory.read<uint32_t>(out) == reference_cls(data[i]) &&
+                     memory.read<uint32_t>(out + 4) == reference_bext(data[i], data[i + 1]);
+            }
+            if (!ok)
+            {
+                std::cout << "  mismatch: " << implementation.name << ", engine " << static_cast<int>(engine) << std::endl;
+            }
+            passed = passed && ok;
+        }
+    }
+    select_bit_extract(selected);
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - bit operations differ") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_vector_ops()
+{
+    std::cout << "=== Vector ISA: lane-wise ops, saturation, reduction on every engine ===" << std::endl;
+
+    // 64 итерации: A[0x4000], B[0x5000] -> A+B, A-B, VADDS, VSSAT #12 по 0x6000 + k * 0x400;
+    // r3 — сумма VREDSUM(A VADDS B), r12 — VREDSUM накопленного VSPLAT 7
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000000010000000001000000), // ADDI r1, r0, 64
+        UINT32_C(0b10110100000000100100000000000000), // ADDI r2, r0, 0x4000
+        UINT32_C(0b10110100000010010110000000000000), // ADDI r9, r0, 0x6000
+        UINT32_C(0b10110100000010100000000000000111), // ADDI r10, r0, 7
+        UINT32_C(0b10000000111010100000000000000101), // VSPLAT v7, r10
+        UINT32_C(0b11000100010000010000000000000000), // VLD v1, 0(r2)
+        UINT32_C(0b11000100010000100001000000000000), // VLD v2, 0x1000(r2)
+        UINT32_C(0b10000000011000010001000000000001), // VADD v3, v1, v2
+        UINT32_C(0b10000000100000010001000000000010), // VSUB v4, v1, v2
+        UINT32_C(0b10000000101000010001000000000011), // VADDS v5, v1, v2
+        UINT32_C(0b10000000110000010110000000000100), // VSSAT v6, v1, #12
+        UINT32_C(0b11001101001000110000000000000000), // VST v3, 0(r9)
+        UINT32_C(0b11001101001001000000010000000000), // VST v4, 0x400(r9)
+        UINT32_C(0b11001101001001010000100000000000), // VST v5, 0x800(r9)
+        UINT32_C(0b11001101001001100000110000000000), // VST v6, 0xC00(r9)
+        UINT32_C(0b10000001000010000011100000000001), // VADD v8, v8, v7
+        UINT32_C(0b10000001011001010000000000000110), // VREDSUM r11, v5
+        UINT32_C(0b00000000011010110001100000010010), // ADD r3, r3, r11
+        UINT32_C(0b10110100010000100000000000010000), // ADDI r2, r2, 16
+        UINT32_C(0b10110101001010010000000000010000), // ADDI r9, r9, 16
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111110000), // BNE r1, r0, -16
+        UINT32_C(0b10000001100010000000000000000110), // VREDSUM r12, v8
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    const std::vector<uint32_t> edges = { 0, 1, 0xFFFFFFFF, 0x7FFFFFFF, 0x80000000, 0x7FFFFFFE, 0x80000001, 2047, 0xFFFFF800, 2048 };
+    std::vector<uint32_t> a(256), b(256);
+    uint32_t state = 88172645u;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        a[i] = i < edges.size() ? edges[i] : (i % 3 == 0 ? state : state >> (i % 20));
+        b[i] = i < edges.size() ? edges[edges.size() - 1 - i] : (i % 5 == 0 ? ~state : state >> 12);
+    }
+
+    auto saturate = [](int64_t value, int bits)
+    {
+        int64_t max_positive = (int64_t{1} << (bits - 1)) - 1;
+        int64_t min_negative = -(int64_t{1} << (bits - 1));
+        return static_cast<uint32_t>(std::min(max_positive, std::max(min_negative, value)));
+    };
+
+    uint32_t expected_sum = 0;
+    for (size_t i = 0; i < a.size(); i++)
+    {
+        expected_sum += saturate(int64_t{static_cast<int32_t>(a[i])} + static_cast<int32_t>(b[i]), 32);
+    }
+
+    bool passed = true;
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+    {
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_engine(engine);
+        cpu.set_quiet(true);
+        write_code_to_memory(program, memory, cpu);
+        cpu.predecode(memory, 0x1000, 0x1000 + program.size() * 4);
+        for (size_t i = 0; i < a.size(); i++)
+        {
+            memory.write<uint32_t>(static_cast<uint32_t>(0x4000 + i * 4), a[i]);
+            memory.write<uint32_t>(static_cast<uint32_t>(0x5000 + i * 4), b[i]);
+        }
+
+        bool ok = cpu.run(memory) == CPU::RunStatus::Halted && cpu.get_retired() == 5 + 64 * 17 + 3 &&
+                  cpu.get_register(3) == expected_sum && cpu.get_register(12) == 64 * 7 * 4 &&
+                  (engine != CPU::Engine::Jit || !Jit::supported() || cpu.get_jit_stats().blocks_compiled > 0);
+        for (size_t i = 0; ok && i < a.size(); i++)
+        {
+            uint32_t out = static_cast<uint32_t>(0x6000 + i * 4);
+            int32_t x = static_cast<int32_t>(a[i]);
+            int32_t y = static_cast<int32_t>(b[i]);
+            ok = memory.read<uint32_t>(out) == a[i] + b[i] &&
+                 memory.read<uint32_t>(out + 0x400) == a[i] - b[i] &&
+                 memory.read<uint32_t>(out + 0x800) == saturate(int64_t{x} + y, 32) &&
+                 memory.read<uint32_t>(out + 0xC00) == saturate(x, 12);
+        }
+
+        // Векторные регистры — часть снимка состояния
+        CPU::State snapshot = cpu.get_state();
+        cpu.set_vector(8, VectorRegister{});
+        cpu.set_state(snapshot);
+        ok = ok && cpu.get_vector(8).lane[3] == 64 * 7 && cpu.get_vector(1).lane[0] == a[252];
+
+        if (!ok)
+        {
+            std::cout << "  mismatch on engine " << static_cast<int>(engine) << std::endl;
+        }
+        passed = passed && ok;
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - vector results differ") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_trace()
+{
+    std::cout << "=== Trace: binary recording replays to the final state ===" << std::endl;
+
+    const std::string path = "cpu_emulator_test_trace.ctr";
+
+    // Цикл из test_profiler: LD/ST по 0x2000, ADDI+BNE
+    const std::vector<uint32_t> loop =
+    {
+        UINT32_C(0b10110100000000010000000000001010), // ADDI r1, r0, 10
+        UINT32_C(0b10110100000000100010000000000000), // ADDI r2, r0, 0x2000
+        UINT32_C(0b11100100010001000000000000000000), // LD r4, 0(r2)
+        UINT32_C(0b10110100100001000000000000000001), // ADDI r4, r4, 1
+        UINT32_C(0b11011100010001000000000000000000), // ST r4, 0(r2)
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111100), // BNE r1, r0, -4
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    bool passed = true;
+
+    // Лимит останавливает run() посреди цикла; второй run() продолжает ту же трассу
+    {
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_quiet(true);
+        write_code_to_memory(loop, memory, cpu);
+        cpu.set_register(5, 0x12345678);
+        cpu.set_vector(2, VectorRegister{ { 1, 2, 3, 4 } });
+
+        TraceWriter writer(path);
+        cpu.set_tracer(&writer);
+        cpu.set_instruction_limit(20);
+        bool stopped = cpu.run(memory) == CPU::RunStatus::Stopped;
+        cpu.set_instruction_limit(0);
+        bool halted = cpu.run(memory) == CPU::RunStatus::Halted;
+        writer.close();
+
+        TraceReader reader(path);
+        TraceRecord record;
+        uint64_t loads = 0, stores = 0, stops = 0, halts = 0, with_word = 0;
+        uint32_t last_pc = 0;
+        while (reader.next(record))
+        {
+            if (record.is_event)
+            {
+                stops += record.event == TraceEvent::Stop;
+                halts += record.event == TraceEvent::Halt;
+                continue;
+            }
+            last_pc = record.pc;
+            with_word += record.word == loop[(record.pc - 0x1000) / 4];
+            if (record.has_memory)
+            {
+                (record.word >> 26 == 0b111001 ? loads : stores)++;
+            }
+        }
+
+        bool same = true;
+        for (uint8_t i = 0; i < 32; i++)
+        {
+            same = same && reader.get_register(i) == cpu.get_register(i);
+        }
+
+        passed = passed && stopped && halted && same && reader.get_start_pc() == 0x1000 &&
+                 reader.instructions() == cpu.get_retired() && cpu.get_retired() == 54 && with_word == 54 &&
+                 loads == 10 && stores == 10 && stops == 1 && halts == 1 && last_pc == 0x1020 &&
+                 reader.get_register(5) == 0x12345678 && reader.get_vector(2).lane[3] == 4 &&
+                 writer.bytes() == reader.bytes() && writer.instructions() == 54;
+    }
+
+    // Векторная программа: V-регистры и 16-байтные обращения; трасса в разы меньше текстовой
+    {
+        const std::vector<uint32_t> program =
+        {
+            UINT32_C(0b10110100000000010000000001000000), // ADDI r1, r0, 64
+            UINT32_C(0b10110100000000100100000000000000), // ADDI r2, r0, 0x4000
+            UINT32_C(0b11000100010000010000000000000000), // VLD v1, 0(r2)
+            UINT32_C(0b10000000011000010000100000000001), // VADD v3, v1, v1
+            UINT32_C(0b11001100010000110001000000000000), // VST v3, 0x1000(r2)
+            UINT32_C(0b10000000100000110000000000000110), // VREDSUM r4, v3
+            UINT32_C(0b00000000011001000001100000010010), // ADD r3, r3, r4
+            UINT32_C(0b10110100010000100000000000010000), // ADDI r2, r2, 16
+            UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+            UINT32_C(0b01100000001000001111111111111001), // BNE r1, r0, -7
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        };
+
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_quiet(true);
+        write_code_to_memory(program, memory, cpu);
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            memory.write<uint32_t>(0x4000 + i * 4, i * 0x01010101u);
+        }
+
+        uint64_t bytes;
+        {
+            TraceWriter writer(path);
+            cpu.set_tracer(&writer);
+            cpu.run(memory);
+            bytes = writer.bytes();
+        }
+
+        TraceReader reader(path);
+        std::ostringstream text;
+        dump_trace(reader, text);
+
+        bool same = true;
+        for (uint8_t i = 0; i < 32; i++)
+        {
+            same = same && reader.get_register(i) == cpu.get_register(i) &&
+                   std::memcmp(reader.get_vector(i).lane, cpu.get_vector(i).lane, sizeof(VectorRegister)) == 0;
+        }
+
+        passed = passed && same && cpu.get_retired() == 2 + 64 * 8 + 2 && reader.instructions() == cpu.get_retired() &&
+                 text.str().find("VST v3, 4096(r2)") != std::string::npos &&
+                 text.str().find("halted at 0x00001030") != std::string::npos &&
+                 (bytes - TRACE_HEADER_SIZE) * 10 < text.str().size();
+    }
+
+    // Инструкция с ошибкой в трассу не попадает — только событие с PC и адресом
+    {
+        const std::vector<uint32_t> program =
+        {
+            UINT32_C(0b10110100000000011111111111111100), // ADDI r1, r0, -4
+            UINT32_C(0b11100100001000100000000000000000), // LD r2, 0(r1)
+        };
+
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_quiet(true);
+        cpu.set_engine(CPU::Engine::Jit);
+        write_code_to_memory(program, memory, cpu);
+        {
+            TraceWriter writer(path);
+            cpu.set_tracer(&writer);
+            cpu.run(memory);
+        }
+
+        TraceReader reader(path);
+        TraceRecord first, fault;
+        passed = passed && reader.next(first) && !first.is_event && reader.get_register(1) == 0xFFFFFFFC &&
+                 reader.next(fault) && fault.is_event && fault.event == TraceEvent::Fault && fault.pc == 0x1004 &&
+                 fault.fault_address == 0xFFFFFFFC &&
+                 fault.fault_code == static_cast<uint8_t>(CPU::Fault::MemoryAccess) && !reader.next(fault);
+    }
+
+    std::remove(path.c_str());
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - trace does not replay") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_checked()
+{
+    std::cout << "=== Checked run: stale decode cache is reported ===" << std::endl;
+
+    // Цикл из test_profiler: ADDI+BNE сливаются при предекодировании
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000000010000000000001010), // ADDI r1, r0, 10
+        UINT32_C(0b10110100000000100010000000000000), // ADDI r2, r0, 0x2000
+        UINT32_C(0b11100100010001000000000000000000), // LD r4, 0(r2)
+        UINT32_C(0b10110100100001000000000000000001), // ADDI r4, r4, 1
+        UINT32_C(0b11011100010001000000000000000000), // ST r4, 0(r2)
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111100), // BNE r1, r0, -4
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    bool passed = true;
+    for (bool checked : { false, true })
+    {
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_quiet(true);
+        cpu.set_checked(checked);
+        write_code_to_memory(program, memory, cpu);
+        cpu.predecode(memory, 0x1000, 0x1000 + program.size() * 4);
+
+        // BNE переписан в обход invalidate_code: в кэше осталась слитая пара со старым смещением
+        memory.write<uint32_t>(0x1018, UINT32_C(0b01100000001000001111111111111101)); // BNE r1, r0, -3
+
+        bool thrown = false;
+        try
+        {
+            cpu.run(memory);
+        }
+        catch (const std::logic_error& e)
+        {
+            thrown = std::string(e.what()).find("0x1014") != std::string::npos;
+        }
+
+        // Быстрый цикл кэшу верит и доходит до конца по старому коду
+        passed = passed && (checked ? thrown : !thrown && cpu.get_retired() == 54);
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - stale entry not detected") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+// tests/aot_sample.cpp — вывод транслятора для этой программы (cpu_emulator aot aot_sample.bin
+// -o tests/aot_sample.cpp --name aot_sample). Если трансляция изменилась, новый вывод
+// пишется рядом в aot_sample.cpp.new
+extern const AotProgram aot_sample;
+
+void test_aot()
+{
+    std::cout << "=== AOT: translated program matches the interpreter ===" << std::endl;
+
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000000010000000001100100), // ADDI r1, r0, 100
+        UINT32_C(0b10110100000000100010000000000000), // ADDI r2, r0, 0x2000
+        UINT32_C(0b11100100010001000000000000000000), // LD r4, 0(r2)
+        UINT32_C(0b00000000100000010010000000010010), // ADD r4, r4, r1
+        UINT32_C(0b00000001001001000000000000001010), // CLS r9, r4
+        UINT32_C(0b00110101010001001010000000000000), // SSAT r10, r4, 20
+        UINT32_C(0b11011100010010100000010000000000), // ST r10, 0x400(r2)
+        UINT32_C(0b10110100010000100000000000000100), // ADDI r2, r2, 4
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111001), // BNE r1, r0, -7
+        UINT32_C(0b00000001011001000100100000010100), // BEXT r11, r4, r9
+        UINT32_C(0b01110001100000000011100000000000), // SBIT r12, 7
+        UINT32_C(0b00000001011011000001100000110110), // SUB r3, r11, r12
+        UINT32_C(0b10110100000011010011000000000000), // ADDI r13, r0, 0x3000
+        UINT32_C(0b01010101101000110110000000000000), // STP r3, r12, 0(r13)
+        UINT32_C(0b10110101101011100000000000010000), // ADDI r14, r13, 0x10
+        UINT32_C(0b00000001110000000110000000011110), // CAS r12, r14, r0
+        UINT32_C(0b00000000000000000000000000111000), // FENCE
+        UINT32_C(0b11000101101000010000000000000000), // VLD v1, 0(r13)
+        UINT32_C(0b10000000010001000000000000000101), // VSPLAT v2, r4
+        UINT32_C(0b10000000011000010001000000000011), // VADDS v3, v1, v2
+        UINT32_C(0b11001101101000110000000000100000), // VST v3, 0x20(r13)
+        UINT32_C(0b10000001111000110000000000000110), // VREDSUM r15, v3
+        UINT32_C(0b01101000101000000000000000000011), // BEQ r5, r0, +3
+        UINT32_C(0b10110100000100000001000001101000), // ADDI r16, r0, 0x1068
+        UINT32_C(0b11011110000000000000000000000000), // ST r0, 0(r16) (портит ADD ниже)
+        UINT32_C(0b00000000011011110001100000010010), // ADD r3, r3, r15
+        UINT32_C(0b01101000110000000000000000000011), // BEQ r6, r0, +3
+        UINT32_C(0b10110100000100101111111111111100), // ADDI r18, r0, -4
+        UINT32_C(0b11100110010100110000000000000000), // LD r19, 0(r18) (ошибка доступа)
+        UINT32_C(0b10110100000010000000000000000001), // ADDI r8, r0, 1 (PRINT_INT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b01111100000000000000010000100010), // J 0x1088
+        UINT32_C(0b10110100000000110000000000000111), // ADDI r3, r0, 7 (недостижима)
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    auto load = [&](Machine& machine)
+    {
+        for (size_t i = 0; i < program.size(); i++)
+        {
+            machine.get_memory().write<uint32_t>(0x1000 + i * 4, program[i]);
+        }
+        for (uint32_t i = 0; i < 100; i++)
+        {
+            machine.get_memory().write<uint32_t>(0x2000 + i * 4, i * 40503u - 2000000u);
+        }
+        machine.prepare_code(0x1000, 0x1000 + program.size() * 4);
+        machine.set_start_address(0x1000);
+        machine.get_cpu().set_quiet(true);
+    };
+
+    bool passed = true;
+
+    Machine source;
+    load(source);
+    AotOptions options;
+    options.name = "aot_sample";
+    options.source = "aot_sample.bin";
+    std::string text = translate_to_cpp(source.get_memory(), { { 0x1000, 0x1000 + program.size() * 4 } }, 0x1000,
+                                        options);
+    std::ifstream golden(AOT_SAMPLE_PATH);
+    std::stringstream expected;
+    expected << golden.rdbuf();
+    if (text != expected.str())
+    {
+        std::ofstream(AOT_SAMPLE_PATH ".new") << text;
+        std::cout << "  translation differs from " << AOT_SAMPLE_PATH << std::endl;
+        passed = false;
+    }
+
+    // r5 != 0 — запись в оттранслированный код (дальше интерпретатор и его ошибка),
+    // r6 != 0 — выход за память, ловушку поднимает интерпретатор
+    for (uint8_t variant : { 0, 5, 6 })
+    {
+        Machine interpreted, translated;
+        BufferedIO interpreted_io, translated_io;
+        load(interpreted);
+        load(translated);
+        interpreted.get_cpu().set_io(interpreted_io);
+        translated.get_cpu().set_io(translated_io);
+        if (variant)
+        {
+            interpreted.get_cpu().set_register(variant, 1);
+            translated.get_cpu().set_register(variant, 1);
+        }
+
+        CPU::RunStatus expected_status = interpreted.run();
+        CPU::RunStatus status = run_aot(aot_sample, translated);
+
+        passed = passed && status == expected_status &&
+                 same_state(interpreted.get_cpu(), interpreted.get_memory(), translated.get_cpu(),
+                            translated.get_memory()) &&
+                 interpreted_io.output() == translated_io.output() &&
+                 (variant == 0) == (status == CPU::RunStatus::Halted);
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - AOT differs from the interpreter") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_event_loop()
+{
+    std::cout << "=== Event loop: guests wait for input without blocking threads ===" << std::endl;
+
+    // Счёт на 2000 итераций, затем два числа из ввода и их сумма
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000000010000011111010000), // ADDI r1, r0, 2000
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111111), // BNE r1, r0, -1
+        UINT32_C(0b10110100000010000000000000000011), // ADDI r8, r0, 3 (READ_INT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b00000000000000110010100000010010), // ADD r5, r0, r3
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b00000000011001010001100000010010), // ADD r3, r3, r5
+        UINT32_C(0b10110100000010000000000000000001), // ADDI r8, r0, 1 (PRINT_INT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+    const uint32_t code_end = 0x1000 + static_cast<uint32_t>(program.size()) * 4;
+
+    bool passed = true;
+
+    // Один CPU: run() останавливается перед SYSCALL и продолжает с него, когда ввод готов.
+    // Число без пробела после него ещё не готово: его хвост может быть в пути
+    std::vector<uint64_t> retired;
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded, CPU::Engine::Jit })
+    {
+        int in[2], out[2];
+        if (pipe(in) != 0 || pipe(out) != 0)
+        {
+            passed = false;
+            break;
+        }
 
-void test_(const std::vector<uint32_t>& program, uint32_t expected_result, const std::string& test_name)
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_engine(engine);
+        cpu.set_quiet(true);
+        FdIO io(in[0], out[1]);
+        cpu.set_io(io);
+        write_code_to_memory(program, memory, cpu);
+        cpu.predecode(memory, 0x1000, code_end);
+
+        passed = passed && write(in[1], "40", 2) == 2 && io.fill();
+        passed = passed && cpu.run(memory) == CPU::RunStatus::Stopped &&
+                 cpu.get_stop_reason() == CPU::StopReason::InputWait && cpu.get_pc() == 0x1010 &&
+                 cpu.get_fault() == CPU::Fault::None;
+        retired.push_back(cpu.get_retired());
+
+        passed = passed && write(in[1], " 2", 2) == 2 && io.fill();
+        passed = passed && cpu.step(memory) == CPU::RunStatus::Running && cpu.get_register(3) == 40;
+        passed = passed && cpu.run(memory) == CPU::RunStatus::Stopped && cpu.get_pc() == 0x1018;
+
+        close(in[1]);
+        passed = passed && io.fill() && io.at_end();
+        passed = passed && cpu.run(memory) == CPU::RunStatus::Halted && io.drain();
+
+        char text[16] = {};
+        passed = passed && read(out[0], text, sizeof(text)) == 3 && std::string(text) == "42\n";
+
+        close(in[0]);
+        close(out[0]);
+        close(out[1]);
+    }
+    passed = passed && retired.size() == 3 && retired[0] == 4002 &&
+             std::count(retired.begin(), retired.end(), retired[0]) == 3;
+
+    // Много гостей на двух потоках; ввод приходит по частям, пока цикл уже работает
+    const size_t guests = 64;
+    SchedulerOptions options;
+    options.threads = 2;
+    options.quantum = 1000;
+    EventLoop loop(options);
+
+    std::vector<int> inputs, outputs;
+    std::vector<CPU::RunStatus> statuses(guests, CPU::RunStatus::Running);
+    for (size_t k = 0; k < guests && passed; k++)
+    {
+        int in[2], out[2];
+        if (pipe(in) != 0 || pipe(out) != 0)
+        {
+            passed = false;
+            break;
+        }
+        inputs.push_back(in[1]);
+        outputs.push_back(out[0]);
+
+        auto machine = std::make_unique<Machine>();
+        write_code_to_memory(program, machine->get_memory(), machine->get_cpu());
+        machine->prepare_code(0x1000, code_end);
+        machine->set_engine(k % 2 ? CPU::Engine::Threaded : CPU::Engine::Switch);
+
+        int input_read = in[0], output_write = out[1];
+        loop.add(std::move(machine), input_read, output_write,
+                 [&statuses, k, input_read, output_write](Machine&, CPU::RunStatus status)
+                 {
+                     statuses[k] = status;
+                     close(input_read);
+                     close(output_write);
+                 });
+    }
+
+    std::thread runner([&loop] { loop.run(); });
+
+    for (size_t k = 0; k < inputs.size(); k++)
+    {
+        std::string first = std::to_string(k) + "\n";
+        passed = passed && write(inputs[k], first.data(), first.size()) == static_cast<ssize_t>(first.size());
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    for (size_t k = 0; k < inputs.size(); k++)
+    {
+        passed = passed && write(inputs[k], "100", 3) == 3;
+        close(inputs[k]);
+    }
+    runner.join();
+
+    for (size_t k = 0; k < outputs.size(); k++)
+    {
+        char text[16] = {};
+        ssize_t count = read(outputs[k], text, sizeof(text) - 1);
+        passed = passed && count > 0 && std::string(text) == std::to_string(k + 100) + "\n" &&
+                 statuses[k] == CPU::RunStatus::Halted;
+        close(outputs[k]);
+    }
+
+    // Сколько раз гости ждали ввода, зависит от того, как быстро стартовали потоки:
+    // ввод может успеть прийти целиком. Само ожидание проверено выше на одном CPU
+    EventLoop::Stats stats = loop.get_stats();
+    passed = passed && stats.guests == guests && stats.quanta >= guests * 4 && loop.get_scheduler().size() == guests;
+    for (Scheduler::GuestId id = 0; id < loop.get_scheduler().size(); id++)
+    {
+        passed = passed && loop.get_scheduler().get_guest_stats(id).state == Scheduler::State::Done;
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - suspended guests lost input or output") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_scheduler()
 {
-    std::cout << "=== " << test_name << " ===" << std::endl;
-    Memory memory(64 * 1024);
-    CPU cpu;
+    std::cout << "=== Scheduler: quanta, weights and waiting guests ===" << std::endl;
 
-    write_code_to_memory(program, memory, cpu);
-    cpu.run(memory);
+    const std::vector<uint32_t> countdown =
+    {
+        UINT32_C(0b01110000001000000111000000000000), // SBIT r1, 14
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111111), // BNE r1, r0, -1
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+    const uint64_t countdown_length = 1 + 2 * 16384 + 2;
+    const std::vector<uint32_t> forever =
+    {
+        UINT32_C(0b01111100000000000000010000000000), // J 0x1000
+    };
+    const std::vector<uint32_t> read_one =
+    {
+        UINT32_C(0b10110100000010000000000000000011), // ADDI r8, r0, 3 (READ_INT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
 
-    uint32_t result = cpu.get_register(3); // r3
-    std::cout << "Result: r3 = " << result << std::endl;
+    auto make = [](const std::vector<uint32_t>& program)
+    {
+        auto machine = std::make_unique<Machine>();
+        write_code_to_memory(program, machine->get_memory(), machine->get_cpu());
+        machine->prepare_code(0x1000, 0x1000 + static_cast<uint32_t>(program.size()) * 4);
+        return machine;
+    };
 
-    if (result == expected_result)
+    bool passed = true;
+
+    // Веса 1, 2, 4 на одном потоке: когда тяжёлый гость закончил, остальные прошли четверть и половину
     {
-        std::cout << "✓ TEST PASSED" << std::endl;
+        SchedulerOptions options;
+        options.quantum = 512;
+        Scheduler scheduler(options);
+
+        Scheduler::GuestStats light, middle;
+        Scheduler::GuestId a = scheduler.add(make(countdown), 1);
+        Scheduler::GuestId b = scheduler.add(make(countdown), 2);
+        scheduler.add(make(countdown), 4, [&](Scheduler::GuestId, Machine&, CPU::RunStatus)
+        {
+            light = scheduler.get_guest_stats(a);
+            middle = scheduler.get_guest_stats(b);
+        });
+        scheduler.run();
+
+        auto near = [](uint64_t value, uint64_t expected) { return value + 1024 >= expected && value <= expected + 1024; };
+        passed = passed && near(light.instructions, countdown_length / 4) && near(middle.instructions, countdown_length / 2);
+
+        for (Scheduler::GuestId id = 0; id < 3; id++)
+        {
+            Scheduler::GuestStats stats = scheduler.get_guest_stats(id);
+            passed = passed && stats.state == Scheduler::State::Done && stats.status == CPU::RunStatus::Halted &&
+                     stats.instructions == countdown_length && stats.quanta > 8 && stats.cpu_seconds > 0;
+        }
+        passed = passed && scheduler.get_stats().switches > 0 && scheduler.get_stats().finished == 3;
     }
-    else
+
+    // Бесконечный цикл не отнимает поток у соседа и останавливается по max_instructions
     {
-        std::cout << "✗ TEST FAILED - Expected " << expected_result << ", got " << result << std::endl;
+        SchedulerOptions options;
+        options.quantum = 1000;
+        options.max_instructions = 100000;
+        Scheduler scheduler(options);
+
+        uint64_t spun = 0;
+        Scheduler::GuestId spinner = scheduler.add(make(forever));
+        scheduler.add(make(countdown), 1, [&](Scheduler::GuestId, Machine&, CPU::RunStatus)
+        {
+            spun = scheduler.get_guest_stats(spinner).instructions;
+        });
+        scheduler.run();
+
+        Scheduler::GuestStats stats = scheduler.get_guest_stats(spinner);
+        passed = passed && spun > 0 && spun < 50000 && stats.status == CPU::RunStatus::Stopped &&
+                 stats.instructions == 100000;
+    }
+
+    // Интерпретаторы сверяют квант только в конце блока: каждый квант кончается на J
+    for (CPU::Engine engine : { CPU::Engine::Switch, CPU::Engine::Threaded })
+    {
+        std::vector<uint32_t> block(63, UINT32_C(0b10110100001000010000000000000001)); // ADDI r1, r1, 1
+        block.push_back(UINT32_C(0b01111100000000000000010000000000));                   // J 0x1000
+
+        SchedulerOptions options;
+        options.quantum = 1000;
+        options.max_instructions = 10000;
+        Scheduler scheduler(options);
+
+        std::unique_ptr<Machine> machine = make(block);
+        machine->set_engine(engine);
+        Scheduler::GuestId id = scheduler.add(std::move(machine));
+        scheduler.run();
+
+        Scheduler::GuestStats stats = scheduler.get_guest_stats(id);
+        const CPU& cpu = scheduler.get_machine(id).get_cpu();
+        passed = passed && stats.status == CPU::RunStatus::Stopped && stats.instructions % 64 == 0 &&
+                 stats.instructions >= 10000 && stats.instructions < 10000 + 64 &&
+                 cpu.get_pc() == 0x1000 && cpu.get_register(1) == stats.instructions / 64 * 63;
+    }
+
+    // Несколько потоков; гость, добавленный из Done, тоже исполняется
+    {
+        SchedulerOptions options;
+        options.threads = 4;
+        options.quantum = 4096;
+        Scheduler scheduler(options);
+
+        bool added = false;
+        for (int k = 0; k < 16; k++)
+        {
+            scheduler.add(make(countdown), 1 + k % 3, [&](Scheduler::GuestId id, Machine&, CPU::RunStatus)
+            {
+                if (id == 0 && !added)
+                {
+                    added = true;
+                    scheduler.add(make(countdown));
+                }
+            });
+        }
+        scheduler.run();
+
+        passed = passed && scheduler.size() == 17 && scheduler.get_stats().finished == 17;
+        for (Scheduler::GuestId id = 0; id < scheduler.size(); id++)
+        {
+            passed = passed && scheduler.get_guest_stats(id).instructions == countdown_length;
+        }
+    }
+
+    // Гость без ввода ждёт, run() возвращается; после wake() следующий run() его продолжает
+    {
+        int in[2], out[2];
+        if (pipe(in) == 0 && pipe(out) == 0)
+        {
+            Scheduler scheduler;
+            FdIO io(in[0], out[1]);
+            auto machine = make(read_one);
+            machine->get_cpu().set_io(io);
+            Scheduler::GuestId id = scheduler.add(std::move(machine));
+
+            scheduler.run();
+            passed = passed && scheduler.get_guest_stats(id).state == Scheduler::State::Waiting;
+
+            passed = passed && write(in[1], "5\n", 2) == 2 && io.fill();
+            scheduler.wake(id);
+            scheduler.run();
+
+            Scheduler::GuestStats stats = scheduler.get_guest_stats(id);
+            passed = passed && stats.state == Scheduler::State::Done && stats.waits == 1 &&
+                     scheduler.get_machine(id).get_cpu().get_register(3) == 5;
+
+            close(in[0]);
+            close(in[1]);
+            close(out[0]);
+            close(out[1]);
+        }
+        else
+        {
+            passed = false;
+        }
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - scheduler shares or stops guests incorrectly") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_cache_model()
+{
+    std::cout << "=== Cache model: replacement, write-back and per-PC misses ===" << std::endl;
+
+    bool passed = true;
+
+    // Два набора по два пути: строки 0, 128 и 256 попадают в один набор
+    auto replay = [](Replacement replacement)
+    {
+        Cache cache({ 256, 2, 64, replacement });
+        uint32_t writeback;
+        std::string hits;
+        for (uint32_t address : { 0u, 128u, 4u, 256u, 128u, 0u })
+        {
+            hits += cache.access(address, address == 4, writeback) ? 'h' : 'm';
+        }
+        return hits;
+    };
+    passed = passed && replay(Replacement::Lru) == "mmhmmm" && replay(Replacement::Fifo) == "mmhmhm";
+
+    {
+        Cache cache({ 256, 2, 64, Replacement::Lru });
+        uint32_t writeback;
+        cache.access(0, true, writeback);
+        cache.access(128, false, writeback);
+        cache.access(256, false, writeback);
+        passed = passed && writeback == 0 && cache.get_stats().writebacks == 1 && cache.get_stats().misses == 3;
+    }
+
+    // Проход по 4 КиБ словами: промах на каждую 64-байтную строку
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000000100010000000000000), // ADDI r2, r0, 0x2000
+        UINT32_C(0b10110100000000010000010000000000), // ADDI r1, r0, 1024
+        UINT32_C(0b11100100010000110000000000000000), // LD r3, 0(r2)
+        UINT32_C(0b10110100010000100000000000000100), // ADDI r2, r2, 4
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111101), // BNE r1, r0, -3
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    std::vector<CacheModel::PcCounters> seen;
+    for (bool stepping : { false, true })
+    {
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_quiet(true);
+        CacheModel model;
+        cpu.set_cache_model(&model);
+        write_code_to_memory(program, memory, cpu);
+        cpu.predecode(memory, 0x1000, 0x1000 + program.size() * 4);
+
+        if (stepping)
+        {
+            while (cpu.step(memory) == CPU::RunStatus::Running) {}
+        }
+        else
+        {
+            passed = passed && cpu.run(memory) == CPU::RunStatus::Halted;
+        }
+
+        const CacheModel::PcCounters* load = model.find(0x1008);
+        passed = passed && load && load->data.accesses == 1024 && load->data.l1_misses == 64 &&
+                 load->data.l2_misses == 64 && load->fetch.accesses == 1024 &&
+                 model.get_l1i().get_stats().misses == 1 && model.get_l1d().get_stats().misses == 64 &&
+                 model.find_region(0x2000) && model.find_region(0x2000)->accesses == 1024 &&
+                 !model.find_region(0x3000) &&
+                 !model.find(0x1000 + program.size() * 4) && cpu.get_retired() == 4 * 1024 + 4;
+        if (load)
+        {
+            seen.push_back(*load);
+        }
+
+        std::ostringstream report;
+        model.report(report, memory);
+        passed = passed && report.str().find("LD r3, 0(r2)") != std::string::npos;
+    }
+    passed = passed && seen.size() == 2 && seen[0].data.l1_misses == seen[1].data.l1_misses;
+
+    // Невыровненный ST ничего не пишет — и в кэш данных не попадает
+    {
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_quiet(true);
+        CacheModel model;
+        cpu.set_cache_model(&model);
+        write_code_to_memory({
+            UINT32_C(0b11011100000000110010000000000001), // ST r3, 0x2001(r0)
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        }, memory, cpu);
+        passed = passed && cpu.run(memory) == CPU::RunStatus::Halted && model.find(0x1000) &&
+                 model.find(0x1000)->data.accesses == 0 && model.get_l1d().get_stats().accesses == 0 &&
+                 !model.find_region(0x2000);
+    }
+
+    // Диапазоны по 4 байта на весь 4 ГиБ: счётчики заводятся только там, куда обращались
+    {
+        CacheModelOptions fine;
+        fine.region_shift = 2;
+        CacheModel model(fine);
+        model.data(0x1000, 0xFFFFFFF0, 4, true);
+        model.data(0x1000, 0x10, 4, false);
+        passed = passed && model.find_region(0xFFFFFFF3) && model.find_region(0xFFFFFFF3)->accesses == 1 &&
+                 model.find_region(0x10) && !model.find_region(0xFFFFFFF4);
+    }
+
+    CacheModelOptions options = parse_cache_options("l1d=16K:4:32:fifo,l2=none");
+    passed = passed && options.l1d.size == 16 * 1024 && options.l1d.ways == 4 && options.l1d.line == 32 &&
+             options.l1d.replacement == Replacement::Fifo && !options.has_l2 && options.l1i.size == 32 * 1024;
+
+    for (const char* bad : { "l3=32K:8:64", "l1d=32K:8", "l1d=32K:8:64:mru", "l1d=3K:8:64" })
+    {
+        try
+        {
+            CacheModel model(parse_cache_options(bad));
+            passed = false;
+        }
+        catch (const std::invalid_argument&)
+        {
+        }
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - cache model counts differ") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_timing_model()
+{
+    std::cout << "=== Timing model: load-use, execute latency and branch predictors ===" << std::endl;
+
+    bool passed = true;
+
+    // 100 проходов: результат LD сразу нужен ADD, CLS — многотактный, BNE назад
+    const std::vector<uint32_t> program =
+    {
+        UINT32_C(0b10110100000000100010000000000000), // ADDI r2, r0, 0x2000
+        UINT32_C(0b10110100000000010000000001100100), // ADDI r1, r0, 100
+        UINT32_C(0b11100100010000110000000000000000), // LD r3, 0(r2)
+        UINT32_C(0b00000000100000110010000000010010), // ADD r4, r4, r3
+        UINT32_C(0b00000000101000110000000000001010), // CLS r5, r3
+        UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+        UINT32_C(0b01100000001000001111111111111100), // BNE r1, r0, -4
+        UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+        UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+    };
+
+    auto simulate = [&](const TimingOptions& options, bool stepping, bool caches)
+    {
+        Memory memory(64 * 1024);
+        CPU cpu;
+        cpu.set_quiet(true);
+        CacheModel cache_model;
+        TimingModel model(options);
+        cpu.set_timing_model(&model);
+        if (caches)
+        {
+            cpu.set_cache_model(&cache_model);
+        }
+        write_code_to_memory(program, memory, cpu);
+        cpu.predecode(memory, 0x1000, 0x1000 + program.size() * 4);
+
+        if (stepping)
+        {
+            while (cpu.step(memory) == CPU::RunStatus::Running) {}
+        }
+        else
+        {
+            passed = passed && cpu.run(memory) == CPU::RunStatus::Halted;
+        }
+
+        std::ostringstream report;
+        model.report(report, memory);
+        passed = passed && report.str().find("BNE") != std::string::npos && model.instructions() == cpu.get_retired();
+        return model;
+    };
+
+    TimingOptions options;
+    options.predictor = PredictorKind::Static;
+    options.cls_latency = 3;
+    TimingModel fixed = simulate(options, false, false);
+    const TimingModel::BranchCounters* loop = fixed.find_branch(0x1018);
+    passed = passed && fixed.instructions() == 504 && fixed.get_stalls().load_use == 100 &&
+             fixed.get_stalls().execute == 200 && fixed.mispredictions() == 1 &&
+             fixed.get_stalls().data_miss == 0 && fixed.cycles() == 504 + 4 + 100 + 200 + 2 &&
+             loop && loop->executed == 100 && loop->taken == 99 && !fixed.find_branch(0x1014);
+
+    options.predictor = PredictorKind::Bimodal;
+    TimingModel bimodal = simulate(options, false, false);
+    TimingModel stepped = simulate(options, true, false);
+    options.predictor = PredictorKind::Gshare;
+    TimingModel gshare = simulate(options, false, false);
+    passed = passed && bimodal.mispredictions() == 2 && stepped.cycles() == bimodal.cycles() &&
+             gshare.mispredictions() > bimodal.mispredictions() && gshare.conditional_branches() == 100;
+
+    // С моделью кэшей промахи становятся простоями
+    TimingModel cached = simulate(options, false, true);
+    passed = passed && cached.get_stalls().fetch_miss > 0 && cached.get_stalls().data_miss > 0 &&
+             cached.cpi() > gshare.cpi();
+
+    options = parse_timing_options("predictor=gshare,bits=14,cls=3,mispredict=5");
+    passed = passed && options.predictor == PredictorKind::Gshare && options.predictor_bits == 14 &&
+             options.cls_latency == 3 && options.mispredict_penalty == 5 && options.bext_latency == 1;
+
+    for (const char* bad : { "predictor=tage", "bits=0", "cls=0", "cls=x", "pipeline=7", "bits" })
+    {
+        try
+        {
+            TimingModel model(parse_timing_options(bad));
+            passed = false;
+        }
+        catch (const std::invalid_argument&)
+        {
+        }
+    }
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - timing model counts differ") << std::endl;
+    std::cout << "------------------------" << std::endl;
+}
+
+void test_assembler()
+{
+    std::cout << "=== Assembler: text syntax, labels and forward references ===" << std::endl;
+
+    bool passed = true;
+
+    // Каждая форма операндов: дизассемблер должен вернуть ту же строку
+    // (у переходов он печатает адрес, в исходнике — метка)
+    const std::vector<std::pair<std::string, std::string>> forms =
+    {
+        { "top: ADDI r1, r0, -5",     "ADDI r1, r0, -5" },
+        { "ADD r3, r1, r2",           "ADD r3, r1, r2" },
+        { "sub r3, r1, r2",           "SUB r3, r1, r2" },
+        { "CAS r3, r1, r2",           "CAS r3, r1, r2" },
+        { "CLS r6, r4",               "CLS r6, r4" },
+        { "BEXT r1, r2, r3",          "BEXT r1, r2, r3" },
+        { "SBIT r3, r0, #5",          "SBIT r3, r0, #5" },
+        { "SSAT r2, r1, #8",          "SSAT r2, r1, #8" },
+        { "LD r3, 16(r1)",            "LD r3, 16(r1)" },
+        { "ST r4, -8(r2)",            "ST r4, -8(r2)" },
+        { "STP r1, r2, 8(r3)",        "STP r1, r2, 8(r3)" },
+        { "SYSCALL",                  "SYSCALL" },
+        { "FENCE",                    "FENCE" },
+        { "VLD v1, (r2)",             "VLD v1, 0(r2)" },
+        { "VST v3, 0x20(r2)",         "VST v3, 32(r2)" },
+        { "VADD v1, v2, v3",          "VADD v1, v2, v3" },
+        { "VSUB v4, v5, v6",          "VSUB v4, v5, v6" },
+        { "VADDS v7, v8, v9",         "VADDS v7, v8, v9" },
+        { "VSSAT v1, v2, #7",         "VSSAT v1, v2, #7" },
+        { "VSPLAT v1, r3",            "VSPLAT v1, r3" },
+        { "VREDSUM r3, v1",           "VREDSUM r3, v1" },
+        { "BNE r1, r0, top",          "BNE r1, r0, 0x1000" },
+        { "BEQ r1, r0, end  # вперёд", "BEQ r1, r0, 0x1060" },
+        { "J top",                    "J 0x1000" },
+        { "end: BEQ r2, r3, #-1",     "BEQ r2, r3, 0x105C" },
+    };
+
+    std::string source;
+    for (const auto& form : forms)
+    {
+        source += form.first + "\n";
+    }
+    Assembly assembly = assemble(source);
+    const std::vector<uint8_t>& code = assembly.segments.front().bytes;
+    passed = passed && assembly.instructions == forms.size() && code.size() == forms.size() * 4 &&
+             assembly.segments.size() == 1 && assembly.symbols.size() == 2;
+    for (size_t i = 0; passed && i < forms.size(); i++)
+    {
+        uint32_t word;
+        std::memcpy(&word, code.data() + i * 4, 4);
+        uint32_t pc = 0x1000 + static_cast<uint32_t>(i) * 4;
+        if (disassemble(word, pc) != forms[i].second)
+        {
+            std::cout << "  " << forms[i].first << " -> " << disassemble(word, pc) << std::endl;
+            passed = false;
+        }
+    }
+
+    uint32_t addi;
+    std::memcpy(&addi, assemble("ADDI r1, r0, 5").segments.front().bytes.data(), 4);
+    passed = passed && addi == UINT32_C(0b10110100000000010000000000000101);
+
+    // Программа с данными и BSS грузится как файл .s
+    const std::string path = "test_assembler.s";
+    {
+        std::ofstream file(path);
+        file << R"(        .entry start
+        .data
+values: .word 1, 2, 3, 4
+        .ascii "sum\n"
+        .bss
+        .align 16
+buffer: .space 64
+
+        .text
+skipped:
+        ADDI r3, r0, 77         // не исполняется: вход — start
+start:  ADDI r2, r0, values
+        ADDI r1, r0, 4
+        ADDI r3, r0, 0
+loop:   LD r4, 0(r2)
+        ADD r3, r3, r4
+        ADDI r2, r2, 4
+        ADDI r1, r1, -1
+        BNE r1, r0, loop
+        ST r3, buffer(r0)
+        J done
+        ADDI r3, r0, 99
+done:   ADDI r8, r0, 0          ; SYS_EXIT
+        SYSCALL
+)";
+    }
+
+    Machine machine;
+    machine.get_cpu().set_quiet(true);
+    LoadedImage image = machine.load(path);
+    std::remove(path.c_str());
+
+    passed = passed && machine.run() == CPU::RunStatus::Halted && machine.get_cpu().get_register(3) == 10 &&
+             image.entry == 0x1004 && image.segments.size() == 3 && image.segments[1].address == 0x2000 &&
+             image.segments[2].address == 0x3000 && machine.get_memory().read<uint32_t>(0x3000) == 10 &&
+             machine.get_memory().read<uint8_t>(0x2010) == 's' && image.symbols.size() == 6;
+
+    // Ошибки — с номером строки
+    const std::vector<std::pair<std::string, size_t>> errors =
+    {
+        { "ADDI r1, r0, 1\nMUL r1, r2, r3", 2 },
+        { "BNE r1, r0, nowhere", 1 },
+        { "a: ADDI r1, r0, 1\na: SYSCALL", 2 },
+        { "ADDI r1, r0, 40000", 1 },
+        { "ADD r32, r0, r1", 1 },
+        { "SBIT r1, r0, #32", 1 },
+        { "LD r1, 8 r2", 1 },
+        { ".data\nADD r1, r2, r3", 2 },
+        { "ADDI r1, r0, far\n.data\n.space 70000\nfar: .word 0", 1 },
+    };
+    for (const auto& error : errors)
+    {
+        try
+        {
+            assemble(error.first);
+            passed = false;
+        }
+        catch (const AssemblyError& e)
+        {
+            passed = passed && e.get_line() == error.second;
+        }
+    }
+
+    // Большая программа — за один проход
+    std::string large;
+    for (int k = 0; k < 100000; k++)
+    {
+        large += "l" + std::to_string(k) + ": ADDI r1, r1, 1\n        BNE r1, r0, l" + std::to_string(k + 1) + "\n";
     }
+    large += "l100000: SYSCALL\n";
+    Assembly big = assemble(large);
+    passed = passed && big.instructions == 200001 && big.symbols.size() == 100001;
+
+    std::cout << (passed ? "✓ TEST PASSED" : "✗ TEST FAILED - assembler output differs") << std::endl;
     std::cout << "------------------------" << std::endl;
 }
+
 void tests()
 {
     // Тест 1: ADDI + ADD (базовая арифметика)
@@ -216,11 +2212,231 @@ test_(
         7,
         "SYSCALL: system call execution"
     );
+
+    // Тест 14: самомодифицирующийся код — ST поверх уже закэшированной инструкции
+    test_(
+        {
+            UINT32_C(0b10110100000000110000000000000000), // ADDI r3, r0, 0
+            UINT32_C(0b10110100000001010000000000000010), // ADDI r5, r0, 2
+            UINT32_C(0b10110100011000110000000000000001), // ADDI r3, r3, 1 (patched at 0x1008)
+            UINT32_C(0b11100100000001100001000000100100), // LD r6, 0x1024(r0)
+            UINT32_C(0b11011100000001100001000000001000), // ST r6, 0x1008(r0)
+            UINT32_C(0b10110100101001011111111111111111), // ADDI r5, r5, -1
+            UINT32_C(0b01100000101000001111111111111100), // BNE r5, r0, -4
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            UINT32_C(0b10110100011000110000000001100100), // data: ADDI r3, r3, 100
+        },
+        101,
+        "Decode cache: ST invalidates cached instruction"
+    );
+
+    // Тест 15: горячий цикл — блок уходит в JIT
+    test_(
+        {
+            UINT32_C(0b10110100000000010000001111101000), // ADDI r1, r0, 1000
+            UINT32_C(0b10110100000000100000000000000000), // ADDI r2, r0, 0
+            UINT32_C(0b10110100000000110000000000000000), // ADDI r3, r0, 0
+            UINT32_C(0b10110100010000100000000000000001), // ADDI r2, r2, 1
+            UINT32_C(0b00000000011000100001100000010010), // ADD r3, r3, r2
+            UINT32_C(0b01100000010000011111111111111110), // BNE r2, r1, -2
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        500500,
+        "Hot loop: sum 1..1000"
+    );
+
+    // Тест 16: все инструкции в горячем цикле
+    test_(
+        {
+            UINT32_C(0b10110100000000010000000100101100), // ADDI r1, r0, 300
+            UINT32_C(0b10110100000010100000100000000000), // ADDI r10, r0, 0x800
+            UINT32_C(0b10110100000000101111111111111001), // ADDI r2, r0, -7
+            UINT32_C(0b10110100010000100000000000100101), // ADDI r2, r2, 37
+            UINT32_C(0b00000000100000100000000000001010), // CLS r4, r2
+            UINT32_C(0b00000000101000100000100000010100), // BEXT r5, r2, r1
+            UINT32_C(0b00110100110000100100100000000000), // SSAT r6, r2, 9
+            UINT32_C(0b01110000111000000110100000000000), // SBIT r7, r0, 13
+            UINT32_C(0b00000001001001010100100000110110), // SUB r9, r9, r5
+            UINT32_C(0b00000001001001000100100000010010), // ADD r9, r9, r4
+            UINT32_C(0b01010101010001100100100000001000), // STP r6, r9, 8(r10)
+            UINT32_C(0b11100101010010110000000000001000), // LD r11, 8(r10)
+            UINT32_C(0b00000001100010110110000000010010), // ADD r12, r12, r11
+            UINT32_C(0b11011101010000100000000000000000), // ST r2, 0(r10)
+            UINT32_C(0b11100101010011010000000000000000), // LD r13, 0(r10)
+            UINT32_C(0b00000001100011010001100000010010), // ADD r3, r12, r13
+            UINT32_C(0b10110101010010100000000000000100), // ADDI r10, r10, 4
+            UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+            UINT32_C(0b01100000001000001111111111110001), // BNE r1, r0, -15
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        86795,
+        "Hot loop: arithmetic, bit ops and memory"
+    );
+
+    // Тест 17: самомодификация уже оттранслированного блока
+    test_(
+        {
+            UINT32_C(0b10110100000000110000000000000000), // ADDI r3, r0, 0
+            UINT32_C(0b10110100000001010000000011001000), // ADDI r5, r0, 200
+            UINT32_C(0b10110100000001110000000001100100), // ADDI r7, r0, 100
+            UINT32_C(0b11100100000001100001000000110000), // LD r6, 0x1030(r0)
+            UINT32_C(0b10110100011000110000000000000001), // ADDI r3, r3, 1 (patched at 0x1010)
+            UINT32_C(0b10110100101001011111111111111111), // ADDI r5, r5, -1
+            UINT32_C(0b01100000101001110000000000000010), // BNE r5, r7, 2
+            UINT32_C(0b11011100000001100001000000010000), // ST r6, 0x1010(r0)
+            UINT32_C(0b01100000101000001111111111111100), // BNE r5, r0, -4
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+            UINT32_C(0b10110100000000000000000000000000), // padding
+            UINT32_C(0b10110100011000110000000001100100), // data: ADDI r3, r3, 100
+        },
+        10100,
+        "Hot loop: self-modifying code leaves JIT"
+    );
+
+    // Тест 18: суперинструкции — пересылки, ADDI+BNE и ADDI r8+SYSCALL
+    test_(
+        {
+            UINT32_C(0b10110100000000010000000000010100), // ADDI r1, r0, 20
+            UINT32_C(0b10110100000000100000000000000000), // ADDI r2, r0, 0
+            UINT32_C(0b10110100000000110000000000000001), // ADDI r3, r0, 1
+            UINT32_C(0b10110100000001000000000000000001), // ADDI r4, r0, 1
+            UINT32_C(0b00000000010000110011000000010010), // ADD r6, r2, r3
+            UINT32_C(0b00000000000000110001000000010010), // ADD r2, r0, r3 (move)
+            UINT32_C(0b00000000000001100001100000010010), // ADD r3, r0, r6 (move)
+            UINT32_C(0b10110100100001000000000000000001), // ADDI r4, r4, 1
+            UINT32_C(0b01100000100000011111111111111100), // BNE r4, r1, -4
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        6765,
+        "Fusion: fibonacci(20) with fused pairs"
+    );
+
+    // Тест 19: неизвестный opcode после горячего цикла — ловушка, PC на нём
+    test_fault(
+        {
+            UINT32_C(0b10110100000000010000000001100100), // ADDI r1, r0, 100
+            UINT32_C(0b10110100001000011111111111111111), // ADDI r1, r1, -1
+            UINT32_C(0b01100000001000001111111111111111), // BNE r1, r0, -1
+            UINT32_C(0b11111100000000000000000000000000), // unknown opcode 0x3F
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        CPU::Fault::IllegalInstruction, 0x100C,
+        "Fault: illegal instruction is precise"
+    );
+
+    // Тест 20: неизвестный системный вызов (в шитом коде — слитый с ADDI r8)
+    test_fault(
+        {
+            UINT32_C(0b10110100000010000000000000001001), // ADDI r8, r0, 9
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        CPU::Fault::UnknownSyscall, 0x1004,
+        "Fault: unknown syscall"
+    );
+
+    // Тест 21: CAS — неудачный обмен не пишет, оба возвращают прежнее слово
+    test_(
+        {
+            UINT32_C(0b10110100000000100010000000000000), // ADDI r2, r0, 0x2000
+            UINT32_C(0b10110100000001000000000000000101), // ADDI r4, r0, 5
+            UINT32_C(0b11011100010001000000000000000000), // ST r4, 0(r2)
+            UINT32_C(0b10110100000001010000000000000100), // ADDI r5, r0, 4
+            UINT32_C(0b10110100000000110000000000001001), // ADDI r3, r0, 9
+            UINT32_C(0b00000000010001010001100000011110), // CAS r3, r2, r5 (fails, r3 = 5)
+            UINT32_C(0b10110100000001100000000000000111), // ADDI r6, r0, 7
+            UINT32_C(0b00000000010000110011000000011110), // CAS r6, r2, r3 (stores 7, r6 = 5)
+            UINT32_C(0b11100100010001110000000000000000), // LD r7, 0(r2)
+            UINT32_C(0b00000000011001100001100000010010), // ADD r3, r3, r6
+            UINT32_C(0b00000000011001110001100000010010), // ADD r3, r3, r7
+            UINT32_C(0b00000000000000000000000000111000), // FENCE
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        17,
+        "CAS: failed and successful exchange"
+    );
+
+    // Тест 22: CAS по невыровненному адресу — ошибка доступа
+    test_fault(
+        {
+            UINT32_C(0b10110100000000100010000000000010), // ADDI r2, r0, 0x2002
+            UINT32_C(0b00000000010000000001100000011110), // CAS r3, r2, r0
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        CPU::Fault::MemoryAccess, 0x1004,
+        "Fault: misaligned CAS"
+    );
+
+    // Тест 23: строка за пределами памяти — ошибка доступа, ничего не выводится
+    test_fault(
+        {
+            UINT32_C(0b10110100000000111111111111111100), // ADDI r3, r0, -4
+            UINT32_C(0b10110100000001000000000000010000), // ADDI r4, r0, 16
+            UINT32_C(0b10110100000010000000000000000010), // ADDI r8, r0, 2 (PRINT_STR)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        CPU::Fault::MemoryAccess, 0x100C,
+        "Fault: SYS_PRINT_STR out of range"
+    );
+
+    // Тест 24: VLD через конец памяти в горячем цикле — ошибка доступа на нём
+    test_fault(
+        {
+            UINT32_C(0b01110000010000000111100000000000), // SBIT r2, 15
+            UINT32_C(0b11000100010000010000000000000000), // VLD v1, 0(r2)
+            UINT32_C(0b10110100010000100000000000001000), // ADDI r2, r2, 8
+            UINT32_C(0b01100000010000001111111111111110), // BNE r2, r0, -2
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        CPU::Fault::MemoryAccess, 0x1004,
+        "Fault: VLD straddles the end of memory"
+    );
+
+    // Тест 25: то же для VST
+    test_fault(
+        {
+            UINT32_C(0b01110000010000000111100000000000), // SBIT r2, 15
+            UINT32_C(0b11001100010000010000000000000000), // VST v1, 0(r2)
+            UINT32_C(0b10110100010000100000000000001000), // ADDI r2, r2, 8
+            UINT32_C(0b01100000010000001111111111111110), // BNE r2, r0, -2
+            UINT32_C(0b10110100000010000000000000000000), // ADDI r8, r0, 0 (EXIT)
+            UINT32_C(0b00000000000000000000000000101000), // SYSCALL
+        },
+        CPU::Fault::MemoryAccess, 0x1004,
+        "Fault: VST straddles the end of memory"
+    );
 }
 
 #ifdef RUN_TESTS
 int main() {
     tests();
+    test_memory_traps();
+    test_image_loader();
+    test_snapshots();
+    test_batch_runner();
+    test_lockstep();
+    test_harts();
+    test_syscall_io();
+    test_profiler();
+    test_run_limits();
+    test_bit_ops();
+    test_vector_ops();
+    test_trace();
+    test_checked();
+    test_aot();
+    test_event_loop();
+    test_scheduler();
+    test_cache_model();
+    test_timing_model();
+    test_assembler();
     return 0;
 }
 #endif